@@ -0,0 +1,179 @@
+#include "AssetPack.h"
+#include "MappedFile.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include "Image.h"
+#include <unordered_map>
+#include <cstring>
+#include <filesystem>
+
+namespace AssetPack
+{
+
+enum class PackState
+{
+    Unopened,
+    Open,
+    Unavailable,
+};
+
+static PackState s_state = PackState::Unopened;
+static MappedFile s_file;
+// The loose files changed after this are newer than their packed copies
+static std::filesystem::file_time_type s_packWriteTime;
+static std::unordered_map<std::string_view, const PackEntry*> s_entries;
+
+static bool isEntryValid(const PackEntry& entry, size_t packSize)
+{
+    if (std::memchr(entry.name, '\0', ASSET_PACK_NAME_LEN) == nullptr
+     || entry.offset % ASSET_PACK_ALIGNMENT != 0
+     || entry.offset > packSize
+     || entry.size > packSize-entry.offset)
+        return false;
+
+    switch (entry.type)
+    {
+    case AssetType::Texture:
+        return entry.params[0] > 0 && entry.params[1] > 0
+            && (int)entry.params[2] == Image::getMipLevelCount(entry.params[0], entry.params[1])
+            && entry.size == Image::getMipChainSize(entry.params[0], entry.params[1], entry.params[2]);
+
+    case AssetType::Mesh:
+        return entry.size == (uint64_t)entry.params[0]*sizeof(float)+(uint64_t)entry.params[1]*sizeof(uint32_t);
+
+    case AssetType::Shader:
+        return true;
+    }
+    return false;
+}
+
+static void open()
+{
+    PROFILE_ZONE("AssetPack::open");
+    s_state = PackState::Unavailable;
+
+    if (!s_file.open(ASSET_PACK_PATH))
+    {
+        Logger::warn << "No asset pack found (" << ASSET_PACK_PATH << "), loading loose files" << Logger::End;
+        return;
+    }
+
+    PackHeader header;
+    if (s_file.size() < sizeof(header))
+    {
+        Logger::warn << "Asset pack is truncated, loading loose files" << Logger::End;
+        s_file.close();
+        return;
+    }
+    std::memcpy(&header, s_file.data(), sizeof(header));
+    if (std::memcmp(header.magic, ASSET_PACK_MAGIC, 4) != 0
+     || header.version != ASSET_PACK_VERSION
+     || header.entryCount > (s_file.size()-sizeof(header))/sizeof(PackEntry))
+    {
+        Logger::warn << "Asset pack is invalid or outdated (version " << header.version
+            << ", expected " << ASSET_PACK_VERSION << "), loading loose files. Rebake it with `acraft-bake`." << Logger::End;
+        s_file.close();
+        return;
+    }
+
+    const auto* entries = (const PackEntry*)(s_file.data()+sizeof(header));
+    for (uint32_t i{}; i < header.entryCount; ++i)
+    {
+        if (!isEntryValid(entries[i], s_file.size()))
+        {
+            Logger::warn << "Asset pack has an invalid entry, loading loose files" << Logger::End;
+            s_entries.clear();
+            s_file.close();
+            return;
+        }
+        s_entries.emplace(std::string_view{entries[i].name}, entries+i);
+    }
+
+    std::error_code ec;
+    s_packWriteTime = std::filesystem::last_write_time(ASSET_PACK_PATH, ec);
+    s_state = PackState::Open;
+    Logger::log << "Opened asset pack with " << header.entryCount << " assets ("
+        << s_file.size()/1024 << " KiB)" << Logger::End;
+}
+
+static const PackEntry* findEntry(const std::string& path, AssetType type)
+{
+    if (!isAvailable())
+        return nullptr;
+
+    const auto found = s_entries.find(pathToName(path));
+    if (found == s_entries.end())
+    {
+        Logger::warn << "Asset not found in pack: " << path << Logger::End;
+        return nullptr;
+    }
+    if (found->second->type != type)
+    {
+        Logger::warn << "Asset has unexpected type in pack: " << path << Logger::End;
+        return nullptr;
+    }
+    // Edited since the pack was baked, missing loose files are fine
+    std::error_code ec;
+    const auto looseWriteTime = std::filesystem::last_write_time(path, ec);
+    if (!ec && looseWriteTime > s_packWriteTime)
+    {
+        Logger::warn << "Asset pack is older than " << path << ", loading the loose file. Rebake it with `acraft-bake`."
+            << Logger::End;
+        return nullptr;
+    }
+    return found->second;
+}
+
+std::string_view pathToName(std::string_view path)
+{
+    while (path.starts_with("../"))
+        path.remove_prefix(3);
+    while (path.starts_with("./"))
+        path.remove_prefix(2);
+    return path;
+}
+
+bool isAvailable()
+{
+    if (s_state == PackState::Unopened)
+        open();
+    return s_state == PackState::Open;
+}
+
+bool findTexture(const std::string& path, TextureView* out)
+{
+    const PackEntry* entry = findEntry(path, AssetType::Texture);
+    if (!entry)
+        return false;
+
+    out->width = entry->params[0];
+    out->height = entry->params[1];
+    out->mipLevelCount = entry->params[2];
+    out->data = (const uint8_t*)s_file.data()+entry->offset;
+    return true;
+}
+
+bool findMesh(const std::string& path, MeshView* out)
+{
+    const PackEntry* entry = findEntry(path, AssetType::Mesh);
+    if (!entry)
+        return false;
+
+    out->vertices = (const float*)(s_file.data()+entry->offset);
+    out->vertexValCount = entry->params[0];
+    out->indices = (const uint*)(s_file.data()+entry->offset+entry->params[0]*sizeof(float));
+    out->indexCount = entry->params[1];
+    return true;
+}
+
+bool findShaderSource(const std::string& path, std::string_view* out)
+{
+    const PackEntry* entry = findEntry(path, AssetType::Shader);
+    if (!entry)
+        return false;
+
+    *out = {s_file.data()+entry->offset, entry->size};
+    return true;
+}
+
+} // End of namespace AssetPack
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "types.h"
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Read-only access to the asset pack produced by `acraft-bake`.
+ *
+ * The pack is mapped into memory on first use and the assets are handed out
+ * as views into the mapping, so they can be uploaded to the GPU without any
+ * decoding or copying. Assets are looked up by their loose file path, every
+ * lookup fails if the pack is missing or outdated, and the lookup of an asset
+ * fails if its loose file is newer than the pack. The callers then load the
+ * loose file instead.
+ */
+namespace AssetPack
+{
+
+// Relative to the working directory, `acraft-bake` puts it in the build directory
+#define ASSET_PACK_PATH "assets.pack"
+#define ASSET_PACK_MAGIC "ACAP"
+// Bump when the layout of the pack or of any asset changes
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_NAME_LEN 96
+// Alignment of the asset data inside the pack
+#define ASSET_PACK_ALIGNMENT 16
+
+enum class AssetType : uint32_t
+{
+    Texture, // RGBA8, flipped vertically, full mip chain. Params: width, height, mip level count
+    Mesh, // `OBJ_VALS_PER_VERT` floats per vertex, then uint32 indices. Params: vertex value count, index count
+    Shader, // Source text, not null-terminated
+};
+
+struct PackHeader
+{
+    char magic[4]{};
+    uint32_t version{};
+    uint32_t entryCount{};
+    uint32_t _reserved{};
+};
+
+// The entry table follows the header
+struct PackEntry
+{
+    // Path relative to the repository root, null-terminated
+    char name[ASSET_PACK_NAME_LEN]{};
+    AssetType type{};
+    uint32_t _reserved{};
+    // Location of the data from the beginning of the pack
+    uint64_t offset{};
+    uint64_t size{};
+    // See `AssetType`
+    uint32_t params[4]{};
+};
+
+struct TextureView
+{
+    int width{};
+    int height{};
+    int mipLevelCount{};
+    // Mip levels stored one after another, see `Image::generateMipChain()`
+    const uint8_t* data{};
+};
+
+struct MeshView
+{
+    const float* vertices{};
+    size_t vertexValCount{};
+    const uint* indices{};
+    size_t indexCount{};
+};
+
+/*
+ * Converts a loose file path, as used by the game, to the name in the pack.
+ */
+std::string_view pathToName(std::string_view path);
+
+/*
+ * Opens the pack if it hasn't been opened yet. Returns false if there is no usable pack.
+ */
+bool isAvailable();
+
+bool findTexture(const std::string& path, TextureView* out);
+bool findMesh(const std::string& path, MeshView* out);
+bool findShaderSource(const std::string& path, std::string_view* out);
+
+} // End of namespace AssetPack
@@ -0,0 +1,175 @@
+#include "Benchmark.h"
+#include "Camera.h"
+#include "glstuff.h"
+#include "GpuTimer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace Benchmark
+{
+
+void applyFlightPath(Camera& camera, int frameI, int frameCount)
+{
+    // Orbit the spawn chunk twice while slowly descending and tilting up
+    const float progress = (float)frameI/std::max(frameCount, 1);
+    const float angleDeg = progress*720.0f;
+    const float radius = 80.0f;
+    const glm::vec3 center = {16.0f, 0.0f, 16.0f};
+
+    camera.setPos({
+            center.x+std::cos(glm::radians(angleDeg))*radius,
+            900.0f-progress*300.0f,
+            center.z+std::sin(glm::radians(angleDeg))*radius});
+    // Look at the center axis
+    camera.setRotationDeg(angleDeg+180.0f, -45.0f+progress*30.0f);
+}
+
+FrameRecorder::FrameRecorder(int frameCount)
+{
+    m_samples.reserve(frameCount);
+    glGenQueries(m_queries.size(), m_queries.data());
+    m_querySampleIs.fill(-1);
+}
+
+void FrameRecorder::collectGpuResult(int slot, bool shouldWait)
+{
+    const int sampleI = m_querySampleIs[slot];
+    if (sampleI == -1)
+        return;
+
+    if (!shouldWait)
+    {
+        int isAvailable{};
+        glGetQueryObjectiv(m_queries[slot*2+1], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+        if (!isAvailable)
+            return;
+    }
+
+    GLuint64 startNs{};
+    GLuint64 endNs{};
+    glGetQueryObjectui64v(m_queries[slot*2+0], GL_QUERY_RESULT, &startNs);
+    glGetQueryObjectui64v(m_queries[slot*2+1], GL_QUERY_RESULT, &endNs);
+    m_samples[sampleI].gpuMs = (endNs-startNs)/1'000'000.0;
+    m_querySampleIs[slot] = -1;
+}
+
+void FrameRecorder::collectGpuPassTimes()
+{
+    const GpuTimer::FrameResults& results = GpuTimer::getLatestResults();
+    if (results.frameId == m_lastGpuPassFrameId)
+        return;
+    m_lastGpuPassFrameId = results.frameId;
+
+    for (int i{}; i < results.passCount; ++i)
+    {
+        const GpuTimer::PassResult& pass = results.passes[i];
+        auto found = std::find_if(m_gpuPassTimes.begin(), m_gpuPassTimes.end(),
+                [&](const auto& entry){ return std::strcmp(entry.first, pass.name) == 0; });
+        if (found == m_gpuPassTimes.end())
+        {
+            m_gpuPassTimes.emplace_back(pass.name, std::vector<double>{});
+            found = m_gpuPassTimes.end()-1;
+        }
+        found->second.push_back(pass.gpuMs);
+    }
+}
+
+void FrameRecorder::beginFrame()
+{
+    const int slot = m_samples.size()%BENCH_GPU_QUERY_FRAMES;
+    // The slot was used BENCH_GPU_QUERY_FRAMES frames ago, this rarely blocks
+    collectGpuResult(slot, true);
+
+    m_frameStart = std::chrono::steady_clock::now();
+    glQueryCounter(m_queries[slot*2+0], GL_TIMESTAMP);
+}
+
+void FrameRecorder::endFrame(uint drawCalls, uint triangles)
+{
+    const int slot = m_samples.size()%BENCH_GPU_QUERY_FRAMES;
+    glQueryCounter(m_queries[slot*2+1], GL_TIMESTAMP);
+    m_querySampleIs[slot] = m_samples.size();
+
+    FrameSample sample;
+    sample.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-m_frameStart).count();
+    sample.drawCalls = drawCalls;
+    sample.triangles = triangles;
+    m_samples.push_back(sample);
+
+    // Pick up anything that is already done
+    for (int i{}; i < BENCH_GPU_QUERY_FRAMES; ++i)
+        collectGpuResult(i, false);
+    collectGpuPassTimes();
+}
+
+/*
+ * Nearest-rank percentile. Sorts `values`.
+ */
+static double percentile(std::vector<double>& values, double perc)
+{
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    const size_t rank = std::ceil(perc/100.0*values.size());
+    return values[std::clamp<size_t>(rank, 1, values.size())-1];
+}
+
+static void printTimesJson(const char* key, std::vector<double>& values, const char* indent="  ")
+{
+    const double p50 = percentile(values, 50);
+    const double p95 = percentile(values, 95);
+    const double p99 = percentile(values, 99);
+    const double max = values.empty() ? 0.0 : values.back();
+    std::printf("%s\"%s\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+            indent, key, p50, p95, p99, max);
+}
+
+void FrameRecorder::printJson(uint64_t seed, float startupMs)
+{
+    for (int i{}; i < BENCH_GPU_QUERY_FRAMES; ++i)
+        collectGpuResult(i, true);
+
+    std::vector<double> cpuTimes;
+    std::vector<double> gpuTimes;
+    uint64_t totalDrawCalls{};
+    uint64_t totalTriangles{};
+    for (const auto& sample : m_samples)
+    {
+        cpuTimes.push_back(sample.cpuMs);
+        if (sample.gpuMs >= 0)
+            gpuTimes.push_back(sample.gpuMs);
+        totalDrawCalls += sample.drawCalls;
+        totalTriangles += sample.triangles;
+    }
+    const size_t frameCount = std::max<size_t>(m_samples.size(), 1);
+
+    std::printf("{\n");
+    std::printf("  \"seed\": %lu,\n", (unsigned long)seed);
+    std::printf("  \"startup_ms\": %.3f,\n", startupMs);
+    std::printf("  \"frames\": %zu,\n", m_samples.size());
+    printTimesJson("cpu_frame_ms", cpuTimes);
+    std::printf(",\n");
+    printTimesJson("gpu_frame_ms", gpuTimes);
+    std::printf(",\n");
+    std::printf("  \"gpu_pass_ms\": {\n");
+    for (size_t i{}; i < m_gpuPassTimes.size(); ++i)
+    {
+        printTimesJson(m_gpuPassTimes[i].first, m_gpuPassTimes[i].second, "    ");
+        std::printf(i+1 < m_gpuPassTimes.size() ? ",\n" : "\n");
+    }
+    std::printf("  },\n");
+    std::printf("  \"draw_calls_per_frame\": %.2f,\n", (double)totalDrawCalls/frameCount);
+    std::printf("  \"triangles_per_frame\": %.2f,\n", (double)totalTriangles/frameCount);
+    std::printf("  \"triangles_total\": %lu\n", (unsigned long)totalTriangles);
+    std::printf("}\n");
+    std::fflush(stdout);
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    glDeleteQueries(m_queries.size(), m_queries.data());
+}
+
+} // End of namespace Benchmark
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "types.h"
+#include <vector>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+
+class Camera;
+
+/*
+ * Deterministic frame-time benchmark, used by the headless mode.
+ */
+namespace Benchmark
+{
+
+// Number of frames a GPU timestamp query may stay in flight before we wait for it
+#define BENCH_GPU_QUERY_FRAMES 4
+
+/*
+ * Moves the camera along a fixed path, only depending on the frame index.
+ */
+void applyFlightPath(Camera& camera, int frameI, int frameCount);
+
+class FrameRecorder final
+{
+private:
+    struct FrameSample
+    {
+        double cpuMs{};
+        double gpuMs{-1}; // -1 until the query result arrives
+        uint drawCalls{};
+        uint triangles{};
+    };
+
+    std::vector<FrameSample> m_samples;
+    std::chrono::steady_clock::time_point m_frameStart{};
+
+    // Start and end timestamp query pairs, reused in a ring
+    std::array<uint, BENCH_GPU_QUERY_FRAMES*2> m_queries{};
+    std::array<int, BENCH_GPU_QUERY_FRAMES> m_querySampleIs{};
+
+    // Pass name -> GPU times from `GpuTimer`
+    std::vector<std::pair<const char*, std::vector<double>>> m_gpuPassTimes;
+    uint64_t m_lastGpuPassFrameId{};
+
+    void collectGpuResult(int slot, bool shouldWait);
+    void collectGpuPassTimes();
+
+public:
+    FrameRecorder(int frameCount);
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+    FrameRecorder(FrameRecorder&&) = delete;
+    FrameRecorder& operator=(FrameRecorder&&) = delete;
+
+    void beginFrame();
+    /*
+     * Call after swapping buffers.
+     */
+    void endFrame(uint drawCalls, uint triangles);
+
+    /*
+     * Waits for the pending GPU queries and prints the results as JSON to stdout.
+     * `startupMs` is the time from entering `main()` to the first frame.
+     */
+    void printJson(uint64_t seed, float startupMs);
+
+    ~FrameRecorder();
+};
+
+} // End of namespace Benchmark
@@ -1,138 +1,397 @@
 #include "Block.h"
 #include "glstuff.h"
+#include "GlState.h"
 #include "../deps/stb/stb_image.h"
-#include "Camera.h"
 #include "Logger.h"
-#include <cassert>
+#include "Profiler.h"
+#include "GpuTimer.h"
+#include "AssetPack.h"
+#include "Image.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <future>
+#include <cstddef>
 #include <glm/gtc/matrix_transform.hpp>
 
-extern Camera g_camera;
-
 BlockStuffHandler::BlockStuffHandler()
 {
     Logger::log << "Setting up block stuff" << Logger::End;
 
     m_blockShaderProg = ShaderProg{
-            "../src/shaders/block_inst.vert.glsl",
-            "../src/shaders/block_inst.frag.glsl"};
+            "../src/shaders/block.vert.glsl",
+            "../src/shaders/block.frag.glsl"};
     loadBlockTextures();
-    setupBlockBuffers();
 
     Logger::log << "Finished setting up block stuff" << Logger::End;
 }
 
+/*
+ * A block texture layer with all of its mip levels, see `Image::generateMipChain()`.
+ */
+struct BlockTexLayer
+{
+    int width{};
+    int height{};
+    // Set if the texture came from the asset pack
+    const uint8_t* packedMipChain{};
+    // Set if the texture was decoded from a loose file
+    std::vector<uint8_t> decodedMipChain;
+    // Empty on success
+    std::string error;
+
+    inline const uint8_t* getMipChain() const { return packedMipChain ? packedMipChain : decodedMipChain.data(); }
+};
+
+/*
+ * Runs on a worker thread.
+ */
+static BlockTexLayer loadBlockTexLayer(const std::string& path)
+{
+    PROFILE_ZONE("loadBlockTexLayer");
+    BlockTexLayer layer;
+
+    AssetPack::TextureView packed;
+    if (AssetPack::findTexture(path, &packed))
+    {
+        layer.width = packed.width;
+        layer.height = packed.height;
+        layer.packedMipChain = packed.data;
+        return layer;
+    }
+
+    int _{};
+    unsigned char* pixels = stbi_load(path.c_str(), &layer.width, &layer.height, &_, 4);
+    if (!pixels)
+    {
+        layer.error = stbi_failure_reason();
+        return layer;
+    }
+    layer.decodedMipChain = Image::generateMipChain(pixels, layer.width, layer.height);
+    stbi_image_free(pixels);
+    return layer;
+}
+
 void BlockStuffHandler::loadBlockTextures()
 {
+    PROFILE_ZONE("loadBlockTextures");
     Logger::dbg << "Loading block textures" << Logger::End;
 
     int maxArrayTextureLayers{};
     glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxArrayTextureLayers);
     Logger::dbg << "GL_MAX_ARRAY_TEXTURE_LAYERS = " << maxArrayTextureLayers << Logger::End;
     // Check if we have space to store all the textures in a texture array
-    assert(BLOCK_TYPE__COUNT <= maxArrayTextureLayers);
+    const int texArrayDepth = BlockRegistry::g_tables.textureCount;
+    if (texArrayDepth > maxArrayTextureLayers)
+    {
+        Logger::fatal << "Too many block textures for a texture array: " << texArrayDepth
+            << ", the maximum is " << maxArrayTextureLayers << Logger::End;
+    }
+    int maxTextureSize{};
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
+    // Open the pack on this thread, the workers only look up textures in it
+    AssetPack::isAvailable();
+    // The baked textures are flipped, do the same with the loose ones
+    stbi_set_flip_vertically_on_load(1);
+
+    // Decode and mipmap the layers on the workers while the finished ones are uploaded here, in order
+    // Note: Layer 0 is reserved, it's left empty
+    const int layerCount = texArrayDepth-1;
+    auto getTextureName{[&](int i){ return BlockRegistry::g_tables.textureNames[i+1]; }};
+    std::vector<std::future<BlockTexLayer>> layerFutures;
+    for (int i{}; i < layerCount; ++i)
+    {
+        std::string path = std::string(BLOCK_TEXTURE_DIR) + "/" + getTextureName(i);
+        layerFutures.push_back(ThreadPool::getShared().submit(
+                [path{std::move(path)}](){ return loadBlockTexLayer(path); }));
+    }
 
-    glGenTextures(1, &m_texArray);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, m_texArray);
-    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, 16, 16, BLOCK_TYPE__COUNT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    // Fill each image layer with the data
-    // Note: Skip air
-    for (size_t i{1}; i < (size_t)BLOCK_TYPE__COUNT; ++i)
+    // The first layer that loads determines the size of the array, the rest must match it
+    std::vector<BlockTexLayer> layers(layerCount);
+    int receivedCount{};
+    int texW{};
+    int texH{};
+    while (texW == 0 && receivedCount < layerCount)
+    {
+        layers[receivedCount] = layerFutures[receivedCount].get();
+        if (layers[receivedCount].error.empty())
+        {
+            texW = layers[receivedCount].width;
+            texH = layers[receivedCount].height;
+        }
+        ++receivedCount;
+    }
+    if (texW == 0)
     {
-        std::string path = std::string(BLOCK_TEXTURE_DIR) + "/" + blockTexturePaths[i];
+        Logger::fatal << "None of the block textures could be loaded" << Logger::End;
+    }
+    if (texW > maxTextureSize || texH > maxTextureSize)
+    {
+        Logger::fatal << "Block textures are too large: " << texW << 'x' << texH
+            << ", the maximum is " << maxTextureSize << Logger::End;
+    }
+    Logger::dbg << "Block texture size: " << texW << 'x' << texH << Logger::End;
 
-        int width{};
-        int height{};
-        int _{};
-        unsigned char* data = stbi_load(path.c_str(), &width, &height, &_, 4);
-        assert(width == 16);
-        assert(height == 16);
+    const int mipLevelCount = Image::getMipLevelCount(texW, texH);
+    const size_t layerSize = Image::getMipChainSize(texW, texH, mipLevelCount);
 
-        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, 16, 16, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glGenTextures(1, &m_texArray);
+    GlState::bindTexture(GL_TEXTURE_2D_ARRAY, m_texArray);
+    for (int level{}, levelW{texW}, levelH{texH}; level < mipLevelCount; ++level)
+    {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA, levelW, levelH, texArrayDepth, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        levelW = std::max(levelW/2, 1);
+        levelH = std::max(levelH/2, 1);
+    }
 
-        stbi_image_free(data);
+    std::array<uint, BLOCK_TEX_UPLOAD_PBO_COUNT> pbos{};
+    glGenBuffers(pbos.size(), pbos.data());
+    std::vector<uint8_t> checkerboardMipChain;
+    for (int i{}; i < layerCount; ++i)
+    {
+        if (i >= receivedCount)
+            layers[i] = layerFutures[i].get();
+        BlockTexLayer& layer = layers[i];
+
+        const uint8_t* mipChain = layer.getMipChain();
+        if (!layer.error.empty() || layer.width != texW || layer.height != texH)
+        {
+            if (!layer.error.empty())
+            {
+                Logger::err << "Failed to load block texture \"" << getTextureName(i) << "\": " << layer.error << Logger::End;
+            }
+            else
+            {
+                Logger::err << "Block texture \"" << getTextureName(i) << "\" is " << layer.width << 'x' << layer.height
+                    << ", but the others are " << texW << 'x' << texH << Logger::End;
+            }
+
+            if (checkerboardMipChain.empty())
+                checkerboardMipChain = Image::generateMipChain(Image::makeCheckerboard(texW, texH).data(), texW, texH);
+            mipChain = checkerboardMipChain.data();
+        }
+
+        // Alternate between the PBOs, so the driver can copy from one while we fill the other.
+        // `glBufferData()` orphans the previous storage instead of waiting for its transfer.
+        GlState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[i%pbos.size()]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, layerSize, mipChain, GL_STREAM_DRAW);
+
+        size_t levelOffset{};
+        for (int level{}, levelW{texW}, levelH{texH}; level < mipLevelCount; ++level)
+        {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, i+1, levelW, levelH, 1, GL_RGBA, GL_UNSIGNED_BYTE, (void*)levelOffset);
+            levelOffset += (size_t)levelW*levelH*4;
+            levelW = std::max(levelW/2, 1);
+            levelH = std::max(levelH/2, 1);
+        }
+
+        // Free the decoded pixels as soon as possible
+        layer = {};
     }
-    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    GlState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(pbos.size(), pbos.data());
+    for (uint pbo : pbos)
+        GlState::onBufferDeleted(pbo);
+
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
     Logger::dbg << "Finished loading block textures" << Logger::End;
 }
 
-void BlockStuffHandler::setupBlockBuffers()
+void BlockStuffHandler::uploadChunkMesh(ChunkGpuMesh* mesh)
 {
-    Logger::dbg << "Setting up block VRAM buffers" << Logger::End;
+    if (!mesh->vao)
+    {
+        glGenVertexArrays(1, &mesh->vao);
+        glGenBuffers(1, &mesh->vbo);
+        glGenBuffers(1, &mesh->ebo);
 
-    glGenVertexArrays(1, &m_vao);
-    glBindVertexArray(m_vao);
+        GlState::bindVao(mesh->vao);
+        GlState::bindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+        glVertexAttribPointer(VERT_ATTRIB_INDEX_MESH_COORDS, 3, GL_FLOAT, GL_FALSE, sizeof(ChunkVertex), (void*)offsetof(ChunkVertex, x));
+        glEnableVertexAttribArray(VERT_ATTRIB_INDEX_MESH_COORDS);
+        glVertexAttribPointer(VERT_ATTRIB_INDEX_TEX_COORDS, 2, GL_FLOAT, GL_FALSE, sizeof(ChunkVertex), (void*)offsetof(ChunkVertex, u));
+        glEnableVertexAttribArray(VERT_ATTRIB_INDEX_TEX_COORDS);
+        glVertexAttribPointer(VERT_ATTRIB_INDEX_TEX_LAYER, 1, GL_FLOAT, GL_FALSE, sizeof(ChunkVertex), (void*)offsetof(ChunkVertex, texLayer));
+        glEnableVertexAttribArray(VERT_ATTRIB_INDEX_TEX_LAYER);
+        glVertexAttribPointer(VERT_ATTRIB_INDEX_LIGHT, 2, GL_FLOAT, GL_FALSE, sizeof(ChunkVertex), (void*)offsetof(ChunkVertex, skyLight));
+        glEnableVertexAttribArray(VERT_ATTRIB_INDEX_LIGHT);
+        glVertexAttribPointer(VERT_ATTRIB_INDEX_AO, 1, GL_FLOAT, GL_FALSE, sizeof(ChunkVertex), (void*)offsetof(ChunkVertex, ao));
+        glEnableVertexAttribArray(VERT_ATTRIB_INDEX_AO);
+        // Part of the VAO state
+        GlState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
+    }
 
+    size_t vertexCount{};
+    size_t indexCount{};
+    for (const SectionMesh& section : mesh->sectionMeshes)
     {
-        glGenBuffers(1, &m_vbo);
+        vertexCount += section.vertices.size();
+        indexCount += section.indices.size();
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-        glBufferData(GL_ARRAY_BUFFER, BLOCK_VERT_DATA_LEN*sizeof(float), &blockVertices, GL_STATIC_DRAW);
+    std::vector<ChunkVertex> vertices;
+    vertices.reserve(vertexCount);
+    std::vector<uint> indices;
+    indices.reserve(indexCount);
+    for (int i{}; i < CHUNK_SECTION_COUNT; ++i)
+    {
+        const SectionMesh& section = mesh->sectionMeshes[i];
+        // The section indices start from 0
+        const uint baseVertex = vertices.size();
+        mesh->firstIndices[i] = indices.size();
+        mesh->indexCounts[i] = section.indices.size();
+        vertices.insert(vertices.end(), section.vertices.begin(), section.vertices.end());
+        for (uint index : section.indices)
+            indices.push_back(baseVertex+index);
+    }
 
-        glVertexAttribPointer(VERT_ATTRIB_INDEX_MESH_COORDS, 3, GL_FLOAT, GL_FALSE, VALS_PER_VERT*sizeof(float), (void*)(0));
-        glEnableVertexAttribArray(VERT_ATTRIB_INDEX_MESH_COORDS);
+    GlState::bindVao(mesh->vao);
+    GlState::bindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(ChunkVertex), vertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(uint), indices.data(), GL_STATIC_DRAW);
+}
 
-        glVertexAttribPointer(VERT_ATTRIB_INDEX_TEX_COORDS, 2, GL_FLOAT, GL_FALSE, VALS_PER_VERT*sizeof(float), (void*)(3*sizeof(float)));
-        glEnableVertexAttribArray(VERT_ATTRIB_INDEX_TEX_COORDS);
+void BlockStuffHandler::deleteChunkMesh(ChunkGpuMesh* mesh)
+{
+    glDeleteBuffers(1, &mesh->vbo);
+    GlState::onBufferDeleted(mesh->vbo);
+    glDeleteBuffers(1, &mesh->ebo);
+    GlState::onBufferDeleted(mesh->ebo);
+    glDeleteVertexArrays(1, &mesh->vao);
+    GlState::onVaoDeleted(mesh->vao);
+}
+
+int BlockStuffHandler::updateChunkMeshes(World& world, std::unique_lock<std::mutex> worldLock)
+{
+    PROFILE_ZONE("updateChunkMeshes");
+
+    // Drop the meshes of the unloaded chunks
+    for (auto it = m_chunkMeshes.begin(); it != m_chunkMeshes.end();)
+    {
+        if (world.getChunks().contains(it->first))
+        {
+            ++it;
+            continue;
+        }
+        deleteChunkMesh(&it->second);
+        it = m_chunkMeshes.erase(it);
+    }
 
-        //----------------------------------------------------------------------
+    struct DirtyChunk
+    {
+        const Chunk* chunk{};
+        uint32_t sections{};
+        ChunkGpuMesh* mesh{};
+    };
+    std::vector<DirtyChunk> dirtyChunks;
+    // The light the meshing reads: the dirty sections and the ones next to them, in the chunk and its neighbours
+    std::unordered_map<const Chunk*, uint32_t> lightSectionMasks;
+    for (const auto& [key, chunk] : world.getChunks())
+    {
+        // Each dirty section is remeshed once, however many edits touched it
+        uint32_t dirtySections = chunk->takeDirtySections(CHUNK_CACHE_MESH);
+        if (m_isFullRemeshNeeded)
+            dirtySections = CHUNK_ALL_SECTIONS_MASK;
+        if (!dirtySections)
+            continue;
+
+        ChunkGpuMesh& mesh = m_chunkMeshes[key];
+        mesh.chunkX = chunk->getChunkX();
+        mesh.chunkZ = chunk->getChunkZ();
+        dirtyChunks.push_back({chunk.get(), dirtySections, &mesh});
+
+        const uint32_t lightSections = (dirtySections | dirtySections << 1 | dirtySections >> 1) & CHUNK_ALL_SECTIONS_MASK;
+        for (const Chunk* neighbour : chunk->getNeighbourhood())
+        {
+            if (neighbour)
+                lightSectionMasks[neighbour] |= lightSections;
+        }
+    }
 
-        glGenBuffers(1, &m_posInstVbo);
+    // The blocks are shared and copied by the world when written, only the light is copied here
+    std::unordered_map<const Chunk*, std::unique_ptr<Chunk>> copies;
+    {
+        PROFILE_ZONE("Copy dirty chunks");
+        for (const auto& [chunk, lightSections] : lightSectionMasks)
+            copies.emplace(chunk, chunk->makeReadCopy(lightSections));
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_posInstVbo);
-        glBufferData(GL_ARRAY_BUFFER, BLOCK_POS_BATCH_SIZE_COUNT*sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
+    struct MeshJob
+    {
+        ChunkNeighbourhood view;
+        int sectionI{};
+        SectionMesh* output{};
+    };
+    std::vector<MeshJob> jobs;
+    std::vector<ChunkGpuMesh*> changedMeshes;
+    for (const DirtyChunk& dirty : dirtyChunks)
+    {
+        changedMeshes.push_back(dirty.mesh);
+
+        ChunkNeighbourhood view;
+        for (size_t i{}; i < view.chunks.size(); ++i)
+        {
+            const Chunk* neighbour = dirty.chunk->getNeighbourhood()[i];
+            view.chunks[i] = neighbour ? copies.at(neighbour).get() : nullptr;
+        }
+        for (int i{}; i < CHUNK_SECTION_COUNT; ++i)
+        {
+            if (dirty.sections & (1u << i))
+                jobs.push_back({view, i, &dirty.mesh->sectionMeshes[i]});
+        }
+    }
+    // The simulation can go on while meshing
+    worldLock.unlock();
 
-        glVertexAttribPointer(VERT_ATTRIB_INDEX_INST_POS, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-        glEnableVertexAttribArray(VERT_ATTRIB_INDEX_INST_POS);
-        glVertexAttribDivisor(VERT_ATTRIB_INDEX_INST_POS, 1); // Instanced attribute
+    m_isFullRemeshNeeded = false;
 
+    // The sections only read the blocks and write their own mesh
+    ThreadPool::getShared().parallelFor(jobs.size(), [&](int i){
+        ChunkMesher::meshSection(jobs[i].view, jobs[i].sectionI, m_isAoEnabled, jobs[i].output);
+    });
 
-        glGenBuffers(1, &m_typeInstVbo);
+    for (ChunkGpuMesh* mesh : changedMeshes)
+        uploadChunkMesh(mesh);
+    if (!changedMeshes.empty())
+        GlState::bindVao(0);
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_typeInstVbo);
-        glBufferData(GL_ARRAY_BUFFER, BLOCK_POS_BATCH_SIZE_COUNT*sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    // The recording splits the list between the threads
+    m_chunkMeshList.clear();
+    for (const auto& [_, mesh] : m_chunkMeshes)
+        m_chunkMeshList.push_back(&mesh);
 
-        glVertexAttribPointer(VERT_ATTRIB_INDEX_INST_TYPE, 1, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(VERT_ATTRIB_INDEX_INST_TYPE);
-        glVertexAttribDivisor(VERT_ATTRIB_INDEX_INST_TYPE, 1); // Instanced attribute
-    }
-    glBindVertexArray(0);
+    return jobs.size();
+}
 
-    Logger::dbg << "Finished setting up block VRAM buffers" << Logger::End;
+void BlockStuffHandler::toggleAo()
+{
+    m_isAoEnabled = !m_isAoEnabled;
+    m_isFullRemeshNeeded = true;
+    Logger::log << "Ambient occlusion " << (m_isAoEnabled ? "enabled" : "disabled") << Logger::End;
 }
 
-void BlockStuffHandler::renderBlocks(std::vector<glm::vec3>& blockPositions, std::vector<int>& blockTexIds)
+int BlockStuffHandler::renderChunks(const Camera& camera)
 {
-    glBindVertexArray(m_vao);
-    m_blockShaderProg.bind();
-    g_camera.updateShaderUniformsIfNeeded(m_blockShaderProg);
+    PROFILE_ZONE("renderChunks");
+    GPU_PASS("Blocks");
 
-    int renderedBlocks{};
-    int remainingBlocks = blockPositions.size();
-    while (remainingBlocks > 0)
+    const int drawnSectionCount = ChunkRenderList::recordDrawsParallel(m_chunkMeshList, camera.getFrustum(),
+            m_blockShaderProg.getId(), m_texArray, &ThreadPool::getShared(), &m_commandBuffers);
     {
-        const int batchSize = std::min(BLOCK_POS_BATCH_SIZE_COUNT, remainingBlocks);
-
-        glBindBuffer(GL_ARRAY_BUFFER, m_posInstVbo);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, batchSize*sizeof(glm::vec3), blockPositions.data()+renderedBlocks);
-
-        glBindBuffer(GL_ARRAY_BUFFER, m_typeInstVbo);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, batchSize*sizeof(float), blockTexIds.data()+renderedBlocks);
-
-        glDrawArraysInstanced(GL_TRIANGLES, 0, BLOCK_VERT_COUNT, batchSize);
-        remainingBlocks -= BLOCK_POS_BATCH_SIZE_COUNT;
-        renderedBlocks += BLOCK_POS_BATCH_SIZE_COUNT;
+        PROFILE_ZONE("Execute render commands");
+        for (const RenderCommandBuffer& buffer : m_commandBuffers)
+            GlState::executeCommands(buffer);
     }
+    return drawnSectionCount;
 }
 
 BlockStuffHandler::~BlockStuffHandler()
 {
     glDeleteTextures(1, &m_texArray);
-    glDeleteBuffers(1, &m_vbo);
-    glDeleteBuffers(1, &m_posInstVbo);
-    glDeleteBuffers(1, &m_typeInstVbo);
-    glDeleteVertexArrays(1, &m_vao);
+    GlState::onTextureDeleted(m_texArray);
+    for (auto& [_, mesh] : m_chunkMeshes)
+        deleteChunkMesh(&mesh);
     Logger::dbg << "Cleaned up block stuff" << Logger::End;
 }
@@ -2,62 +2,46 @@
 
 #include "Texture.h"
 #include "ShaderProg.h"
+#include "BlockRegistry.h"
+#include "ChunkMesher.h"
+#include "ChunkRenderList.h"
+#include "RenderCommands.h"
+#include "Camera.h"
 #include "types.h"
 #include <vector>
 #include <string>
 #include <array>
+#include <mutex>
+#include <unordered_map>
 
-enum BlockType
-{
-    BLOCK_TYPE_AIR,
-    BLOCK_TYPE_COBBLESTONE,
-    BLOCK_TYPE_DIRT,
-    BLOCK_TYPE_GRASS,
-    BLOCK_TYPE_STONE,
-    BLOCK_TYPE_BEDROCK,
-    BLOCK_TYPE_DEEPSLATE,
-    BLOCK_TYPE_COAL_ORE,
-    BLOCK_TYPE_DEEPSLATE_COAL_ORE,
-    BLOCK_TYPE__COUNT,
-};
-
-#define BLOCK_TEXTURE_DIR "../textures"
-constexpr std::array<const char*, (int)BLOCK_TYPE__COUNT> blockTexturePaths = {
-    "", // Air, skipped
-    "cobblestone.png",
-    "dirt.png",
-    "grass.png",
-    "stone.png",
-    "bedrock.png",
-    "deepslate.png",
-    "coal_ore.png",
-    "deepslate_coal_ore.png",
-};
-
-struct Block
-{
-    BlockType type{};
-};
+// Pixel buffers used in turns to upload the block texture layers
+#define BLOCK_TEX_UPLOAD_PBO_COUNT 2
 
 /*
- * Singleton class that handles block texture loading, VRAM buffer initialization and rendering.
+ * Singleton class that handles block texture loading, chunk meshing and rendering.
  */
 class BlockStuffHandler final
 {
 private:
     uint m_texArray;
-    uint m_vao;
-    uint m_vbo;
-    uint m_posInstVbo;
-    uint m_typeInstVbo;
     ShaderProg m_blockShaderProg;
+    // Chunk key -> mesh, see `World::getChunkKey()`
+    std::unordered_map<uint64_t, ChunkGpuMesh> m_chunkMeshes;
+    // The values of `m_chunkMeshes`, that can be split between the recording threads
+    std::vector<const ChunkGpuMesh*> m_chunkMeshList;
+    // One per chunk group, reused every frame
+    std::vector<RenderCommandBuffer> m_commandBuffers;
+    bool m_isAoEnabled = true;
+    // Set when all the loaded chunks have to be remeshed, like after toggling AO
+    bool m_isFullRemeshNeeded{};
 
     /*
      * Called by `get()` when it is called first time.
      */
     BlockStuffHandler();
     void loadBlockTextures();
-    void setupBlockBuffers();
+    void uploadChunkMesh(ChunkGpuMesh* mesh);
+    void deleteChunkMesh(ChunkGpuMesh* mesh);
 
 public:
     BlockStuffHandler(const BlockStuffHandler&) = delete;
@@ -71,60 +55,30 @@ public:
         return instance;
     }
 
-    void renderBlocks(std::vector<glm::vec3>& blockPositions, std::vector<int>& blockTexIds);
+    /*
+     * Remeshes the sections marked dirty since the last call (on the worker pool),
+     * uploads the changed chunks and drops the meshes of the unloaded ones.
+     * `worldLock` is only held while the dirty chunks are copied, the meshing reads the copies.
+     * Returns the number of sections remeshed.
+     */
+    int updateChunkMeshes(World& world, std::unique_lock<std::mutex> worldLock);
+    /*
+     * Switches the ambient occlusion of the meshes, and remeshes everything on the next update.
+     */
+    void toggleAo();
+
+    /*
+     * Records the draws of the sections inside the view frustum on the worker pool,
+     * and executes them. Returns the number of sections drawn.
+     */
+    int renderChunks(const Camera& camera);
 
     ~BlockStuffHandler();
 };
 
 #define VERT_ATTRIB_INDEX_MESH_COORDS 0
 #define VERT_ATTRIB_INDEX_TEX_COORDS 1
+#define VERT_ATTRIB_INDEX_TEX_LAYER 2
+#define VERT_ATTRIB_INDEX_LIGHT 3
+#define VERT_ATTRIB_INDEX_AO 4
 #define VALS_PER_VERT 5
-#define VERT_ATTRIB_INDEX_INST_POS 2
-#define VERT_ATTRIB_INDEX_INST_TYPE 3
-
-#define BLOCK_VERT_COUNT 36
-#define BLOCK_VERT_DATA_LEN (BLOCK_VERT_COUNT * VALS_PER_VERT)
-static constexpr float blockVertices[BLOCK_VERT_DATA_LEN] = {
-    //       Mesh              Texture
-    // X      Y      Z          X     Y
-    -1.0f,  1.0f, -1.0f, /**/ 0.0f,  1.0f,
-     1.0f,  1.0f,  1.0f, /**/ 1.0f,  0.0f,
-     1.0f,  1.0f, -1.0f, /**/ 1.0f,  1.0f,
-     1.0f,  1.0f,  1.0f, /**/ 1.0f,  1.0f,
-    -1.0f, -1.0f,  1.0f, /**/ 0.0f,  0.0f,
-     1.0f, -1.0f,  1.0f, /**/ 1.0f,  0.0f,
-    -1.0f,  1.0f,  1.0f, /**/ 0.0f,  1.0f,
-    -1.0f, -1.0f, -1.0f, /**/ 1.0f,  0.0f,
-    -1.0f, -1.0f,  1.0f, /**/ 0.0f,  0.0f,
-     1.0f, -1.0f, -1.0f, /**/ 1.0f,  1.0f,
-    -1.0f, -1.0f,  1.0f, /**/ 0.0f,  0.0f,
-    -1.0f, -1.0f, -1.0f, /**/ 0.0f,  1.0f,
-     1.0f,  1.0f, -1.0f, /**/ 1.0f,  1.0f,
-     1.0f, -1.0f,  1.0f, /**/ 0.0f,  0.0f,
-     1.0f, -1.0f, -1.0f, /**/ 1.0f,  0.0f,
-    -1.0f,  1.0f, -1.0f, /**/ 0.0f,  1.0f,
-     1.0f, -1.0f, -1.0f, /**/ 1.0f,  0.0f,
-    -1.0f, -1.0f, -1.0f, /**/ 0.0f,  0.0f,
-    -1.0f,  1.0f, -1.0f, /**/ 0.0f,  1.0f,
-    -1.0f,  1.0f,  1.0f, /**/ 0.0f,  0.0f,
-     1.0f,  1.0f,  1.0f, /**/ 1.0f,  0.0f,
-     1.0f,  1.0f,  1.0f, /**/ 1.0f,  1.0f,
-    -1.0f,  1.0f,  1.0f, /**/ 0.0f,  1.0f,
-    -1.0f, -1.0f,  1.0f, /**/ 0.0f,  0.0f,
-    -1.0f,  1.0f,  1.0f, /**/ 0.0f,  1.0f,
-    -1.0f,  1.0f, -1.0f, /**/ 1.0f,  1.0f,
-    -1.0f, -1.0f, -1.0f, /**/ 1.0f,  0.0f,
-     1.0f, -1.0f, -1.0f, /**/ 1.0f,  1.0f,
-     1.0f, -1.0f,  1.0f, /**/ 1.0f,  0.0f,
-    -1.0f, -1.0f,  1.0f, /**/ 0.0f,  0.0f,
-     1.0f,  1.0f, -1.0f, /**/ 1.0f,  1.0f,
-     1.0f,  1.0f,  1.0f, /**/ 0.0f,  1.0f,
-     1.0f, -1.0f,  1.0f, /**/ 0.0f,  0.0f,
-    -1.0f,  1.0f, -1.0f, /**/ 0.0f,  1.0f,
-     1.0f,  1.0f, -1.0f, /**/ 1.0f,  1.0f,
-     1.0f, -1.0f, -1.0f, /**/ 1.0f,  0.0f,
-};
-#define BLOCK_MODEL_SCALE 0.5f
-
-// Number of blocks renderd at once
-#define BLOCK_POS_BATCH_SIZE_COUNT 1024*1024*10
@@ -0,0 +1,184 @@
+#include "BlockRegistry.h"
+#include "Logger.h"
+#include "MappedFile.h"
+#include <charconv>
+#include <deque>
+#include <filesystem>
+
+namespace BlockRegistry
+{
+
+BlockTables g_tables = defaultBlockTables;
+
+// Storage of the texture names coming from the overlay
+static std::deque<std::string> s_overlayTextureNames;
+
+BlockType findByName(std::string_view name)
+{
+    for (size_t i{}; i < blockDefs.size(); ++i)
+    {
+        if (name == blockDefs[i].name)
+            return (BlockType)i;
+    }
+    return BLOCK_TYPE__COUNT;
+}
+
+static std::string_view nextToken(std::string_view* line)
+{
+    const size_t start = line->find_first_not_of(" \t\r");
+    if (start == std::string_view::npos)
+    {
+        *line = {};
+        return {};
+    }
+    line->remove_prefix(start);
+    const size_t end = std::min(line->find_first_of(" \t\r"), line->size());
+    const std::string_view token = line->substr(0, end);
+    line->remove_prefix(end);
+    return token;
+}
+
+static bool parseFlags(std::string_view value, uint8_t* flagsOut)
+{
+    uint8_t flags{};
+    while (!value.empty())
+    {
+        const size_t end = std::min(value.find(','), value.size());
+        const std::string_view flag = value.substr(0, end);
+        if (flag == "visible")       flags |= BLOCK_FLAG_VISIBLE;
+        else if (flag == "opaque")   flags |= BLOCK_FLAG_OPAQUE;
+        else if (flag == "solid")    flags |= BLOCK_FLAG_SOLID;
+        else if (flag == "emissive") flags |= BLOCK_FLAG_EMISSIVE;
+        else if (flag == "random_ticked") flags |= BLOCK_FLAG_RANDOM_TICKED;
+        else if (flag == "falling")  flags |= BLOCK_FLAG_FALLING;
+        else if (flag == "fluid")    flags |= BLOCK_FLAG_FLUID;
+        else if (!flag.empty())      return false;
+        value.remove_prefix(std::min(end+1, value.size()));
+    }
+    *flagsOut = flags;
+    return true;
+}
+
+/*
+ * Returns the bit of each face that `key` sets, 0 if it isn't a face key.
+ */
+static uint getFaceMask(std::string_view key)
+{
+    if (key == "all")    return 0b111111;
+    if (key == "side")   return (1 << BLOCK_FACE_FRONT)|(1 << BLOCK_FACE_LEFT)|(1 << BLOCK_FACE_RIGHT)|(1 << BLOCK_FACE_BACK);
+    if (key == "top")    return 1 << BLOCK_FACE_TOP;
+    if (key == "bottom") return 1 << BLOCK_FACE_BOTTOM;
+    if (key == "front")  return 1 << BLOCK_FACE_FRONT;
+    if (key == "back")   return 1 << BLOCK_FACE_BACK;
+    if (key == "left")   return 1 << BLOCK_FACE_LEFT;
+    if (key == "right")  return 1 << BLOCK_FACE_RIGHT;
+    return 0;
+}
+
+static uint16_t addOverlayTexture(std::string_view name)
+{
+    for (int i{1}; i < g_tables.textureCount; ++i)
+    {
+        if (name == g_tables.textureNames[i])
+            return i;
+    }
+    s_overlayTextureNames.emplace_back(name);
+    return findOrAddTextureLayer(&g_tables, s_overlayTextureNames.back().c_str());
+}
+
+void loadOverlay(const std::string& path)
+{
+    if (!std::filesystem::exists(path))
+    {
+        Logger::dbg << "No block overlay (" << path << "), using the built-in block properties" << Logger::End;
+        return;
+    }
+
+    MappedFile file;
+    if (!file.open(path))
+    {
+        Logger::err << "Failed to open block overlay: " << path << Logger::End;
+        return;
+    }
+    Logger::log << "Loading block overlay: " << path << Logger::End;
+
+    std::string_view content = file.view();
+    int lineI{};
+    int changedCount{};
+    while (!content.empty())
+    {
+        ++lineI;
+        const size_t lineEnd = std::min(content.find('\n'), content.size());
+        std::string_view line = content.substr(0, lineEnd);
+        content.remove_prefix(std::min(lineEnd+1, content.size()));
+        line = line.substr(0, std::min(line.find('#'), line.size()));
+
+        const std::string_view blockName = nextToken(&line);
+        if (blockName.empty())
+            continue;
+        const BlockType type = findByName(blockName);
+        if (type == BLOCK_TYPE__COUNT)
+        {
+            Logger::err << path << ':' << lineI << ": Unknown block: " << blockName << Logger::End;
+            continue;
+        }
+
+        for (std::string_view token = nextToken(&line); !token.empty(); token = nextToken(&line))
+        {
+            const size_t eqPos = token.find('=');
+            if (eqPos == std::string_view::npos)
+            {
+                Logger::err << path << ':' << lineI << ": Expected key=value: " << token << Logger::End;
+                continue;
+            }
+            const std::string_view key = token.substr(0, eqPos);
+            const std::string_view value = token.substr(eqPos+1);
+
+            if (key == "flags")
+            {
+                if (!parseFlags(value, &g_tables.flags[type]))
+                {
+                    Logger::err << path << ':' << lineI << ": Invalid flags: " << value << Logger::End;
+                    continue;
+                }
+            }
+            else if (key == "light")
+            {
+                int light{};
+                const auto result = std::from_chars(value.data(), value.data()+value.size(), light);
+                if (result.ec != std::errc{} || light < 0 || light > 15)
+                {
+                    Logger::err << path << ':' << lineI << ": Invalid light level: " << value << Logger::End;
+                    continue;
+                }
+                g_tables.lightEmission[type] = light;
+            }
+            else if (const uint faceMask = getFaceMask(key))
+            {
+                const uint16_t layer = addOverlayTexture(value);
+                if (layer == 0)
+                {
+                    Logger::err << path << ':' << lineI << ": Too many block textures, the maximum is "
+                        << BLOCK_MAX_TEXTURES-1 << Logger::End;
+                    continue;
+                }
+                for (int face{}; face < BLOCK_FACE__COUNT; ++face)
+                {
+                    if (faceMask & (1 << face))
+                        g_tables.faceLayers[(int)type*BLOCK_FACE__COUNT+face] = layer;
+                }
+            }
+            else
+            {
+                Logger::err << path << ':' << lineI << ": Unknown key: " << key << Logger::End;
+                continue;
+            }
+            ++changedCount;
+        }
+    }
+
+    Logger::log << "Applied " << changedCount << " block property overrides, "
+        << g_tables.textureCount-1 << " block textures in use" << Logger::End;
+}
+
+} // End of namespace BlockRegistry
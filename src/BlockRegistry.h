@@ -0,0 +1,190 @@
+#pragma once
+
+#include "types.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+enum BlockType : uint8_t
+{
+    BLOCK_TYPE_AIR,
+    BLOCK_TYPE_COBBLESTONE,
+    BLOCK_TYPE_DIRT,
+    BLOCK_TYPE_GRASS,
+    BLOCK_TYPE_STONE,
+    BLOCK_TYPE_BEDROCK,
+    BLOCK_TYPE_DEEPSLATE,
+    BLOCK_TYPE_COAL_ORE,
+    BLOCK_TYPE_DEEPSLATE_COAL_ORE,
+    BLOCK_TYPE_WATER,
+    BLOCK_TYPE_LAVA,
+    BLOCK_TYPE__COUNT,
+};
+
+struct Block
+{
+    BlockType type{};
+    // Meaning depends on the type, like the level of fluids, see `FluidSim`
+    uint8_t state{};
+};
+// Keep the sections small
+static_assert(sizeof(Block) == 2);
+
+/*
+ * Same order as the faces in the face table of the chunk mesher.
+ */
+enum BlockFace
+{
+    BLOCK_FACE_TOP,    // +Y
+    BLOCK_FACE_FRONT,  // +Z
+    BLOCK_FACE_LEFT,   // -X
+    BLOCK_FACE_BOTTOM, // -Y
+    BLOCK_FACE_RIGHT,  // +X
+    BLOCK_FACE_BACK,   // -Z
+    BLOCK_FACE__COUNT,
+};
+
+#define BLOCK_FLAG_VISIBLE  (1 << 0) // Has faces to render
+#define BLOCK_FLAG_OPAQUE   (1 << 1) // Completely hides the faces behind it
+#define BLOCK_FLAG_SOLID    (1 << 2) // Collides with entities
+#define BLOCK_FLAG_EMISSIVE (1 << 3) // Emits light, see `BlockDef::lightEmission`
+#define BLOCK_FLAG_RANDOM_TICKED (1 << 4) // Changes by itself now and then, see `TickScheduler`
+#define BLOCK_FLAG_FALLING  (1 << 5) // Falls when there is nothing solid under it
+#define BLOCK_FLAG_FLUID    (1 << 6) // Flows into the air around it, see `FluidSim`
+
+// Upper limit of block types, sizes the face layer uniform block
+// Note: Keep in sync with `block_inst.vert.glsl`
+#define BLOCK_MAX_TYPES 256
+// Upper limit of distinct block textures, including the reserved layer 0
+#define BLOCK_MAX_TEXTURES 256
+#define BLOCK_TEXTURE_DIR "../textures"
+// Optional, overrides the built-in properties
+#define BLOCK_OVERLAY_PATH "../blocks.txt"
+
+static_assert(BLOCK_TYPE__COUNT <= BLOCK_MAX_TYPES);
+
+/*
+ * Source of the built-in block properties.
+ */
+struct BlockDef
+{
+    const char* name{};
+    uint flags{};
+    // 0-15, only used if the block is emissive
+    uint8_t lightEmission{};
+    // Texture file names in `BLOCK_TEXTURE_DIR`, see `BlockFace`
+    std::array<const char*, BLOCK_FACE__COUNT> faceTextures{};
+};
+
+using FaceTextures = std::array<const char*, BLOCK_FACE__COUNT>;
+
+constexpr FaceTextures allFaces(const char* texture)
+{
+    return {texture, texture, texture, texture, texture, texture};
+}
+
+constexpr FaceTextures topSideBottom(const char* top, const char* side, const char* bottom)
+{
+    return {top, side, side, bottom, side, side};
+}
+
+constexpr std::array<BlockDef, BLOCK_TYPE__COUNT> blockDefs = {{
+    {"air",                0,                                                    0, allFaces(nullptr)},
+    {"cobblestone",        BLOCK_FLAG_VISIBLE|BLOCK_FLAG_OPAQUE|BLOCK_FLAG_SOLID, 0, allFaces("cobblestone.png")},
+    {"dirt",               BLOCK_FLAG_VISIBLE|BLOCK_FLAG_OPAQUE|BLOCK_FLAG_SOLID, 0, allFaces("dirt.png")},
+    {"grass",              BLOCK_FLAG_VISIBLE|BLOCK_FLAG_OPAQUE|BLOCK_FLAG_SOLID|BLOCK_FLAG_RANDOM_TICKED, 0, topSideBottom("grass.png", "grass.png", "dirt.png")},
+    {"stone",              BLOCK_FLAG_VISIBLE|BLOCK_FLAG_OPAQUE|BLOCK_FLAG_SOLID, 0, allFaces("stone.png")},
+    {"bedrock",            BLOCK_FLAG_VISIBLE|BLOCK_FLAG_OPAQUE|BLOCK_FLAG_SOLID, 0, allFaces("bedrock.png")},
+    {"deepslate",          BLOCK_FLAG_VISIBLE|BLOCK_FLAG_OPAQUE|BLOCK_FLAG_SOLID, 0, allFaces("deepslate.png")},
+    {"coal_ore",           BLOCK_FLAG_VISIBLE|BLOCK_FLAG_OPAQUE|BLOCK_FLAG_SOLID, 0, allFaces("coal_ore.png")},
+    {"deepslate_coal_ore", BLOCK_FLAG_VISIBLE|BLOCK_FLAG_OPAQUE|BLOCK_FLAG_SOLID, 0, allFaces("deepslate_coal_ore.png")},
+    {"water",              BLOCK_FLAG_VISIBLE|BLOCK_FLAG_FLUID,                  0, allFaces("water.png")},
+    {"lava",               BLOCK_FLAG_VISIBLE|BLOCK_FLAG_EMISSIVE|BLOCK_FLAG_FLUID, 15, allFaces("lava.png")},
+}};
+
+/*
+ * Dense per-type property tables. Every lookup is a single array index.
+ */
+struct BlockTables
+{
+    std::array<uint8_t, BLOCK_TYPE__COUNT> flags{};
+    std::array<uint8_t, BLOCK_TYPE__COUNT> lightEmission{};
+    // Texture array layer of each face, indexed by `type*BLOCK_FACE__COUNT+face`
+    std::array<uint16_t, (int)BLOCK_TYPE__COUNT*BLOCK_FACE__COUNT> faceLayers{};
+    // File name of each texture array layer. Layer 0 is reserved for faces without a texture.
+    std::array<const char*, BLOCK_MAX_TEXTURES> textureNames{};
+    int textureCount{1};
+};
+
+/*
+ * Returns the layer of `name`, adding it if it's new.
+ * Returns 0 if there is no room for more textures.
+ */
+constexpr uint16_t findOrAddTextureLayer(BlockTables* tables, const char* name)
+{
+    for (int i{1}; i < tables->textureCount; ++i)
+    {
+        if (std::string_view{tables->textureNames[i]} == name)
+            return i;
+    }
+    if (tables->textureCount == BLOCK_MAX_TEXTURES)
+        return 0;
+    tables->textureNames[tables->textureCount] = name;
+    return tables->textureCount++;
+}
+
+constexpr BlockTables makeBlockTables(const std::array<BlockDef, BLOCK_TYPE__COUNT>& defs)
+{
+    BlockTables tables;
+    for (size_t type{}; type < defs.size(); ++type)
+    {
+        tables.flags[type] = defs[type].flags;
+        tables.lightEmission[type] = defs[type].lightEmission;
+        for (int face{}; face < BLOCK_FACE__COUNT; ++face)
+        {
+            const char* texture = defs[type].faceTextures[face];
+            tables.faceLayers[type*BLOCK_FACE__COUNT+face] = texture ? findOrAddTextureLayer(&tables, texture) : 0;
+        }
+    }
+    return tables;
+}
+
+// Built at compile time
+constexpr BlockTables defaultBlockTables = makeBlockTables(blockDefs);
+
+namespace BlockRegistry
+{
+
+// The tables in use: `defaultBlockTables` with the overlay applied
+extern BlockTables g_tables;
+
+inline bool isVisible(BlockType type) { return g_tables.flags[type] & BLOCK_FLAG_VISIBLE; }
+inline bool isOpaque(BlockType type) { return g_tables.flags[type] & BLOCK_FLAG_OPAQUE; }
+inline bool isSolid(BlockType type) { return g_tables.flags[type] & BLOCK_FLAG_SOLID; }
+inline bool isEmissive(BlockType type) { return g_tables.flags[type] & BLOCK_FLAG_EMISSIVE; }
+inline bool isRandomTicked(BlockType type) { return g_tables.flags[type] & BLOCK_FLAG_RANDOM_TICKED; }
+inline bool isFalling(BlockType type) { return g_tables.flags[type] & BLOCK_FLAG_FALLING; }
+inline bool isFluid(BlockType type) { return g_tables.flags[type] & BLOCK_FLAG_FLUID; }
+inline uint8_t getLightEmission(BlockType type) { return g_tables.lightEmission[type]; }
+inline uint getFaceLayer(BlockType type, BlockFace face) { return g_tables.faceLayers[(int)type*BLOCK_FACE__COUNT+face]; }
+
+inline const char* getName(BlockType type) { return blockDefs[type].name; }
+/*
+ * Returns `BLOCK_TYPE__COUNT` if there is no such block.
+ */
+BlockType findByName(std::string_view name);
+
+/*
+ * Overrides the built-in properties with the ones in a text file, if it exists.
+ * Must be called before the block textures are loaded and the chunks are made.
+ *
+ * Each line is a block name followed by `key=value` pairs:
+ *     flags=visible,opaque,solid,emissive,random_ticked,falling,fluid (replaces all flags)
+ *     light=<0-15>
+ *     all|top|bottom|side|front|back|left|right=<texture file>
+ * `#` starts a comment. New block types can't be added this way.
+ */
+void loadOverlay(const std::string& path);
+
+} // End of namespace BlockRegistry
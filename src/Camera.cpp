@@ -1,9 +1,19 @@
 #include "Camera.h"
 #include "Logger.h"
+#include "GlState.h"
 #include <cmath>
 
 extern bool g_isDebugCam;
 
+void Camera::_recalcFrontVec()
+{
+    glm::vec3 camDir;
+    camDir.x = cos(glm::radians(m_yawDeg)) * cos(glm::radians(m_pitchDeg));
+    camDir.y = sin(glm::radians(m_pitchDeg));
+    camDir.z = sin(glm::radians(m_yawDeg)) * cos(glm::radians(m_pitchDeg));
+    m_frontVec = glm::normalize(camDir);
+}
+
 void Camera::_recalcProjMat()
 {
     m_projMat = glm::perspective(glm::radians(m_fovDeg), m_winAspectRatio, m_near, m_far);
@@ -13,12 +23,6 @@ void Camera::_recalcProjMat()
 
 void Camera::_recalcViewMat()
 {
-    glm::vec3 camDir;
-    camDir.x = cos(glm::radians(m_yawDeg)) * cos(glm::radians(m_pitchDeg));
-    camDir.y = sin(glm::radians(m_pitchDeg));
-    camDir.z = sin(glm::radians(m_yawDeg)) * cos(glm::radians(m_pitchDeg));
-    m_frontVec = glm::normalize(camDir);
-
     if (g_isDebugCam)
     {
         static constexpr auto pos = glm::vec3{0.0f, 1000.0f, 0.0f};
@@ -35,12 +39,15 @@ void Camera::_recalcViewMat()
 void Camera::_recalcFrustumMat()
 {
     m_frustumMat = m_projMat.get() * m_viewMat.get();
+    m_frustum = Frustum{m_frustumMat.get()};
 }
 
 Camera::Camera(float winAspectRatio, float fovDeg)
 {
     setWinAspectRatio(winAspectRatio);
     setFovDeg(fovDeg);
+    // Kept up to date without a GL context, so it can be moved on any thread
+    _recalcFrontVec();
     m_projMat.markOutdated();
     m_viewMat.markOutdated();
 }
@@ -63,53 +70,54 @@ void Camera::setPos(const glm::vec3& pos)
     m_viewMat.markOutdated();
 }
 
-void Camera::moveForward(float amount, int frameTime)
+void Camera::moveForward(float amount, float frameTimeMs)
 {
     const float prevY = m_pos.y;
-    m_pos += m_frontVec * (amount * frameTime);
+    m_pos += m_frontVec * (amount * frameTimeMs);
     m_pos.y = prevY;
     m_viewMat.markOutdated();
 }
 
-void Camera::moveBackwards(float amount, int frameTime)
+void Camera::moveBackwards(float amount, float frameTimeMs)
 {
     const float prevY = m_pos.y;
-    m_pos -= m_frontVec * (amount * frameTime);
+    m_pos -= m_frontVec * (amount * frameTimeMs);
     m_pos.y = prevY;
     m_viewMat.markOutdated();
 }
 
-void Camera::moveLeft(float amount, int frameTime)
+void Camera::moveLeft(float amount, float frameTimeMs)
 {
     const float prevY = m_pos.y;
-    m_pos -= glm::normalize(glm::cross(m_frontVec, {0.0f, 1.0f, 0.0f})) * (amount * frameTime);
+    m_pos -= glm::normalize(glm::cross(m_frontVec, {0.0f, 1.0f, 0.0f})) * (amount * frameTimeMs);
     m_pos.y = prevY;
     m_viewMat.markOutdated();
 }
 
-void Camera::moveRight(float amount, int frameTime)
+void Camera::moveRight(float amount, float frameTimeMs)
 {
     const float prevY = m_pos.y;
-    m_pos += glm::normalize(glm::cross(m_frontVec, {0.0f, 1.0f, 0.0f})) * (amount * frameTime);
+    m_pos += glm::normalize(glm::cross(m_frontVec, {0.0f, 1.0f, 0.0f})) * (amount * frameTimeMs);
     m_pos.y = prevY;
     m_viewMat.markOutdated();
 }
 
-void Camera::moveUp(float amount, int frameTime)
+void Camera::moveUp(float amount, float frameTimeMs)
 {
-    m_pos.y += (amount * frameTime);
+    m_pos.y += (amount * frameTimeMs);
     m_viewMat.markOutdated();
 }
 
-void Camera::moveDown(float amount, int frameTime)
+void Camera::moveDown(float amount, float frameTimeMs)
 {
-    m_pos.y -= (amount * frameTime);
+    m_pos.y -= (amount * frameTimeMs);
     m_viewMat.markOutdated();
 }
 
 void Camera::rotateHorizontallyDeg(float deg)
 {
     m_yawDeg += deg;
+    _recalcFrontVec();
     m_viewMat.markOutdated();
 }
 
@@ -121,22 +129,43 @@ void Camera::rotateVerticallyDeg(float deg)
     else if (m_pitchDeg < -89.9)
         m_pitchDeg = -89.9;
 
+    _recalcFrontVec();
     m_viewMat.markOutdated();
 }
 
-void Camera::updateShaderUniformsIfNeeded(ShaderProg& shader)
+void Camera::setRotationDeg(float yawDeg, float pitchDeg)
+{
+    m_yawDeg = yawDeg;
+    m_pitchDeg = 0.0f;
+    // Clamp the same way
+    rotateVerticallyDeg(pitchDeg);
+}
+
+void Camera::updateUniformBufferIfNeeded()
 {
+    if (!m_ubo)
+    {
+        glGenBuffers(1, &m_ubo);
+        GlState::bindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+        // Layout: mat4 inViewMat, mat4 inProjMat
+        glBufferData(GL_UNIFORM_BUFFER, 2*sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+        GlState::bindBufferBase(GL_UNIFORM_BUFFER, UBO_BINDING_CAMERA, m_ubo);
+        Logger::dbg << "Created camera uniform buffer (id=" << m_ubo << ')' << Logger::End;
+    }
+
     if (m_viewMat.isOutdated())
     {
         _recalcViewMat();
-        shader.setUniform("inViewMat", m_viewMat.get());
+        GlState::bindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(m_viewMat.get()));
         m_frustumMat.markOutdated();
     }
 
     if (m_projMat.isOutdated())
     {
         _recalcProjMat();
-        shader.setUniform("inProjMat", m_projMat.get());
+        GlState::bindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(m_projMat.get()));
         m_frustumMat.markOutdated();
     }
 
@@ -150,15 +179,3 @@ void Camera::onDebugModeSwitch()
 {
     m_viewMat.markOutdated();
 }
-
-bool Camera::isPointVisible(const glm::vec3& point)
-{
-    // See: http://www8.cs.umu.se/kurser/5DV051/HT12/lab/plane_extraction.pdf
-
-    const glm::vec4 vector = glm::vec4(point, 1);
-    const glm::vec4 transfVec = m_frustumMat.get() * vector;
-
-    return (-transfVec.w < transfVec.x < transfVec.w)
-       &&  (-transfVec.w < transfVec.y < transfVec.w)
-       &&  (-transfVec.w < transfVec.z < transfVec.w);
-}
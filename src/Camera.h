@@ -2,6 +2,7 @@
 
 #include <glm/vec3.hpp>
 #include "ShaderProg.h"
+#include "Frustum.h"
 
 class Camera final
 {
@@ -43,7 +44,17 @@ private:
     MaybeOutdated<glm::mat4> m_viewMat{};
     MaybeOutdated<glm::mat4> m_projMat{};
     MaybeOutdated<glm::mat4> m_frustumMat{};
+    // Planes of `m_frustumMat`
+    Frustum m_frustum{};
 
+    /*
+     * Uniform buffer holding the view and projection matrices (std140),
+     * shared by all shader programs through `UBO_BINDING_CAMERA`.
+     * Created on first update, when we already have a GL context.
+     */
+    uint m_ubo{};
+
+    void _recalcFrontVec();
     void _recalcProjMat();
     void _recalcViewMat();
     void _recalcFrustumMat();
@@ -55,24 +66,40 @@ public:
     void setWinAspectRatio(float ratio);
     void setPos(const glm::vec3& pos);
 
-    void moveForward(float amount, int frameTime);
-    void moveBackwards(float amount, int frameTime);
-    void moveLeft(float amount, int frameTime);
-    void moveRight(float amount, int frameTime);
-    void moveUp(float amount, int frameTime);
-    void moveDown(float amount, int frameTime);
+    /*
+     * `amount` is per millisecond.
+     */
+    void moveForward(float amount, float frameTimeMs);
+    void moveBackwards(float amount, float frameTimeMs);
+    void moveLeft(float amount, float frameTimeMs);
+    void moveRight(float amount, float frameTimeMs);
+    void moveUp(float amount, float frameTimeMs);
+    void moveDown(float amount, float frameTimeMs);
 
     void rotateHorizontallyDeg(float deg);
     void rotateVerticallyDeg(float deg);
+    void setRotationDeg(float yawDeg, float pitchDeg);
 
     inline const glm::vec3& getPos() const { return m_pos; }
     inline float getHorizRotDeg() const { return m_yawDeg; }
     inline float getVertRotDeg() const { return m_pitchDeg; }
     inline const glm::vec3& getFrontVec() const { return m_frontVec; }
 
-    void updateShaderUniformsIfNeeded(ShaderProg& shader);
+    /*
+     * Recalculates the outdated matrices and uploads them to the camera
+     * uniform buffer. Call once per frame before rendering.
+     */
+    void updateUniformBufferIfNeeded();
 
     void onDebugModeSwitch();
 
-    bool isPointVisible(const glm::vec3& point);
+    /*
+     * Up to date after `updateUniformBufferIfNeeded()`.
+     */
+    inline const Frustum& getFrustum() const { return m_frustum; }
+    /*
+     * Returns false if the axis aligned box is surely outside the view frustum.
+     * Boxes near the frustum corners may be reported visible.
+     */
+    inline bool isBoxVisible(const glm::vec3& min, const glm::vec3& max) const { return m_frustum.isBoxVisible(min, max); }
 };
@@ -0,0 +1,106 @@
+#include "Chunk.h"
+#include <algorithm>
+#include <atomic>
+
+Chunk::Chunk(int chunkX, int chunkZ)
+    : m_chunkX{chunkX}, m_chunkZ{chunkZ}
+{
+    m_neighbourhood[4] = this;
+    markSectionsDirty(CHUNK_ALL_SECTIONS_MASK, CHUNK_ALL_CACHES_MASK);
+}
+
+ChunkSection& Chunk::getOrCreateSection(int sectionI)
+{
+    std::shared_ptr<ChunkSection>& section = m_sections[sectionI];
+    if (!section)
+    {
+        section = std::make_shared<ChunkSection>();
+    }
+    // New references are only made while the chunk isn't written, so it can't become shared after the check
+    else if (section.use_count() > 1)
+    {
+        section = std::make_shared<ChunkSection>(*section);
+    }
+    else
+    {
+        // A snapshot may have just released it on another thread, its reads have to finish before our writes
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *section;
+}
+
+void Chunk::onSectionWritten(int sectionI)
+{
+    const ChunkSection* section = m_sections[sectionI].get();
+    if (section && section->randomTickedCount)
+        m_randomTickedSections |= 1u << sectionI;
+    else
+        m_randomTickedSections &= ~(1u << sectionI);
+
+    if (section && section->nonAirCount == 0)
+        m_sections[sectionI].reset();
+}
+
+ChunkSnapshot Chunk::takeSnapshot() const
+{
+    ChunkSnapshot snapshot{m_chunkX, m_chunkZ, {}};
+    std::copy(m_sections.begin(), m_sections.end(), snapshot.sections.begin());
+    return snapshot;
+}
+
+std::unique_ptr<Chunk> Chunk::makeReadCopy(uint32_t lightSectionMask) const
+{
+    auto copy = std::make_unique<Chunk>(m_chunkX, m_chunkZ);
+    copy->m_sections = m_sections;
+    copy->m_randomTickedSections = m_randomTickedSections;
+    for (int i{}; i < CHUNK_SECTION_COUNT; ++i)
+    {
+        if ((lightSectionMask & (1u << i)) && m_lightSections[i])
+            copy->m_lightSections[i] = std::make_unique<LightSection>(*m_lightSections[i]);
+    }
+    copy->m_isLit = m_isLit;
+    return copy;
+}
+
+void Chunk::setBlock(int x, int y, int z, Block block)
+{
+    // Setting air in an empty section
+    if (block.type == BLOCK_TYPE_AIR && !m_sections[y/CHUNK_SECTION_HEIGHT])
+        return;
+    ChunkSection& section = getOrCreateSection(y/CHUNK_SECTION_HEIGHT);
+
+    Block& dst = section.blocks[ChunkSection::getIndex(x, y%CHUNK_SECTION_HEIGHT, z)];
+    section.nonAirCount += (block.type != BLOCK_TYPE_AIR)-(dst.type != BLOCK_TYPE_AIR);
+    section.randomTickedCount += BlockRegistry::isRandomTicked(block.type)-BlockRegistry::isRandomTicked(dst.type);
+    dst = block;
+
+    onSectionWritten(y/CHUNK_SECTION_HEIGHT);
+}
+
+LightSection& Chunk::getOrCreateLightSection(int sectionI)
+{
+    if (!m_lightSections[sectionI])
+        m_lightSections[sectionI] = std::make_unique<LightSection>();
+    return *m_lightSections[sectionI];
+}
+
+void Chunk::freeLightSectionIfDefault(int sectionI)
+{
+    static const LightSection defaultSection;
+    const LightSection* section = m_lightSections[sectionI].get();
+    if (section && section->levels[LIGHT_SKY].data == defaultSection.levels[LIGHT_SKY].data
+                && section->levels[LIGHT_BLOCK].data == defaultSection.levels[LIGHT_BLOCK].data)
+        m_lightSections[sectionI].reset();
+}
+
+void Chunk::setLight(LightType type, int x, int y, int z, uint8_t level)
+{
+    std::unique_ptr<LightSection>& section = m_lightSections[y/CHUNK_SECTION_HEIGHT];
+    if (!section)
+    {
+        if (level == getDefaultLight(type))
+            return;
+        section = std::make_unique<LightSection>();
+    }
+    section->levels[type].set(ChunkSection::getIndex(x, y%CHUNK_SECTION_HEIGHT, z), level);
+}
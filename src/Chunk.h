@@ -0,0 +1,218 @@
+#pragma once
+
+#include "BlockRegistry.h"
+#include <array>
+#include <memory>
+#include <cstdint>
+#include <utility>
+
+#define CHUNK_WIDTH_BLOCKS 16
+#define CHUNK_HEIGHT_BLOCKS 384
+#define CHUNK_SECTION_HEIGHT 16
+#define CHUNK_SECTION_COUNT (CHUNK_HEIGHT_BLOCKS/CHUNK_SECTION_HEIGHT)
+#define CHUNK_SECTION_BLOCK_COUNT (CHUNK_WIDTH_BLOCKS*CHUNK_WIDTH_BLOCKS*CHUNK_SECTION_HEIGHT)
+#define LIGHT_MAX 15
+
+/*
+ * A 16x16x16 piece of a chunk.
+ */
+struct ChunkSection
+{
+    // Indexing: [y][z][x], see `getIndex()`
+    std::array<Block, CHUNK_SECTION_BLOCK_COUNT> blocks{};
+    // Number of blocks that aren't air, the section is freed when it drops to 0
+    int nonAirCount{};
+    // Number of blocks with `BLOCK_FLAG_RANDOM_TICKED`, the random ticks skip the section if 0
+    int randomTickedCount{};
+
+    static constexpr int getIndex(int x, int y, int z)
+    {
+        return (y*CHUNK_WIDTH_BLOCKS+z)*CHUNK_WIDTH_BLOCKS+x;
+    }
+};
+
+/*
+ * 4 bits per block, two blocks per byte, indexed like `ChunkSection::blocks`.
+ */
+struct NibbleArray
+{
+    std::array<uint8_t, CHUNK_SECTION_BLOCK_COUNT/2> data{};
+
+    inline uint8_t get(int i) const { return (data[i/2] >> (i%2*4)) & 0xf; }
+    inline void set(int i, uint8_t val)
+    {
+        const int shift = i%2*4;
+        data[i/2] = (data[i/2] & ~(0xf << shift)) | (val << shift);
+    }
+    inline void fill(uint8_t val) { data.fill(val | (val << 4)); }
+};
+
+enum LightType
+{
+    LIGHT_SKY,
+    LIGHT_BLOCK,
+    LIGHT__COUNT,
+};
+
+/*
+ * Light levels of a section, in [0, `LIGHT_MAX`].
+ */
+struct LightSection
+{
+    std::array<NibbleArray, LIGHT__COUNT> levels{};
+
+    // Starts like the default, see `Chunk::getDefaultLight()`
+    LightSection() { levels[LIGHT_SKY].fill(LIGHT_MAX); }
+};
+
+/*
+ * Data derived from the blocks, each kept up to date by its owner.
+ * The edits mark the affected sections dirty, each owner takes its bits.
+ * A dirty light bit means the whole chunk is relit, single-block edits
+ * are queued in `World` for an incremental update instead.
+ */
+enum ChunkCache
+{
+    CHUNK_CACHE_MESH,
+    CHUNK_CACHE_LIGHT,
+    // The copy in the region file, see `RegionStore`
+    CHUNK_CACHE_SAVE,
+    CHUNK_CACHE__COUNT,
+};
+
+#define CHUNK_ALL_SECTIONS_MASK ((1u << CHUNK_SECTION_COUNT)-1)
+#define CHUNK_ALL_CACHES_MASK ((1u << CHUNK_CACHE__COUNT)-1)
+static_assert(CHUNK_SECTION_COUNT <= 32);
+
+/*
+ * The blocks of a chunk frozen at one moment, for reading on another thread.
+ * Shares the sections with the chunk, the chunk copies a section before writing it.
+ */
+struct ChunkSnapshot
+{
+    int chunkX{};
+    int chunkZ{};
+    // Null if the section is all air
+    std::array<std::shared_ptr<const ChunkSection>, CHUNK_SECTION_COUNT> sections;
+};
+
+class Chunk final
+{
+private:
+    /*
+     * Position of the chunk in a chunk-sized grid.
+     */
+    int m_chunkX{};
+    int m_chunkZ{};
+
+    // Null if the section is all air. Shared with the snapshots, copied on write.
+    std::array<std::shared_ptr<ChunkSection>, CHUNK_SECTION_COUNT> m_sections;
+    // Bit per section with `ChunkSection::randomTickedCount` above 0, so the ticks don't touch the rest
+    uint32_t m_randomTickedSections{};
+    // Null if the section has the default light, written by `LightEngine`
+    std::array<std::unique_ptr<LightSection>, CHUNK_SECTION_COUNT> m_lightSections;
+    bool m_isLit{};
+
+    // The 3x3 chunks around this one, itself in the middle, indexed by `(dz+1)*3+(dx+1)`.
+    // Null if not loaded. Maintained by `World`.
+    std::array<Chunk*, 9> m_neighbourhood{};
+
+    // Bit per section, see `ChunkCache`
+    std::array<uint32_t, CHUNK_CACHE__COUNT> m_dirtySections{};
+
+    friend class World;
+
+public:
+    Chunk(int chunkX, int chunkZ);
+
+    // Disable copying and moving, the neighbours point to it
+    Chunk(const Chunk&) = delete;
+    Chunk& operator=(const Chunk&) = delete;
+    Chunk(Chunk&&) = delete;
+    Chunk& operator=(Chunk&&) = delete;
+
+    inline int getChunkX() const { return m_chunkX; }
+    inline int getChunkZ() const { return m_chunkZ; }
+
+    /*
+     * Takes coordinates local to the chunk: x and z in [0, 16), y in [0, `CHUNK_HEIGHT_BLOCKS`).
+     */
+    inline Block getBlock(int x, int y, int z) const
+    {
+        const ChunkSection* section = m_sections[y/CHUNK_SECTION_HEIGHT].get();
+        return section ? section->blocks[ChunkSection::getIndex(x, y%CHUNK_SECTION_HEIGHT, z)] : Block{};
+    }
+    /*
+     * Takes local coordinates, see `getBlock()`.
+     * Allocates or frees the section when needed.
+     * Doesn't mark anything dirty, use the `World` functions for editing loaded chunks.
+     */
+    void setBlock(int x, int y, int z, Block block);
+
+    inline const ChunkSection* getSection(int sectionI) const { return m_sections[sectionI].get(); }
+    /*
+     * Returns the section for writing, allocating it if needed, or copying it if a snapshot shares it.
+     * Keep the counts of `ChunkSection` up to date and call `onSectionWritten()` after writing.
+     */
+    ChunkSection& getOrCreateSection(int sectionI);
+    /*
+     * Frees the section if it became empty and updates the section masks from its counts.
+     */
+    void onSectionWritten(int sectionI);
+    inline uint32_t getRandomTickedSections() const { return m_randomTickedSections; }
+    /*
+     * Shares the sections, doesn't copy any blocks.
+     */
+    ChunkSnapshot takeSnapshot() const;
+    /*
+     * A copy for reading on another thread while this chunk is edited.
+     * Shares the sections like `takeSnapshot()`, and copies the light of the sections in
+     * `lightSectionMask`, the others have the default light. The copy has no neighbours.
+     */
+    std::unique_ptr<Chunk> makeReadCopy(uint32_t lightSectionMask) const;
+
+    /*
+     * Light of open sky, used where there is no light section.
+     */
+    static constexpr uint8_t getDefaultLight(LightType type) { return type == LIGHT_SKY ? LIGHT_MAX : 0; }
+    /*
+     * Takes local coordinates, see `getBlock()`.
+     */
+    inline uint8_t getLight(LightType type, int x, int y, int z) const
+    {
+        const LightSection* section = m_lightSections[y/CHUNK_SECTION_HEIGHT].get();
+        return section ? section->levels[type].get(ChunkSection::getIndex(x, y%CHUNK_SECTION_HEIGHT, z)) : getDefaultLight(type);
+    }
+    void setLight(LightType type, int x, int y, int z, uint8_t level);
+    inline const LightSection* getLightSection(int sectionI) const { return m_lightSections[sectionI].get(); }
+    LightSection& getOrCreateLightSection(int sectionI);
+    void freeLightSectionIfDefault(int sectionI);
+    /*
+     * False until the first full lighting, the light sections only hold the defaults till then.
+     */
+    inline bool isLit() const { return m_isLit; }
+    inline void setLit() { m_isLit = true; }
+
+    /*
+     * `cacheMask` has a bit per `ChunkCache`.
+     */
+    inline void markSectionsDirty(uint32_t sectionMask, uint32_t cacheMask)
+    {
+        for (int i{}; i < CHUNK_CACHE__COUNT; ++i)
+        {
+            if (cacheMask & (1u << i))
+                m_dirtySections[i] |= sectionMask;
+        }
+    }
+    /*
+     * Returns the dirty sections of `cache` and marks them clean.
+     */
+    inline uint32_t takeDirtySections(ChunkCache cache) { return std::exchange(m_dirtySections[cache], 0); }
+    inline uint32_t getDirtySections(ChunkCache cache) const { return m_dirtySections[cache]; }
+
+    /*
+     * `dx` and `dz` are in [-1, 1]. Returns null if the neighbour isn't loaded.
+     */
+    inline Chunk* getNeighbour(int dx, int dz) const { return m_neighbourhood[(dz+1)*3+(dx+1)]; }
+    inline const std::array<Chunk*, 9>& getNeighbourhood() const { return m_neighbourhood; }
+};
@@ -0,0 +1,214 @@
+#include "ChunkMesher.h"
+#include "Profiler.h"
+#include <array>
+
+namespace ChunkMesher
+{
+
+struct FaceCorner
+{
+    // Offset from the minimum corner of the block
+    int x{};
+    int y{};
+    int z{};
+    float u{};
+    float v{};
+};
+
+struct FaceDef
+{
+    // Direction of the neighbour that can hide the face
+    int normalX{};
+    int normalY{};
+    int normalZ{};
+    // Counter-clockwise, seen from the outside
+    std::array<FaceCorner, 4> corners{};
+};
+
+// Indexed by `BlockFace`
+static constexpr std::array<FaceDef, BLOCK_FACE__COUNT> faceDefs = {{
+    { 0,  1,  0, {{{0, 1, 1, 0, 0}, {1, 1, 1, 1, 0}, {1, 1, 0, 1, 1}, {0, 1, 0, 0, 1}}}}, // Top
+    { 0,  0,  1, {{{0, 0, 1, 0, 0}, {1, 0, 1, 1, 0}, {1, 1, 1, 1, 1}, {0, 1, 1, 0, 1}}}}, // Front
+    {-1,  0,  0, {{{0, 0, 1, 0, 0}, {0, 1, 1, 0, 1}, {0, 1, 0, 1, 1}, {0, 0, 0, 1, 0}}}}, // Left
+    { 0, -1,  0, {{{0, 0, 1, 0, 0}, {0, 0, 0, 0, 1}, {1, 0, 0, 1, 1}, {1, 0, 1, 1, 0}}}}, // Bottom
+    { 1,  0,  0, {{{1, 0, 1, 0, 0}, {1, 0, 0, 1, 0}, {1, 1, 0, 1, 1}, {1, 1, 1, 0, 1}}}}, // Right
+    { 0,  0, -1, {{{0, 0, 0, 0, 0}, {0, 1, 0, 0, 1}, {1, 1, 0, 1, 1}, {1, 0, 0, 1, 0}}}}, // Back
+}};
+
+/*
+ * Light reaching a face corner past the blocks in front of the face around it, in [0, 3].
+ */
+static inline int getCornerAo(bool isSide1Opaque, bool isSide2Opaque, bool isCornerOpaque)
+{
+    // The two sides hide the corner block too
+    if (isSide1Opaque && isSide2Opaque)
+        return 0;
+    return 3-(isSide1Opaque+isSide2Opaque+isCornerOpaque);
+}
+
+// The section with a block wide border from the neighbours
+#define PADDED_WIDTH (CHUNK_WIDTH_BLOCKS+2)
+#define PADDED_HEIGHT (CHUNK_SECTION_HEIGHT+2)
+
+/*
+ * Opacity of the blocks around and in a section, so the face culling and
+ * the AO don't look up the same neighbours through the view again and again.
+ * Takes section coordinates, that can be 1 block outside of the section.
+ */
+struct OpacityCache
+{
+    bool isOpaque[PADDED_HEIGHT][PADDED_WIDTH][PADDED_WIDTH]{};
+
+    inline bool get(int x, int y, int z) const { return isOpaque[y+1][z+1][x+1]; }
+};
+
+static void fillOpacityCache(const ChunkNeighbourhood& view, int originY, OpacityCache* out)
+{
+    for (int y{-1}; y <= CHUNK_SECTION_HEIGHT; ++y)
+    {
+        for (int z{-1}; z <= CHUNK_WIDTH_BLOCKS; ++z)
+        {
+            for (int x{-1}; x <= CHUNK_WIDTH_BLOCKS; ++x)
+                out->isOpaque[y+1][z+1][x+1] = BlockRegistry::isOpaque(view.getBlock(x, originY+y, z).type);
+        }
+    }
+}
+
+struct Offset
+{
+    int x{};
+    int y{};
+    int z{};
+};
+
+// The blocks darkening a face corner, relative to the block in front of the face
+struct CornerAoOffsets
+{
+    Offset side1{};
+    Offset side2{};
+    Offset diagonal{};
+};
+
+static constexpr std::array<std::array<CornerAoOffsets, 4>, BLOCK_FACE__COUNT> calcAoOffsets()
+{
+    std::array<std::array<CornerAoOffsets, 4>, BLOCK_FACE__COUNT> offsets{};
+    for (size_t faceI{}; faceI < faceDefs.size(); ++faceI)
+    {
+        const FaceDef& face = faceDefs[faceI];
+        // The axes along the face
+        const int normalAxis = face.normalX ? 0 : (face.normalY ? 1 : 2);
+        const int uAxis = (normalAxis+1)%3;
+        const int vAxis = (normalAxis+2)%3;
+        for (size_t i{}; i < face.corners.size(); ++i)
+        {
+            const int cornerPos[3]{face.corners[i].x, face.corners[i].y, face.corners[i].z};
+            // Towards the corner, from the middle of the face
+            int side1[3]{};
+            side1[uAxis] = cornerPos[uAxis]*2-1;
+            int side2[3]{};
+            side2[vAxis] = cornerPos[vAxis]*2-1;
+            offsets[faceI][i] = {
+                {side1[0], side1[1], side1[2]},
+                {side2[0], side2[1], side2[2]},
+                {side1[0]+side2[0], side1[1]+side2[1], side1[2]+side2[2]}};
+        }
+    }
+    return offsets;
+}
+
+// Indexed by `BlockFace` and the corner
+static constexpr std::array<std::array<CornerAoOffsets, 4>, BLOCK_FACE__COUNT> aoOffsets = calcAoOffsets();
+
+/*
+ * Fills `out` with the AO of the corners of a face, in the order of `FaceDef::corners`.
+ * The front block is the one the face looks at, in section coordinates.
+ */
+static inline void calcFaceAo(const OpacityCache& opacity, int faceI,
+        int frontX, int frontY, int frontZ, std::array<int, 4>* out)
+{
+    for (size_t i{}; i < out->size(); ++i)
+    {
+        const CornerAoOffsets& offs = aoOffsets[faceI][i];
+        (*out)[i] = getCornerAo(
+                opacity.get(frontX+offs.side1.x, frontY+offs.side1.y, frontZ+offs.side1.z),
+                opacity.get(frontX+offs.side2.x, frontY+offs.side2.y, frontZ+offs.side2.z),
+                opacity.get(frontX+offs.diagonal.x, frontY+offs.diagonal.y, frontZ+offs.diagonal.z));
+    }
+}
+
+void meshSection(const ChunkNeighbourhood& view, int sectionI, bool withAo, SectionMesh* out)
+{
+    PROFILE_ZONE("ChunkMesher::meshSection");
+    out->vertices.clear();
+    out->indices.clear();
+
+    const ChunkSection* section = view.getMiddle().getSection(sectionI);
+    if (!section)
+        return;
+
+    const int originX = view.getMiddle().getChunkX()*CHUNK_WIDTH_BLOCKS;
+    const int originY = sectionI*CHUNK_SECTION_HEIGHT;
+    const int originZ = view.getMiddle().getChunkZ()*CHUNK_WIDTH_BLOCKS;
+
+    OpacityCache opacity;
+    fillOpacityCache(view, originY, &opacity);
+
+    for (int y{}; y < CHUNK_SECTION_HEIGHT; ++y)
+    {
+        for (int z{}; z < CHUNK_WIDTH_BLOCKS; ++z)
+        {
+            for (int x{}; x < CHUNK_WIDTH_BLOCKS; ++x)
+            {
+                const BlockType type = section->blocks[ChunkSection::getIndex(x, y, z)].type;
+                if (!BlockRegistry::isVisible(type))
+                    continue;
+
+                for (int faceI{}; faceI < BLOCK_FACE__COUNT; ++faceI)
+                {
+                    const FaceDef& face = faceDefs[faceI];
+                    const int frontX = x+face.normalX;
+                    const int frontY = originY+y+face.normalY;
+                    const int frontZ = z+face.normalZ;
+                    if (opacity.get(x+face.normalX, y+face.normalY, z+face.normalZ))
+                        continue;
+                    // The faces between the cells of a fluid are inside of it
+                    if (BlockRegistry::isFluid(type) && view.getBlock(frontX, frontY, frontZ).type == type)
+                        continue;
+
+                    const float texLayer = BlockRegistry::getFaceLayer(type, (BlockFace)faceI);
+                    const float skyLight = view.getLight(LIGHT_SKY, frontX, frontY, frontZ)/(float)LIGHT_MAX;
+                    const float blockLight = view.getLight(LIGHT_BLOCK, frontX, frontY, frontZ)/(float)LIGHT_MAX;
+                    std::array<int, 4> cornerAos{3, 3, 3, 3};
+                    if (withAo)
+                        calcFaceAo(opacity, faceI, x+face.normalX, y+face.normalY, z+face.normalZ, &cornerAos);
+
+                    const uint firstVertI = out->vertices.size();
+                    for (size_t i{}; i < face.corners.size(); ++i)
+                    {
+                        const FaceCorner& corner = face.corners[i];
+                        out->vertices.push_back({
+                                (float)(originX+x+corner.x), (float)(originY+y+corner.y), (float)(originZ+z+corner.z),
+                                corner.u, corner.v, texLayer, skyLight, blockLight, cornerAos[i]/3.0f});
+                    }
+
+                    // The diagonal joins the brighter pair of corners, so that a lone dark
+                    // corner stays in one triangle and the shading doesn't depend on the rotation
+                    if (cornerAos[0]+cornerAos[2] >= cornerAos[1]+cornerAos[3])
+                    {
+                        out->indices.insert(out->indices.end(), {
+                                firstVertI, firstVertI+1, firstVertI+2,
+                                firstVertI, firstVertI+2, firstVertI+3});
+                    }
+                    else
+                    {
+                        out->indices.insert(out->indices.end(), {
+                                firstVertI+1, firstVertI+2, firstVertI+3,
+                                firstVertI+1, firstVertI+3, firstVertI});
+                    }
+                }
+            }
+        }
+    }
+}
+
+} // End of namespace ChunkMesher
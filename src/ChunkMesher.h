@@ -0,0 +1,44 @@
+#pragma once
+
+#include "World.h"
+#include "types.h"
+#include <vector>
+
+struct ChunkVertex
+{
+    // World position in block units, the shader scales it
+    float x{};
+    float y{};
+    float z{};
+    float u{};
+    float v{};
+    float texLayer{};
+    // Light of the block in front of the face, in [0, 1]
+    float skyLight{};
+    float blockLight{};
+    // Ambient occlusion of the corner, from 0 (fully occluded) to 1
+    float ao{};
+};
+
+struct SectionMesh
+{
+    std::vector<ChunkVertex> vertices;
+    // Two triangles per face
+    std::vector<uint> indices;
+
+    inline bool isEmpty() const { return indices.empty(); }
+};
+
+namespace ChunkMesher
+{
+
+/*
+ * Builds the faces of a section that aren't hidden by an opaque neighbour.
+ * Blocks of the neighbouring chunks are read through `view`, unloaded chunks count as air.
+ * With `withAo`, the corners are darkened by the opaque blocks touching them,
+ * otherwise the AO is 1 everywhere.
+ * `out` is cleared first, its memory is reused.
+ */
+void meshSection(const ChunkNeighbourhood& view, int sectionI, bool withAo, SectionMesh* out);
+
+} // End of namespace ChunkMesher
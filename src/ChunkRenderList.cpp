@@ -0,0 +1,99 @@
+#include "ChunkRenderList.h"
+#include "Profiler.h"
+#include <algorithm>
+
+namespace ChunkRenderList
+{
+
+int recordDraws(const ChunkGpuMesh* const* meshes, int count, const Frustum& frustum, RenderCommandBuffer* out)
+{
+    int visibleSectionCount{};
+    for (int meshI{}; meshI < count; ++meshI)
+    {
+        const ChunkGpuMesh& mesh = *meshes[meshI];
+        bool isMeshBound = false;
+
+        // Consecutive visible sections are drawn with one call
+        uint runFirstIndex{};
+        uint runIndexCount{};
+        auto flushRun{[&](){
+            if (runIndexCount == 0)
+                return;
+            if (!isMeshBound)
+            {
+                out->bindMesh(mesh.vao);
+                isMeshBound = true;
+            }
+            out->drawTriangles(runFirstIndex, runIndexCount);
+            runIndexCount = 0;
+        }};
+
+        for (int i{}; i < CHUNK_SECTION_COUNT; ++i)
+        {
+            if (mesh.indexCounts[i] == 0)
+            {
+                // Empty sections take no space in the buffers, they don't break the run
+                continue;
+            }
+
+            // Blocks are 2 units wide and centered on twice their coordinates
+            const glm::vec3 boxMin{
+                mesh.chunkX*CHUNK_WIDTH_BLOCKS*2-1.0f,
+                i*CHUNK_SECTION_HEIGHT*2-1.0f,
+                mesh.chunkZ*CHUNK_WIDTH_BLOCKS*2-1.0f};
+            const glm::vec3 boxMax = boxMin+glm::vec3{CHUNK_WIDTH_BLOCKS*2, CHUNK_SECTION_HEIGHT*2, CHUNK_WIDTH_BLOCKS*2};
+            if (!frustum.isBoxVisible(boxMin, boxMax))
+            {
+                flushRun();
+                continue;
+            }
+
+            if (runIndexCount == 0)
+                runFirstIndex = mesh.firstIndices[i];
+            runIndexCount += mesh.indexCounts[i];
+            ++visibleSectionCount;
+        }
+        flushRun();
+    }
+    return visibleSectionCount;
+}
+
+int recordDrawsParallel(const std::vector<const ChunkGpuMesh*>& meshes, const Frustum& frustum,
+        uint progId, uint texArrayId, ThreadPool* pool, std::vector<RenderCommandBuffer>* buffers)
+{
+    PROFILE_ZONE("ChunkRenderList::recordDrawsParallel");
+
+    const int meshCount = meshes.size();
+    int groupCount = 1;
+    if (pool)
+    {
+        groupCount = std::min(
+                (pool->getThreadCount()+1)*CHUNK_RENDER_GROUPS_PER_THREAD,
+                (meshCount+CHUNK_RENDER_MIN_GROUP_SIZE-1)/CHUNK_RENDER_MIN_GROUP_SIZE);
+        groupCount = std::max(groupCount, 1);
+    }
+    buffers->resize(groupCount);
+
+    std::vector<int> visibleSectionCounts(groupCount);
+    auto recordGroup{[&](int groupI){
+        // Consecutive groups, so the buffers stay in the order of `meshes`
+        const int begin = (long)meshCount*groupI/groupCount;
+        const int end = (long)meshCount*(groupI+1)/groupCount;
+        RenderCommandBuffer& buffer = (*buffers)[groupI];
+        buffer.clear();
+        buffer.useProgram(progId);
+        buffer.bindTextureArray(texArrayId);
+        visibleSectionCounts[groupI] = recordDraws(meshes.data()+begin, end-begin, frustum, &buffer);
+    }};
+    if (pool)
+        pool->parallelFor(groupCount, recordGroup);
+    else
+        recordGroup(0);
+
+    int visibleSectionCount{};
+    for (int count : visibleSectionCounts)
+        visibleSectionCount += count;
+    return visibleSectionCount;
+}
+
+} // End of namespace ChunkRenderList
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ChunkMesher.h"
+#include "RenderCommands.h"
+#include "Frustum.h"
+#include "ThreadPool.h"
+#include "types.h"
+#include <array>
+#include <vector>
+
+// Groups per recording thread, so that uneven groups balance out
+#define CHUNK_RENDER_GROUPS_PER_THREAD 4
+// Smaller groups aren't worth a task
+#define CHUNK_RENDER_MIN_GROUP_SIZE 16
+
+/*
+ * GPU copy of the meshes of a chunk. The sections are stored one after another
+ * in the same buffers, so each of them can be drawn or skipped on its own.
+ */
+struct ChunkGpuMesh
+{
+    int chunkX{};
+    int chunkZ{};
+    // Kept to rebuild the buffers when only some of the sections change
+    std::array<SectionMesh, CHUNK_SECTION_COUNT> sectionMeshes;
+    // Where each section is in the index buffer, in indices
+    std::array<uint, CHUNK_SECTION_COUNT> firstIndices{};
+    std::array<uint, CHUNK_SECTION_COUNT> indexCounts{};
+    uint vao{};
+    uint vbo{};
+    uint ebo{};
+};
+
+/*
+ * Builds the draw lists of the chunks without the graphics API.
+ *
+ * The draws aren't sorted by state and have no uniforms of their own: every chunk is drawn
+ * with the same program and texture array, bound once per buffer, the vertices are in world
+ * space and the camera matrices are in a uniform buffer. Only the mesh changes between
+ * the draws, and each is bound once.
+ */
+namespace ChunkRenderList
+{
+
+/*
+ * Records the draws of the sections of `meshes` inside the frustum into `out`.
+ * Consecutive visible sections of a chunk are drawn with one call.
+ * Returns the number of visible sections.
+ */
+int recordDraws(const ChunkGpuMesh* const* meshes, int count, const Frustum& frustum, RenderCommandBuffer* out);
+
+/*
+ * Records `meshes` on `pool` into one buffer per group of consecutive chunks, `buffers`
+ * is resized to the number of groups. With a null pool, everything is recorded into one buffer.
+ * Every buffer binds `progId` and `texArrayId` first, so executing them in order
+ * draws the same as recording serially. Returns the number of visible sections.
+ */
+int recordDrawsParallel(const std::vector<const ChunkGpuMesh*>& meshes, const Frustum& frustum,
+        uint progId, uint texArrayId, ThreadPool* pool, std::vector<RenderCommandBuffer>* buffers);
+
+} // End of namespace ChunkRenderList
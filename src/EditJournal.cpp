@@ -0,0 +1,444 @@
+#include "EditJournal.h"
+#include "MappedFile.h"
+#include "Varint.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include "common.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+/*
+ * Retries after partial writes. Returns false on error.
+ */
+static bool writeAll(int fd, const char* data, size_t size)
+{
+    while (size)
+    {
+        const ssize_t written = ::write(fd, data, size);
+        if (written == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+/*
+ * Creates an empty journal file, replacing the old one. Returns -1 on error.
+ */
+static int createFile(const std::string& path)
+{
+    // Appending, so the writes go to the end after `clear()` truncates the file
+    const int fd = ::open(path.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_APPEND|O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+        Logger::err << "Failed to open journal: \"" << path << "\": " << std::strerror(errno) << Logger::End;
+        return -1;
+    }
+    JournalFileHeader header;
+    std::memcpy(header.magic, JOURNAL_MAGIC, 4);
+    header.version = JOURNAL_VERSION;
+    if (!writeAll(fd, (const char*)&header, sizeof(header)) || fdatasync(fd) == -1)
+    {
+        Logger::err << "Failed to write journal: \"" << path << "\": " << std::strerror(errno) << Logger::End;
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool EditJournal::open(const std::string& path)
+{
+    close();
+
+    const int fd = createFile(path);
+    if (fd == -1)
+        return false;
+
+    m_fd = fd;
+    m_path = path;
+    m_syncedSize = sizeof(JournalFileHeader);
+    m_failedBatches.clear();
+    // The batch header is filled in by the commit
+    m_pending.assign(sizeof(JournalBatchHeader), '\0');
+    m_pendingRecordCount = 0;
+    m_lastPos = {};
+    m_isStopping = false;
+    m_thread = std::thread{&EditJournal::threadMain, this};
+    Logger::dbg << "Opened journal: \"" << path << '"' << Logger::End;
+    return true;
+}
+
+void EditJournal::close()
+{
+    if (m_fd == -1)
+        return;
+
+    {
+        const std::lock_guard lock{m_pendingMutex};
+        m_isStopping = true;
+    }
+    m_pendingCv.notify_all();
+    m_thread.join();
+    commit();
+    if (!m_failedBatches.empty())
+    {
+        Logger::err << "Lost " << m_failedBatches.size() << " journal bytes that failed to be written: \"" << m_path << '"' << Logger::End;
+    }
+
+    ::close(m_fd);
+    m_fd = -1;
+    Logger::dbg << "Closed journal after " << m_commitCount.load() << " commits, " << m_committedBytes.load() << " bytes" << Logger::End;
+}
+
+void EditJournal::threadMain()
+{
+    PROFILE_THREAD_NAME("Journal");
+    std::unique_lock lock{m_pendingMutex};
+    while (!m_isStopping)
+    {
+        m_pendingCv.wait_for(lock, std::chrono::milliseconds{JOURNAL_COMMIT_INTERVAL_MS},
+                [&](){
+                    return m_isStopping || !m_rotationPath.empty() || m_pending.size() >= JOURNAL_MAX_PENDING_BYTES;
+                });
+        lock.unlock();
+        commit();
+        lock.lock();
+    }
+}
+
+void EditJournal::beginRecord(JournalRecordType type)
+{
+    m_pending.push_back((char)type);
+    ++m_pendingRecordCount;
+}
+
+void EditJournal::append(BlockPos pos, Block block)
+{
+    bool isFull{};
+    {
+        const std::lock_guard lock{m_pendingMutex};
+        beginRecord(JOURNAL_RECORD_SET);
+        Varint::write(&m_pending, Varint::zigzag((int64_t)pos.x-m_lastPos.x));
+        Varint::write(&m_pending, Varint::zigzag((int64_t)pos.y-m_lastPos.y));
+        Varint::write(&m_pending, Varint::zigzag((int64_t)pos.z-m_lastPos.z));
+        m_pending.push_back((char)block.type);
+        m_pending.push_back((char)block.state);
+        m_lastPos = pos;
+        isFull = m_pending.size() >= JOURNAL_MAX_PENDING_BYTES;
+    }
+    if (isFull)
+        m_pendingCv.notify_one();
+}
+
+void EditJournal::appendFill(BlockPos min, BlockPos max, Block block)
+{
+    const std::lock_guard lock{m_pendingMutex};
+    beginRecord(JOURNAL_RECORD_FILL);
+    Varint::write(&m_pending, Varint::zigzag(min.x));
+    Varint::write(&m_pending, Varint::zigzag(min.y));
+    Varint::write(&m_pending, Varint::zigzag(min.z));
+    // The bounds may be swapped
+    Varint::write(&m_pending, Varint::zigzag((int64_t)max.x-min.x));
+    Varint::write(&m_pending, Varint::zigzag((int64_t)max.y-min.y));
+    Varint::write(&m_pending, Varint::zigzag((int64_t)max.z-min.z));
+    m_pending.push_back((char)block.type);
+    m_pending.push_back((char)block.state);
+}
+
+void EditJournal::writeBatch(std::string* buffer, uint32_t recordCount)
+{
+    const std::string_view payload = std::string_view{*buffer}.substr(sizeof(JournalBatchHeader));
+    const JournalBatchHeader header{(uint32_t)payload.size(), recordCount, fnv1aHash(payload)};
+    std::memcpy(buffer->data(), &header, sizeof(header));
+    // Drop what is left of a failed write, the batches after it would be unreachable
+    if (!m_failedBatches.empty() && ftruncate(m_fd, m_syncedSize) == -1)
+    {
+        Logger::err << "Failed to truncate journal: \"" << m_path << "\": " << std::strerror(errno) << Logger::End;
+        m_failedBatches.append(*buffer);
+        return;
+    }
+
+    // A single write and sync for all the edits since the last good commit
+    const std::string* data = buffer;
+    if (!m_failedBatches.empty())
+    {
+        m_failedBatches.append(*buffer);
+        data = &m_failedBatches;
+    }
+    if (!writeAll(m_fd, data->data(), data->size()) || fdatasync(m_fd) == -1)
+    {
+        Logger::err << "Failed to write journal, retrying with the next commit: \"" << m_path << "\": " << std::strerror(errno) << Logger::End;
+        if (data == buffer)
+            m_failedBatches = *buffer;
+        return;
+    }
+    m_syncedSize += data->size();
+    ++m_commitCount;
+    m_committedBytes += data->size();
+    m_failedBatches.clear();
+}
+
+void EditJournal::commit()
+{
+    PROFILE_ZONE("EditJournal::commit");
+    const std::lock_guard writeLock{m_writeMutex};
+    if (m_fd == -1)
+        return;
+
+    std::string rotationPath;
+    uint32_t rotatedRecordCount{};
+    uint32_t recordCount{};
+    {
+        const std::lock_guard lock{m_pendingMutex};
+        if (!m_rotationPath.empty())
+        {
+            rotationPath = std::exchange(m_rotationPath, {});
+            m_rotatedWriteBuffer.swap(m_rotatedPending);
+            rotatedRecordCount = std::exchange(m_rotatedRecordCount, 0);
+        }
+        if (m_pendingRecordCount)
+        {
+            m_writeBuffer.swap(m_pending);
+            m_pending.assign(sizeof(JournalBatchHeader), '\0');
+            recordCount = std::exchange(m_pendingRecordCount, 0);
+            m_lastPos = {};
+        }
+    }
+
+    if (!rotationPath.empty())
+    {
+        if (rotatedRecordCount)
+            writeBatch(&m_rotatedWriteBuffer, rotatedRecordCount);
+        // On error the edits keep going to the old file, they are still safe
+        const int fd = createFile(rotationPath);
+        if (fd != -1)
+        {
+            ::close(m_fd);
+            m_fd = fd;
+            m_path = std::move(rotationPath);
+            // The failed batches go to the new file, they come before its edits
+            m_syncedSize = sizeof(JournalFileHeader);
+        }
+    }
+    if (recordCount)
+        writeBatch(&m_writeBuffer, recordCount);
+}
+
+void EditJournal::clear()
+{
+    const std::lock_guard writeLock{m_writeMutex};
+    {
+        const std::lock_guard lock{m_pendingMutex};
+        m_pending.assign(sizeof(JournalBatchHeader), '\0');
+        m_pendingRecordCount = 0;
+        m_lastPos = {};
+        m_rotationPath.clear();
+        m_rotatedRecordCount = 0;
+    }
+    m_failedBatches.clear();
+    if (m_fd == -1)
+        return;
+
+    m_syncedSize = sizeof(JournalFileHeader);
+    if (ftruncate(m_fd, sizeof(JournalFileHeader)) == -1 || fdatasync(m_fd) == -1)
+    {
+        Logger::err << "Failed to clear journal: \"" << m_path << "\": " << std::strerror(errno) << Logger::End;
+    }
+}
+
+void EditJournal::rotate(const std::string& newPath)
+{
+    {
+        const std::lock_guard lock{m_pendingMutex};
+        m_rotationPath = newPath;
+        m_rotatedPending.swap(m_pending);
+        m_pending.assign(sizeof(JournalBatchHeader), '\0');
+        m_rotatedRecordCount = std::exchange(m_pendingRecordCount, 0);
+        m_lastPos = {};
+    }
+    m_pendingCv.notify_one();
+}
+
+std::string EditJournal::getPath()
+{
+    const std::lock_guard writeLock{m_writeMutex};
+    return m_path;
+}
+
+// A parsed journal record, a set has `min` equal to `max`
+struct ReplayRecord
+{
+    JournalRecordType type{};
+    BlockPos min;
+    BlockPos max;
+    Block block;
+};
+
+/*
+ * Parses the records of a batch into `records`.
+ * Returns false if the records are invalid.
+ */
+static bool parseBatch(const char* pos, const char* end, uint32_t recordCount, std::vector<ReplayRecord>* records)
+{
+    records->clear();
+    BlockPos lastPos;
+    uint64_t vals[6]{};
+    for (uint32_t i{}; i < recordCount; ++i)
+    {
+        if (pos == end)
+            return false;
+        const uint8_t type = *pos++;
+        if (type != JOURNAL_RECORD_SET && type != JOURNAL_RECORD_FILL)
+            return false;
+        const int valCount = type == JOURNAL_RECORD_FILL ? 6 : 3;
+        for (int j{}; j < valCount; ++j)
+        {
+            if (!Varint::read(&pos, end, &vals[j]))
+                return false;
+        }
+        if (end-pos < 2)
+            return false;
+        const Block block{(BlockType)(uint8_t)pos[0], (uint8_t)pos[1]};
+        pos += 2;
+        if (block.type >= BLOCK_TYPE__COUNT)
+            return false;
+
+        if (type == JOURNAL_RECORD_SET)
+        {
+            lastPos = {
+                (int)(lastPos.x+Varint::unzigzag(vals[0])),
+                (int)(lastPos.y+Varint::unzigzag(vals[1])),
+                (int)(lastPos.z+Varint::unzigzag(vals[2]))};
+            records->push_back({JOURNAL_RECORD_SET, lastPos, lastPos, block});
+        }
+        else
+        {
+            const BlockPos min{
+                (int)Varint::unzigzag(vals[0]), (int)Varint::unzigzag(vals[1]), (int)Varint::unzigzag(vals[2])};
+            const BlockPos max{
+                (int)(min.x+Varint::unzigzag(vals[3])),
+                (int)(min.y+Varint::unzigzag(vals[4])),
+                (int)(min.z+Varint::unzigzag(vals[5]))};
+            records->push_back({JOURNAL_RECORD_FILL, min, max, block});
+        }
+    }
+    return pos == end;
+}
+
+/*
+ * Applies the parsed records of a batch in order.
+ */
+static void applyBatch(const std::vector<ReplayRecord>& records,
+        World* world, const ChunkLoader& loader, std::vector<BlockEdit>* edits, JournalReplayStats* stats)
+{
+    auto loadChunk{[&](int chunkX, int chunkZ){
+        if (!loader || world->getChunk(chunkX, chunkZ))
+            return;
+        if (std::unique_ptr<Chunk> chunk = loader(chunkX, chunkZ))
+            world->addChunk(std::move(chunk));
+    }};
+
+    // The sets are applied together, up to the next fill
+    auto flushEdits{[&](){
+        stats->skippedCount += edits->size()-world->setBlocks(*edits);
+        edits->clear();
+    }};
+
+    for (const ReplayRecord& record : records)
+    {
+        if (record.type == JOURNAL_RECORD_SET)
+        {
+            loadChunk(World::blockToChunkCoord(record.min.x), World::blockToChunkCoord(record.min.z));
+            edits->push_back({record.min, record.block});
+        }
+        else
+        {
+            flushEdits();
+            if (loader)
+            {
+                for (int chunkZ = World::blockToChunkCoord(record.min.z); chunkZ <= World::blockToChunkCoord(record.max.z); ++chunkZ)
+                {
+                    for (int chunkX = World::blockToChunkCoord(record.min.x); chunkX <= World::blockToChunkCoord(record.max.x); ++chunkX)
+                        loadChunk(chunkX, chunkZ);
+                }
+            }
+            world->fillBox(record.min, record.max, record.block);
+        }
+    }
+    flushEdits();
+    stats->editCount += records.size();
+}
+
+JournalReplayStats EditJournal::replay(const std::string& path, World* world, const ChunkLoader& loader)
+{
+    PROFILE_ZONE("EditJournal::replay");
+    JournalReplayStats stats;
+    MappedFile file;
+    if (!file.open(path))
+        return stats;
+
+    const char* pos = file.data();
+    const char* const end = pos+file.size();
+    JournalFileHeader header;
+    if (file.size() >= sizeof(header))
+        std::memcpy(&header, pos, sizeof(header));
+    if (file.size() < sizeof(header) || std::memcmp(header.magic, JOURNAL_MAGIC, 4) != 0
+     || header.version != JOURNAL_VERSION)
+    {
+        if (file.size())
+        {
+            Logger::err << "Invalid or outdated journal, ignoring it: \"" << path << '"' << Logger::End;
+        }
+        stats.discardedBytes = file.size();
+        return stats;
+    }
+    pos += sizeof(header);
+
+    std::vector<ReplayRecord> records;
+    std::vector<BlockEdit> edits;
+    while ((size_t)(end-pos) >= sizeof(JournalBatchHeader))
+    {
+        JournalBatchHeader batch;
+        std::memcpy(&batch, pos, sizeof(batch));
+        const char* payload = pos+sizeof(batch);
+        // Cut off or partly written by a crash
+        if ((size_t)(end-payload) < batch.payloadSize || fnv1aHash({payload, batch.payloadSize}) != batch.hash)
+            break;
+        // A batch is applied whole or not at all
+        if (!parseBatch(payload, payload+batch.payloadSize, batch.recordCount, &records))
+        {
+            Logger::err << "Invalid records in journal batch " << stats.batchCount << ": \"" << path << '"' << Logger::End;
+            break;
+        }
+        applyBatch(records, world, loader, &edits, &stats);
+        pos = payload+batch.payloadSize;
+        ++stats.batchCount;
+    }
+    stats.discardedBytes = end-pos;
+
+    if (stats.discardedBytes)
+    {
+        Logger::warn << "Discarded the last " << stats.discardedBytes << " bytes of the journal, they weren't committed"
+            << Logger::End;
+    }
+    if (stats.skippedCount)
+    {
+        Logger::warn << "Skipped " << stats.skippedCount << " journaled edits in chunks that aren't loaded" << Logger::End;
+    }
+    return stats;
+}
+
+EditJournal::~EditJournal()
+{
+    close();
+}
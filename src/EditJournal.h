@@ -0,0 +1,167 @@
+#pragma once
+
+#include "World.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define JOURNAL_MAGIC "ACJL"
+// Bump when the layout of the records changes
+#define JOURNAL_VERSION 1
+// The appended edits are written and synced together this often, a crash loses at most this much
+#define JOURNAL_COMMIT_INTERVAL_MS 50
+// Commit early if this many bytes are waiting
+#define JOURNAL_MAX_PENDING_BYTES (4*1024*1024)
+
+struct JournalFileHeader
+{
+    char magic[4]{};
+    uint32_t version{};
+};
+
+// Each commit is a batch: this header, then `payloadSize` bytes of records
+struct JournalBatchHeader
+{
+    uint32_t payloadSize{};
+    uint32_t recordCount{};
+    // FNV-1a of the payload, a torn write at the end of the file doesn't match
+    uint64_t hash{};
+};
+
+enum JournalRecordType : uint8_t
+{
+    // Position relative to the previous set in the batch, then the block
+    JOURNAL_RECORD_SET,
+    // Minimum corner, the size minus 1, then the block. One per section span written by `World::fillBox()`
+    JOURNAL_RECORD_FILL,
+};
+
+// Loads or generates a chunk that isn't in the world yet, may return null
+using ChunkLoader = std::function<std::unique_ptr<Chunk>(int chunkX, int chunkZ)>;
+
+struct JournalReplayStats
+{
+    long batchCount{};
+    long editCount{};
+    // Edits in chunks that weren't loaded
+    long skippedCount{};
+    // Bytes after the last valid batch, left by a crash
+    size_t discardedBytes{};
+};
+
+/*
+ * Append-only log of the block edits since the last checkpoint, for crash safety
+ * without writing whole chunks on every edit.
+ *
+ * The edits are encoded into a buffer, and a writer thread commits the buffer every
+ * `JOURNAL_COMMIT_INTERVAL_MS` as one batch with a single write and sync, so the editing
+ * thread never waits for the disk. The positions are varints relative to the previous edit
+ * of the batch, so nearby edits take a few bytes.
+ *
+ * Thread-safe.
+ */
+class EditJournal final
+{
+private:
+    int m_fd{-1};
+    std::string m_path;
+
+    // Guards the pending batch
+    std::mutex m_pendingMutex;
+    std::condition_variable m_pendingCv;
+    std::string m_pending;
+    uint32_t m_pendingRecordCount{};
+    // Base of the relative positions in the pending batch
+    BlockPos m_lastPos;
+    bool m_isStopping{};
+    // Set by `rotate()`, the edits before it and their record count
+    std::string m_rotationPath;
+    std::string m_rotatedPending;
+    uint32_t m_rotatedRecordCount{};
+
+    // Held while a batch is written, so the batches go to the file in order
+    std::mutex m_writeMutex;
+    // Reused by the commits
+    std::string m_writeBuffer;
+    std::string m_rotatedWriteBuffer;
+    std::atomic<long> m_commitCount{};
+    std::atomic<size_t> m_committedBytes{};
+    // End of the last batch that was written and synced, a failed write is cut back to it
+    size_t m_syncedSize{};
+    // Batches with their headers that failed to be written, retried by the next commit
+    std::string m_failedBatches;
+
+    std::thread m_thread;
+
+    void threadMain();
+    /*
+     * Call with `m_pendingMutex` held.
+     */
+    void beginRecord(JournalRecordType type);
+    /*
+     * Fills in the batch header at the beginning of `buffer`, then writes and syncs it
+     * after the batches that failed before. On failure the file is cut back to the last
+     * synced batch and the batch is kept for the next commit.
+     * Call with `m_writeMutex` held.
+     */
+    void writeBatch(std::string* buffer, uint32_t recordCount);
+
+public:
+    EditJournal() = default;
+
+    EditJournal(const EditJournal&) = delete;
+    EditJournal& operator=(const EditJournal&) = delete;
+    EditJournal(EditJournal&&) = delete;
+    EditJournal& operator=(EditJournal&&) = delete;
+
+    /*
+     * Creates an empty journal, replacing the file. Replay the old one first.
+     * Returns false on error.
+     */
+    bool open(const std::string& path);
+    /*
+     * Commits the pending edits and closes the file.
+     */
+    void close();
+    inline bool isOpen() const { return m_fd != -1; }
+
+    void append(BlockPos pos, Block block);
+    void appendFill(BlockPos min, BlockPos max, Block block);
+
+    /*
+     * Writes and syncs the pending edits, returns when they are on the disk.
+     */
+    void commit();
+    /*
+     * Drops every edit, call when a checkpoint saved all of them.
+     */
+    void clear();
+    /*
+     * Sends the edits from now on to a new journal file. The pending edits still go to the
+     * current file. Doesn't wait for the disk, the next commit switches the files.
+     * Call again only after a commit.
+     */
+    void rotate(const std::string& newPath);
+    /*
+     * The file being written. Stays the old file if a rotation failed.
+     */
+    std::string getPath();
+
+    inline long getCommitCount() const { return m_commitCount; }
+    inline size_t getCommittedBytes() const { return m_committedBytes; }
+
+    /*
+     * Applies the edits of a journal to the loaded chunks, in order, up to the first
+     * batch that is incomplete or damaged. A missing file is an empty journal.
+     * The chunks that aren't loaded are added with `loader` first, if given.
+     * Don't give `world` a journal until after this, or the edits are journaled again.
+     */
+    static JournalReplayStats replay(const std::string& path, World* world, const ChunkLoader& loader={});
+
+    ~EditJournal();
+};
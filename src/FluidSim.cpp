@@ -0,0 +1,192 @@
+#include "FluidSim.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <array>
+#include <climits>
+
+// Bits of the chunk coordinates in a packed cell, enough for 2^26 blocks in each direction
+#define CELL_CHUNK_COORD_BITS 23
+
+static constexpr std::array<std::array<int, 2>, 4> horizontalOffsets = {{{1, 0}, {-1, 0}, {0, 1}, {0, -1}}};
+
+static inline int getMaxLevel(BlockType type)
+{
+    return type == BLOCK_TYPE_LAVA ? FLUID_LAVA_MAX_LEVEL : FLUID_WATER_MAX_LEVEL;
+}
+
+/*
+ * Fluids only spread sideways on blocks and on sources, not over air or flowing fluid,
+ * so a falling column doesn't spread until it lands.
+ */
+static inline bool canSpreadSideways(const ChunkNeighbourhood& view, int x, int y, int z)
+{
+    if (y == 0)
+        return true;
+    const Block below = view.getBlock(x, y-1, z);
+    return below.type != BLOCK_TYPE_AIR && !(BlockRegistry::isFluid(below.type) && below.state != 0);
+}
+
+/*
+ * The state of a cell after the step, from the cells around it before the step.
+ * Takes coordinates relative to the middle chunk of `view`.
+ */
+static Block calcNextCell(const ChunkNeighbourhood& view, int x, int y, int z)
+{
+    const Block curr = view.getBlock(x, y, z);
+    const bool isFluid = BlockRegistry::isFluid(curr.type);
+    // Only air and flowing fluid changes, the sources and the other blocks stay
+    if (!(curr.type == BLOCK_TYPE_AIR || (isFluid && curr.state != 0)))
+        return curr;
+
+    const Block above = view.getBlock(x, y+1, z);
+    if (BlockRegistry::isFluid(above.type) && (!isFluid || above.type == curr.type))
+        return {above.type, FLUID_FALLING_BIT};
+
+    // Fed by the side with the lowest level, different fluids don't mix
+    BlockType bestType = BLOCK_TYPE_AIR;
+    int bestLevel = INT_MAX;
+    for (const auto& [dx, dz] : horizontalOffsets)
+    {
+        const Block side = view.getBlock(x+dx, y, z+dz);
+        if (!BlockRegistry::isFluid(side.type) || (isFluid && side.type != curr.type)
+         || !canSpreadSideways(view, x+dx, y, z+dz))
+            continue;
+        const int level = ((side.state & FLUID_FALLING_BIT) ? 0 : (side.state & FLUID_LEVEL_MASK))+1;
+        if (level <= getMaxLevel(side.type) && level < bestLevel)
+        {
+            bestType = side.type;
+            bestLevel = level;
+        }
+    }
+    // Dries up without a feeding cell
+    if (bestType == BLOCK_TYPE_AIR)
+        return {};
+    return {bestType, (uint8_t)bestLevel};
+}
+
+FluidSim::FluidSim(World* world, ThreadPool* pool)
+    : m_world{world}, m_pool{pool}, m_batches(FLUID_BATCH_COUNT)
+{
+}
+
+uint64_t FluidSim::packCell(BlockPos pos)
+{
+    // Sorted by chunk, then like the blocks in the sections
+    constexpr uint64_t chunkCoordMask = (1ull << CELL_CHUNK_COORD_BITS)-1;
+    const uint64_t chunkX = (uint32_t)World::blockToChunkCoord(pos.x) & chunkCoordMask;
+    const uint64_t chunkZ = (uint32_t)World::blockToChunkCoord(pos.z) & chunkCoordMask;
+    return (chunkX << (CELL_CHUNK_COORD_BITS+17)) | (chunkZ << 17) | ((uint64_t)pos.y << 8)
+        | (World::blockToLocalCoord(pos.z) << 4) | World::blockToLocalCoord(pos.x);
+}
+
+BlockPos FluidSim::unpackCell(uint64_t cell)
+{
+    // Shifts the sign bit of the chunk coordinates to the top, and back with sign extension
+    constexpr int signShift = 32-CELL_CHUNK_COORD_BITS;
+    const int chunkX = (int32_t)((uint32_t)(cell >> (CELL_CHUNK_COORD_BITS+17)) << signShift) >> signShift;
+    const int chunkZ = (int32_t)((uint32_t)(cell >> 17) << signShift) >> signShift;
+    return {
+        chunkX*CHUNK_WIDTH_BLOCKS+(int)(cell & 0xf),
+        (int)((cell >> 8) & 0x1ff),
+        chunkZ*CHUNK_WIDTH_BLOCKS+(int)((cell >> 4) & 0xf),
+    };
+}
+
+int FluidSim::getBatchI(int chunkX, int chunkZ)
+{
+    // Neighbouring chunks go to different batches, so a flood is spread out
+    return ((uint32_t)chunkX*73856093u ^ (uint32_t)chunkZ*19349663u) % FLUID_BATCH_COUNT;
+}
+
+void FluidSim::activate(BlockPos pos)
+{
+    if (pos.y < 0 || pos.y >= CHUNK_HEIGHT_BLOCKS)
+        return;
+    const int batchI = getBatchI(World::blockToChunkCoord(pos.x), World::blockToChunkCoord(pos.z));
+    m_batches[batchI].activeCells.push_back(packCell(pos));
+}
+
+void FluidSim::onBlockChanged(BlockPos pos)
+{
+    // The cells that read it in `calcNextCell()`: itself, the one below, the ones beside it,
+    // and the ones beside the block above, that spread sideways depending on it
+    activate(pos);
+    activate({pos.x, pos.y-1, pos.z});
+    for (const auto& [dx, dz] : horizontalOffsets)
+    {
+        activate({pos.x+dx, pos.y, pos.z+dz});
+        activate({pos.x+dx, pos.y+1, pos.z+dz});
+    }
+}
+
+void FluidSim::updateBatch(Batch* batch)
+{
+    std::vector<uint64_t>& cells = batch->activeCells;
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+    batch->changes.clear();
+    const World& world = *m_world;
+    const Chunk* chunk{};
+    ChunkNeighbourhood view;
+    for (const uint64_t cell : cells)
+    {
+        const BlockPos pos = unpackCell(cell);
+        const int chunkX = World::blockToChunkCoord(pos.x);
+        const int chunkZ = World::blockToChunkCoord(pos.z);
+        if (!chunk || chunk->getChunkX() != chunkX || chunk->getChunkZ() != chunkZ)
+        {
+            // The chunk may have been unloaded since the cell was activated
+            chunk = world.getChunk(chunkX, chunkZ);
+            if (!chunk)
+                continue;
+            view = world.getNeighbourhood(*chunk);
+        }
+
+        const int localX = World::blockToLocalCoord(pos.x);
+        const int localZ = World::blockToLocalCoord(pos.z);
+        const Block curr = chunk->getBlock(localX, pos.y, localZ);
+        const Block next = calcNextCell(view, localX, pos.y, localZ);
+        if (next.type != curr.type || next.state != curr.state)
+            batch->changes.push_back({pos, next});
+    }
+}
+
+FluidStats FluidSim::step()
+{
+    PROFILE_ZONE("FluidSim::step");
+
+    // Only reads the world
+    if (m_pool)
+    {
+        m_pool->parallelFor(m_batches.size(), [&](int i){ updateBatch(&m_batches[i]); });
+    }
+    else
+    {
+        for (Batch& batch : m_batches)
+            updateBatch(&batch);
+    }
+
+    FluidStats stats;
+    m_changes.clear();
+    for (Batch& batch : m_batches)
+    {
+        stats.activeCells += batch.activeCells.size();
+        batch.activeCells.clear();
+        m_changes.insert(m_changes.end(), batch.changes.begin(), batch.changes.end());
+    }
+    stats.changes = m_changes.size();
+
+    m_world->setBlocks(m_changes);
+    for (const BlockEdit& change : m_changes)
+        onBlockChanged(change.pos);
+    return stats;
+}
+
+size_t FluidSim::getActiveCount() const
+{
+    size_t count{};
+    for (const Batch& batch : m_batches)
+        count += batch.activeCells.size();
+    return count;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "World.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+// Bits of `Block::state` of fluids:
+// Distance from the source, 0 for sources
+#define FLUID_LEVEL_MASK 0x7
+// Fed from above, spreads like a source where it lands
+#define FLUID_FALLING_BIT 0x8
+
+// How far the fluids flow from their sources on flat ground
+#define FLUID_WATER_MAX_LEVEL 7
+#define FLUID_LAVA_MAX_LEVEL 3
+static_assert(FLUID_WATER_MAX_LEVEL <= FLUID_LEVEL_MASK && FLUID_LAVA_MAX_LEVEL <= FLUID_LEVEL_MASK);
+
+// The active cells are split into this many batches by their chunk, updated in parallel
+#define FLUID_BATCH_COUNT 64
+
+struct FluidStats
+{
+    // Cells looked at, most of them don't change
+    long activeCells{};
+    long changes{};
+};
+
+/*
+ * Fluid flow as a cellular automaton over the chunk storage. Only the active cells are
+ * updated: the ones around the cells that changed since the previous step.
+ *
+ * The new state of each active cell is calculated from the states before the step, so the
+ * order of the cells doesn't matter. The cells are batched by their chunk and calculated
+ * in parallel, then the changes are written with `World::setBlocks()`, which marks the
+ * sections dirty once per chunk for the mesh update.
+ *
+ * A flowing cell is at most `FLUID_*_MAX_LEVEL` steps away from a source or a falling cell,
+ * and dries up without one. The flow never makes or removes sources.
+ */
+class FluidSim final
+{
+private:
+    struct Batch
+    {
+        // Packed positions, see `packCell()`, sorted and deduplicated by the step
+        std::vector<uint64_t> activeCells;
+        std::vector<BlockEdit> changes;
+    };
+
+    World* m_world{};
+    ThreadPool* m_pool{};
+    std::vector<Batch> m_batches;
+    // The changes of the last step, sorted by chunk in each batch
+    std::vector<BlockEdit> m_changes;
+
+    static uint64_t packCell(BlockPos pos);
+    static BlockPos unpackCell(uint64_t cell);
+    static int getBatchI(int chunkX, int chunkZ);
+
+    void activate(BlockPos pos);
+    void updateBatch(Batch* batch);
+
+public:
+    /*
+     * With a null pool, the batches are updated on the calling thread.
+     */
+    FluidSim(World* world, ThreadPool* pool);
+
+    FluidSim(const FluidSim&) = delete;
+    FluidSim& operator=(const FluidSim&) = delete;
+    FluidSim(FluidSim&&) = delete;
+    FluidSim& operator=(FluidSim&&) = delete;
+
+    /*
+     * Call after a block is changed outside of the steps, wakes up the cells it affects.
+     * The fluids placed by the world generation or the batched edits don't flow until then.
+     */
+    void onBlockChanged(BlockPos pos);
+
+    FluidStats step();
+
+    /*
+     * The blocks changed by the last `step()`.
+     */
+    inline const std::vector<BlockEdit>& getChanges() const { return m_changes; }
+    /*
+     * Cells to update in the next step, a cell may be counted more than once.
+     * The fluids have settled when it's 0.
+     */
+    size_t getActiveCount() const;
+};
@@ -0,0 +1,32 @@
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::mat4& mat)
+{
+    // See: http://www8.cs.umu.se/kurser/5DV051/HT12/lab/plane_extraction.pdf
+
+    const glm::vec4 row0{mat[0][0], mat[1][0], mat[2][0], mat[3][0]};
+    const glm::vec4 row1{mat[0][1], mat[1][1], mat[2][1], mat[3][1]};
+    const glm::vec4 row2{mat[0][2], mat[1][2], mat[2][2], mat[3][2]};
+    const glm::vec4 row3{mat[0][3], mat[1][3], mat[2][3], mat[3][3]};
+    planes = {
+        row3+row0, row3-row0, // Left, right
+        row3+row1, row3-row1, // Bottom, top
+        row3+row2, row3-row2, // Near, far
+    };
+}
+
+bool Frustum::isBoxVisible(const glm::vec3& min, const glm::vec3& max) const
+{
+    for (const glm::vec4& plane : planes)
+    {
+        // The corner that is the furthest along the plane normal
+        const glm::vec4 corner{
+            plane.x >= 0 ? max.x : min.x,
+            plane.y >= 0 ? max.y : min.y,
+            plane.z >= 0 ? max.z : min.z,
+            1.0f};
+        if (glm::dot(plane, corner) < 0)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <array>
+#include <glm/glm.hpp>
+
+/*
+ * The 6 planes of a view frustum, for culling on any thread.
+ */
+struct Frustum
+{
+    // Left, right, bottom, top, near, far. The normals point inwards.
+    std::array<glm::vec4, 6> planes{};
+
+    Frustum() = default;
+    /*
+     * Extracts the planes of a projection*view matrix.
+     */
+    explicit Frustum(const glm::mat4& mat);
+
+    /*
+     * Returns false if the axis aligned box is surely outside the frustum.
+     * Boxes near the frustum corners may be reported visible.
+     */
+    bool isBoxVisible(const glm::vec3& min, const glm::vec3& max) const;
+};
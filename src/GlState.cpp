@@ -0,0 +1,235 @@
+#include "GlState.h"
+#include "Logger.h"
+#include <array>
+
+namespace GlState
+{
+
+/*
+ * Texture targets we keep track of. Binds to other targets are forwarded.
+ */
+enum TexTargetSlot
+{
+    TEX_TARGET_SLOT_2D,
+    TEX_TARGET_SLOT_2D_ARRAY,
+    TEX_TARGET_SLOT__COUNT,
+};
+
+/*
+ * Buffer targets that are not part of the VAO state.
+ */
+enum BufferTargetSlot
+{
+    BUFFER_TARGET_SLOT_ARRAY,
+    BUFFER_TARGET_SLOT_UNIFORM,
+    BUFFER_TARGET_SLOT_PIXEL_UNPACK,
+    BUFFER_TARGET_SLOT_PIXEL_PACK,
+    BUFFER_TARGET_SLOT__COUNT,
+};
+
+// Objects are never bound with id -1, so it can be used as "unknown"
+#define UNKNOWN_BINDING ((uint)-1)
+
+static uint s_boundProgId = UNKNOWN_BINDING;
+static uint s_boundVaoId = UNKNOWN_BINDING;
+static std::array<uint, BUFFER_TARGET_SLOT__COUNT> s_boundBuffers = []{
+    std::array<uint, BUFFER_TARGET_SLOT__COUNT> arr{};
+    arr.fill(UNKNOWN_BINDING);
+    return arr;
+}();
+static uint s_activeTexUnit = 0; // GL default
+static std::array<std::array<uint, TEX_TARGET_SLOT__COUNT>, GLSTATE_MAX_TEX_UNITS> s_boundTextures = []{
+    std::array<std::array<uint, TEX_TARGET_SLOT__COUNT>, GLSTATE_MAX_TEX_UNITS> arr{};
+    for (auto& unit : arr)
+        unit.fill(UNKNOWN_BINDING);
+    return arr;
+}();
+static GLenum s_polygonMode = GL_FILL;
+
+static FrameStats s_currFrameStats{};
+static FrameStats s_lastFrameStats{};
+
+static int texTargetToSlot(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D:         return TEX_TARGET_SLOT_2D;
+    case GL_TEXTURE_2D_ARRAY:   return TEX_TARGET_SLOT_2D_ARRAY;
+    default:                    return -1;
+    }
+}
+
+static int bufferTargetToSlot(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER:           return BUFFER_TARGET_SLOT_ARRAY;
+    case GL_UNIFORM_BUFFER:         return BUFFER_TARGET_SLOT_UNIFORM;
+    case GL_PIXEL_UNPACK_BUFFER:    return BUFFER_TARGET_SLOT_PIXEL_UNPACK;
+    case GL_PIXEL_PACK_BUFFER:      return BUFFER_TARGET_SLOT_PIXEL_PACK;
+    default:                        return -1;
+    }
+}
+
+/*
+ * Updates `cached` and returns true if the change has to be sent to the driver.
+ */
+template <typename T>
+static inline bool updateCached(T& cached, T value)
+{
+    if (cached == value)
+    {
+        ++s_currFrameStats.changesAvoided;
+        return false;
+    }
+    cached = value;
+    ++s_currFrameStats.changesIssued;
+    return true;
+}
+
+void useProgram(uint progId)
+{
+    if (updateCached(s_boundProgId, progId))
+        glUseProgram(progId);
+}
+
+void bindVao(uint vaoId)
+{
+    if (updateCached(s_boundVaoId, vaoId))
+        glBindVertexArray(vaoId);
+}
+
+void bindBuffer(GLenum target, uint bufferId)
+{
+    const int slot = bufferTargetToSlot(target);
+    if (slot == -1)
+    {
+        ++s_currFrameStats.changesIssued;
+        glBindBuffer(target, bufferId);
+        return;
+    }
+
+    if (updateCached(s_boundBuffers[slot], bufferId))
+        glBindBuffer(target, bufferId);
+}
+
+void bindBufferBase(GLenum target, uint index, uint bufferId)
+{
+    // Indexed binds are rare, just forward them
+    ++s_currFrameStats.changesIssued;
+    glBindBufferBase(target, index, bufferId);
+
+    // This also binds to the generic binding point
+    const int slot = bufferTargetToSlot(target);
+    if (slot != -1)
+        s_boundBuffers[slot] = bufferId;
+}
+
+void setActiveTexUnit(uint unit)
+{
+    if (unit >= GLSTATE_MAX_TEX_UNITS)
+    {
+        Logger::fatal << "Texture unit out of range: " << unit << Logger::End;
+    }
+
+    if (updateCached(s_activeTexUnit, unit))
+        glActiveTexture(GL_TEXTURE0+unit);
+}
+
+void bindTexture(GLenum target, uint texId)
+{
+    const int slot = texTargetToSlot(target);
+    if (slot == -1)
+    {
+        ++s_currFrameStats.changesIssued;
+        glBindTexture(target, texId);
+        return;
+    }
+
+    if (updateCached(s_boundTextures[s_activeTexUnit][slot], texId))
+        glBindTexture(target, texId);
+}
+
+void setPolygonMode(GLenum mode)
+{
+    if (updateCached(s_polygonMode, mode))
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void onProgramDeleted(uint progId)
+{
+    if (s_boundProgId == progId)
+        s_boundProgId = 0;
+}
+
+void onVaoDeleted(uint vaoId)
+{
+    if (s_boundVaoId == vaoId)
+        s_boundVaoId = 0;
+}
+
+void onBufferDeleted(uint bufferId)
+{
+    for (uint& bound : s_boundBuffers)
+    {
+        if (bound == bufferId)
+            bound = 0;
+    }
+}
+
+void onTextureDeleted(uint texId)
+{
+    for (auto& unit : s_boundTextures)
+    {
+        for (uint& bound : unit)
+        {
+            if (bound == texId)
+                bound = 0;
+        }
+    }
+}
+
+void executeCommands(const RenderCommandBuffer& buffer)
+{
+    for (const RenderCommand& command : buffer.getCommands())
+    {
+        switch (command.type)
+        {
+        case RENDER_CMD_USE_PROGRAM:
+            useProgram(command.arg0);
+            break;
+
+        case RENDER_CMD_BIND_TEXTURE_ARRAY:
+            bindTexture(GL_TEXTURE_2D_ARRAY, command.arg0);
+            break;
+
+        case RENDER_CMD_BIND_MESH:
+            bindVao(command.arg0);
+            break;
+
+        case RENDER_CMD_DRAW_TRIANGLES:
+            glDrawElements(GL_TRIANGLES, command.arg1, GL_UNSIGNED_INT, (void*)(command.arg0*sizeof(uint)));
+            countDraw(command.arg1/3);
+            break;
+        }
+    }
+}
+
+void countDraw(uint triangles)
+{
+    ++s_currFrameStats.drawCalls;
+    s_currFrameStats.triangles += triangles;
+}
+
+void onFrameEnd()
+{
+    s_lastFrameStats = s_currFrameStats;
+    s_currFrameStats = {};
+}
+
+const FrameStats& getLastFrameStats()
+{
+    return s_lastFrameStats;
+}
+
+} // End of namespace GlState
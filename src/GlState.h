@@ -0,0 +1,63 @@
+#pragma once
+
+#include "glstuff.h"
+#include "types.h"
+#include "RenderCommands.h"
+
+/*
+ * Shadow copy of the GL binding state.
+ * All wrappers bind through these functions, so redundant binds
+ * never reach the driver.
+ *
+ * Note: `GL_ELEMENT_ARRAY_BUFFER` is part of the VAO state,
+ *       so binds to it are forwarded without caching.
+ */
+namespace GlState
+{
+
+#define GLSTATE_MAX_TEX_UNITS 16
+
+struct FrameStats
+{
+    // State changes sent to the driver
+    uint changesIssued{};
+    // Redundant state changes skipped
+    uint changesAvoided{};
+    uint drawCalls{};
+    uint triangles{};
+};
+
+void useProgram(uint progId);
+void bindVao(uint vaoId);
+void bindBuffer(GLenum target, uint bufferId);
+void bindBufferBase(GLenum target, uint index, uint bufferId);
+void setActiveTexUnit(uint unit);
+void bindTexture(GLenum target, uint texId);
+void setPolygonMode(GLenum mode);
+
+/*
+ * Executes the recorded commands, the binds go through the shadow state too.
+ * Call on the thread of the GL context.
+ */
+void executeCommands(const RenderCommandBuffer& buffer);
+
+/*
+ * GL unbinds deleted objects, these keep the shadow state in sync.
+ */
+void onProgramDeleted(uint progId);
+void onVaoDeleted(uint vaoId);
+void onBufferDeleted(uint bufferId);
+void onTextureDeleted(uint texId);
+
+/*
+ * Call after each draw call to count it in the frame stats.
+ */
+void countDraw(uint triangles);
+
+/*
+ * Call at the end of each frame. Saves and resets the counters.
+ */
+void onFrameEnd();
+const FrameStats& getLastFrameStats();
+
+} // End of namespace GlState
@@ -0,0 +1,117 @@
+#include "GpuTimer.h"
+#include "glstuff.h"
+#include "Logger.h"
+#include "Profiler.h"
+
+namespace GpuTimer
+{
+
+struct FrameQueries
+{
+    std::array<uint, GPU_TIMER_MAX_PASSES> queries{};
+    std::array<const char*, GPU_TIMER_MAX_PASSES> names{};
+    // When the pass was submitted, used to place it in the trace
+    std::array<int64_t, GPU_TIMER_MAX_PASSES> cpuStartNs{};
+    int passCount{};
+};
+
+static std::array<FrameQueries, GPU_TIMER_FRAMES> s_frames{};
+static int s_currFrameI{};
+static bool s_isInitialized{};
+static bool s_isPassActive{};
+static FrameResults s_latestResults{};
+static uint64_t s_droppedFrameCount{};
+
+static int64_t getCpuTimeNs()
+{
+#ifdef ACRAFT_PROFILER
+    return Profiler::getTimeNs();
+#else
+    return 0;
+#endif
+}
+
+void beginPass(const char* name)
+{
+    if (!s_isInitialized)
+    {
+        for (auto& frame : s_frames)
+            glGenQueries(frame.queries.size(), frame.queries.data());
+        s_isInitialized = true;
+    }
+
+    if (s_isPassActive)
+    {
+        Logger::fatal << "GPU timer passes can't be nested (beginning " << name << ')' << Logger::End;
+    }
+
+    FrameQueries& frame = s_frames[s_currFrameI];
+    if (frame.passCount >= GPU_TIMER_MAX_PASSES)
+    {
+        Logger::fatal << "Too many GPU timer passes in a frame, increase GPU_TIMER_MAX_PASSES" << Logger::End;
+    }
+
+    frame.names[frame.passCount] = name;
+    frame.cpuStartNs[frame.passCount] = getCpuTimeNs();
+    glBeginQuery(GL_TIME_ELAPSED, frame.queries[frame.passCount]);
+    s_isPassActive = true;
+}
+
+void endPass()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    ++s_frames[s_currFrameI].passCount;
+    s_isPassActive = false;
+}
+
+/*
+ * Returns false if the queries are still running.
+ */
+static bool collectResults(FrameQueries& frame)
+{
+    if (frame.passCount == 0)
+        return true;
+
+    // Queries finish in order, so the last one being done means all of them are
+    int isAvailable{};
+    glGetQueryObjectiv(frame.queries[frame.passCount-1], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+    if (!isAvailable)
+        return false;
+
+    s_latestResults.passCount = frame.passCount;
+    ++s_latestResults.frameId;
+    for (int i{}; i < frame.passCount; ++i)
+    {
+        GLuint64 elapsedNs{};
+        glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &elapsedNs);
+        s_latestResults.passes[i] = {frame.names[i], elapsedNs/1'000'000.0};
+
+#ifdef ACRAFT_PROFILER
+        if (Profiler::isCapturing())
+            Profiler::recordGpuZone(frame.names[i], frame.cpuStartNs[i], frame.cpuStartNs[i]+(int64_t)elapsedNs);
+#endif
+    }
+    return true;
+}
+
+void onFrameEnd()
+{
+    s_currFrameI = (s_currFrameI+1)%GPU_TIMER_FRAMES;
+
+    // This slot was used GPU_TIMER_FRAMES frames ago
+    FrameQueries& oldest = s_frames[s_currFrameI];
+    if (!collectResults(oldest))
+    {
+        // The GPU is too far behind, reuse the queries instead of waiting
+        ++s_droppedFrameCount;
+        Logger::dbg << "GPU timer results not ready, dropped frame (" << s_droppedFrameCount << " so far)" << Logger::End;
+    }
+    oldest.passCount = 0;
+}
+
+const FrameResults& getLatestResults()
+{
+    return s_latestResults;
+}
+
+} // End of namespace GpuTimer
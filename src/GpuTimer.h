@@ -0,0 +1,69 @@
+#pragma once
+
+#include "types.h"
+#include <array>
+#include <cstdint>
+
+/*
+ * Measures the GPU time of render passes with `GL_TIME_ELAPSED` queries.
+ *
+ * Every frame has its own set of queries in a ring of `GPU_TIMER_FRAMES`,
+ * so results are read back a few frames later without stalling the pipeline.
+ * Passes can't be nested, since only one `GL_TIME_ELAPSED` query can be active.
+ */
+namespace GpuTimer
+{
+
+#define GPU_TIMER_FRAMES 4
+#define GPU_TIMER_MAX_PASSES 16
+
+struct PassResult
+{
+    const char* name{};
+    double gpuMs{};
+};
+
+struct FrameResults
+{
+    // Increases by one for every frame that got its results
+    uint64_t frameId{};
+    std::array<PassResult, GPU_TIMER_MAX_PASSES> passes{};
+    int passCount{};
+};
+
+/*
+ * `name` must be a string literal.
+ */
+void beginPass(const char* name);
+void endPass();
+
+/*
+ * Call at the end of each frame. Collects the results of the oldest frame in flight.
+ */
+void onFrameEnd();
+
+/*
+ * Results of the newest frame whose queries are done.
+ */
+const FrameResults& getLatestResults();
+
+class ScopedPass final
+{
+public:
+    explicit ScopedPass(const char* name) { beginPass(name); }
+    ScopedPass(const ScopedPass&) = delete;
+    ScopedPass& operator=(const ScopedPass&) = delete;
+    ScopedPass(ScopedPass&&) = delete;
+    ScopedPass& operator=(ScopedPass&&) = delete;
+    ~ScopedPass() { endPass(); }
+};
+
+} // End of namespace GpuTimer
+
+#define _GPU_PASS_CONCAT_IMPL(a, b) a##b
+#define _GPU_PASS_CONCAT(a, b) _GPU_PASS_CONCAT_IMPL(a, b)
+
+/*
+ * Measures the GPU time of the rest of the enclosing scope. `name` must be a string literal.
+ */
+#define GPU_PASS(name) const GpuTimer::ScopedPass _GPU_PASS_CONCAT(_gpuPass, __LINE__){name}
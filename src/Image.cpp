@@ -0,0 +1,98 @@
+#include "Image.h"
+#include <algorithm>
+#include <cstring>
+
+namespace Image
+{
+
+int getMipLevelCount(int width, int height)
+{
+    int levelCount = 1;
+    while (width > 1 || height > 1)
+    {
+        width = std::max(width/2, 1);
+        height = std::max(height/2, 1);
+        ++levelCount;
+    }
+    return levelCount;
+}
+
+size_t getMipChainSize(int width, int height, int levelCount)
+{
+    size_t size{};
+    for (int i{}; i < levelCount; ++i)
+    {
+        size += (size_t)width*height*4;
+        width = std::max(width/2, 1);
+        height = std::max(height/2, 1);
+    }
+    return size;
+}
+
+std::vector<uint8_t> generateMipChain(const uint8_t* rgba, int width, int height)
+{
+    const int levelCount = getMipLevelCount(width, height);
+    std::vector<uint8_t> output(getMipChainSize(width, height, levelCount));
+    std::memcpy(output.data(), rgba, (size_t)width*height*4);
+
+    size_t srcOffset{};
+    size_t dstOffset = (size_t)width*height*4;
+    int srcW = width;
+    int srcH = height;
+    for (int level{1}; level < levelCount; ++level)
+    {
+        const int dstW = std::max(srcW/2, 1);
+        const int dstH = std::max(srcH/2, 1);
+        const uint8_t* src = output.data()+srcOffset;
+        uint8_t* dst = output.data()+dstOffset;
+
+        for (int y{}; y < dstH; ++y)
+        {
+            // Odd sizes: the last row/column is reused
+            const int srcY0 = std::min(y*2, srcH-1);
+            const int srcY1 = std::min(y*2+1, srcH-1);
+            for (int x{}; x < dstW; ++x)
+            {
+                const int srcX0 = std::min(x*2, srcW-1);
+                const int srcX1 = std::min(x*2+1, srcW-1);
+                for (int c{}; c < 4; ++c)
+                {
+                    const int sum = src[((size_t)srcY0*srcW+srcX0)*4+c]
+                                  + src[((size_t)srcY0*srcW+srcX1)*4+c]
+                                  + src[((size_t)srcY1*srcW+srcX0)*4+c]
+                                  + src[((size_t)srcY1*srcW+srcX1)*4+c];
+                    dst[((size_t)y*dstW+x)*4+c] = (sum+2)/4;
+                }
+            }
+        }
+
+        srcOffset = dstOffset;
+        dstOffset += (size_t)dstW*dstH*4;
+        srcW = dstW;
+        srcH = dstH;
+    }
+    return output;
+}
+
+std::vector<uint8_t> makeCheckerboard(int width, int height)
+{
+    std::vector<uint8_t> output((size_t)width*height*4);
+    // 2x2 squares at any resolution
+    const int squareW = std::max(width/2, 1);
+    const int squareH = std::max(height/2, 1);
+    for (int y{}; y < height; ++y)
+    {
+        for (int x{}; x < width; ++x)
+        {
+            const bool isMagenta = ((x/squareW)+(y/squareH))%2 == 0;
+            uint8_t* pixel = output.data()+((size_t)y*width+x)*4;
+            pixel[0] = isMagenta ? 255 : 0;
+            pixel[1] = 0;
+            pixel[2] = isMagenta ? 255 : 0;
+            pixel[3] = 255;
+        }
+    }
+    return output;
+}
+
+} // End of namespace Image
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace Image
+{
+
+/*
+ * Returns the number of mip levels down to 1x1.
+ */
+int getMipLevelCount(int width, int height);
+
+/*
+ * Size in bytes of an RGBA8 mip chain, all levels included.
+ */
+size_t getMipChainSize(int width, int height, int levelCount);
+
+/*
+ * Builds the full mip chain of an RGBA8 image with a 2x2 box filter.
+ * The levels are stored one after another, level 0 is a copy of `rgba`.
+ */
+std::vector<uint8_t> generateMipChain(const uint8_t* rgba, int width, int height);
+
+/*
+ * RGBA8 magenta and black checkerboard, used in place of textures that failed to load.
+ */
+std::vector<uint8_t> makeCheckerboard(int width, int height);
+
+} // End of namespace Image
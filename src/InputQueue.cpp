@@ -0,0 +1,29 @@
+#include "InputQueue.h"
+
+static_assert((INPUT_QUEUE_CAPACITY & (INPUT_QUEUE_CAPACITY-1)) == 0);
+
+bool InputQueue::push(const InputEvent& event)
+{
+    // The indices only grow, they are wrapped when indexing
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail-m_head.load(std::memory_order_acquire) == INPUT_QUEUE_CAPACITY)
+    {
+        m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    m_events[tail & (INPUT_QUEUE_CAPACITY-1)] = event;
+    // Publishes the event to the consumer
+    m_tail.store(tail+1, std::memory_order_release);
+    return true;
+}
+
+bool InputQueue::pop(InputEvent* out)
+{
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire))
+        return false;
+    *out = m_events[head & (INPUT_QUEUE_CAPACITY-1)];
+    // Gives the slot back to the producer
+    m_head.store(head+1, std::memory_order_release);
+    return true;
+}
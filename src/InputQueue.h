@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Has to be a power of 2
+#define INPUT_QUEUE_CAPACITY 1024
+
+/*
+ * What the player wants to do, the window callbacks map the keys and buttons to these.
+ */
+enum InputAction
+{
+    INPUT_ACTION_FORWARD,
+    INPUT_ACTION_BACKWARDS,
+    INPUT_ACTION_LEFT,
+    INPUT_ACTION_RIGHT,
+    INPUT_ACTION_UP,
+    INPUT_ACTION_DOWN,
+    INPUT_ACTION_BREAK_BLOCK,
+    INPUT_ACTION_PLACE_BLOCK,
+    INPUT_ACTION_PLACE_FLUID,
+    INPUT_ACTION__COUNT,
+};
+
+enum InputEventType
+{
+    // An action started or ended
+    INPUT_EVENT_ACTION,
+    // The cursor moved
+    INPUT_EVENT_LOOK,
+};
+
+struct InputEvent
+{
+    InputEventType type{};
+    // For `INPUT_EVENT_ACTION`
+    InputAction action{};
+    bool isPressed{};
+    // For `INPUT_EVENT_LOOK`, in pixels, y grows upwards
+    float lookX{};
+    float lookY{};
+};
+
+/*
+ * Lock-free single-producer single-consumer ring buffer of input events.
+ * The window callbacks push on the main thread, the simulation pops on its own.
+ */
+class InputQueue final
+{
+private:
+    std::array<InputEvent, INPUT_QUEUE_CAPACITY> m_events{};
+    // Only written by the consumer
+    alignas(64) std::atomic<size_t> m_head{};
+    // Only written by the producer
+    alignas(64) std::atomic<size_t> m_tail{};
+    // Events dropped because the queue was full
+    std::atomic<size_t> m_droppedCount{};
+
+public:
+    /*
+     * Returns false and drops the event if the queue is full.
+     */
+    bool push(const InputEvent& event);
+    /*
+     * Returns false if the queue is empty.
+     */
+    bool pop(InputEvent* out);
+
+    inline size_t getDroppedCount() const { return m_droppedCount.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,146 @@
+#include "InputRecording.h"
+#include "Simulation.h"
+#include "MappedFile.h"
+#include "Varint.h"
+#include "Logger.h"
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+// Layout of the byte after the tick delta
+#define INPUT_RECORDING_ACTION_MASK 0x3f
+#define INPUT_RECORDING_PRESSED_BIT 0x40
+#define INPUT_RECORDING_LOOK_BIT 0x80
+static_assert(INPUT_ACTION__COUNT <= INPUT_RECORDING_ACTION_MASK+1);
+
+bool InputRecording::save(const std::string& path) const
+{
+    InputRecordingHeader header;
+    std::memcpy(header.magic, INPUT_RECORDING_MAGIC, 4);
+    header.version = INPUT_RECORDING_VERSION;
+    header.seed = m_seed;
+    header.windowWidth = m_windowWidth;
+    header.windowHeight = m_windowHeight;
+    header.tickCount = m_tickCount;
+    header.eventCount = m_inputs.size();
+    header.ticksPerSec = SIM_TICKS_PER_SEC;
+
+    std::string data;
+    data.append((const char*)&header, sizeof(header));
+    uint64_t lastTickI{};
+    for (const auto& [tickI, event] : m_inputs)
+    {
+        Varint::write(&data, tickI-lastTickI);
+        lastTickI = tickI;
+        if (event.type == INPUT_EVENT_LOOK)
+        {
+            data.push_back((char)INPUT_RECORDING_LOOK_BIT);
+            data.append((const char*)&event.lookX, sizeof(float));
+            data.append((const char*)&event.lookY, sizeof(float));
+        }
+        else
+        {
+            data.push_back((char)(event.action | (event.isPressed ? INPUT_RECORDING_PRESSED_BIT : 0)));
+        }
+    }
+
+    std::ofstream file{path, std::ios::binary|std::ios::trunc};
+    file.write(data.data(), data.size());
+    if (!file)
+    {
+        Logger::err << "Failed to write input recording: \"" << path << '"' << Logger::End;
+        return false;
+    }
+    Logger::log << "Saved input recording of " << m_tickCount << " ticks and " << m_inputs.size()
+        << " events (" << data.size() << " bytes): \"" << path << '"' << Logger::End;
+    return true;
+}
+
+bool InputRecording::load(const std::string& path)
+{
+    MappedFile file;
+    if (!file.open(path))
+    {
+        Logger::err << "Failed to open input recording: \"" << path << '"' << Logger::End;
+        return false;
+    }
+
+    InputRecordingHeader header;
+    if (file.size() >= sizeof(header))
+        std::memcpy(&header, file.data(), sizeof(header));
+    if (file.size() < sizeof(header) || std::memcmp(header.magic, INPUT_RECORDING_MAGIC, 4) != 0
+     || header.version != INPUT_RECORDING_VERSION)
+    {
+        Logger::err << "Invalid or outdated input recording: \"" << path << '"' << Logger::End;
+        return false;
+    }
+    if (header.ticksPerSec != SIM_TICKS_PER_SEC)
+    {
+        Logger::err << "Input recording was made at " << header.ticksPerSec << " ticks/s instead of "
+            << SIM_TICKS_PER_SEC << ": \"" << path << '"' << Logger::End;
+        return false;
+    }
+
+    if (header.windowWidth == 0 || header.windowHeight == 0
+     || header.windowWidth > (uint32_t)std::numeric_limits<int>::max()
+     || header.windowHeight > (uint32_t)std::numeric_limits<int>::max())
+    {
+        Logger::err << "Invalid window size in input recording, width: " << header.windowWidth
+            << ", height: " << header.windowHeight << ": \"" << path << '"' << Logger::End;
+        return false;
+    }
+
+    const char* pos = file.data()+sizeof(header);
+    const char* const end = file.data()+file.size();
+    std::vector<RecordedInput> inputs;
+    uint64_t tickI{};
+    for (uint64_t i{}; i < header.eventCount; ++i)
+    {
+        uint64_t tickDelta{};
+        if (!Varint::read(&pos, end, &tickDelta) || pos == end)
+            break;
+        tickI += tickDelta;
+        const uint8_t flags = *pos++;
+
+        InputEvent event;
+        if (flags & INPUT_RECORDING_LOOK_BIT)
+        {
+            if ((size_t)(end-pos) < 2*sizeof(float))
+                break;
+            event.type = INPUT_EVENT_LOOK;
+            std::memcpy(&event.lookX, pos, sizeof(float));
+            std::memcpy(&event.lookY, pos+sizeof(float), sizeof(float));
+            pos += 2*sizeof(float);
+        }
+        else
+        {
+            if ((flags & INPUT_RECORDING_ACTION_MASK) >= INPUT_ACTION__COUNT)
+                break;
+            event.type = INPUT_EVENT_ACTION;
+            event.action = (InputAction)(flags & INPUT_RECORDING_ACTION_MASK);
+            event.isPressed = flags & INPUT_RECORDING_PRESSED_BIT;
+        }
+        inputs.push_back({tickI, event});
+    }
+    if (inputs.size() != header.eventCount || pos != end)
+    {
+        Logger::err << "Invalid events in input recording: \"" << path << '"' << Logger::End;
+        return false;
+    }
+
+    m_seed = header.seed;
+    m_windowWidth = header.windowWidth;
+    m_windowHeight = header.windowHeight;
+    m_tickCount = header.tickCount;
+    m_inputs = std::move(inputs);
+    m_nextInputI = 0;
+    return true;
+}
+
+bool InputRecording::popEvent(uint64_t tickI, InputEvent* out)
+{
+    if (m_nextInputI == m_inputs.size() || m_inputs[m_nextInputI].tickI > tickI)
+        return false;
+    *out = m_inputs[m_nextInputI++].event;
+    return true;
+}
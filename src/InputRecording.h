@@ -0,0 +1,95 @@
+#pragma once
+
+#include "InputQueue.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define INPUT_RECORDING_MAGIC "ACIR"
+// Bump when the layout of the file changes
+#define INPUT_RECORDING_VERSION 1
+
+struct InputRecordingHeader
+{
+    char magic[4]{};
+    uint32_t version{};
+    uint64_t seed{};
+    uint32_t windowWidth{};
+    uint32_t windowHeight{};
+    // The replay ends after this many ticks
+    uint64_t tickCount{};
+    uint64_t eventCount{};
+    // A recording of a different tick rate can't be replayed
+    uint32_t ticksPerSec{};
+    uint32_t _reserved{};
+};
+
+/*
+ * An input event and the simulation tick that applied it.
+ */
+struct RecordedInput
+{
+    uint64_t tickI{};
+    InputEvent event;
+};
+
+/*
+ * The input of a session with the seed and window size it ran with, for replaying it.
+ *
+ * The events are stored by the tick that applied them, not by wall time, and the ticks have a
+ * fixed length, so the replay repeats the same player path and world edits regardless of the
+ * frame rate, the timing of the ticks or the number of threads.
+ *
+ * After the header each event is the number of ticks since the previous one (varint), a byte
+ * with its type, action and pressed state, and for look events the two movements (f32).
+ */
+class InputRecording final
+{
+private:
+    uint64_t m_seed{};
+    int m_windowWidth{};
+    int m_windowHeight{};
+    uint64_t m_tickCount{};
+    std::vector<RecordedInput> m_inputs;
+    // Next event to replay
+    size_t m_nextInputI{};
+
+public:
+    InputRecording() = default;
+    InputRecording(uint64_t seed, int windowWidth, int windowHeight)
+        : m_seed{seed}, m_windowWidth{windowWidth}, m_windowHeight{windowHeight}
+    {
+    }
+
+    InputRecording(const InputRecording&) = delete;
+    InputRecording& operator=(const InputRecording&) = delete;
+    InputRecording(InputRecording&&) = delete;
+    InputRecording& operator=(InputRecording&&) = delete;
+
+    /*
+     * Events have to be recorded in tick order.
+     */
+    inline void record(uint64_t tickI, const InputEvent& event) { m_inputs.push_back({tickI, event}); }
+    inline void setTickCount(uint64_t tickCount) { m_tickCount = tickCount; }
+
+    /*
+     * Returns false on error.
+     */
+    bool save(const std::string& path) const;
+    /*
+     * Returns false if the file can't be read or isn't a valid recording.
+     */
+    bool load(const std::string& path);
+
+    /*
+     * Returns the next event applied by tick `tickI`, false if it has no more.
+     * Call with increasing ticks.
+     */
+    bool popEvent(uint64_t tickI, InputEvent* out);
+
+    inline uint64_t getSeed() const { return m_seed; }
+    inline int getWindowWidth() const { return m_windowWidth; }
+    inline int getWindowHeight() const { return m_windowHeight; }
+    inline uint64_t getTickCount() const { return m_tickCount; }
+    inline size_t getEventCount() const { return m_inputs.size(); }
+};
@@ -0,0 +1,391 @@
+#include "LightEngine.h"
+#include "Profiler.h"
+#include <algorithm>
+
+// Sky light doesn't fade going down, that direction is the first
+static constexpr int neighbourOffsets[6][3]{
+    { 0, -1,  0},
+    { 0,  1,  0},
+    {-1,  0,  0},
+    { 1,  0,  0},
+    { 0,  0, -1},
+    { 0,  0,  1},
+};
+
+LightEngine::LightEngine(World* world)
+    : m_world{world}
+{
+}
+
+Chunk* LightEngine::findChunk(int chunkX, int chunkZ)
+{
+    if (m_lastChunk)
+    {
+        const int dx = chunkX-m_lastChunk->getChunkX();
+        const int dz = chunkZ-m_lastChunk->getChunkZ();
+        if (dx == 0 && dz == 0)
+            return m_lastChunk;
+        if (dx >= -1 && dx <= 1 && dz >= -1 && dz <= 1)
+        {
+            if (Chunk* neighbour = m_lastChunk->getNeighbour(dx, dz))
+                return m_lastChunk = neighbour;
+        }
+    }
+
+    Chunk* chunk = m_world->getChunk(chunkX, chunkZ);
+    if (chunk)
+        m_lastChunk = chunk;
+    return chunk;
+}
+
+uint8_t LightEngine::getLight(const Chunk& chunk, LightType type, int x, int y, int z) const
+{
+    return chunk.getLight(type, World::blockToLocalCoord(x), y, World::blockToLocalCoord(z));
+}
+
+void LightEngine::setLight(Chunk* chunk, LightType type, int x, int y, int z, uint8_t level)
+{
+    const int localX = World::blockToLocalCoord(x);
+    const int localZ = World::blockToLocalCoord(z);
+    chunk->setLight(type, localX, y, localZ, level);
+
+    // The faces around the block are lit by it
+    const int minSectionI = std::max(y-1, 0)/CHUNK_SECTION_HEIGHT;
+    const int maxSectionI = std::min(y+1, CHUNK_HEIGHT_BLOCKS-1)/CHUNK_SECTION_HEIGHT;
+    chunk->markSectionsDirty(((2u << maxSectionI)-1) & ~((1u << minSectionI)-1), 1u << CHUNK_CACHE_MESH);
+    auto markNeighbour{[&](int dx, int dz){
+        if (Chunk* neighbour = chunk->getNeighbour(dx, dz))
+            neighbour->markSectionsDirty(1u << (y/CHUNK_SECTION_HEIGHT), 1u << CHUNK_CACHE_MESH);
+    }};
+    if (localX == 0)
+        markNeighbour(-1, 0);
+    else if (localX == CHUNK_WIDTH_BLOCKS-1)
+        markNeighbour(1, 0);
+    if (localZ == 0)
+        markNeighbour(0, -1);
+    else if (localZ == CHUNK_WIDTH_BLOCKS-1)
+        markNeighbour(0, 1);
+}
+
+void LightEngine::propagateRemove(LightType type)
+{
+    for (size_t i{}; i < m_removeQueue.size(); ++i)
+    {
+        const LightNode node = m_removeQueue[i];
+        for (int dirI{}; dirI < 6; ++dirI)
+        {
+            const int x = node.x+neighbourOffsets[dirI][0];
+            const int y = node.y+neighbourOffsets[dirI][1];
+            const int z = node.z+neighbourOffsets[dirI][2];
+            if (y < 0 || y >= CHUNK_HEIGHT_BLOCKS)
+                continue;
+            Chunk* chunk = findChunk(World::blockToChunkCoord(x), World::blockToChunkCoord(z));
+            if (!chunk)
+                continue;
+
+            const uint8_t level = getLight(*chunk, type, x, y, z);
+            if (level == 0)
+                continue;
+
+            const bool isLitByNode = level < node.level || (type == LIGHT_SKY && dirI == 0 && node.level == LIGHT_MAX);
+            if (isLitByNode)
+            {
+                setLight(chunk, type, x, y, z, 0);
+                m_removeQueue.push_back({x, y, z, level});
+
+                // Light sources keep their own light
+                const uint8_t emission = type == LIGHT_BLOCK ? BlockRegistry::getLightEmission(
+                        chunk->getBlock(World::blockToLocalCoord(x), y, World::blockToLocalCoord(z)).type) : 0;
+                if (emission)
+                {
+                    setLight(chunk, type, x, y, z, emission);
+                    m_addQueue.push_back({x, y, z, emission});
+                }
+            }
+            else
+            {
+                // Lit from somewhere else, it can relight what we have darkened
+                m_addQueue.push_back({x, y, z, level});
+            }
+        }
+    }
+    m_removeQueue.clear();
+}
+
+void LightEngine::propagateAdd(LightType type)
+{
+    for (size_t i{}; i < m_addQueue.size(); ++i)
+    {
+        const LightNode& node = m_addQueue[i];
+        const int nodeX = node.x;
+        const int nodeY = node.y;
+        const int nodeZ = node.z;
+        const Chunk* nodeChunk = findChunk(World::blockToChunkCoord(nodeX), World::blockToChunkCoord(nodeZ));
+        if (!nodeChunk)
+            continue;
+        // May have got brighter since it was queued
+        const uint8_t level = getLight(*nodeChunk, type, nodeX, nodeY, nodeZ);
+        if (level <= 1)
+            continue;
+
+        for (int dirI{}; dirI < 6; ++dirI)
+        {
+            const int x = nodeX+neighbourOffsets[dirI][0];
+            const int y = nodeY+neighbourOffsets[dirI][1];
+            const int z = nodeZ+neighbourOffsets[dirI][2];
+            if (y < 0 || y >= CHUNK_HEIGHT_BLOCKS)
+                continue;
+            Chunk* chunk = findChunk(World::blockToChunkCoord(x), World::blockToChunkCoord(z));
+            if (!chunk)
+                continue;
+
+            const int localX = World::blockToLocalCoord(x);
+            const int localZ = World::blockToLocalCoord(z);
+            if (BlockRegistry::isOpaque(chunk->getBlock(localX, y, localZ).type))
+                continue;
+
+            const uint8_t newLevel = (type == LIGHT_SKY && dirI == 0 && level == LIGHT_MAX) ? LIGHT_MAX : level-1;
+            if (chunk->getLight(type, localX, y, localZ) < newLevel)
+            {
+                setLight(chunk, type, x, y, z, newLevel);
+                // May reallocate, `node` is not used after this
+                m_addQueue.push_back({x, y, z, newLevel});
+            }
+        }
+    }
+    m_addQueue.clear();
+}
+
+/*
+ * Returns the index of the highest section that has blocks or non-default light, or -1.
+ */
+static int getTopSectionI(const Chunk& chunk)
+{
+    for (int i{CHUNK_SECTION_COUNT-1}; i >= 0; --i)
+    {
+        if (chunk.getSection(i) || chunk.getLightSection(i))
+            return i;
+    }
+    return -1;
+}
+
+void LightEngine::lightChunksFromScratch(const std::vector<Chunk*>& chunks)
+{
+    PROFILE_ZONE("LightEngine::lightChunksFromScratch");
+
+    std::vector<int> topSectionIs(chunks.size());
+    for (size_t i{}; i < chunks.size(); ++i)
+        topSectionIs[i] = getTopSectionI(*chunks[i]);
+
+    for (int typeI{}; typeI < LIGHT__COUNT; ++typeI)
+    {
+        const LightType type = (LightType)typeI;
+
+        // Darken the chunks, and whatever was lit by them before
+        for (size_t chunkI{}; chunkI < chunks.size(); ++chunkI)
+        {
+            Chunk* chunk = chunks[chunkI];
+            const int originX = chunk->getChunkX()*CHUNK_WIDTH_BLOCKS;
+            const int originZ = chunk->getChunkZ()*CHUNK_WIDTH_BLOCKS;
+            for (int sectionI{}; sectionI <= topSectionIs[chunkI]; ++sectionI)
+            {
+                NibbleArray& levels = chunk->getOrCreateLightSection(sectionI).levels[type];
+                if (chunk->isLit())
+                {
+                    for (int y{}; y < CHUNK_SECTION_HEIGHT; ++y)
+                    {
+                        for (int z{}; z < CHUNK_WIDTH_BLOCKS; ++z)
+                        {
+                            for (int x{}; x < CHUNK_WIDTH_BLOCKS; ++x)
+                            {
+                                m_removeQueue.push_back({originX+x, sectionI*CHUNK_SECTION_HEIGHT+y, originZ+z,
+                                        levels.get(ChunkSection::getIndex(x, y, z))});
+                            }
+                        }
+                    }
+                }
+                levels.fill(0);
+            }
+        }
+        propagateRemove(type);
+
+        for (size_t chunkI{}; chunkI < chunks.size(); ++chunkI)
+        {
+            Chunk* chunk = chunks[chunkI];
+            const int originX = chunk->getChunkX()*CHUNK_WIDTH_BLOCKS;
+            const int originZ = chunk->getChunkZ()*CHUNK_WIDTH_BLOCKS;
+            if (type == LIGHT_SKY)
+            {
+                int topSectionI = topSectionIs[chunkI];
+                if (!chunk->isLit())
+                {
+                    // The open sky of a new chunk has to reach into the caves of its neighbours too
+                    for (int dirI{2}; dirI < 6; ++dirI)
+                    {
+                        if (const Chunk* neighbour = chunk->getNeighbour(neighbourOffsets[dirI][0], neighbourOffsets[dirI][2]))
+                            topSectionI = std::max(topSectionI, getTopSectionI(*neighbour));
+                    }
+                }
+                const int topY = (topSectionI+1)*CHUNK_SECTION_HEIGHT;
+
+                // Full light down the columns, above `topY` it's the default already
+                for (int z{}; z < CHUNK_WIDTH_BLOCKS; ++z)
+                {
+                    for (int x{}; x < CHUNK_WIDTH_BLOCKS; ++x)
+                    {
+                        for (int y{topY-1}; y >= 0 && !BlockRegistry::isOpaque(chunk->getBlock(x, y, z).type); --y)
+                        {
+                            chunk->setLight(type, x, y, z, LIGHT_MAX);
+                            m_addQueue.push_back({originX+x, y, originZ+z, LIGHT_MAX});
+                        }
+                    }
+                }
+            }
+            else
+            {
+                for (int sectionI{}; sectionI <= topSectionIs[chunkI]; ++sectionI)
+                {
+                    const ChunkSection* section = chunk->getSection(sectionI);
+                    if (!section)
+                        continue;
+                    for (int y{}; y < CHUNK_SECTION_HEIGHT; ++y)
+                    {
+                        for (int z{}; z < CHUNK_WIDTH_BLOCKS; ++z)
+                        {
+                            for (int x{}; x < CHUNK_WIDTH_BLOCKS; ++x)
+                            {
+                                const uint8_t emission = BlockRegistry::getLightEmission(
+                                        section->blocks[ChunkSection::getIndex(x, y, z)].type);
+                                if (!emission)
+                                    continue;
+                                const int worldY = sectionI*CHUNK_SECTION_HEIGHT+y;
+                                chunk->setLight(type, x, worldY, z, emission);
+                                m_addQueue.push_back({originX+x, worldY, originZ+z, emission});
+                            }
+                        }
+                    }
+                }
+            }
+
+            if (chunk->isLit())
+                continue;
+
+            // The lit neighbours haven't spread their light into the new chunk
+            for (int dirI{2}; dirI < 6; ++dirI)
+            {
+                const int dx = neighbourOffsets[dirI][0];
+                const int dz = neighbourOffsets[dirI][2];
+                const Chunk* neighbour = chunk->getNeighbour(dx, dz);
+                if (!neighbour || !neighbour->isLit())
+                    continue;
+
+                // The side of the neighbour facing us
+                const int neighbourOriginX = neighbour->getChunkX()*CHUNK_WIDTH_BLOCKS;
+                const int neighbourOriginZ = neighbour->getChunkZ()*CHUNK_WIDTH_BLOCKS;
+                for (int y{}; y < CHUNK_HEIGHT_BLOCKS; ++y)
+                {
+                    for (int i{}; i < CHUNK_WIDTH_BLOCKS; ++i)
+                    {
+                        const int x = dx == 0 ? i : (dx < 0 ? CHUNK_WIDTH_BLOCKS-1 : 0);
+                        const int z = dz == 0 ? i : (dz < 0 ? CHUNK_WIDTH_BLOCKS-1 : 0);
+                        const uint8_t level = neighbour->getLight(type, x, y, z);
+                        if (level > 1)
+                            m_addQueue.push_back({neighbourOriginX+x, y, neighbourOriginZ+z, level});
+                    }
+                }
+            }
+        }
+        propagateAdd(type);
+    }
+
+    for (size_t chunkI{}; chunkI < chunks.size(); ++chunkI)
+    {
+        Chunk* chunk = chunks[chunkI];
+        chunk->setLit();
+        for (int sectionI{}; sectionI <= topSectionIs[chunkI]; ++sectionI)
+            chunk->freeLightSectionIfDefault(sectionI);
+
+        // The bulk writes above didn't mark the meshes
+        const int originX = chunk->getChunkX()*CHUNK_WIDTH_BLOCKS;
+        const int originZ = chunk->getChunkZ()*CHUNK_WIDTH_BLOCKS;
+        m_world->markBoxDirty({originX, 0, originZ},
+                {originX+CHUNK_WIDTH_BLOCKS-1, std::max(topSectionIs[chunkI]+1, 1)*CHUNK_SECTION_HEIGHT-1, originZ+CHUNK_WIDTH_BLOCKS-1},
+                1u << CHUNK_CACHE_MESH);
+    }
+}
+
+void LightEngine::relightBlocks(const std::vector<BlockPos>& positions)
+{
+    PROFILE_ZONE("LightEngine::relightBlocks");
+
+    for (int typeI{}; typeI < LIGHT__COUNT; ++typeI)
+    {
+        const LightType type = (LightType)typeI;
+
+        // Darken the edited blocks and what they lit
+        for (const BlockPos& pos : positions)
+        {
+            Chunk* chunk = findChunk(World::blockToChunkCoord(pos.x), World::blockToChunkCoord(pos.z));
+            if (!chunk || !chunk->isLit())
+                continue;
+            m_removeQueue.push_back({pos.x, pos.y, pos.z, getLight(*chunk, type, pos.x, pos.y, pos.z)});
+            setLight(chunk, type, pos.x, pos.y, pos.z, 0);
+        }
+        propagateRemove(type);
+
+        // Then let the light in from around them
+        for (const BlockPos& pos : positions)
+        {
+            Chunk* chunk = findChunk(World::blockToChunkCoord(pos.x), World::blockToChunkCoord(pos.z));
+            if (!chunk || !chunk->isLit())
+                continue;
+            const BlockType blockType = chunk->getBlock(World::blockToLocalCoord(pos.x), pos.y, World::blockToLocalCoord(pos.z)).type;
+
+            const uint8_t emission = type == LIGHT_BLOCK ? BlockRegistry::getLightEmission(blockType) : 0;
+            if (emission > getLight(*chunk, type, pos.x, pos.y, pos.z))
+            {
+                setLight(chunk, type, pos.x, pos.y, pos.z, emission);
+                m_addQueue.push_back({pos.x, pos.y, pos.z, emission});
+            }
+
+            if (BlockRegistry::isOpaque(blockType))
+                continue;
+            // Open to the sky above the world
+            if (type == LIGHT_SKY && pos.y == CHUNK_HEIGHT_BLOCKS-1)
+            {
+                setLight(chunk, type, pos.x, pos.y, pos.z, LIGHT_MAX);
+                m_addQueue.push_back({pos.x, pos.y, pos.z, LIGHT_MAX});
+            }
+            for (const auto& offset : neighbourOffsets)
+            {
+                const int y = pos.y+offset[1];
+                if (y >= 0 && y < CHUNK_HEIGHT_BLOCKS)
+                    m_addQueue.push_back({pos.x+offset[0], y, pos.z+offset[2], 0});
+            }
+        }
+        propagateAdd(type);
+    }
+}
+
+int LightEngine::update()
+{
+    PROFILE_ZONE("LightEngine::update");
+    // Chunks may have been removed since the last update
+    m_lastChunk = nullptr;
+
+    std::vector<Chunk*> dirtyChunks;
+    for (const auto& [_, chunk] : m_world->getChunks())
+    {
+        // Light can spread anywhere in the chunk, so it is relit whole
+        if (chunk->takeDirtySections(CHUNK_CACHE_LIGHT))
+            dirtyChunks.push_back(chunk.get());
+    }
+    if (!dirtyChunks.empty())
+        lightChunksFromScratch(dirtyChunks);
+
+    const std::vector<BlockPos> changedBlocks = m_world->takeChangedBlocks();
+    if (!changedBlocks.empty())
+        relightBlocks(changedBlocks);
+
+    return dirtyChunks.size();
+}
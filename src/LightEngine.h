@@ -0,0 +1,68 @@
+#pragma once
+
+#include "World.h"
+#include <vector>
+#include <cstdint>
+
+/*
+ * Keeps the sky and block light of the loaded chunks up to date.
+ *
+ * Sky light comes down the columns without loss until an opaque block,
+ * and both kinds lose a level per block when spreading any other way.
+ * New and batch-edited chunks are lit from scratch, single-block edits
+ * only touch the blocks whose light depends on them, in any chunk.
+ * The written blocks mark the meshes around them dirty.
+ */
+class LightEngine final
+{
+private:
+    World* m_world{};
+
+    struct LightNode
+    {
+        int x{};
+        int y{};
+        int z{};
+        // The level when it was queued
+        uint8_t level{};
+    };
+    // Used as FIFO queues, kept to reuse their memory
+    std::vector<LightNode> m_removeQueue;
+    std::vector<LightNode> m_addQueue;
+    // See `findChunk()`
+    Chunk* m_lastChunk{};
+
+    /*
+     * Like `BlockAccessor::findChunk()`, valid during an update.
+     */
+    Chunk* findChunk(int chunkX, int chunkZ);
+    uint8_t getLight(const Chunk& chunk, LightType type, int x, int y, int z) const;
+    /*
+     * Takes world coordinates.
+     */
+    void setLight(Chunk* chunk, LightType type, int x, int y, int z, uint8_t level);
+
+    /*
+     * Darkens the blocks whose light came from the nodes of `m_removeQueue`,
+     * and queues the brighter ones around them to spread light back.
+     */
+    void propagateRemove(LightType type);
+    void propagateAdd(LightType type);
+
+    void lightChunksFromScratch(const std::vector<Chunk*>& chunks);
+    void relightBlocks(const std::vector<BlockPos>& positions);
+
+public:
+    explicit LightEngine(World* world);
+
+    LightEngine(const LightEngine&) = delete;
+    LightEngine& operator=(const LightEngine&) = delete;
+    LightEngine(LightEngine&&) = delete;
+    LightEngine& operator=(LightEngine&&) = delete;
+
+    /*
+     * Lights the chunks with dirty light sections and applies the queued
+     * single-block edits. Call before meshing. Returns the number of chunks lit.
+     */
+    int update();
+};
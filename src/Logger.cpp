@@ -1,22 +1,289 @@
 #include "Logger.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace Logger
 {
 
-std::string _loggerPrefix;
-
+#ifdef LOGGER_STRIP_DEBUG
+NullLogger dbg;
+#else
 Logger dbg{Logger::Type::Debug};
+#endif
 Logger log{Logger::Type::Log};
 Logger warn{Logger::Type::Warning};
 Logger err{Logger::Type::Error};
 Logger fatal{Logger::Type::Fatal};
 
+struct Record
+{
+    Logger::Type type{};
+    uint32_t len{};
+    std::array<char, LOGGER_MAX_LINE_LEN> text{};
+};
+
+/*
+ * Line being built by a thread, one per logger type.
+ */
+struct PendingLine
+{
+    Record record{};
+    // Whether this is the beginning of the line
+    bool isBeginning{true};
+    bool isHex{};
+};
+
+/*
+ * Single producer (the owner thread), single consumer (whoever holds `s_writeMutex`).
+ */
+struct ThreadRing
+{
+    std::array<Record, LOGGER_RING_SIZE> records{};
+    std::atomic<uint32_t> readCount{};
+    std::atomic<uint32_t> writeCount{};
+};
+
+thread_local std::array<PendingLine, Logger::typeCount> t_pendingLines{};
+thread_local std::array<char, LOGGER_MAX_PREFIX_LEN> t_prefix{};
+thread_local size_t t_prefixLen{};
+
+// Rings outlive their threads, so records of finished threads still get written
+static std::mutex s_ringsMutex;
+static std::vector<std::unique_ptr<ThreadRing>> s_rings;
+
+// Held while writing to the terminal
+static std::mutex s_writeMutex;
+static std::atomic<bool> s_isWriterShutDown{};
+
+static void writeRecord(const Record& record)
+{
+    std::FILE* stream = (record.type == Logger::Type::Debug || record.type == Logger::Type::Log) ? stdout : stderr;
+    std::fwrite(record.text.data(), 1, record.len, stream);
+}
+
+/*
+ * Writes out the queued records of every thread.
+ * Must be called with `s_writeMutex` held.
+ * Returns true if anything was written.
+ */
+static bool drainRings()
+{
+    bool hasWritten = false;
+    std::lock_guard<std::mutex> ringsGuard{s_ringsMutex};
+    for (auto& ring : s_rings)
+    {
+        const uint32_t writeCount = ring->writeCount.load(std::memory_order_acquire);
+        uint32_t readCount = ring->readCount.load(std::memory_order_relaxed);
+        for (; readCount != writeCount; ++readCount)
+        {
+            writeRecord(ring->records[readCount%LOGGER_RING_SIZE]);
+            hasWritten = true;
+        }
+        ring->readCount.store(readCount, std::memory_order_release);
+    }
+
+    if (hasWritten)
+    {
+        std::fflush(stdout);
+        std::fflush(stderr);
+    }
+    return hasWritten;
+}
+
+/*
+ * Background thread that writes the queued records.
+ * Started when the first record is submitted, stopped at exit.
+ */
+class WriterThread final
+{
+private:
+    std::atomic<bool> m_isRunning{true};
+    std::thread m_thread;
+
+    void run()
+    {
+        while (m_isRunning.load(std::memory_order_relaxed))
+        {
+            bool hasWritten{};
+            {
+                std::lock_guard<std::mutex> guard{s_writeMutex};
+                hasWritten = drainRings();
+            }
+            if (!hasWritten)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+public:
+    WriterThread()
+        : m_thread{&WriterThread::run, this}
+    {
+    }
+
+    WriterThread(const WriterThread&) = delete;
+    WriterThread& operator=(const WriterThread&) = delete;
+    WriterThread(WriterThread&&) = delete;
+    WriterThread& operator=(WriterThread&&) = delete;
+
+    ~WriterThread()
+    {
+        m_isRunning.store(false, std::memory_order_relaxed);
+        m_thread.join();
+
+        // From now on, records are written synchronously
+        std::lock_guard<std::mutex> guard{s_writeMutex};
+        s_isWriterShutDown.store(true);
+        drainRings();
+    }
+};
+
+static void ensureWriterStarted()
+{
+    static WriterThread writer;
+}
+
+static ThreadRing& getThreadRing()
+{
+    thread_local ThreadRing* ring = []{
+        std::lock_guard<std::mutex> guard{s_ringsMutex};
+        s_rings.push_back(std::make_unique<ThreadRing>());
+        return s_rings.back().get();
+    }();
+    return *ring;
+}
+
+static void submitRecord(const Record& record)
+{
+    if (s_isWriterShutDown.load())
+    {
+        std::lock_guard<std::mutex> guard{s_writeMutex};
+        writeRecord(record);
+        return;
+    }
+    ensureWriterStarted();
+
+    ThreadRing& ring = getThreadRing();
+    const uint32_t writeCount = ring.writeCount.load(std::memory_order_relaxed);
+    // Only wait for the writer if the ring is full
+    while (writeCount-ring.readCount.load(std::memory_order_acquire) >= LOGGER_RING_SIZE)
+        std::this_thread::yield();
+
+    Record& slot = ring.records[writeCount%LOGGER_RING_SIZE];
+    slot.type = record.type;
+    slot.len = record.len;
+    std::memcpy(slot.text.data(), record.text.data(), record.len);
+    ring.writeCount.store(writeCount+1, std::memory_order_release);
+}
+
+void flush()
+{
+    std::lock_guard<std::mutex> guard{s_writeMutex};
+    drainRings();
+}
+
+static std::string_view getHeader(Logger::Type type)
+{
+    switch (type)
+    {
+    case Logger::Type::Debug:   return LOGGER_COLOR_DBG   "[DBG]";
+    case Logger::Type::Log:     return LOGGER_COLOR_LOG   "[INFO]";
+    case Logger::Type::Warning: return LOGGER_COLOR_WARN  "[WARN]";
+    case Logger::Type::Error:   return LOGGER_COLOR_ERR   "[ERR]";
+    case Logger::Type::Fatal:   return LOGGER_COLOR_FATAL "[FATAL]";
+    }
+    return "";
+}
+
+static void appendToRecord(Record& record, std::string_view str)
+{
+    // Keep space for the line break
+    const size_t len = std::min(str.size(), record.text.size()-1-record.len);
+    std::memcpy(record.text.data()+record.len, str.data(), len);
+    record.len += len;
+}
+
+void Logger::append(std::string_view str)
+{
+    PendingLine& line = t_pendingLines[(int)m_type];
+    if (line.isBeginning)
+    {
+        line.record.type = m_type;
+        line.record.len = 0;
+        appendToRecord(line.record, getHeader(m_type));
+        if (t_prefixLen)
+        {
+            appendToRecord(line.record, "<");
+            appendToRecord(line.record, {t_prefix.data(), t_prefixLen});
+            appendToRecord(line.record, ">");
+        }
+        appendToRecord(line.record, LOGGER_COLOR_DEF ": ");
+        line.isBeginning = false;
+    }
+    appendToRecord(line.record, str);
+}
+
+bool Logger::isHexMode() const
+{
+    return t_pendingLines[(int)m_type].isHex;
+}
+
+void Logger::setHexMode(bool isHex)
+{
+    t_pendingLines[(int)m_type].isHex = isHex;
+}
+
+void Logger::endLine()
+{
+    PendingLine& line = t_pendingLines[(int)m_type];
+    // Print empty lines too
+    if (line.isBeginning)
+        append("");
+    line.record.text[line.record.len++] = '\n';
+    line.isBeginning = true;
+
+    if (m_type == Type::Fatal)
+    {
+        // Write everything before this record and the record itself right now, we are exiting
+        std::lock_guard<std::mutex> guard{s_writeMutex};
+        drainRings();
+        writeRecord(line.record);
+        std::fputs("\n==================== Fatal error. Exiting. ====================\n", stderr);
+        std::fflush(stderr);
+        abort();
+    }
+
+    submitRecord(line.record);
+}
+
+Logger& Logger::operator()(std::string_view prefix)
+{
+    t_prefixLen = std::min(prefix.size(), t_prefix.size());
+    std::memcpy(t_prefix.data(), prefix.data(), t_prefixLen);
+    return *this;
+}
+
+Logger& Logger::operator()(Control ctrl)
+{
+    if (ctrl == Control::End)
+        t_prefixLen = 0;
+    return *this;
+}
+
 void setLoggerVerbosity(LoggerVerbosity verbosity)
 {
     switch (verbosity)
     {
     case LoggerVerbosity::Quiet:
+#ifndef LOGGER_STRIP_DEBUG
         dbg.m_isEnabled   = false;
+#endif
         log.m_isEnabled   = false;
         warn.m_isEnabled  = true;
         err.m_isEnabled   = true;
@@ -24,7 +291,9 @@ void setLoggerVerbosity(LoggerVerbosity verbosity)
         break;
 
     case LoggerVerbosity::Verbose:
+#ifndef LOGGER_STRIP_DEBUG
         dbg.m_isEnabled   = false;
+#endif
         log.m_isEnabled   = true;
         warn.m_isEnabled  = true;
         err.m_isEnabled   = true;
@@ -32,7 +301,9 @@ void setLoggerVerbosity(LoggerVerbosity verbosity)
         break;
 
     case LoggerVerbosity::Debug:
+#ifndef LOGGER_STRIP_DEBUG
         dbg.m_isEnabled   = true;
+#endif
         log.m_isEnabled   = true;
         warn.m_isEnabled  = true;
         err.m_isEnabled   = true;
@@ -42,4 +313,3 @@ void setLoggerVerbosity(LoggerVerbosity verbosity)
 }
 
 } // End of namespace Logger
-
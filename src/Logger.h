@@ -1,6 +1,12 @@
 #pragma once
 
-#include <iostream>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <ios>
+#include <string>
+#include <string_view>
+#include <type_traits>
 
 #define LOGGER_COLOR_DEF   "\033[0m"
 #define LOGGER_COLOR_DBG   "\033[96m"
@@ -9,6 +15,19 @@
 #define LOGGER_COLOR_ERR   "\033[91m"
 #define LOGGER_COLOR_FATAL "\033[101;97m"
 
+// Longer records are truncated
+#define LOGGER_MAX_LINE_LEN 1024
+// Records a thread can have queued before it has to wait for the writer thread
+#define LOGGER_RING_SIZE 128
+#define LOGGER_MAX_PREFIX_LEN 64
+
+/*
+ * Records are formatted on the logging thread into a thread-local buffer without
+ * allocating, queued in a per-thread lock-free ring and written to the terminal
+ * by a background thread. Fatal records flush everything synchronously.
+ *
+ * Define `LOGGER_STRIP_DEBUG` to compile out `Logger::dbg`.
+ */
 namespace Logger
 {
 
@@ -27,8 +46,6 @@ enum Control
     End, // Can be used to mark the end of the line
 };
 
-extern std::string _loggerPrefix;
-
 class Logger final
 {
 public:
@@ -43,10 +60,9 @@ public:
         Error,
         Fatal,
     };
+    static constexpr int typeCount = (int)Type::Fatal+1;
 
 private:
-    // Whether this is the beginning of the line
-    bool m_isBeginning{true};
     // The logger type: info, error, etc.
     Type m_type{};
     // If this logger object is enabled
@@ -54,42 +70,82 @@ private:
 
     friend void setLoggerVerbosity(LoggerVerbosity verbosity);
 
+    void append(std::string_view str);
+    // Whether integers are printed in hex, set by `std::hex` and `std::dec`
+    bool isHexMode() const;
+    void setHexMode(bool isHex);
+    void endLine();
+
+    template <typename T>
+    inline void appendNumber(T value)
+    {
+        std::array<char, 32> buffer{};
+        std::to_chars_result result{};
+        if constexpr (std::is_floating_point_v<T>)
+            // Same as the default stream formatting
+            result = std::to_chars(buffer.data(), buffer.data()+buffer.size(), value, std::chars_format::general, 6);
+        else
+            result = std::to_chars(buffer.data(), buffer.data()+buffer.size(), value, isHexMode() ? 16 : 10);
+        append({buffer.data(), (size_t)(result.ptr-buffer.data())});
+    }
+
 public:
     Logger(Type type)
         : m_type{type}
     {
     }
 
+    inline Logger& operator<<(std::string_view value)
+    {
+        if (m_isEnabled)
+            append(value);
+        // Make the operator chainable
+        return *this;
+    }
+
+    inline Logger& operator<<(const char* value) { return *this << std::string_view{value ? value : "(null)"}; }
+    inline Logger& operator<<(const std::string& value) { return *this << std::string_view{value}; }
+    // OpenGL strings
+    inline Logger& operator<<(const unsigned char* value) { return *this << (const char*)value; }
+    inline Logger& operator<<(char value) { return *this << std::string_view{&value, 1}; }
+    inline Logger& operator<<(bool value) { return *this << (value ? '1' : '0'); }
+
     template <typename T>
-    inline Logger& operator<<(const T &value)
+        requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+    inline Logger& operator<<(T value)
     {
         if (!m_isEnabled)
             return *this;
 
-        if (m_isBeginning)
-        {
-            switch (m_type)
-            {
-            case Type::Debug:   std::cout << LOGGER_COLOR_DBG   "[DBG]"   << (_loggerPrefix.empty() ? "" : '<'+_loggerPrefix+'>') << LOGGER_COLOR_DEF ": "; break;
-            case Type::Log:     std::cout << LOGGER_COLOR_LOG   "[INFO]"  << (_loggerPrefix.empty() ? "" : '<'+_loggerPrefix+'>') << LOGGER_COLOR_DEF ": "; break;
-            case Type::Warning: std::cerr << LOGGER_COLOR_WARN  "[WARN]"  << (_loggerPrefix.empty() ? "" : '<'+_loggerPrefix+'>') << LOGGER_COLOR_DEF ": "; break;
-            case Type::Error:   std::cerr << LOGGER_COLOR_ERR   "[ERR]"   << (_loggerPrefix.empty() ? "" : '<'+_loggerPrefix+'>') << LOGGER_COLOR_DEF ": "; break;
-            case Type::Fatal:   std::cerr << LOGGER_COLOR_FATAL "[FATAL]" << (_loggerPrefix.empty() ? "" : '<'+_loggerPrefix+'>') << LOGGER_COLOR_DEF ": "; break;
-            }
-        }
-
-        switch (m_type)
-        {
-        case Type::Debug:   std::cout << value; break;
-        case Type::Log:     std::cout << value; break;
-        case Type::Warning: std::cerr << value; break;
-        case Type::Error:   std::cerr << value; break;
-        case Type::Fatal:   std::cerr << value; break;
-        }
-
-        m_isBeginning = false;
+        if constexpr (std::is_enum_v<T>)
+            appendNumber((std::underlying_type_t<T>)value);
+        else
+            appendNumber(value);
+        return *this;
+    }
 
-        // Make the operator chainable
+    inline Logger& operator<<(const void* value)
+    {
+        if (!m_isEnabled)
+            return *this;
+
+        append("0x");
+        const bool wasHex = isHexMode();
+        setHexMode(true);
+        appendNumber((uintptr_t)value);
+        setHexMode(wasHex);
+        return *this;
+    }
+
+    /*
+     * Supports `std::hex` and `std::dec`.
+     */
+    inline Logger& operator<<(std::ios_base& (*manip)(std::ios_base&))
+    {
+        if (manip == static_cast<std::ios_base& (*)(std::ios_base&)>(std::hex))
+            setHexMode(true);
+        else if (manip == static_cast<std::ios_base& (*)(std::ios_base&)>(std::dec))
+            setHexMode(false);
         return *this;
     }
 
@@ -100,56 +156,43 @@ public:
         if (ctrl != End)
             return *this;
 
-        switch (m_type)
-        {
-        case Type::Debug:
-        case Type::Log:
-            std::cout << '\n';
-            break;
-
-        case Type::Warning:
-        case Type::Error:
-            std::cerr << '\n';
-            break;
-
-        case Type::Fatal:
-            std::cerr << '\n';
-            std::cerr << "\n==================== Fatal error. Exiting. ====================\n";
-            abort();
-            break;
-        }
-
-        // We printed the \n, to this is the beginning of the new line
-        m_isBeginning = true;
+        endLine();
 
         // Make the operator chainable
         return *this;
     }
 
     /*
-     * Sets the prefix to `prefix`.
+     * Sets the prefix of the calling thread to `prefix`.
      */
-    inline Logger& operator()(const std::string& prefix)
-    {
-        _loggerPrefix = prefix;
-        return *this;
-    }
+    Logger& operator()(std::string_view prefix);
 
     /*
-     * If ctrl is End, clears the prefix.
+     * If ctrl is End, clears the prefix of the calling thread.
      */
-    inline Logger& operator()(Control ctrl)
-    {
-        if (ctrl == Control::End)
-            _loggerPrefix.clear();
-        return *this;
-    }
+    Logger& operator()(Control ctrl);
+};
+
+/*
+ * Used in place of a stripped logger. Everything compiles to nothing.
+ */
+class NullLogger final
+{
+public:
+    template <typename T>
+    constexpr NullLogger& operator<<(const T&) { return *this; }
+    template <typename T>
+    constexpr NullLogger& operator()(const T&) { return *this; }
 };
 
 /*
  * Logger object instances with different types
  */
+#ifdef LOGGER_STRIP_DEBUG
+extern NullLogger dbg;
+#else
 extern Logger dbg;
+#endif
 extern Logger log;
 extern Logger warn;
 extern Logger err;
@@ -157,5 +200,9 @@ extern Logger fatal;
 
 void setLoggerVerbosity(LoggerVerbosity verbosity);
 
-} // End of namespace Logger
+/*
+ * Synchronously writes out everything queued so far.
+ */
+void flush();
 
+} // End of namespace Logger
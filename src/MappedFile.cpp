@@ -0,0 +1,143 @@
+#include "MappedFile.h"
+#include "Logger.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <utility>
+
+MappedFile::MappedFile(const std::string& path)
+{
+    open(path);
+}
+
+MappedFile::MappedFile(MappedFile&& temp) noexcept
+    : m_data{std::exchange(temp.m_data, nullptr)},
+    m_size{std::exchange(temp.m_size, 0)},
+    m_path{std::move(temp.m_path)}
+{
+    temp.m_path.clear();
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& temp) noexcept
+{
+    if (&temp == this)
+        return *this;
+
+    close();
+    m_data = std::exchange(temp.m_data, nullptr);
+    m_size = std::exchange(temp.m_size, 0);
+    m_path = std::move(temp.m_path);
+    temp.m_path.clear();
+
+    return *this;
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+    const int fd = ::open(path.c_str(), O_RDONLY|O_CLOEXEC);
+    if (fd == -1)
+    {
+        Logger::dbg << "Failed to open file for mapping: \"" << path << "\": " << std::strerror(errno) << Logger::End;
+        return false;
+    }
+
+    struct stat fileStat{};
+    if (fstat(fd, &fileStat) == -1)
+    {
+        Logger::err << "Failed to stat file: \"" << path << "\": " << std::strerror(errno) << Logger::End;
+        ::close(fd);
+        return false;
+    }
+
+    m_path = path;
+    m_size = fileStat.st_size;
+    // Mapping an empty file fails, but it's still a valid, empty file
+    if (m_size == 0)
+    {
+        ::close(fd);
+        return true;
+    }
+
+    void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file referenced
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        Logger::err << "Failed to map file: \"" << path << "\": " << std::strerror(errno) << Logger::End;
+        m_size = 0;
+        m_path.clear();
+        return false;
+    }
+    // We read through it sequentially most of the time
+    madvise(mapping, m_size, MADV_SEQUENTIAL);
+
+    m_data = (const char*)mapping;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data)
+        munmap((void*)m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_path.clear();
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool writeFileAtomically(const std::string& path, std::string_view data)
+{
+    // A unique name, so two processes writing the same file don't share the temporary file
+    std::string tempPath = path+".XXXXXX";
+    const int fd = mkostemp(tempPath.data(), O_CLOEXEC);
+    if (fd == -1)
+    {
+        Logger::err << "Failed to create temporary file for: \"" << path << "\": " << std::strerror(errno) << Logger::End;
+        return false;
+    }
+    // Created private, give it the usual permissions
+    fchmod(fd, 0644);
+
+    bool isOk = true;
+    while (!data.empty())
+    {
+        const ssize_t written = ::write(fd, data.data(), data.size());
+        if (written == -1 && errno == EINTR)
+            continue;
+        if (written == -1)
+        {
+            isOk = false;
+            break;
+        }
+        data.remove_prefix(written);
+    }
+    isOk = isOk && fsync(fd) == 0;
+    isOk = ::close(fd) == 0 && isOk;
+    if (!isOk || std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        Logger::err << "Failed to write file: \"" << path << "\": " << std::strerror(errno) << Logger::End;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    // Make the rename itself durable
+    const std::string dirPath = std::filesystem::path{path}.parent_path().string();
+    const int dirFd = ::open(dirPath.empty() ? "." : dirPath.c_str(), O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    if (dirFd != -1)
+    {
+        fsync(dirFd);
+        ::close(dirFd);
+    }
+    return true;
+}
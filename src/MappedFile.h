@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+/*
+ * Read-only memory mapping of a whole file.
+ */
+class MappedFile final
+{
+private:
+    const char* m_data{};
+    size_t m_size{};
+    std::string m_path;
+
+public:
+    MappedFile() = default;
+    MappedFile(const std::string& path);
+
+    // Disable copying
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Implement moving
+    MappedFile(MappedFile&& temp) noexcept;
+    MappedFile& operator=(MappedFile&& temp) noexcept;
+
+    /*
+     * Returns false if the file can't be opened or mapped.
+     */
+    bool open(const std::string& path);
+    void close();
+
+    inline bool isOpen() const { return m_data != nullptr || (m_size == 0 && !m_path.empty()); }
+    inline const char* data() const { return m_data; }
+    inline size_t size() const { return m_size; }
+    inline std::string_view view() const { return {m_data, m_size}; }
+
+    ~MappedFile();
+};
+
+/*
+ * Writes to a temporary file first, then renames it over `path`, so a crash
+ * never leaves a half-written file behind. Returns false on error.
+ */
+bool writeFileAtomically(const std::string& path, std::string_view data);
@@ -0,0 +1,156 @@
+#include "Metrics.h"
+#include "Logger.h"
+#include <algorithm>
+
+namespace Metrics
+{
+
+static std::array<Counter, METRICS_MAX_COUNTERS> s_counters;
+static int s_counterCount{};
+static std::array<Gauge, METRICS_MAX_GAUGES> s_gauges;
+static int s_gaugeCount{};
+static std::array<Histogram, METRICS_MAX_HISTOGRAMS> s_histograms;
+static int s_histogramCount{};
+
+static double s_windowStartSec = -1;
+static double s_firstWindowStartSec{};
+static std::FILE* s_csvFile{};
+static bool s_isCsvHeaderWritten{};
+
+double Histogram::getPercentile(double perc) const
+{
+    if (m_count == 0)
+        return 0.0;
+
+    const uint64_t rank = std::max<uint64_t>(perc/100.0*m_count+0.5, 1);
+    uint64_t seen{};
+    for (int i{}; i < METRICS_HIST_BUCKET_COUNT; ++i)
+    {
+        seen += m_buckets[i];
+        if (seen >= rank)
+        {
+            // Upper edge of the bucket, but never more than the real maximum
+            return std::min((i+1)*METRICS_HIST_BUCKET_WIDTH_MS, m_max);
+        }
+    }
+    // In the overflow bucket
+    return m_max;
+}
+
+void Histogram::closeWindow()
+{
+    m_lastWindowStats.count = m_count;
+    m_lastWindowStats.p50 = getPercentile(50);
+    m_lastWindowStats.p95 = getPercentile(95);
+    m_lastWindowStats.p99 = getPercentile(99);
+    m_lastWindowStats.max = m_max;
+
+    m_buckets.fill(0);
+    m_count = 0;
+    m_max = 0.0;
+}
+
+template <typename T, size_t N>
+static T& addMetric(std::array<T, N>& metrics, int& count, const char* name)
+{
+    if (count >= (int)N)
+    {
+        Logger::fatal << "Too many metrics of the same kind, can't add: " << name << Logger::End;
+    }
+    T& metric = metrics[count++];
+    metric.setName(name);
+    return metric;
+}
+
+Counter& addCounter(const char* name)
+{
+    return addMetric(s_counters, s_counterCount, name);
+}
+
+Gauge& addGauge(const char* name)
+{
+    return addMetric(s_gauges, s_gaugeCount, name);
+}
+
+Histogram& addHistogram(const char* name)
+{
+    return addMetric(s_histograms, s_histogramCount, name);
+}
+
+void openCsv(const char* path)
+{
+    s_csvFile = std::fopen(path, "w");
+    if (!s_csvFile)
+    {
+        Logger::err << "Failed to open metrics CSV file: " << path << Logger::End;
+        return;
+    }
+    Logger::log << "Writing metrics to " << path << Logger::End;
+}
+
+static void writeCsvHeader()
+{
+    std::fprintf(s_csvFile, "time_sec");
+    for (int i{}; i < s_counterCount; ++i)
+        std::fprintf(s_csvFile, ",%s", s_counters[i].getName());
+    for (int i{}; i < s_gaugeCount; ++i)
+        std::fprintf(s_csvFile, ",%s", s_gauges[i].getName());
+    for (int i{}; i < s_histogramCount; ++i)
+    {
+        const char* name = s_histograms[i].getName();
+        std::fprintf(s_csvFile, ",%s_count,%s_p50,%s_p95,%s_p99,%s_max", name, name, name, name, name);
+    }
+    std::fprintf(s_csvFile, "\n");
+    s_isCsvHeaderWritten = true;
+}
+
+static void writeCsvRow(double nowSec)
+{
+    if (!s_isCsvHeaderWritten)
+        writeCsvHeader();
+
+    std::fprintf(s_csvFile, "%.3f", nowSec-s_firstWindowStartSec);
+    for (int i{}; i < s_counterCount; ++i)
+        std::fprintf(s_csvFile, ",%lu", (unsigned long)s_counters[i].get());
+    for (int i{}; i < s_gaugeCount; ++i)
+        std::fprintf(s_csvFile, ",%g", s_gauges[i].get());
+    for (int i{}; i < s_histogramCount; ++i)
+    {
+        const HistogramStats& stats = s_histograms[i].getLastWindowStats();
+        std::fprintf(s_csvFile, ",%lu,%.3f,%.3f,%.3f,%.3f",
+                (unsigned long)stats.count, stats.p50, stats.p95, stats.p99, stats.max);
+    }
+    std::fprintf(s_csvFile, "\n");
+}
+
+bool update(double nowSec)
+{
+    if (s_windowStartSec < 0)
+    {
+        s_windowStartSec = nowSec;
+        s_firstWindowStartSec = nowSec;
+        return false;
+    }
+
+    if (nowSec-s_windowStartSec < METRICS_WINDOW_SEC)
+        return false;
+
+    for (int i{}; i < s_histogramCount; ++i)
+        s_histograms[i].closeWindow();
+    if (s_csvFile)
+        writeCsvRow(nowSec);
+
+    s_windowStartSec = nowSec;
+    return true;
+}
+
+void shutdown()
+{
+    if (s_csvFile)
+    {
+        std::fclose(s_csvFile);
+        s_csvFile = nullptr;
+    }
+}
+
+} // End of namespace Metrics
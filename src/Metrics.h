@@ -0,0 +1,130 @@
+#pragma once
+
+#include "types.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+/*
+ * Registry of counters, gauges and frame-time histograms.
+ *
+ * Metrics are registered once at startup, updating them doesn't allocate.
+ * `update()` closes a window every `METRICS_WINDOW_SEC` seconds: the histograms
+ * are summarized and reset, and a row is appended to the CSV file if there is one.
+ */
+namespace Metrics
+{
+
+#define METRICS_MAX_COUNTERS 32
+#define METRICS_MAX_GAUGES 32
+#define METRICS_MAX_HISTOGRAMS 16
+
+// Histogram buckets are 0.1ms wide, values above the last one go to the overflow bucket
+#define METRICS_HIST_BUCKET_WIDTH_MS 0.1
+#define METRICS_HIST_BUCKET_COUNT 1000
+
+#define METRICS_WINDOW_SEC 1.0
+
+/*
+ * Monotonically increasing value. Can be updated from any thread.
+ */
+class Counter final
+{
+private:
+    const char* m_name{};
+    std::atomic<uint64_t> m_value{};
+
+public:
+    inline void setName(const char* name) { m_name = name; }
+    inline const char* getName() const { return m_name; }
+    inline void add(uint64_t amount=1) { m_value.fetch_add(amount, std::memory_order_relaxed); }
+    inline uint64_t get() const { return m_value.load(std::memory_order_relaxed); }
+};
+
+/*
+ * Value that is overwritten, e.g. the number of things rendered this frame.
+ * Can be updated from any thread.
+ */
+class Gauge final
+{
+private:
+    const char* m_name{};
+    std::atomic<double> m_value{};
+
+public:
+    inline void setName(const char* name) { m_name = name; }
+    inline const char* getName() const { return m_name; }
+    inline void set(double value) { m_value.store(value, std::memory_order_relaxed); }
+    inline double get() const { return m_value.load(std::memory_order_relaxed); }
+};
+
+/*
+ * Summary of a histogram window.
+ */
+struct HistogramStats
+{
+    uint64_t count{};
+    double p50{};
+    double p95{};
+    double p99{};
+    double max{};
+};
+
+/*
+ * Fixed-bucket histogram of millisecond values. Only update it from one thread.
+ */
+class Histogram final
+{
+private:
+    const char* m_name{};
+    std::array<uint32_t, METRICS_HIST_BUCKET_COUNT+1> m_buckets{};
+    uint64_t m_count{};
+    double m_max{};
+    HistogramStats m_lastWindowStats{};
+
+    double getPercentile(double perc) const;
+
+public:
+    inline void setName(const char* name) { m_name = name; }
+    inline const char* getName() const { return m_name; }
+
+    inline void record(double valueMs)
+    {
+        const int bucketI = valueMs < 0 ? 0 : (int)(valueMs/METRICS_HIST_BUCKET_WIDTH_MS);
+        ++m_buckets[bucketI < METRICS_HIST_BUCKET_COUNT ? bucketI : METRICS_HIST_BUCKET_COUNT];
+        ++m_count;
+        if (valueMs > m_max)
+            m_max = valueMs;
+    }
+
+    /*
+     * Summarizes the current window and starts a new one.
+     */
+    void closeWindow();
+    /*
+     * Summary of the last closed window.
+     */
+    inline const HistogramStats& getLastWindowStats() const { return m_lastWindowStats; }
+};
+
+/*
+ * `name` must be a string literal. The returned references stay valid.
+ */
+Counter& addCounter(const char* name);
+Gauge& addGauge(const char* name);
+Histogram& addHistogram(const char* name);
+
+/*
+ * Start appending a row to the CSV file after every window.
+ */
+void openCsv(const char* path);
+
+/*
+ * Call once per frame. Returns true if a window was closed.
+ */
+bool update(double nowSec);
+
+void shutdown();
+
+} // End of namespace Metrics
@@ -0,0 +1,129 @@
+#include "NetClient.h"
+#include "Logger.h"
+#include "Profiler.h"
+
+bool NetClient::connect(const std::string& address, int viewDistance)
+{
+    m_connection = NetConnection::connect(address);
+    if (!m_connection)
+        return false;
+
+    m_message.clear();
+    NetProtocol::write(&m_message, (uint32_t)NET_PROTOCOL_VERSION);
+    NetProtocol::write(&m_message, (uint8_t)viewDistance);
+    m_connection->send(NET_MSG_HELLO, m_message);
+    m_connection->flush();
+    return true;
+}
+
+void NetClient::sendPlayerPos(const glm::vec3& pos)
+{
+    if (!m_connection)
+        return;
+    m_message.clear();
+    NetProtocol::write(&m_message, pos.x);
+    NetProtocol::write(&m_message, pos.y);
+    NetProtocol::write(&m_message, pos.z);
+    m_connection->send(NET_MSG_PLAYER_POS, m_message);
+}
+
+void NetClient::sendSetBlock(BlockPos pos, Block block)
+{
+    if (!m_connection)
+        return;
+    m_message.clear();
+    NetProtocol::write(&m_message, (int32_t)pos.x);
+    NetProtocol::write(&m_message, (int32_t)pos.y);
+    NetProtocol::write(&m_message, (int32_t)pos.z);
+    NetProtocol::write(&m_message, (uint8_t)block.type);
+    NetProtocol::write(&m_message, block.state);
+    m_connection->send(NET_MSG_SET_BLOCK, m_message);
+}
+
+bool NetClient::handleMessage(NetMessageType type, std::string_view payload, World* world)
+{
+    const char* pos = payload.data();
+    const char* const end = pos+payload.size();
+    switch (type)
+    {
+    case NET_MSG_WELCOME:
+    {
+        uint32_t ticksPerSec{};
+        if (!NetProtocol::read(&pos, end, &m_playerId) || !NetProtocol::read(&pos, end, &ticksPerSec))
+            return false;
+        Logger::dbg << "Joined as player " << m_playerId << ", server runs at " << ticksPerSec << " ticks/s"
+            << Logger::End;
+        return true;
+    }
+
+    case NET_MSG_CHUNK:
+    {
+        int32_t chunkX{};
+        int32_t chunkZ{};
+        if (!NetProtocol::read(&pos, end, &chunkX) || !NetProtocol::read(&pos, end, &chunkZ))
+            return false;
+        ++m_receivedChunkCount;
+        if (!world)
+            return true;
+        auto chunk = std::make_unique<Chunk>(chunkX, chunkZ);
+        if (!NetProtocol::decodeChunk(&pos, end, chunk.get()) || pos != end)
+            return false;
+        // Sent again after it went out of view and came back
+        world->removeChunk(chunkX, chunkZ);
+        world->addChunk(std::move(chunk));
+        return true;
+    }
+
+    case NET_MSG_UNLOAD_CHUNK:
+    {
+        int32_t chunkX{};
+        int32_t chunkZ{};
+        if (!NetProtocol::read(&pos, end, &chunkX) || !NetProtocol::read(&pos, end, &chunkZ))
+            return false;
+        if (world)
+            world->removeChunk(chunkX, chunkZ);
+        return true;
+    }
+
+    case NET_MSG_TICK:
+    {
+        float serverTickMs{};
+        if (!NetProtocol::read(&pos, end, &m_lastTickI) || !NetProtocol::read(&pos, end, &serverTickMs))
+            return false;
+        if (m_isRecordingServerTickMs)
+            m_serverTickMs.push_back(serverTickMs);
+        if (!world)
+            return true;
+        m_edits.clear();
+        if (!NetProtocol::decodeDeltas(&pos, end, &m_edits) || pos != end)
+            return false;
+        world->setBlocks(m_edits);
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+bool NetClient::update(World* world)
+{
+    if (!m_connection)
+        return false;
+    PROFILE_ZONE("NetClient::update");
+
+    m_connection->flush();
+    m_connection->receive();
+    NetMessageType type{};
+    std::string_view payload;
+    while (m_connection->popMessage(&type, &payload))
+    {
+        if (!handleMessage(type, payload, world))
+        {
+            Logger::err << "Invalid message of type " << (int)type << " from the server" << Logger::End;
+            m_connection.reset();
+            return false;
+        }
+    }
+    return !m_connection->isClosed();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "NetSocket.h"
+#include "World.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glm/vec3.hpp>
+
+/*
+ * Connection to a `Server`, it mirrors the chunks the server sends into a local world.
+ */
+class NetClient final
+{
+private:
+    std::unique_ptr<NetConnection> m_connection;
+    // Set by the welcome message
+    uint32_t m_playerId{};
+    uint64_t m_lastTickI{};
+    // From the tick messages, see `takeServerTickMs()`
+    std::vector<float> m_serverTickMs;
+    bool m_isRecordingServerTickMs{};
+    long m_receivedChunkCount{};
+    // Reused for encoding and decoding
+    std::string m_message;
+    std::vector<BlockEdit> m_edits;
+
+    /*
+     * Returns false if the message is invalid.
+     */
+    bool handleMessage(NetMessageType type, std::string_view payload, World* world);
+
+public:
+    NetClient() = default;
+
+    NetClient(const NetClient&) = delete;
+    NetClient& operator=(const NetClient&) = delete;
+    NetClient(NetClient&&) = delete;
+    NetClient& operator=(NetClient&&) = delete;
+
+    /*
+     * Connects and asks for the chunks within `viewDistance`. Returns false on error.
+     */
+    bool connect(const std::string& address, int viewDistance);
+    inline bool isConnected() const { return m_connection && !m_connection->isClosed(); }
+
+    /*
+     * `pos` is in blocks.
+     */
+    void sendPlayerPos(const glm::vec3& pos);
+    /*
+     * The server applies it and sends it back with the deltas of its next tick.
+     */
+    void sendSetBlock(BlockPos pos, Block block);
+
+    /*
+     * Sends the queued messages, and applies the received chunks and deltas to `world`.
+     * With a null `world` the messages are only counted. Returns false if disconnected,
+     * or if the server sent something invalid, which drops the connection.
+     */
+    bool update(World* world);
+
+    inline uint32_t getPlayerId() const { return m_playerId; }
+    inline uint64_t getLastTickI() const { return m_lastTickI; }
+    /*
+     * Off by default, nothing else takes them and they would pile up.
+     */
+    inline void setRecordingServerTickMs(bool isRecording) { m_isRecordingServerTickMs = isRecording; }
+    /*
+     * Returns the tick times reported by the server since the last call, while recording.
+     */
+    inline std::vector<float> takeServerTickMs() { return std::exchange(m_serverTickMs, {}); }
+    inline long getReceivedChunkCount() const { return m_receivedChunkCount; }
+    inline uint64_t getSentBytes() const { return m_connection ? m_connection->getSentBytes() : 0; }
+    inline uint64_t getReceivedBytes() const { return m_connection ? m_connection->getReceivedBytes() : 0; }
+};
@@ -0,0 +1,180 @@
+#include "NetProtocol.h"
+#include "Varint.h"
+#include <algorithm>
+#include <bit>
+
+namespace NetProtocol
+{
+
+// The indices don't span two words, so a few bits of each word may be unused
+static inline int getIndicesPerWord(int bitsPerIndex) { return 64/bitsPerIndex; }
+
+static void encodeSection(const ChunkSection& section, std::string* out)
+{
+    std::vector<Block> palette;
+    std::array<uint16_t, CHUNK_SECTION_BLOCK_COUNT> indices;
+    uint16_t lastIndex{};
+    for (size_t i{}; i < section.blocks.size(); ++i)
+    {
+        const Block block = section.blocks[i];
+        // Neighbouring blocks are mostly the same, the palette is searched only on a change
+        if (palette.empty() || palette[lastIndex].type != block.type || palette[lastIndex].state != block.state)
+        {
+            const auto found = std::find_if(palette.begin(), palette.end(), [&](const Block& entry){
+                return entry.type == block.type && entry.state == block.state;
+            });
+            lastIndex = found-palette.begin();
+            if (found == palette.end())
+                palette.push_back(block);
+        }
+        indices[i] = lastIndex;
+    }
+
+    Varint::write(out, palette.size());
+    for (const Block& entry : palette)
+    {
+        out->push_back((char)entry.type);
+        out->push_back((char)entry.state);
+    }
+    if (palette.size() == 1)
+        return;
+
+    const int bitsPerIndex = std::bit_width(palette.size()-1);
+    const int indicesPerWord = getIndicesPerWord(bitsPerIndex);
+    for (size_t i{}; i < indices.size(); i += indicesPerWord)
+    {
+        uint64_t word{};
+        const size_t count = std::min<size_t>(indicesPerWord, indices.size()-i);
+        for (size_t j{}; j < count; ++j)
+            word |= (uint64_t)indices[i+j] << (j*bitsPerIndex);
+        write(out, word);
+    }
+}
+
+static bool decodeSection(const char** pos, const char* end, ChunkSection* out)
+{
+    uint64_t paletteSize{};
+    if (!Varint::read(pos, end, &paletteSize) || paletteSize == 0 || paletteSize > CHUNK_SECTION_BLOCK_COUNT
+     || (uint64_t)(end-*pos) < paletteSize*2)
+        return false;
+    std::vector<Block> palette(paletteSize);
+    for (Block& entry : palette)
+    {
+        entry = {(BlockType)(uint8_t)(*pos)[0], (uint8_t)(*pos)[1]};
+        *pos += 2;
+        if (entry.type >= BLOCK_TYPE__COUNT)
+            return false;
+    }
+
+    auto setBlock{[&](size_t i, const Block& block){
+        out->blocks[i] = block;
+        out->nonAirCount += block.type != BLOCK_TYPE_AIR;
+        out->randomTickedCount += BlockRegistry::isRandomTicked(block.type);
+    }};
+
+    if (paletteSize == 1)
+    {
+        for (size_t i{}; i < out->blocks.size(); ++i)
+            setBlock(i, palette[0]);
+        return true;
+    }
+
+    const int bitsPerIndex = std::bit_width(paletteSize-1);
+    const int indicesPerWord = getIndicesPerWord(bitsPerIndex);
+    const uint64_t indexMask = (1ull << bitsPerIndex)-1;
+    for (size_t i{}; i < out->blocks.size(); i += indicesPerWord)
+    {
+        uint64_t word{};
+        if (!read(pos, end, &word))
+            return false;
+        const size_t count = std::min<size_t>(indicesPerWord, out->blocks.size()-i);
+        for (size_t j{}; j < count; ++j)
+        {
+            const uint64_t index = (word >> (j*bitsPerIndex)) & indexMask;
+            if (index >= paletteSize)
+                return false;
+            setBlock(i+j, palette[index]);
+        }
+    }
+    return true;
+}
+
+void encodeChunk(const Chunk& chunk, std::string* out)
+{
+    uint32_t sectionMask{};
+    for (int i{}; i < CHUNK_SECTION_COUNT; ++i)
+    {
+        if (chunk.getSection(i))
+            sectionMask |= 1u << i;
+    }
+    Varint::write(out, sectionMask);
+    for (int i{}; i < CHUNK_SECTION_COUNT; ++i)
+    {
+        if (const ChunkSection* section = chunk.getSection(i))
+            encodeSection(*section, out);
+    }
+}
+
+bool decodeChunk(const char** pos, const char* end, Chunk* out)
+{
+    uint64_t sectionMask{};
+    if (!Varint::read(pos, end, &sectionMask) || sectionMask > CHUNK_ALL_SECTIONS_MASK)
+        return false;
+    for (int i{}; i < CHUNK_SECTION_COUNT; ++i)
+    {
+        if (!(sectionMask & (1u << i)))
+            continue;
+        const bool isValid = decodeSection(pos, end, &out->getOrCreateSection(i));
+        out->onSectionWritten(i);
+        if (!isValid)
+            return false;
+    }
+    return true;
+}
+
+void encodeDeltas(const std::vector<BlockEdit>& edits, std::string* out)
+{
+    Varint::write(out, edits.size());
+    BlockPos lastPos;
+    for (const BlockEdit& edit : edits)
+    {
+        Varint::write(out, Varint::zigzag((int64_t)edit.pos.x-lastPos.x));
+        Varint::write(out, Varint::zigzag((int64_t)edit.pos.y-lastPos.y));
+        Varint::write(out, Varint::zigzag((int64_t)edit.pos.z-lastPos.z));
+        out->push_back((char)edit.block.type);
+        out->push_back((char)edit.block.state);
+        lastPos = edit.pos;
+    }
+}
+
+bool decodeDeltas(const char** pos, const char* end, std::vector<BlockEdit>* out)
+{
+    uint64_t count{};
+    // Each edit takes at least 5 bytes
+    if (!Varint::read(pos, end, &count) || count > (uint64_t)(end-*pos)/5)
+        return false;
+    BlockPos lastPos;
+    for (uint64_t i{}; i < count; ++i)
+    {
+        uint64_t vals[3]{};
+        for (uint64_t& val : vals)
+        {
+            if (!Varint::read(pos, end, &val))
+                return false;
+        }
+        if (end-*pos < 2)
+            return false;
+        const Block block{(BlockType)(uint8_t)(*pos)[0], (uint8_t)(*pos)[1]};
+        *pos += 2;
+        if (block.type >= BLOCK_TYPE__COUNT)
+            return false;
+        lastPos = {
+            (int)(lastPos.x+Varint::unzigzag(vals[0])),
+            (int)(lastPos.y+Varint::unzigzag(vals[1])),
+            (int)(lastPos.z+Varint::unzigzag(vals[2]))};
+        out->push_back({lastPos, block});
+    }
+    return true;
+}
+
+} // End of namespace NetProtocol
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "World.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Bump when the messages change
+#define NET_PROTOCOL_VERSION 1
+#define NET_DEFAULT_ADDRESS "127.0.0.1:47800"
+// Size and type of each message, followed by its payload
+#define NET_MESSAGE_HEADER_SIZE 5
+// Anything larger is a protocol error, a whole chunk is far smaller
+#define NET_MAX_MESSAGE_SIZE (4*1024*1024)
+
+/*
+ * The payloads are listed after each type. The values are in the byte order of the machine,
+ * the server and the clients run on the same machine.
+ */
+enum NetMessageType : uint8_t
+{
+    // Client to server: protocol version (u32), view distance in chunks (u8)
+    NET_MSG_HELLO,
+    // Client to server: position of the player in blocks (3x f32)
+    NET_MSG_PLAYER_POS,
+    // Client to server: position (3x i32), block type (u8), block state (u8)
+    NET_MSG_SET_BLOCK,
+
+    // Server to client: player ID (u32), ticks per second (u32)
+    NET_MSG_WELCOME,
+    // Server to client: chunk position (2x i32), then the blocks, see `NetProtocol::encodeChunk()`
+    NET_MSG_CHUNK,
+    // Server to client: chunk position (2x i32) of a chunk that went out of the view distance
+    NET_MSG_UNLOAD_CHUNK,
+    // Server to client, every tick: tick index (u64), duration of the previous tick in ms (f32),
+    // then the blocks changed in the chunks of the client, see `NetProtocol::encodeDeltas()`
+    NET_MSG_TICK,
+
+    NET_MSG__COUNT,
+};
+
+namespace NetProtocol
+{
+
+template <typename T>
+inline void write(std::string* out, const T& val)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    out->append((const char*)&val, sizeof(T));
+}
+
+/*
+ * Reads a value and moves `pos` past it. Returns false if the data ends before the value.
+ */
+template <typename T>
+inline bool read(const char** pos, const char* end, T* out)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    if ((size_t)(end-*pos) < sizeof(T))
+        return false;
+    std::memcpy(out, *pos, sizeof(T));
+    *pos += sizeof(T);
+    return true;
+}
+
+/*
+ * Palette-compressed chunk: the mask of the non-empty sections, then for each of them
+ * the distinct blocks of the section and an index into them per block, packed into
+ * as few bits as the palette needs. A section of one block type takes a few bytes.
+ */
+void encodeChunk(const Chunk& chunk, std::string* out);
+/*
+ * `out` has to be empty. Returns false if the data is invalid.
+ */
+bool decodeChunk(const char** pos, const char* end, Chunk* out);
+
+/*
+ * The count, then each edit relative to the previous one, so sort the edits by position.
+ */
+void encodeDeltas(const std::vector<BlockEdit>& edits, std::string* out);
+/*
+ * Appends to `out`. Returns false if the data is invalid.
+ */
+bool decodeDeltas(const char** pos, const char* end, std::vector<BlockEdit>* out);
+
+} // End of namespace NetProtocol
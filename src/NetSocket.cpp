@@ -0,0 +1,265 @@
+#include "NetSocket.h"
+#include "Logger.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#define NET_UNIX_PREFIX "unix:"
+// Bytes read by a `recv()` call
+#define NET_RECV_CHUNK_SIZE (64*1024)
+
+/*
+ * Resolves the address and creates a socket for it, then binds or connects it.
+ * Returns -1 on error.
+ */
+static int openSocket(const std::string& address, bool isListening)
+{
+    auto doBindOrConnect{[&](int fd, const sockaddr* addr, socklen_t addrLen){
+        if (isListening)
+        {
+            const int yes = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+            return bind(fd, addr, addrLen) == 0 && ::listen(fd, SOMAXCONN) == 0;
+        }
+        return ::connect(fd, addr, addrLen) == 0;
+    }};
+
+    if (address.starts_with(NET_UNIX_PREFIX))
+    {
+        const std::string path = address.substr(std::strlen(NET_UNIX_PREFIX));
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        {
+            Logger::err << "Invalid Unix socket path: \"" << path << '"' << Logger::End;
+            return -1;
+        }
+        std::memcpy(addr.sun_path, path.c_str(), path.size()+1);
+        if (isListening)
+            unlink(path.c_str());
+
+        const int fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+        if (fd == -1 || !doBindOrConnect(fd, (const sockaddr*)&addr, sizeof(addr)))
+        {
+            Logger::err << "Failed to " << (isListening ? "listen on" : "connect to") << " \"" << address << "\": "
+                << std::strerror(errno) << Logger::End;
+            if (fd != -1)
+                ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    const size_t colonPos = address.rfind(':');
+    if (colonPos == std::string::npos)
+    {
+        Logger::err << "Invalid address, expected HOST:PORT or unix:PATH: \"" << address << '"' << Logger::End;
+        return -1;
+    }
+    const std::string host = address.substr(0, colonPos);
+    const std::string port = address.substr(colonPos+1);
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = isListening ? AI_PASSIVE : 0;
+    addrinfo* results{};
+    const int error = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &results);
+    if (error)
+    {
+        Logger::err << "Failed to resolve \"" << address << "\": " << gai_strerror(error) << Logger::End;
+        return -1;
+    }
+
+    int fd = -1;
+    for (const addrinfo* result = results; result && fd == -1; result = result->ai_next)
+    {
+        fd = socket(result->ai_family, result->ai_socktype|SOCK_CLOEXEC, result->ai_protocol);
+        if (fd != -1 && !doBindOrConnect(fd, result->ai_addr, result->ai_addrlen))
+        {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(results);
+    if (fd == -1)
+    {
+        Logger::err << "Failed to " << (isListening ? "listen on" : "connect to") << " \"" << address << "\": "
+            << std::strerror(errno) << Logger::End;
+    }
+    return fd;
+}
+
+NetConnection::NetConnection(int fd)
+    : m_fd{fd}
+{
+    fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL)|O_NONBLOCK);
+    // The ticks are small messages, don't wait to merge them. Fails harmlessly on Unix sockets.
+    const int yes = 1;
+    setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+}
+
+std::unique_ptr<NetConnection> NetConnection::connect(const std::string& address)
+{
+    const int fd = openSocket(address, false);
+    if (fd == -1)
+        return nullptr;
+    return std::make_unique<NetConnection>(fd);
+}
+
+void NetConnection::close()
+{
+    if (m_fd != -1)
+        ::close(m_fd);
+    m_fd = -1;
+    m_isClosed = true;
+    m_sendBuffer = {};
+    m_sendOffset = 0;
+}
+
+void NetConnection::send(NetMessageType type, std::string_view payload)
+{
+    if (m_isClosed)
+        return;
+    // Drop the written part once in a while instead of on every write
+    if (m_sendOffset && m_sendOffset == m_sendBuffer.size())
+    {
+        m_sendBuffer.clear();
+        m_sendOffset = 0;
+    }
+    NetProtocol::write(&m_sendBuffer, (uint32_t)payload.size());
+    NetProtocol::write(&m_sendBuffer, type);
+    m_sendBuffer.append(payload);
+}
+
+void NetConnection::flush()
+{
+    while (!m_isClosed && m_sendOffset < m_sendBuffer.size())
+    {
+        const ssize_t sent = ::send(m_fd, m_sendBuffer.data()+m_sendOffset, m_sendBuffer.size()-m_sendOffset,
+                MSG_NOSIGNAL);
+        if (sent == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                close();
+            break;
+        }
+        m_sendOffset += sent;
+        m_sentBytes += sent;
+    }
+    if (m_sendOffset > m_sendBuffer.size()/2)
+    {
+        m_sendBuffer.erase(0, m_sendOffset);
+        m_sendOffset = 0;
+    }
+}
+
+void NetConnection::receive()
+{
+    m_recvBuffer.erase(0, m_recvOffset);
+    m_recvOffset = 0;
+    while (!m_isClosed)
+    {
+        const size_t oldSize = m_recvBuffer.size();
+        m_recvBuffer.resize(oldSize+NET_RECV_CHUNK_SIZE);
+        const ssize_t received = recv(m_fd, m_recvBuffer.data()+oldSize, NET_RECV_CHUNK_SIZE, 0);
+        m_recvBuffer.resize(oldSize+std::max<ssize_t>(received, 0));
+        if (received == 0)
+        {
+            close();
+        }
+        else if (received == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                close();
+            break;
+        }
+        else
+        {
+            m_receivedBytes += received;
+        }
+    }
+}
+
+bool NetConnection::popMessage(NetMessageType* type, std::string_view* payload)
+{
+    const char* pos = m_recvBuffer.data()+m_recvOffset;
+    const char* const end = m_recvBuffer.data()+m_recvBuffer.size();
+    uint32_t size{};
+    uint8_t rawType{};
+    if (!NetProtocol::read(&pos, end, &size) || !NetProtocol::read(&pos, end, &rawType))
+        return false;
+    if (size > NET_MAX_MESSAGE_SIZE || rawType >= NET_MSG__COUNT)
+    {
+        Logger::err << "Invalid message of type " << (int)rawType << ", " << size << " bytes, disconnecting"
+            << Logger::End;
+        close();
+        return false;
+    }
+    if ((size_t)(end-pos) < size)
+        return false;
+
+    *type = (NetMessageType)rawType;
+    *payload = {pos, size};
+    m_recvOffset += NET_MESSAGE_HEADER_SIZE+size;
+    return true;
+}
+
+NetConnection::~NetConnection()
+{
+    close();
+}
+
+bool NetListener::listen(const std::string& address)
+{
+    close();
+    m_fd = openSocket(address, true);
+    if (m_fd == -1)
+        return false;
+    fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL)|O_NONBLOCK);
+    if (address.starts_with(NET_UNIX_PREFIX))
+        m_unixPath = address.substr(std::strlen(NET_UNIX_PREFIX));
+    return true;
+}
+
+std::unique_ptr<NetConnection> NetListener::accept()
+{
+    if (m_fd == -1)
+        return nullptr;
+    const int fd = accept4(m_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd == -1)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            Logger::err << "Failed to accept connection: " << std::strerror(errno) << Logger::End;
+        }
+        return nullptr;
+    }
+    return std::make_unique<NetConnection>(fd);
+}
+
+void NetListener::close()
+{
+    if (m_fd == -1)
+        return;
+    ::close(m_fd);
+    m_fd = -1;
+    if (!m_unixPath.empty())
+        unlink(m_unixPath.c_str());
+    m_unixPath.clear();
+}
+
+NetListener::~NetListener()
+{
+    close();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "NetProtocol.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/*
+ * A non-blocking stream socket, TCP or Unix, carrying framed messages.
+ *
+ * `send()` queues the messages and `flush()` writes as much as the socket takes,
+ * `receive()` reads what arrived and `popMessage()` splits it, so a slow peer never
+ * blocks the caller. The addresses are "HOST:PORT" or "unix:PATH".
+ */
+class NetConnection final
+{
+private:
+    int m_fd{-1};
+    bool m_isClosed{};
+    std::string m_sendBuffer;
+    // Already written part of `m_sendBuffer`
+    size_t m_sendOffset{};
+    std::string m_recvBuffer;
+    // Already popped part of `m_recvBuffer`
+    size_t m_recvOffset{};
+    uint64_t m_sentBytes{};
+    uint64_t m_receivedBytes{};
+
+public:
+    /*
+     * Takes over a connected socket.
+     */
+    explicit NetConnection(int fd);
+
+    NetConnection(const NetConnection&) = delete;
+    NetConnection& operator=(const NetConnection&) = delete;
+    NetConnection(NetConnection&&) = delete;
+    NetConnection& operator=(NetConnection&&) = delete;
+
+    /*
+     * Blocks until connected. Returns null on error.
+     */
+    static std::unique_ptr<NetConnection> connect(const std::string& address);
+
+    void send(NetMessageType type, std::string_view payload);
+    void flush();
+    void receive();
+    /*
+     * Returns false if no whole message is left. The payload is valid until the next `receive()`.
+     * Closes the connection on a malformed message.
+     */
+    bool popMessage(NetMessageType* type, std::string_view* payload);
+    /*
+     * Drops the queued messages, `isClosed()` is true from now on.
+     */
+    void close();
+
+    /*
+     * Closed by the peer or because of an error.
+     */
+    inline bool isClosed() const { return m_isClosed; }
+    // Queued, but not written yet
+    inline size_t getQueuedBytes() const { return m_sendBuffer.size()-m_sendOffset; }
+    inline uint64_t getSentBytes() const { return m_sentBytes; }
+    inline uint64_t getReceivedBytes() const { return m_receivedBytes; }
+
+    ~NetConnection();
+};
+
+/*
+ * Accepts connections without blocking.
+ */
+class NetListener final
+{
+private:
+    int m_fd{-1};
+    // Removed when closed
+    std::string m_unixPath;
+
+public:
+    NetListener() = default;
+
+    NetListener(const NetListener&) = delete;
+    NetListener& operator=(const NetListener&) = delete;
+    NetListener(NetListener&&) = delete;
+    NetListener& operator=(NetListener&&) = delete;
+
+    /*
+     * Returns false on error.
+     */
+    bool listen(const std::string& address);
+    /*
+     * Returns null if nobody is waiting.
+     */
+    std::unique_ptr<NetConnection> accept();
+    void close();
+
+    ~NetListener();
+};
@@ -0,0 +1,198 @@
+#include "Profiler.h"
+
+#ifdef ACRAFT_PROFILER
+
+#include "Logger.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdio>
+#include <ctime>
+
+namespace Profiler
+{
+
+// Atomic, because `stopCapture()` reads the rings while their threads may still write them
+struct ZoneEvent
+{
+    std::atomic<const char*> name{};
+    std::atomic<int64_t> startNs{};
+    std::atomic<int64_t> endNs{};
+};
+
+/*
+ * Written only by its owner thread, read by `stopCapture()`.
+ * The zones that started before the stop are still recorded when they end,
+ * so the reader skips the slots that the writer reached again while it read them.
+ */
+struct ThreadBuffer
+{
+    std::array<ZoneEvent, PROFILER_RING_SIZE> events{};
+    // Total number of events written, the ring index is this modulo the size
+    std::atomic<uint64_t> writtenCount{};
+    int threadId{};
+    std::atomic<const char*> threadName{};
+};
+
+static std::atomic<bool> s_isCapturing{};
+static int64_t s_captureStartNs{};
+
+// Buffers live until exit, so the events of finished threads can still be dumped
+static std::mutex s_buffersMutex;
+static std::vector<std::unique_ptr<ThreadBuffer>> s_buffers;
+
+static ThreadBuffer* createBuffer()
+{
+    std::lock_guard<std::mutex> guard{s_buffersMutex};
+    s_buffers.push_back(std::make_unique<ThreadBuffer>());
+    s_buffers.back()->threadId = s_buffers.size();
+    return s_buffers.back().get();
+}
+
+static ThreadBuffer& getThreadBuffer()
+{
+    thread_local ThreadBuffer* buffer = createBuffer();
+    return *buffer;
+}
+
+static ThreadBuffer& getGpuBuffer()
+{
+    static ThreadBuffer* buffer = []{
+        ThreadBuffer* buff = createBuffer();
+        buff->threadName = "GPU";
+        return buff;
+    }();
+    return *buffer;
+}
+
+int64_t getTimeNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool isCapturing()
+{
+    return s_isCapturing.load(std::memory_order_relaxed);
+}
+
+void startCapture()
+{
+    if (isCapturing())
+        return;
+
+    s_captureStartNs = getTimeNs();
+    s_isCapturing.store(true, std::memory_order_relaxed);
+    Logger::log << "Started profiler capture" << Logger::End;
+}
+
+static void writeChromeTrace(std::FILE* file, int64_t captureEndNs)
+{
+    std::fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    bool isFirst = true;
+    auto writeSeparator{[&](){
+        if (!isFirst)
+            std::fprintf(file, ",\n");
+        isFirst = false;
+    }};
+
+    std::lock_guard<std::mutex> guard{s_buffersMutex};
+    for (const auto& buffer : s_buffers)
+    {
+        const char* threadName = buffer->threadName.load(std::memory_order_relaxed);
+        if (threadName)
+        {
+            writeSeparator();
+            std::fprintf(file, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                    buffer->threadId, threadName);
+        }
+
+        const uint64_t writtenCount = buffer->writtenCount.load(std::memory_order_acquire);
+        const uint64_t firstI = writtenCount > PROFILER_RING_SIZE ? writtenCount-PROFILER_RING_SIZE : 0;
+        for (uint64_t i{firstI}; i < writtenCount; ++i)
+        {
+            const ZoneEvent& event = buffer->events[i%PROFILER_RING_SIZE];
+            const char* name = event.name.load(std::memory_order_relaxed);
+            const int64_t startNs = event.startNs.load(std::memory_order_relaxed);
+            const int64_t endNs = event.endNs.load(std::memory_order_relaxed);
+            // Pairs with the fence in `writeZone()`: if we read any part of a newer event,
+            // we see the count from before it was written, and the slot is skipped
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (buffer->writtenCount.load(std::memory_order_relaxed) >= i+PROFILER_RING_SIZE)
+                continue;
+            if (startNs < s_captureStartNs || endNs > captureEndNs)
+                continue;
+
+            writeSeparator();
+            // Timestamps are in microseconds
+            std::fprintf(file, "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                    name, buffer->threadId,
+                    (startNs-s_captureStartNs)/1000.0, (endNs-startNs)/1000.0);
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+}
+
+void stopCapture()
+{
+    if (!isCapturing())
+        return;
+
+    s_isCapturing.store(false, std::memory_order_relaxed);
+    const int64_t captureEndNs = getTimeNs();
+
+    char path[64]{};
+    std::snprintf(path, sizeof(path), "trace_%ld.json", (long)std::time(nullptr));
+    std::FILE* file = std::fopen(path, "w");
+    if (!file)
+    {
+        Logger::err << "Failed to open trace output file: " << path << Logger::End;
+        return;
+    }
+    writeChromeTrace(file, captureEndNs);
+    std::fclose(file);
+
+    Logger::log << "Stopped profiler capture (" << (captureEndNs-s_captureStartNs)/1'000'000 << "ms), wrote " << path << Logger::End;
+}
+
+void toggleCapture()
+{
+    if (isCapturing())
+        stopCapture();
+    else
+        startCapture();
+}
+
+void setThreadName(const char* name)
+{
+    getThreadBuffer().threadName.store(name, std::memory_order_relaxed);
+}
+
+static void writeZone(ThreadBuffer& buffer, const char* name, int64_t startNs, int64_t endNs)
+{
+    const uint64_t writtenCount = buffer.writtenCount.load(std::memory_order_relaxed);
+    // Keeps the slot writes after the previous count store, see `writeChromeTrace()`
+    std::atomic_thread_fence(std::memory_order_release);
+    ZoneEvent& event = buffer.events[writtenCount%PROFILER_RING_SIZE];
+    event.name.store(name, std::memory_order_relaxed);
+    event.startNs.store(startNs, std::memory_order_relaxed);
+    event.endNs.store(endNs, std::memory_order_relaxed);
+    buffer.writtenCount.store(writtenCount+1, std::memory_order_release);
+}
+
+void recordZone(const char* name, int64_t startNs, int64_t endNs)
+{
+    writeZone(getThreadBuffer(), name, startNs, endNs);
+}
+
+void recordGpuZone(const char* name, int64_t startNs, int64_t endNs)
+{
+    writeZone(getGpuBuffer(), name, startNs, endNs);
+}
+
+} // End of namespace Profiler
+
+#endif // ACRAFT_PROFILER
@@ -0,0 +1,88 @@
+#pragma once
+
+/*
+ * Scoped CPU profiler.
+ *
+ * Zones are recorded into per-thread ring buffers while a capture is running
+ * and dumped in the Chrome Trace Event format when it is stopped.
+ * Open the output in chrome://tracing or https://ui.perfetto.dev.
+ *
+ * When `ACRAFT_PROFILER` is not defined, the macros compile to nothing.
+ */
+
+#ifdef ACRAFT_PROFILER
+
+#include <cstdint>
+
+namespace Profiler
+{
+
+// Zone events kept per thread, older ones are overwritten
+#define PROFILER_RING_SIZE (1<<16)
+
+int64_t getTimeNs();
+
+bool isCapturing();
+void startCapture();
+/*
+ * Stops capturing and writes the captured zones to `trace_<time>.json`.
+ */
+void stopCapture();
+void toggleCapture();
+
+/*
+ * Names the calling thread in the trace. `name` must be a string literal.
+ */
+void setThreadName(const char* name);
+
+/*
+ * Records a finished zone on the calling thread. `name` must be a string literal.
+ */
+void recordZone(const char* name, int64_t startNs, int64_t endNs);
+
+/*
+ * Records a zone on the "GPU" track. Only call it from the GL thread.
+ */
+void recordGpuZone(const char* name, int64_t startNs, int64_t endNs);
+
+class ScopedZone final
+{
+private:
+    const char* m_name;
+    int64_t m_startNs;
+
+public:
+    explicit ScopedZone(const char* name)
+        : m_name{name}, m_startNs{isCapturing() ? getTimeNs() : -1}
+    {
+    }
+
+    ScopedZone(const ScopedZone&) = delete;
+    ScopedZone& operator=(const ScopedZone&) = delete;
+    ScopedZone(ScopedZone&&) = delete;
+    ScopedZone& operator=(ScopedZone&&) = delete;
+
+    ~ScopedZone()
+    {
+        if (m_startNs != -1)
+            recordZone(m_name, m_startNs, getTimeNs());
+    }
+};
+
+} // End of namespace Profiler
+
+#define _PROFILER_CONCAT_IMPL(a, b) a##b
+#define _PROFILER_CONCAT(a, b) _PROFILER_CONCAT_IMPL(a, b)
+
+/*
+ * Profiles the rest of the enclosing scope. `name` must be a string literal.
+ */
+#define PROFILE_ZONE(name) const Profiler::ScopedZone _PROFILER_CONCAT(_profilerZone, __LINE__){name}
+#define PROFILE_THREAD_NAME(name) Profiler::setThreadName(name)
+
+#else // ACRAFT_PROFILER
+
+#define PROFILE_ZONE(name) static_cast<void>(0)
+#define PROFILE_THREAD_NAME(name) static_cast<void>(0)
+
+#endif // ACRAFT_PROFILER
@@ -0,0 +1,141 @@
+#include "Raycast.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Raycast
+{
+
+// The face a block is entered through, indexed by axis and `step > 0`
+static constexpr BlockFace entryFaces[3][2]{
+    {BLOCK_FACE_RIGHT, BLOCK_FACE_LEFT},
+    {BLOCK_FACE_TOP, BLOCK_FACE_BOTTOM},
+    {BLOCK_FACE_FRONT, BLOCK_FACE_BACK},
+};
+
+glm::vec3 renderToBlockCoords(const glm::vec3& pos)
+{
+    // Blocks are 2 units wide and centered on twice their position
+    return {(pos.x+1.0f)/2.0f, (pos.y+1.0f)/2.0f, (pos.z+1.0f)/2.0f};
+}
+
+RayHit castRay(const World& world, const Ray& ray)
+{
+    const float origin[3]{ray.origin.x, ray.origin.y, ray.origin.z};
+    float dir[3]{ray.dir.x, ray.dir.y, ray.dir.z};
+    const float dirLen = std::sqrt(dir[0]*dir[0]+dir[1]*dir[1]+dir[2]*dir[2]);
+    if (dirLen == 0)
+        return {};
+    for (float& val : dir)
+        val /= dirLen;
+
+    int cell[3]{};
+    int step[3]{};
+    // Distance along the ray between two boundaries of the axis
+    float tDelta[3]{};
+    // Distance along the ray to the next boundary of the axis
+    float tMax[3]{};
+    for (int i{}; i < 3; ++i)
+    {
+        cell[i] = (int)std::floor(origin[i]);
+        if (dir[i] == 0)
+        {
+            tDelta[i] = std::numeric_limits<float>::infinity();
+            tMax[i] = std::numeric_limits<float>::infinity();
+            continue;
+        }
+        step[i] = dir[i] > 0 ? 1 : -1;
+        tDelta[i] = std::abs(1.0f/dir[i]);
+        tMax[i] = ((dir[i] > 0 ? cell[i]+1 : cell[i])-origin[i])/dir[i];
+    }
+
+    const Chunk* chunk{};
+    float t{};
+    int lastAxis = -1;
+    BlockPos prevPos{cell[0], cell[1], cell[2]};
+    while (true)
+    {
+        const int chunkX = World::blockToChunkCoord(cell[0]);
+        const int chunkZ = World::blockToChunkCoord(cell[2]);
+        if (!chunk || chunk->getChunkX() != chunkX || chunk->getChunkZ() != chunkZ)
+        {
+            // The ray usually moves to a neighbour of the last chunk
+            const int dx = chunk ? chunkX-chunk->getChunkX() : 2;
+            const int dz = chunk ? chunkZ-chunk->getChunkZ() : 2;
+            const Chunk* neighbour = (std::abs(dx) <= 1 && std::abs(dz) <= 1) ? chunk->getNeighbour(dx, dz) : nullptr;
+            chunk = neighbour ? neighbour : world.getChunk(chunkX, chunkZ);
+        }
+
+        const bool isInHeightRange = cell[1] >= 0 && cell[1] < CHUNK_HEIGHT_BLOCKS;
+        const ChunkSection* section = (chunk && isInHeightRange) ? chunk->getSection(cell[1]/CHUNK_SECTION_HEIGHT) : nullptr;
+        if (section)
+        {
+            const Block block = section->blocks[ChunkSection::getIndex(
+                    World::blockToLocalCoord(cell[0]), cell[1]%CHUNK_SECTION_HEIGHT, World::blockToLocalCoord(cell[2]))];
+            if (BlockRegistry::isSolid(block.type))
+            {
+                RayHit hit;
+                hit.isHit = true;
+                hit.pos = {cell[0], cell[1], cell[2]};
+                hit.block = block;
+                hit.face = lastAxis == -1 ? BLOCK_FACE__COUNT : entryFaces[lastAxis][step[lastAxis] > 0];
+                hit.prevPos = prevPos;
+                hit.distance = t;
+                return hit;
+            }
+        }
+        else
+        {
+            // Nothing to hit in this 16^3 box (empty section, unloaded chunk or outside the world),
+            // so jump to the last cell of the ray inside it
+            int cellsToEdge[3]{};
+            float tExit = std::numeric_limits<float>::infinity();
+            for (int i{}; i < 3; ++i)
+            {
+                if (step[i] == 0)
+                    continue;
+                const int boxMin = cell[i] & ~(CHUNK_SECTION_HEIGHT-1);
+                cellsToEdge[i] = step[i] > 0 ? boxMin+CHUNK_SECTION_HEIGHT-1-cell[i] : cell[i]-boxMin;
+                tExit = std::min(tExit, tMax[i]+cellsToEdge[i]*tDelta[i]);
+            }
+            if (tExit > ray.maxDist)
+                return {};
+
+            for (int i{}; i < 3; ++i)
+            {
+                if (step[i] == 0 || tMax[i] >= tExit)
+                    continue;
+                // The boundaries crossed before leaving the box, the rounding can't take us out of it
+                const int crossCount = std::min(cellsToEdge[i], (int)std::ceil((tExit-tMax[i])/tDelta[i]));
+                cell[i] += step[i]*crossCount;
+                tMax[i] += tDelta[i]*crossCount;
+            }
+        }
+
+        const int axis = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+        t = tMax[axis];
+        if (t > ray.maxDist)
+            return {};
+        prevPos = {cell[0], cell[1], cell[2]};
+        cell[axis] += step[axis];
+        tMax[axis] += tDelta[axis];
+        lastAxis = axis;
+    }
+}
+
+void castRays(const World& world, const std::vector<Ray>& rays, std::vector<RayHit>* out, ThreadPool* pool)
+{
+    PROFILE_ZONE("Raycast::castRays");
+
+    out->resize(rays.size());
+    const int batchCount = (rays.size()+RAYCAST_BATCH_SIZE-1)/RAYCAST_BATCH_SIZE;
+    (pool ? *pool : ThreadPool::getShared()).parallelFor(batchCount, [&](int batchI){
+        const size_t end = std::min(rays.size(), (size_t)(batchI+1)*RAYCAST_BATCH_SIZE);
+        for (size_t i = (size_t)batchI*RAYCAST_BATCH_SIZE; i < end; ++i)
+            (*out)[i] = castRay(world, rays[i]);
+    });
+}
+
+} // End of namespace Raycast
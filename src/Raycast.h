@@ -0,0 +1,62 @@
+#pragma once
+
+#include "World.h"
+#include <glm/vec3.hpp>
+#include <vector>
+
+// Default reach of the camera, in blocks
+#define RAYCAST_PICK_DISTANCE 8.0f
+// Rays per task in `castRays()`
+#define RAYCAST_BATCH_SIZE 64
+
+class ThreadPool;
+
+/*
+ * In block units, where the block (x, y, z) fills [x, x+1) on each axis.
+ */
+struct Ray
+{
+    glm::vec3 origin{};
+    // Doesn't need to be normalized
+    glm::vec3 dir{};
+    float maxDist{};
+};
+
+struct RayHit
+{
+    bool isHit{};
+    BlockPos pos{};
+    Block block{};
+    // The face the ray entered through,
+    // `BLOCK_FACE__COUNT` if the ray started inside the block
+    BlockFace face{BLOCK_FACE__COUNT};
+    // The cell before the hit one, where a placed block would go
+    BlockPos prevPos{};
+    // From the origin to the entry point, in blocks
+    float distance{};
+};
+
+namespace Raycast
+{
+
+/*
+ * Converts the camera position to block units, see `Ray`.
+ */
+glm::vec3 renderToBlockCoords(const glm::vec3& pos);
+
+/*
+ * Walks the blocks along the ray (Amanatides-Woo DDA) until it reaches a solid one
+ * or `maxDist`. Sections that are all air and unloaded chunks are crossed in one step.
+ *
+ * Only reads the world, so any number of threads can cast at the same time,
+ * as long as the world isn't modified meanwhile.
+ */
+RayHit castRay(const World& world, const Ray& ray);
+
+/*
+ * Casts the rays on `pool`, or the shared pool if null.
+ * `out` gets the results in the same order.
+ */
+void castRays(const World& world, const std::vector<Ray>& rays, std::vector<RayHit>* out, ThreadPool* pool=nullptr);
+
+} // End of namespace Raycast
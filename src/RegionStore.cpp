@@ -0,0 +1,232 @@
+#include "RegionStore.h"
+#include "MappedFile.h"
+#include "Varint.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <utility>
+
+static inline int chunkToRegionCoord(int chunkCoord) { return chunkCoord >> 5; }
+static inline int getEntryIndex(int chunkX, int chunkZ)
+{
+    return (chunkZ & (REGION_WIDTH_CHUNKS-1))*REGION_WIDTH_CHUNKS+(chunkX & (REGION_WIDTH_CHUNKS-1));
+}
+static_assert(REGION_WIDTH_CHUNKS == 1 << 5);
+
+static constexpr size_t tableOffset = sizeof(RegionFileHeader);
+static constexpr size_t dataOffset = tableOffset+REGION_CHUNK_COUNT*sizeof(RegionChunkEntry);
+
+/*
+ * Returns false if the file isn't a valid region file.
+ */
+static bool readTable(const MappedFile& file, std::array<RegionChunkEntry, REGION_CHUNK_COUNT>* out)
+{
+    if (file.size() < dataOffset)
+        return false;
+    RegionFileHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, REGION_MAGIC, 4) != 0 || header.version != REGION_VERSION)
+        return false;
+
+    std::memcpy(out->data(), file.data()+tableOffset, REGION_CHUNK_COUNT*sizeof(RegionChunkEntry));
+    for (const RegionChunkEntry& entry : *out)
+    {
+        if (entry.size && (entry.offset < dataOffset || entry.offset+entry.size > file.size()))
+            return false;
+    }
+    return true;
+}
+
+bool RegionStore::open(const std::string& dirPath)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(dirPath, ec);
+    if (ec)
+    {
+        Logger::err << "Failed to create region directory: \"" << dirPath << "\": " << ec.message() << Logger::End;
+        return false;
+    }
+    m_dirPath = dirPath;
+    return true;
+}
+
+std::string RegionStore::getRegionPath(int regionX, int regionZ) const
+{
+    char name[64]{};
+    std::snprintf(name, sizeof(name), "r.%d.%d.bin", regionX, regionZ);
+    return m_dirPath+'/'+name;
+}
+
+void RegionStore::encodeChunk(const ChunkSnapshot& chunk, std::string* out)
+{
+    uint32_t sectionMask{};
+    for (int i{}; i < CHUNK_SECTION_COUNT; ++i)
+    {
+        if (chunk.sections[i])
+            sectionMask |= 1u << i;
+    }
+    Varint::write(out, sectionMask);
+
+    for (int i{}; i < CHUNK_SECTION_COUNT; ++i)
+    {
+        const ChunkSection* section = chunk.sections[i].get();
+        if (!section)
+            continue;
+        // Runs of the same block: the length, then the block
+        const auto& blocks = section->blocks;
+        for (size_t runBegin{}; runBegin < blocks.size();)
+        {
+            const Block block = blocks[runBegin];
+            size_t runEnd = runBegin+1;
+            while (runEnd < blocks.size() && blocks[runEnd].type == block.type && blocks[runEnd].state == block.state)
+                ++runEnd;
+            Varint::write(out, runEnd-runBegin);
+            out->push_back((char)block.type);
+            out->push_back((char)block.state);
+            runBegin = runEnd;
+        }
+    }
+}
+
+bool RegionStore::decodeChunk(std::string_view data, Chunk* out)
+{
+    const char* pos = data.data();
+    const char* const end = pos+data.size();
+    uint64_t sectionMask{};
+    if (!Varint::read(&pos, end, &sectionMask) || sectionMask > CHUNK_ALL_SECTIONS_MASK)
+        return false;
+
+    for (int i{}; i < CHUNK_SECTION_COUNT; ++i)
+    {
+        if (!(sectionMask & (1u << i)))
+            continue;
+        ChunkSection& section = out->getOrCreateSection(i);
+        size_t blockI{};
+        while (blockI < section.blocks.size())
+        {
+            uint64_t runLength{};
+            if (!Varint::read(&pos, end, &runLength) || runLength == 0
+             || runLength > section.blocks.size()-blockI || end-pos < 2)
+            {
+                out->onSectionWritten(i);
+                return false;
+            }
+            const Block block{(BlockType)(uint8_t)pos[0], (uint8_t)pos[1]};
+            pos += 2;
+            if (block.type >= BLOCK_TYPE__COUNT)
+            {
+                out->onSectionWritten(i);
+                return false;
+            }
+
+            std::fill_n(section.blocks.begin()+blockI, runLength, block);
+            if (block.type != BLOCK_TYPE_AIR)
+                section.nonAirCount += runLength;
+            if (BlockRegistry::isRandomTicked(block.type))
+                section.randomTickedCount += runLength;
+            blockI += runLength;
+        }
+        out->onSectionWritten(i);
+    }
+    return pos == end;
+}
+
+std::unique_ptr<Chunk> RegionStore::loadChunk(int chunkX, int chunkZ) const
+{
+    PROFILE_ZONE("RegionStore::loadChunk");
+    const std::string path = getRegionPath(chunkToRegionCoord(chunkX), chunkToRegionCoord(chunkZ));
+    MappedFile file;
+    if (!file.open(path))
+        return nullptr;
+
+    std::array<RegionChunkEntry, REGION_CHUNK_COUNT> table;
+    if (!readTable(file, &table))
+    {
+        Logger::err << "Invalid or outdated region file: \"" << path << '"' << Logger::End;
+        return nullptr;
+    }
+    const RegionChunkEntry& entry = table[getEntryIndex(chunkX, chunkZ)];
+    if (!entry.size)
+        return nullptr;
+
+    auto chunk = std::make_unique<Chunk>(chunkX, chunkZ);
+    if (!decodeChunk(file.view().substr(entry.offset, entry.size), chunk.get()))
+    {
+        Logger::err << "Invalid chunk " << chunkX << ", " << chunkZ << " in region file: \"" << path << '"' << Logger::End;
+        return nullptr;
+    }
+    // Same as on the disk
+    chunk->takeDirtySections(CHUNK_CACHE_SAVE);
+    return chunk;
+}
+
+bool RegionStore::saveChunks(const std::vector<ChunkSnapshot>& chunks) const
+{
+    PROFILE_ZONE("RegionStore::saveChunks");
+    std::map<std::pair<int, int>, std::vector<const ChunkSnapshot*>> regions;
+    for (const ChunkSnapshot& chunk : chunks)
+        regions[{chunkToRegionCoord(chunk.chunkX), chunkToRegionCoord(chunk.chunkZ)}].push_back(&chunk);
+
+    bool isOk = true;
+    std::string encoded;
+    std::string fileData;
+    for (const auto& [regionCoords, regionChunks] : regions)
+    {
+        const std::string path = getRegionPath(regionCoords.first, regionCoords.second);
+
+        // The chunks we don't save are copied from the old file
+        MappedFile oldFile;
+        std::array<RegionChunkEntry, REGION_CHUNK_COUNT> oldTable{};
+        if (oldFile.open(path) && !readTable(oldFile, &oldTable))
+        {
+            Logger::err << "Replacing invalid or outdated region file: \"" << path << '"' << Logger::End;
+            oldTable = {};
+        }
+        std::array<std::string_view, REGION_CHUNK_COUNT> chunkData;
+        for (int i{}; i < REGION_CHUNK_COUNT; ++i)
+        {
+            if (oldTable[i].size)
+                chunkData[i] = oldFile.view().substr(oldTable[i].offset, oldTable[i].size);
+        }
+
+        encoded.clear();
+        std::vector<std::pair<int, size_t>> newChunks;
+        for (const ChunkSnapshot* chunk : regionChunks)
+        {
+            const size_t begin = encoded.size();
+            encodeChunk(*chunk, &encoded);
+            newChunks.push_back({getEntryIndex(chunk->chunkX, chunk->chunkZ), begin});
+        }
+        for (size_t i{}; i < newChunks.size(); ++i)
+        {
+            const size_t end = i+1 < newChunks.size() ? newChunks[i+1].second : encoded.size();
+            chunkData[newChunks[i].first] = std::string_view{encoded}.substr(newChunks[i].second, end-newChunks[i].second);
+        }
+
+        RegionFileHeader header;
+        std::memcpy(header.magic, REGION_MAGIC, 4);
+        header.version = REGION_VERSION;
+        std::array<RegionChunkEntry, REGION_CHUNK_COUNT> table{};
+        size_t offset = dataOffset;
+        for (int i{}; i < REGION_CHUNK_COUNT; ++i)
+        {
+            table[i] = {offset, (uint32_t)chunkData[i].size(), 0};
+            offset += chunkData[i].size();
+        }
+
+        fileData.clear();
+        fileData.reserve(offset);
+        fileData.append((const char*)&header, sizeof(header));
+        fileData.append((const char*)table.data(), sizeof(table));
+        for (const std::string_view data : chunkData)
+            fileData.append(data);
+        oldFile.close();
+        isOk = writeFileAtomically(path, fileData) && isOk;
+    }
+    return isOk;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Chunk.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define REGION_WIDTH_CHUNKS 32
+#define REGION_CHUNK_COUNT (REGION_WIDTH_CHUNKS*REGION_WIDTH_CHUNKS)
+#define REGION_MAGIC "ACRG"
+// Bump when the layout of the files or of the chunks changes
+#define REGION_VERSION 1
+
+struct RegionFileHeader
+{
+    char magic[4]{};
+    uint32_t version{};
+};
+
+// The header is followed by a table of these, indexed by `localZ*REGION_WIDTH_CHUNKS+localX`
+struct RegionChunkEntry
+{
+    // From the beginning of the file
+    uint64_t offset{};
+    // 0 if the chunk isn't saved
+    uint32_t size{};
+    uint32_t _reserved{};
+};
+
+/*
+ * Chunks saved in region files of 32x32 chunks in a directory.
+ *
+ * A saved chunk is the mask of its non-empty sections, then the blocks of each of them,
+ * run-length encoded. The light isn't saved, it's recalculated after loading.
+ * The files are replaced atomically, a crash leaves either the old or the new one.
+ */
+class RegionStore final
+{
+private:
+    std::string m_dirPath;
+
+    std::string getRegionPath(int regionX, int regionZ) const;
+
+public:
+    /*
+     * Creates the directory if needed. Returns false on error.
+     */
+    bool open(const std::string& dirPath);
+
+    /*
+     * Returns null if the chunk was never saved. Its `CHUNK_CACHE_SAVE` is clean.
+     */
+    std::unique_ptr<Chunk> loadChunk(int chunkX, int chunkZ) const;
+    /*
+     * Writes the chunks into their region files, keeping the other chunks of the files.
+     * Returns false if any of the files couldn't be written. Safe to call on any thread.
+     */
+    bool saveChunks(const std::vector<ChunkSnapshot>& chunks) const;
+
+    static void encodeChunk(const ChunkSnapshot& chunk, std::string* out);
+    /*
+     * `out` has to be empty. Returns false if the data is invalid.
+     */
+    static bool decodeChunk(std::string_view data, Chunk* out);
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "types.h"
+#include <vector>
+
+/*
+ * Draw commands recorded without touching the graphics API, so any thread
+ * can record them. The objects are referred to by the backend's ids.
+ */
+enum RenderCommandType
+{
+    RENDER_CMD_USE_PROGRAM,
+    RENDER_CMD_BIND_TEXTURE_ARRAY,
+    RENDER_CMD_BIND_MESH,
+    // Indexed triangles of the bound mesh
+    RENDER_CMD_DRAW_TRIANGLES,
+};
+
+struct RenderCommand
+{
+    RenderCommandType type{};
+    // The object id, or the first index when drawing
+    uint arg0{};
+    // The index count when drawing
+    uint arg1{};
+};
+
+/*
+ * A list of commands recorded by one thread, executed by the render thread.
+ * Clearing keeps the memory, so the buffers are meant to be reused every frame.
+ */
+class RenderCommandBuffer final
+{
+private:
+    std::vector<RenderCommand> m_commands;
+    uint m_drawCount{};
+
+public:
+    inline void clear()
+    {
+        m_commands.clear();
+        m_drawCount = 0;
+    }
+
+    inline void useProgram(uint progId) { m_commands.push_back({RENDER_CMD_USE_PROGRAM, progId}); }
+    inline void bindTextureArray(uint texId) { m_commands.push_back({RENDER_CMD_BIND_TEXTURE_ARRAY, texId}); }
+    inline void bindMesh(uint meshId) { m_commands.push_back({RENDER_CMD_BIND_MESH, meshId}); }
+    inline void drawTriangles(uint firstIndex, uint indexCount)
+    {
+        m_commands.push_back({RENDER_CMD_DRAW_TRIANGLES, firstIndex, indexCount});
+        ++m_drawCount;
+    }
+
+    inline const std::vector<RenderCommand>& getCommands() const { return m_commands; }
+    inline uint getDrawCount() const { return m_drawCount; }
+};
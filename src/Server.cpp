@@ -0,0 +1,451 @@
+#include "Server.h"
+#include "WorldGen.h"
+#include "ThreadPool.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <tuple>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr Clock::duration tickDuration = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>{1.0/SERVER_TICKS_PER_SEC});
+
+static inline int getDistanceSq(int dx, int dz) { return dx*dx+dz*dz; }
+
+Server::Server(uint64_t seed)
+    : m_tickScheduler{&m_world, &ThreadPool::getShared(), seed},
+      m_fluidSim{&m_world, &ThreadPool::getShared()}
+{
+    for (int dz = -SERVER_MAX_VIEW_DISTANCE; dz <= SERVER_MAX_VIEW_DISTANCE; ++dz)
+    {
+        for (int dx = -SERVER_MAX_VIEW_DISTANCE; dx <= SERVER_MAX_VIEW_DISTANCE; ++dx)
+        {
+            if (getDistanceSq(dx, dz) <= SERVER_MAX_VIEW_DISTANCE*SERVER_MAX_VIEW_DISTANCE)
+                m_chunkOrder.push_back({dx, dz});
+        }
+    }
+    std::stable_sort(m_chunkOrder.begin(), m_chunkOrder.end(), [](const auto& a, const auto& b){
+        return getDistanceSq(a.first, a.second) < getDistanceSq(b.first, b.second);
+    });
+}
+
+bool Server::listen(const std::string& address)
+{
+    if (!m_listener.listen(address))
+        return false;
+    Logger::log << "Listening on " << address << Logger::End;
+    return true;
+}
+
+void Server::acceptPlayers()
+{
+    while (std::unique_ptr<NetConnection> connection = m_listener.accept())
+    {
+        auto player = std::make_unique<ServerPlayer>();
+        player->id = m_nextPlayerId++;
+        player->connection = std::move(connection);
+        Logger::log << "Player " << player->id << " connected" << Logger::End;
+        m_players.push_back(std::move(player));
+    }
+}
+
+bool Server::handleMessages(ServerPlayer* player)
+{
+    NetConnection& connection = *player->connection;
+    connection.receive();
+
+    NetMessageType type{};
+    std::string_view payload;
+    while (connection.popMessage(&type, &payload))
+    {
+        const char* pos = payload.data();
+        const char* const end = pos+payload.size();
+        switch (type)
+        {
+        case NET_MSG_HELLO:
+        {
+            uint32_t version{};
+            uint8_t viewDistance{};
+            if (!NetProtocol::read(&pos, end, &version) || !NetProtocol::read(&pos, end, &viewDistance))
+                return false;
+            if (version != NET_PROTOCOL_VERSION)
+            {
+                Logger::warn << "Player " << player->id << " has protocol version " << version
+                    << ", expected " << NET_PROTOCOL_VERSION << Logger::End;
+                return false;
+            }
+            player->viewDistance = std::clamp<int>(viewDistance, 1, SERVER_MAX_VIEW_DISTANCE);
+
+            m_message.clear();
+            NetProtocol::write(&m_message, player->id);
+            NetProtocol::write(&m_message, (uint32_t)SERVER_TICKS_PER_SEC);
+            connection.send(NET_MSG_WELCOME, m_message);
+            break;
+        }
+
+        case NET_MSG_PLAYER_POS:
+        {
+            glm::vec3 playerPos{};
+            if (!NetProtocol::read(&pos, end, &playerPos.x) || !NetProtocol::read(&pos, end, &playerPos.y)
+             || !NetProtocol::read(&pos, end, &playerPos.z))
+                return false;
+            if (!std::isfinite(playerPos.x) || !std::isfinite(playerPos.y) || !std::isfinite(playerPos.z))
+                return false;
+            player->pos = playerPos;
+            break;
+        }
+
+        case NET_MSG_SET_BLOCK:
+        {
+            BlockPos blockPos;
+            uint8_t blockType{};
+            uint8_t blockState{};
+            if (!NetProtocol::read(&pos, end, &blockPos.x) || !NetProtocol::read(&pos, end, &blockPos.y)
+             || !NetProtocol::read(&pos, end, &blockPos.z) || !NetProtocol::read(&pos, end, &blockType)
+             || !NetProtocol::read(&pos, end, &blockState) || blockType >= BLOCK_TYPE__COUNT)
+                return false;
+            // Only in the chunks the player has, the others may be far away or not generated
+            const uint64_t chunkKey = World::getChunkKey(
+                    World::blockToChunkCoord(blockPos.x), World::blockToChunkCoord(blockPos.z));
+            if (player->sentChunks.contains(chunkKey)
+             && m_world.setBlock(blockPos.x, blockPos.y, blockPos.z, {(BlockType)blockType, blockState}))
+                onBlockChanged(blockPos);
+            break;
+        }
+
+        default:
+            Logger::warn << "Player " << player->id << " sent unexpected message type " << (int)type << Logger::End;
+            return false;
+        }
+    }
+    return true;
+}
+
+void Server::onBlockChanged(BlockPos pos)
+{
+    m_tickScheduler.onBlockChanged(pos);
+    m_fluidSim.onBlockChanged(pos);
+    m_changedPositions.push_back(pos);
+}
+
+int Server::loadChunks()
+{
+    PROFILE_ZONE("Server::loadChunks");
+
+    struct MissingChunk
+    {
+        // To the nearest player that needs it
+        int distanceSq{};
+        int chunkX{};
+        int chunkZ{};
+    };
+    std::vector<MissingChunk> missing;
+    for (const auto& player : m_players)
+    {
+        if (!player->viewDistance)
+            continue;
+        const int viewDistanceSq = player->viewDistance*player->viewDistance;
+        for (size_t i = player->nextChunkOrderI; i < m_chunkOrder.size(); ++i)
+        {
+            const auto [dx, dz] = m_chunkOrder[i];
+            const int distanceSq = getDistanceSq(dx, dz);
+            if (distanceSq > viewDistanceSq)
+                break;
+            if (!m_world.getChunk(player->chunkX+dx, player->chunkZ+dz))
+                missing.push_back({distanceSq, player->chunkX+dx, player->chunkZ+dz});
+        }
+    }
+    if (missing.empty())
+        return 0;
+
+    std::sort(missing.begin(), missing.end(), [](const MissingChunk& a, const MissingChunk& b){
+        return std::tie(a.chunkX, a.chunkZ, a.distanceSq) < std::tie(b.chunkX, b.chunkZ, b.distanceSq);
+    });
+    // Keep the nearest of the duplicates
+    missing.erase(std::unique(missing.begin(), missing.end(), [](const MissingChunk& a, const MissingChunk& b){
+        return a.chunkX == b.chunkX && a.chunkZ == b.chunkZ;
+    }), missing.end());
+    std::stable_sort(missing.begin(), missing.end(), [](const MissingChunk& a, const MissingChunk& b){
+        return a.distanceSq < b.distanceSq;
+    });
+
+    // In batches of one chunk per thread, until the time is up
+    const auto startTime = Clock::now();
+    ThreadPool& pool = ThreadPool::getShared();
+    const size_t batchSize = pool.getThreadCount()+1;
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    size_t doneCount{};
+    while (doneCount < missing.size()
+        && std::chrono::duration<float, std::milli>(Clock::now()-startTime).count() < SERVER_CHUNK_LOAD_BUDGET_MS)
+    {
+        const size_t count = std::min(batchSize, missing.size()-doneCount);
+        chunks.clear();
+        chunks.resize(count);
+        pool.parallelFor(count, [&](int i){
+            const MissingChunk& chunk = missing[doneCount+i];
+            if (m_worldStore)
+                chunks[i] = m_worldStore->loadChunk(chunk.chunkX, chunk.chunkZ);
+            if (!chunks[i])
+            {
+                chunks[i] = WorldGen::genChunk(chunk.chunkX, chunk.chunkZ);
+                // Without a store it's the same as a regenerated one, so it can be unloaded
+                if (!m_worldStore)
+                    chunks[i]->takeDirtySections(CHUNK_CACHE_SAVE);
+            }
+        });
+        for (std::unique_ptr<Chunk>& chunk : chunks)
+            m_world.addChunk(std::move(chunk));
+        doneCount += count;
+    }
+    return doneCount;
+}
+
+void Server::sendDeltas()
+{
+    PROFILE_ZONE("Server::sendDeltas");
+
+    // Sorted by chunk, so the clients apply them with few chunk lookups
+    auto getSortKey{[](const BlockPos& pos){
+        return std::make_tuple(World::blockToChunkCoord(pos.x), World::blockToChunkCoord(pos.z), pos.y, pos.z, pos.x);
+    }};
+    std::sort(m_changedPositions.begin(), m_changedPositions.end(), [&](const BlockPos& a, const BlockPos& b){
+        return getSortKey(a) < getSortKey(b);
+    });
+    m_changedPositions.erase(std::unique(m_changedPositions.begin(), m_changedPositions.end(),
+            [](const BlockPos& a, const BlockPos& b){ return a.x == b.x && a.y == b.y && a.z == b.z; }),
+            m_changedPositions.end());
+
+    // A block may have changed more than once, only the last state is sent
+    std::vector<BlockEdit> edits;
+    std::vector<uint64_t> chunkKeys;
+    edits.reserve(m_changedPositions.size());
+    chunkKeys.reserve(m_changedPositions.size());
+    for (const BlockPos& pos : m_changedPositions)
+    {
+        edits.push_back({pos, m_world.getBlock(pos.x, pos.y, pos.z)});
+        chunkKeys.push_back(World::getChunkKey(World::blockToChunkCoord(pos.x), World::blockToChunkCoord(pos.z)));
+    }
+    m_lastTickStats.changedBlocks = edits.size();
+    m_changedPositions.clear();
+
+    std::vector<BlockEdit> playerEdits;
+    for (const auto& player : m_players)
+    {
+        if (!player->viewDistance)
+            continue;
+        playerEdits.clear();
+        for (size_t i{}; i < edits.size(); ++i)
+        {
+            if (player->sentChunks.contains(chunkKeys[i]))
+                playerEdits.push_back(edits[i]);
+        }
+
+        m_message.clear();
+        NetProtocol::write(&m_message, m_tickI);
+        NetProtocol::write(&m_message, m_lastTickStats.tickMs);
+        NetProtocol::encodeDeltas(playerEdits, &m_message);
+        player->connection->send(NET_MSG_TICK, m_message);
+        // The ticks go to everyone, so the queue of a stuck client grows without bound
+        if (player->connection->getQueuedBytes() > SERVER_MAX_SEND_QUEUE_BYTES)
+        {
+            Logger::warn << "Player " << player->id << " isn't reading, " << player->connection->getQueuedBytes()
+                << " bytes queued, disconnecting" << Logger::End;
+            player->connection->close();
+        }
+    }
+}
+
+int Server::streamChunks(ServerPlayer* player)
+{
+    if (!player->viewDistance)
+        return 0;
+    PROFILE_ZONE("Server::streamChunks");
+    NetConnection& connection = *player->connection;
+
+    // Unload the chunks that left the view, one chunk further, so walking along a border doesn't resend them
+    const int unloadDistanceSq = (player->viewDistance+1)*(player->viewDistance+1);
+    for (auto it = player->sentChunks.begin(); it != player->sentChunks.end();)
+    {
+        const int chunkX = (int32_t)(*it >> 32);
+        const int chunkZ = (int32_t)(uint32_t)*it;
+        if (getDistanceSq(chunkX-player->chunkX, chunkZ-player->chunkZ) <= unloadDistanceSq)
+        {
+            ++it;
+            continue;
+        }
+        m_message.clear();
+        NetProtocol::write(&m_message, (int32_t)chunkX);
+        NetProtocol::write(&m_message, (int32_t)chunkZ);
+        connection.send(NET_MSG_UNLOAD_CHUNK, m_message);
+        it = player->sentChunks.erase(it);
+    }
+
+    int sentCount{};
+    // Whether every chunk before `i` was sent, see `ServerPlayer::nextChunkOrderI`
+    bool isAllSent = true;
+    const int viewDistanceSq = player->viewDistance*player->viewDistance;
+    for (size_t i = player->nextChunkOrderI; i < m_chunkOrder.size(); ++i)
+    {
+        const auto [dx, dz] = m_chunkOrder[i];
+        if (getDistanceSq(dx, dz) > viewDistanceSq)
+            break;
+        if (sentCount == SERVER_CHUNKS_PER_PLAYER_TICK || connection.getQueuedBytes() > SERVER_MAX_QUEUED_BYTES)
+            break;
+
+        const int chunkX = player->chunkX+dx;
+        const int chunkZ = player->chunkZ+dz;
+        const uint64_t chunkKey = World::getChunkKey(chunkX, chunkZ);
+        if (!player->sentChunks.contains(chunkKey))
+        {
+            // Not loaded yet
+            const Chunk* chunk = m_world.getChunk(chunkX, chunkZ);
+            if (!chunk)
+            {
+                isAllSent = false;
+                continue;
+            }
+
+            m_message.clear();
+            NetProtocol::write(&m_message, (int32_t)chunkX);
+            NetProtocol::write(&m_message, (int32_t)chunkZ);
+            NetProtocol::encodeChunk(*chunk, &m_message);
+            connection.send(NET_MSG_CHUNK, m_message);
+            player->sentChunks.insert(chunkKey);
+            ++sentCount;
+        }
+        if (isAllSent)
+            player->nextChunkOrderI = i+1;
+    }
+    return sentCount;
+}
+
+void Server::unloadUnseenChunks()
+{
+    PROFILE_ZONE("Server::unloadUnseenChunks");
+    std::vector<std::pair<int, int>> unseen;
+    for (const auto& [key, chunk] : m_world.getChunks())
+    {
+        // Not saved yet. Without a store, only the chunks that were never edited can be dropped.
+        if (m_worldStore ? !m_worldStore->isChunkSaved(*chunk) : chunk->getDirtySections(CHUNK_CACHE_SAVE))
+            continue;
+
+        const bool isSeen = std::any_of(m_players.begin(), m_players.end(), [&](const auto& player){
+            const int keepDistance = player->viewDistance+2;
+            return player->viewDistance && getDistanceSq(
+                    chunk->getChunkX()-player->chunkX, chunk->getChunkZ()-player->chunkZ) <= keepDistance*keepDistance;
+        });
+        if (!isSeen)
+            unseen.push_back({chunk->getChunkX(), chunk->getChunkZ()});
+    }
+    for (const auto& [chunkX, chunkZ] : unseen)
+        m_world.removeChunk(chunkX, chunkZ);
+}
+
+void Server::tick()
+{
+    PROFILE_ZONE("Server::tick");
+    const auto beginTime = Clock::now();
+    ServerTickStats stats;
+
+    acceptPlayers();
+    for (size_t i{}; i < m_players.size();)
+    {
+        ServerPlayer* player = m_players[i].get();
+        if (handleMessages(player) && !player->connection->isClosed())
+        {
+            const int chunkX = World::blockToChunkCoord((int)std::floor(player->pos.x));
+            const int chunkZ = World::blockToChunkCoord((int)std::floor(player->pos.z));
+            if (chunkX != player->chunkX || chunkZ != player->chunkZ)
+            {
+                player->chunkX = chunkX;
+                player->chunkZ = chunkZ;
+                player->nextChunkOrderI = 0;
+            }
+            ++i;
+            continue;
+        }
+        Logger::log << "Player " << player->id << " disconnected" << Logger::End;
+        m_players.erase(m_players.begin()+i);
+    }
+
+    m_tickScheduler.tick();
+    for (const BlockPos& pos : m_tickScheduler.getChangedBlocks())
+    {
+        m_fluidSim.onBlockChanged(pos);
+        m_changedPositions.push_back(pos);
+    }
+    if (m_tickI%SERVER_FLUID_TICK_INTERVAL == 0)
+    {
+        m_fluidSim.step();
+        for (const BlockEdit& change : m_fluidSim.getChanges())
+        {
+            m_tickScheduler.onBlockChanged(change.pos);
+            m_changedPositions.push_back(change.pos);
+        }
+    }
+    // Nothing is lit here, the clients light their copies
+    m_world.takeChangedBlocks();
+
+    sendDeltas();
+    stats.changedBlocks = m_lastTickStats.changedBlocks;
+    stats.loadedChunks = loadChunks();
+    for (const auto& player : m_players)
+    {
+        stats.sentChunks += streamChunks(player.get());
+        player->connection->flush();
+    }
+
+    if (m_tickI%SERVER_UNLOAD_INTERVAL_TICKS == SERVER_UNLOAD_INTERVAL_TICKS-1)
+        unloadUnseenChunks();
+    if (m_worldStore && m_tickI%SERVER_CHECKPOINT_INTERVAL_TICKS == SERVER_CHECKPOINT_INTERVAL_TICKS-1)
+    {
+        const size_t chunkCount = m_worldStore->checkpoint();
+        if (chunkCount)
+        {
+            Logger::dbg << "Checkpointing " << chunkCount << " chunks" << Logger::End;
+        }
+    }
+
+    ++m_tickI;
+    stats.playerCount = m_players.size();
+    stats.chunkCount = m_world.getChunks().size();
+    stats.tickMs = std::chrono::duration<float, std::milli>(Clock::now()-beginTime).count();
+    m_lastTickStats = stats;
+}
+
+void Server::run(const std::atomic<bool>& isStopping)
+{
+    PROFILE_THREAD_NAME("Server");
+
+    float maxTickMs{};
+    double tickMsSum{};
+    Clock::time_point nextTickTime = Clock::now();
+    while (!isStopping)
+    {
+        tick();
+        maxTickMs = std::max(maxTickMs, m_lastTickStats.tickMs);
+        tickMsSum += m_lastTickStats.tickMs;
+        if (m_tickI%SERVER_STATS_INTERVAL_TICKS == 0)
+        {
+            Logger::log << m_lastTickStats.playerCount << " players, " << m_lastTickStats.chunkCount
+                << " chunks, tick time avg: " << tickMsSum/SERVER_STATS_INTERVAL_TICKS << "ms, max: "
+                << maxTickMs << "ms" << Logger::End;
+            maxTickMs = 0;
+            tickMsSum = 0;
+        }
+
+        nextTickTime += tickDuration;
+        const Clock::time_point now = Clock::now();
+        if (now-nextTickTime > tickDuration*SERVER_MAX_CATCHUP_TICKS)
+        {
+            Logger::warn << "Server is behind by " << (now-nextTickTime)/tickDuration
+                << " ticks, skipping them" << Logger::End;
+            nextTickTime = now;
+        }
+        std::this_thread::sleep_until(nextTickTime);
+    }
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "World.h"
+#include "TickScheduler.h"
+#include "FluidSim.h"
+#include "WorldStore.h"
+#include "NetSocket.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <glm/vec3.hpp>
+
+#define SERVER_TICKS_PER_SEC 20
+// If the ticks fall behind more than this, the missed ones are skipped instead of run in a burst
+#define SERVER_MAX_CATCHUP_TICKS 5
+// Ticks between logging the stats in `Server::run()`
+#define SERVER_STATS_INTERVAL_TICKS (SERVER_TICKS_PER_SEC*10)
+// Ticks between the fluid steps, the fluids flow 10 blocks/s
+#define SERVER_FLUID_TICK_INTERVAL 2
+// Ticks between the checkpoints of the world store
+#define SERVER_CHECKPOINT_INTERVAL_TICKS (SERVER_TICKS_PER_SEC*30)
+// Ticks between unloading the chunks that no player sees
+#define SERVER_UNLOAD_INTERVAL_TICKS SERVER_TICKS_PER_SEC
+#define SERVER_MAX_VIEW_DISTANCE 32
+// Time per tick spent loading and generating chunks for all the players together
+#define SERVER_CHUNK_LOAD_BUDGET_MS 20
+// Chunks sent to a player per tick
+#define SERVER_CHUNKS_PER_PLAYER_TICK 16
+// No more chunks are queued for a player with this many unsent bytes, it can't keep up
+#define SERVER_MAX_QUEUED_BYTES (2*1024*1024)
+// A player with this many unsent bytes stopped reading, it is disconnected
+#define SERVER_MAX_SEND_QUEUE_BYTES (16*1024*1024)
+
+struct ServerPlayer
+{
+    uint32_t id{};
+    std::unique_ptr<NetConnection> connection;
+    // Set by the hello message, no chunks are sent before it
+    int viewDistance{};
+    glm::vec3 pos{};
+    int chunkX{};
+    int chunkZ{};
+    // The chunks before this in `Server::m_chunkOrder` were all sent, reset when the player changes chunk
+    size_t nextChunkOrderI{};
+    std::unordered_set<uint64_t> sentChunks;
+};
+
+struct ServerTickStats
+{
+    float tickMs{};
+    int playerCount{};
+    size_t chunkCount{};
+    int loadedChunks{};
+    int sentChunks{};
+    size_t changedBlocks{};
+};
+
+/*
+ * Runs the world without rendering, and streams it to the players over sockets.
+ *
+ * Each player gets the chunks around it nearest first, palette-compressed, and the
+ * changed blocks of its chunks batched into one message per tick.
+ * The chunks are loaded from the world store or generated when a player gets near them,
+ * and unloaded when no player sees them and they are saved.
+ */
+class Server final
+{
+private:
+    World m_world;
+    TickScheduler m_tickScheduler;
+    FluidSim m_fluidSim;
+    WorldStore* m_worldStore{};
+    NetListener m_listener;
+    std::vector<std::unique_ptr<ServerPlayer>> m_players;
+    uint32_t m_nextPlayerId{1};
+    uint64_t m_tickI{};
+    ServerTickStats m_lastTickStats;
+
+    // Chunk offsets within `SERVER_MAX_VIEW_DISTANCE`, nearest first
+    std::vector<std::pair<int, int>> m_chunkOrder;
+    // Positions changed during the tick, by any source
+    std::vector<BlockPos> m_changedPositions;
+    // Reused for encoding
+    std::string m_message;
+
+    void acceptPlayers();
+    /*
+     * Returns false if the player sent something invalid.
+     */
+    bool handleMessages(ServerPlayer* player);
+    void onBlockChanged(BlockPos pos);
+    /*
+     * Loads or generates the missing chunks near the players, nearest first. Returns their number.
+     */
+    int loadChunks();
+    void sendDeltas();
+    /*
+     * Sends the chunks that came into view, nearest first, and unloads the ones that left it.
+     * Returns the number of chunks sent.
+     */
+    int streamChunks(ServerPlayer* player);
+    void unloadUnseenChunks();
+
+public:
+    /*
+     * Call `WorldGen::setSeed()` first.
+     */
+    explicit Server(uint64_t seed);
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+    Server(Server&&) = delete;
+    Server& operator=(Server&&) = delete;
+
+    bool listen(const std::string& address);
+    /*
+     * Loads the chunks from `store` and checkpoints it, it has to be attached to the world.
+     * Call before the first tick.
+     */
+    inline void setWorldStore(WorldStore* store) { m_worldStore = store; }
+    inline World& getWorld() { return m_world; }
+
+    void tick();
+    /*
+     * Ticks at `SERVER_TICKS_PER_SEC` until `isStopping` is set.
+     */
+    void run(const std::atomic<bool>& isStopping);
+
+    inline const ServerTickStats& getLastTickStats() const { return m_lastTickStats; }
+};
@@ -0,0 +1,160 @@
+#include "ShaderCache.h"
+#include "glstuff.h"
+#include "Logger.h"
+#include "common.h"
+#include "MappedFile.h"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+namespace ShaderCache
+{
+
+#define SHADER_CACHE_MAGIC "ACPB"
+#define SHADER_CACHE_VERSION 1
+
+struct CacheFileHeader
+{
+    char magic[4]{};
+    uint32_t version{};
+    uint64_t key{};
+    uint32_t binaryFormat{};
+    uint32_t binarySize{};
+    // How long compiling and linking the sources took, used to report the time saved
+    float compileMs{};
+};
+
+static std::string keyToPath(uint64_t key)
+{
+    char name[17]{};
+    std::snprintf(name, sizeof(name), "%016lx", (unsigned long)key);
+    return std::string(SHADER_CACHE_DIR) + '/' + name + ".bin";
+}
+
+static std::string glStr(GLenum name)
+{
+    const auto* str = (const char*)glGetString(name);
+    return str ? str : "";
+}
+
+bool isSupported()
+{
+    if (!GLEW_ARB_get_program_binary)
+        return false;
+
+    int formatCount{};
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    return formatCount > 0;
+}
+
+/*
+ * Hashes the length before the data, so the end of a field can't pass for the start of the next one.
+ */
+static uint64_t hashField(std::string_view data, uint64_t hash=fnv1aHash({}))
+{
+    const uint64_t size = data.size();
+    hash = fnv1aHash({(const char*)&size, sizeof(size)}, hash);
+    return fnv1aHash(data, hash);
+}
+
+uint64_t makeKey(const std::string& vertSrc, const std::string& fragSrc)
+{
+    uint64_t hash = hashField(vertSrc);
+    hash = hashField(fragSrc, hash);
+    hash = hashField(glStr(GL_VENDOR), hash);
+    hash = hashField(glStr(GL_RENDERER), hash);
+    hash = hashField(glStr(GL_VERSION), hash);
+    return hash;
+}
+
+uint tryLoad(uint64_t key, float* compileMsOut)
+{
+    const std::string path = keyToPath(key);
+    std::ifstream file{path, std::ios::binary};
+    if (!file)
+        return 0;
+
+    CacheFileHeader header;
+    if (!file.read((char*)&header, sizeof(header))
+     || std::memcmp(header.magic, SHADER_CACHE_MAGIC, 4) != 0
+     || header.version != SHADER_CACHE_VERSION
+     || header.key != key)
+    {
+        Logger::dbg << "Ignoring invalid shader cache entry: " << path << Logger::End;
+        return 0;
+    }
+
+    // A damaged size would allocate up to 4 GiB before the read fails
+    std::error_code error;
+    const uintmax_t fileSize = std::filesystem::file_size(path, error);
+    if (error || header.binarySize > fileSize-sizeof(header))
+    {
+        Logger::dbg << "Ignoring truncated shader cache entry: " << path << Logger::End;
+        return 0;
+    }
+
+    std::vector<char> binary(header.binarySize);
+    if (!file.read(binary.data(), binary.size()))
+    {
+        Logger::dbg << "Ignoring truncated shader cache entry: " << path << Logger::End;
+        return 0;
+    }
+
+    uint progId = glCreateProgram();
+    glProgramBinary(progId, header.binaryFormat, binary.data(), binary.size());
+    int linkStat{};
+    glGetProgramiv(progId, GL_LINK_STATUS, &linkStat);
+    if (linkStat == GL_FALSE)
+    {
+        // The driver may reject binaries for any reason, just compile again
+        Logger::dbg << "Driver rejected cached program binary: " << path << Logger::End;
+        glDeleteProgram(progId);
+        return 0;
+    }
+
+    *compileMsOut = header.compileMs;
+    return progId;
+}
+
+void store(uint64_t key, uint progId, float compileMs)
+{
+    int binarySize{};
+    glGetProgramiv(progId, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+    if (binarySize <= 0)
+        return;
+
+    std::vector<char> binary(binarySize);
+    GLenum binaryFormat{};
+    glGetProgramBinary(progId, binarySize, nullptr, &binaryFormat, binary.data());
+
+    std::error_code ec;
+    std::filesystem::create_directories(SHADER_CACHE_DIR, ec);
+    if (ec)
+    {
+        Logger::warn << "Failed to create shader cache directory: " << ec.message() << Logger::End;
+        return;
+    }
+
+    CacheFileHeader header;
+    std::memcpy(header.magic, SHADER_CACHE_MAGIC, 4);
+    header.version = SHADER_CACHE_VERSION;
+    header.key = key;
+    header.binaryFormat = binaryFormat;
+    header.binarySize = binarySize;
+    header.compileMs = compileMs;
+
+    std::string fileData((const char*)&header, sizeof(header));
+    fileData.append(binary.data(), binary.size());
+    // Another instance may be reading the entry, it never sees a half-written one
+    const std::string path = keyToPath(key);
+    if (!writeFileAtomically(path, fileData))
+    {
+        Logger::warn << "Failed to write shader cache entry: " << path << Logger::End;
+        return;
+    }
+    Logger::dbg << "Saved program binary to cache: " << path << " (" << binarySize << " bytes)" << Logger::End;
+}
+
+} // End of namespace ShaderCache
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "types.h"
+#include <string>
+#include <cstdint>
+
+/*
+ * On-disk cache of linked shader program binaries.
+ *
+ * Entries are keyed by a hash of the shader sources and the GL vendor,
+ * renderer and version strings, so a driver update or a shader edit
+ * just results in a cache miss.
+ */
+namespace ShaderCache
+{
+
+#define SHADER_CACHE_DIR "../cache/shaders"
+
+/*
+ * Returns true if the driver can save and load program binaries.
+ */
+bool isSupported();
+
+uint64_t makeKey(const std::string& vertSrc, const std::string& fragSrc);
+
+/*
+ * Creates a program from the cached binary.
+ * Returns 0 if there is no usable entry. Rejected binaries are not an error.
+ * `compileMsOut` is set to the time the original compilation took.
+ */
+uint tryLoad(uint64_t key, float* compileMsOut);
+
+/*
+ * Saves the binary of a linked program. The program must have been linked with
+ * `GL_PROGRAM_BINARY_RETRIEVABLE_HINT` set.
+ */
+void store(uint64_t key, uint progId, float compileMs);
+
+} // End of namespace ShaderCache
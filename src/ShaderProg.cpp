@@ -1,7 +1,10 @@
 #include "ShaderProg.h"
+#include "ShaderCache.h"
+#include "GlState.h"
+#include "Profiler.h"
+#include "AssetPack.h"
 #include "common.h"
-
-uint ShaderProg::s_boundProgId = -1;
+#include <chrono>
 
 ShaderProg::ShaderProg(const std::string& vertPath, const std::string& fragPath)
 {
@@ -16,10 +19,12 @@ ShaderProg::ShaderProg(ShaderProg&& temp) noexcept
     m_progId = temp.m_progId;
     m_vertPath = temp.m_vertPath;
     m_fragPath = temp.m_fragPath;
+    m_uniformLocs = std::move(temp.m_uniformLocs);
 
     temp.m_progId = 0;
     temp.m_vertPath = "";
     temp.m_fragPath = "";
+    temp.m_uniformLocs.clear();
 }
 
 ShaderProg& ShaderProg::operator=(ShaderProg&& temp) noexcept
@@ -30,27 +35,78 @@ ShaderProg& ShaderProg::operator=(ShaderProg&& temp) noexcept
     m_progId = temp.m_progId;
     m_vertPath = temp.m_vertPath;
     m_fragPath = temp.m_fragPath;
+    m_uniformLocs = std::move(temp.m_uniformLocs);
 
     temp.m_progId = 0;
     temp.m_vertPath = "";
     temp.m_fragPath = "";
+    temp.m_uniformLocs.clear();
 
     return *this;
 }
 
+void ShaderProg::cacheUniformLocations()
+{
+    m_uniformLocs.clear();
+
+    int uniformCount{};
+    glGetProgramiv(m_progId, GL_ACTIVE_UNIFORMS, &uniformCount);
+    int maxNameLen{};
+    glGetProgramiv(m_progId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLen);
+
+    std::string name(maxNameLen, '\0');
+    for (int i{}; i < uniformCount; ++i)
+    {
+        int nameLen{};
+        int size{};
+        GLenum type{};
+        glGetActiveUniform(m_progId, i, maxNameLen, &nameLen, &size, &type, name.data());
+        const std::string uniformName = name.substr(0, nameLen);
+
+        // Members of uniform blocks have no location
+        const int loc = glGetUniformLocation(m_progId, uniformName.c_str());
+        if (loc == -1)
+            continue;
+
+        m_uniformLocs[uniformName] = loc;
+        // Arrays are reported as "name[0]", make them accessible as "name" too
+        if (uniformName.ends_with("[0]"))
+            m_uniformLocs[uniformName.substr(0, uniformName.size()-3)] = loc;
+    }
+
+    Logger::dbg << "Cached " << m_uniformLocs.size() << " uniform locations of program " << m_progId << Logger::End;
+}
+
+void ShaderProg::bindUniformBlocks()
+{
+    const uint cameraBlockI = glGetUniformBlockIndex(m_progId, UBO_NAME_CAMERA);
+    if (cameraBlockI != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(m_progId, cameraBlockI, UBO_BINDING_CAMERA);
+    }
+}
+
 int ShaderProg::getUniformLocation(const char* name) const
 {
-    int loc = glGetUniformLocation(m_progId, name);
-    if (loc == -1)
+    const auto found = m_uniformLocs.find(name);
+    if (found == m_uniformLocs.end())
     {
         Logger::fatal << "Failed to get location of uniform: \"" << name << "\" in program: " << m_progId << Logger::End; 
+        return -1; // Not reached
     }
-    return loc;
+    return found->second;
 }
 
-static uint setupShader(const std::string& path, bool isVert)
+static std::string loadShaderSource(const std::string& path)
+{
+    std::string_view packed;
+    if (AssetPack::findShaderSource(path, &packed))
+        return std::string{packed};
+    return loadTextFile(path);
+}
+
+static uint setupShader(const std::string& shaderStr, bool isVert)
 {
-    const std::string shaderStr = loadTextFile(path);
     const char* shaderCStrP = shaderStr.c_str();
 
     uint shaderId = glCreateShader(isVert ? GL_VERTEX_SHADER : GL_FRAGMENT_SHADER);
@@ -77,9 +133,11 @@ static uint setupShader(const std::string& path, bool isVert)
 
 }
 
-static uint setupProgram(uint vertId, uint fragId)
+static uint setupProgram(uint vertId, uint fragId, bool isBinaryRetrievable)
 {
     uint progId = glCreateProgram();
+    if (isBinaryRetrievable)
+        glProgramParameteri(progId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glAttachShader(progId, vertId);
     glAttachShader(progId, fragId);
     glLinkProgram(progId);
@@ -105,43 +163,73 @@ static uint setupProgram(uint vertId, uint fragId)
 
 void ShaderProg::open(const std::string& vertPath, const std::string& fragPath)
 {
+    PROFILE_ZONE("ShaderProg::open");
     m_vertPath = vertPath;
     m_fragPath = fragPath;
 
-    Logger::log << "Loading vertex shader: " << vertPath << Logger::End;
-    uint vertId = setupShader(vertPath, true);
-    Logger::log << "Loaded vertex shader (id=" << vertId << ")" << Logger::End;
+    const std::string vertSrc = loadShaderSource(vertPath);
+    const std::string fragSrc = loadShaderSource(fragPath);
 
-    Logger::log << "Loading fragment shader: " << fragPath << Logger::End;
-    uint fragId = setupShader(fragPath, false);
-    Logger::log << "Loaded fragment shader (id=" << fragId << ")" << Logger::End;
+    const auto startTime = std::chrono::steady_clock::now();
+    auto getElapsedMs{[&](){
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-startTime).count();
+    }};
 
-    Logger::log << "Linking shader program" << Logger::End;
-    m_progId = setupProgram(vertId, fragId);
-    glDeleteShader(vertId);
-    glDeleteShader(fragId);
+    const bool isCacheSupported = ShaderCache::isSupported();
+    const uint64_t cacheKey = isCacheSupported ? ShaderCache::makeKey(vertSrc, fragSrc) : 0;
+    float originalCompileMs{};
+    m_progId = isCacheSupported ? ShaderCache::tryLoad(cacheKey, &originalCompileMs) : 0;
+    if (m_progId)
+    {
+        const float loadMs = getElapsedMs();
+        Logger::log << "Loaded shader program from binary cache in " << loadMs << "ms, saved "
+            << originalCompileMs-loadMs << "ms (" << vertPath << ", " << fragPath << ')' << Logger::End;
+    }
+    else
+    {
+        Logger::log << "Loading vertex shader: " << vertPath << Logger::End;
+        uint vertId = setupShader(vertSrc, true);
+        Logger::log << "Loaded vertex shader (id=" << vertId << ")" << Logger::End;
+
+        Logger::log << "Loading fragment shader: " << fragPath << Logger::End;
+        uint fragId = setupShader(fragSrc, false);
+        Logger::log << "Loaded fragment shader (id=" << fragId << ")" << Logger::End;
+
+        Logger::log << "Linking shader program" << Logger::End;
+        m_progId = setupProgram(vertId, fragId, isCacheSupported);
+        glDeleteShader(vertId);
+        glDeleteShader(fragId);
+
+        const float compileMs = getElapsedMs();
+        Logger::dbg << "Compiling and linking took " << compileMs << "ms" << Logger::End;
+        if (isCacheSupported)
+            ShaderCache::store(cacheKey, m_progId, compileMs);
+    }
+    cacheUniformLocations();
+    bindUniformBlocks();
     Logger::log << "Set up shader program" << Logger::End;
 }
 
 void ShaderProg::bind()
 {
-    // If the currently bound program is not this one, bind it
-    if (s_boundProgId != m_progId)
-    {
-        glUseProgram(m_progId);
-        s_boundProgId = m_progId;
-    }
+    GlState::useProgram(m_progId);
 }
 
 void ShaderProg::setUniform(const char* name, const glm::mat4& x)
+{
+    setUniform(getUniformLocation(name), x);
+}
+
+void ShaderProg::setUniform(int loc, const glm::mat4& x)
 {
     bind();
-    glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(x));
+    glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(x));
 }
 
 ShaderProg::~ShaderProg()
 {
     glDeleteProgram(m_progId);
+    GlState::onProgramDeleted(m_progId);
     Logger::dbg << "Shader program " << m_progId << " deleted. "
         << "\n\tVertex shader: " << m_vertPath << ","
         << "\n\tFragment shader: " << m_fragPath << Logger::End;
@@ -5,6 +5,15 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <string>
+#include <unordered_map>
+
+/*
+ * Uniform block binding points shared by every program.
+ * A program that declares one of these blocks gets it bound to the
+ * matching point after linking, so the buffer only has to be bound once.
+ */
+#define UBO_NAME_CAMERA "CameraBlock"
+#define UBO_BINDING_CAMERA 0
 
 class ShaderProg final
 {
@@ -12,10 +21,11 @@ private:
     uint m_progId{};
     std::string m_vertPath;
     std::string m_fragPath;
+    // Uniform name -> location, filled by introspection after linking
+    std::unordered_map<std::string, int> m_uniformLocs;
 
-    static uint s_boundProgId;
-
-    int getUniformLocation(const char* name) const;
+    void cacheUniformLocations();
+    void bindUniformBlocks();
 
 public:
     ShaderProg() = default;
@@ -31,8 +41,16 @@ public:
     void open(const std::string& vertPath, const std::string& fragPath);
 
     void bind();
+    inline uint getId() const { return m_progId; }
+
+    /*
+     * Looks up the location in the cache built at link time.
+     * Does not call into GL.
+     */
+    int getUniformLocation(const char* name) const;
 
     void setUniform(const char* name, const glm::mat4& x);
+    void setUniform(int loc, const glm::mat4& x);
 
     ~ShaderProg();
 };
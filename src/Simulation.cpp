@@ -0,0 +1,247 @@
+#include "Simulation.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <glm/glm.hpp>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr Clock::duration tickDuration = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>{1.0/SIM_TICKS_PER_SEC});
+static constexpr float tickMs = 1000.0f/SIM_TICKS_PER_SEC;
+
+PlayerState SimSnapshot::interpolatePlayer(Clock::time_point now) const
+{
+    const float alpha = std::clamp(
+            std::chrono::duration<float>(now-time)/std::chrono::duration<float>(tickDuration), 0.0f, 1.0f);
+    return {
+        glm::mix(prevPlayer.pos, player.pos, alpha),
+        glm::mix(prevPlayer.yawDeg, player.yawDeg, alpha),
+        glm::mix(prevPlayer.pitchDeg, player.pitchDeg, alpha),
+    };
+}
+
+Simulation::Simulation(InputQueue* inputQueue, uint64_t seed)
+    : m_tickScheduler{&m_world, &ThreadPool::getShared(), seed},
+      m_fluidSim{&m_world, &ThreadPool::getShared()},
+      m_inputQueue{inputQueue}, m_tickTimeGauge{Metrics::addGauge("sim_tick_ms")}
+{
+}
+
+PlayerState Simulation::getPlayerState() const
+{
+    return {m_player.getPos(), m_player.getHorizRotDeg(), m_player.getVertRotDeg()};
+}
+
+void Simulation::setPlayerPos(const glm::vec3& pos)
+{
+    m_player.setPos(pos);
+}
+
+void Simulation::start()
+{
+    const PlayerState player = getPlayerState();
+    m_snapshot.store(std::make_shared<const SimSnapshot>(SimSnapshot{0, Clock::now(), player, player, {}}));
+    m_isStopping = false;
+    m_thread = std::thread{&Simulation::threadMain, this};
+    Logger::dbg << "Started simulation thread at " << SIM_TICKS_PER_SEC << " ticks/s" << Logger::End;
+}
+
+void Simulation::stop()
+{
+    if (!m_thread.joinable())
+        return;
+    m_isStopping = true;
+    m_thread.join();
+    Logger::dbg << "Stopped simulation thread after " << m_tickI << " ticks" << Logger::End;
+}
+
+void Simulation::threadMain()
+{
+    PROFILE_THREAD_NAME("Simulation");
+
+    Clock::time_point nextTickTime = Clock::now();
+    while (!m_isStopping && !m_isReplayDone)
+    {
+        tick(nextTickTime);
+
+        nextTickTime += tickDuration;
+        const Clock::time_point now = Clock::now();
+        if (now-nextTickTime > tickDuration*SIM_MAX_CATCHUP_TICKS)
+        {
+            Logger::warn << "Simulation is behind by " << (now-nextTickTime)/tickDuration
+                << " ticks, skipping them" << Logger::End;
+            nextTickTime = now;
+        }
+        std::this_thread::sleep_until(nextTickTime);
+    }
+}
+
+void Simulation::onBlockChanged(BlockPos pos)
+{
+    m_tickScheduler.onBlockChanged(pos);
+    m_fluidSim.onBlockChanged(pos);
+}
+
+void Simulation::setBlock(BlockPos pos, Block block)
+{
+    if (m_netClient)
+    {
+        m_netClient->sendSetBlock(pos, block);
+        return;
+    }
+    m_world.setBlock(pos.x, pos.y, pos.z, block);
+    onBlockChanged(pos);
+}
+
+void Simulation::recordInput(InputRecording* recording)
+{
+    m_inputRecording = recording;
+    m_isReplaying = false;
+}
+
+void Simulation::replayInput(InputRecording* recording)
+{
+    m_inputRecording = recording;
+    m_isReplaying = true;
+    m_isReplayDone = recording->getTickCount() == 0;
+}
+
+bool Simulation::popInput(InputEvent* out)
+{
+    if (m_isReplaying)
+    {
+        // The live input is dropped, it would change the path
+        InputEvent liveEvent;
+        while (m_inputQueue->pop(&liveEvent)) {}
+        return m_inputRecording->popEvent(m_tickI, out);
+    }
+
+    if (!m_inputQueue->pop(out))
+        return false;
+    if (m_inputRecording)
+        m_inputRecording->record(m_tickI, *out);
+    return true;
+}
+
+void Simulation::handleInput(bool* isBreakRequested, Block* placedBlock)
+{
+    InputEvent event;
+    while (popInput(&event))
+    {
+        switch (event.type)
+        {
+        case INPUT_EVENT_ACTION:
+            m_heldActions[event.action] = event.isPressed;
+            if (event.isPressed && event.action == INPUT_ACTION_BREAK_BLOCK)
+                *isBreakRequested = true;
+            else if (event.isPressed && event.action == INPUT_ACTION_PLACE_BLOCK)
+                *placedBlock = {BLOCK_TYPE_COBBLESTONE};
+            else if (event.isPressed && event.action == INPUT_ACTION_PLACE_FLUID)
+                *placedBlock = {BLOCK_TYPE_WATER};
+            break;
+
+        case INPUT_EVENT_LOOK:
+            m_player.rotateHorizontallyDeg(event.lookX*SIM_LOOK_DEG_PER_PIXEL);
+            m_player.rotateVerticallyDeg(event.lookY*SIM_LOOK_DEG_PER_PIXEL);
+            break;
+        }
+    }
+}
+
+void Simulation::tick(Clock::time_point tickTime)
+{
+    PROFILE_ZONE("Simulation::tick");
+    const Clock::time_point beginTime = Clock::now();
+    const PlayerState prevPlayer = getPlayerState();
+
+    bool isBreakRequested{};
+    Block placedBlock{};
+    handleInput(&isBreakRequested, &placedBlock);
+
+    if (m_heldActions[INPUT_ACTION_FORWARD])
+        m_player.moveForward(SIM_PLAYER_SPEED, tickMs);
+    if (m_heldActions[INPUT_ACTION_BACKWARDS])
+        m_player.moveBackwards(SIM_PLAYER_SPEED, tickMs);
+    if (m_heldActions[INPUT_ACTION_LEFT])
+        m_player.moveLeft(SIM_PLAYER_SPEED, tickMs);
+    if (m_heldActions[INPUT_ACTION_RIGHT])
+        m_player.moveRight(SIM_PLAYER_SPEED, tickMs);
+    if (m_heldActions[INPUT_ACTION_UP])
+        m_player.moveUp(SIM_PLAYER_SPEED, tickMs);
+    if (m_heldActions[INPUT_ACTION_DOWN])
+        m_player.moveDown(SIM_PLAYER_SPEED, tickMs);
+
+    RayHit targetedBlock;
+    {
+        const std::lock_guard lock{m_worldMutex};
+
+        targetedBlock = Raycast::castRay(m_world, {
+                Raycast::renderToBlockCoords(m_player.getPos()), m_player.getFrontVec(), RAYCAST_PICK_DISTANCE});
+        if (targetedBlock.isHit)
+        {
+            const BlockPos& pos = targetedBlock.pos;
+            const BlockPos& prevPos = targetedBlock.prevPos;
+            if (isBreakRequested)
+            {
+                setBlock(pos, {BLOCK_TYPE_AIR});
+            }
+            // Not when the player is inside the block
+            else if (placedBlock.type != BLOCK_TYPE_AIR && targetedBlock.face != BLOCK_FACE__COUNT)
+            {
+                setBlock(prevPos, placedBlock);
+            }
+        }
+
+        if (m_netClient)
+        {
+            // The server runs the block ticks and the fluids, their results come with the deltas
+            m_netClient->sendPlayerPos(Raycast::renderToBlockCoords(m_player.getPos()));
+            if (!m_netClient->update(&m_world))
+            {
+                Logger::err << "Lost the connection to the server" << Logger::End;
+                m_netClient = nullptr;
+            }
+        }
+        else
+        {
+            m_tickScheduler.tick();
+            for (const BlockPos& pos : m_tickScheduler.getChangedBlocks())
+                m_fluidSim.onBlockChanged(pos);
+            if (m_tickI%SIM_FLUID_TICK_INTERVAL == 0)
+            {
+                m_fluidSim.step();
+                for (const BlockEdit& change : m_fluidSim.getChanges())
+                    m_tickScheduler.onBlockChanged(change.pos);
+            }
+        }
+        // The light changes mark the meshes dirty for the next mesh update
+        m_lightEngine.update();
+
+        if (m_worldStore && m_tickI%SIM_CHECKPOINT_INTERVAL_TICKS == SIM_CHECKPOINT_INTERVAL_TICKS-1)
+        {
+            // Only takes the snapshots, the chunks are written in the background
+            const size_t chunkCount = m_worldStore->checkpoint();
+            if (chunkCount)
+            {
+                Logger::dbg << "Checkpointing " << chunkCount << " chunks" << Logger::End;
+            }
+        }
+    }
+
+    const PlayerState player = getPlayerState();
+    m_pathChecksum = fnv1aHash({(const char*)&player, sizeof(player)}, m_pathChecksum);
+    ++m_tickI;
+    if (m_inputRecording && m_isReplaying && m_tickI >= m_inputRecording->getTickCount())
+        m_isReplayDone = true;
+    else if (m_inputRecording && !m_isReplaying)
+        m_inputRecording->setTickCount(m_tickI);
+    m_snapshot.store(std::make_shared<const SimSnapshot>(
+                SimSnapshot{m_tickI, tickTime, prevPlayer, player, targetedBlock}));
+    m_tickTimeGauge.set(std::chrono::duration<double, std::milli>(Clock::now()-beginTime).count());
+}
+
+Simulation::~Simulation()
+{
+    stop();
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "World.h"
+#include "LightEngine.h"
+#include "TickScheduler.h"
+#include "FluidSim.h"
+#include "WorldStore.h"
+#include "NetClient.h"
+#include "Raycast.h"
+#include "Camera.h"
+#include "InputQueue.h"
+#include "InputRecording.h"
+#include "Metrics.h"
+#include "common.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <glm/vec3.hpp>
+
+#define SIM_TICKS_PER_SEC 60
+// If the ticks fall behind more than this, the missed ones are skipped instead of run in a burst
+#define SIM_MAX_CATCHUP_TICKS 5
+// In render units per millisecond
+#define SIM_PLAYER_SPEED 0.1f
+#define SIM_LOOK_DEG_PER_PIXEL 0.1f
+// Ticks between the fluid steps, the fluids flow 12 blocks/s
+#define SIM_FLUID_TICK_INTERVAL 5
+// Ticks between the checkpoints of the world store, the journal covers the edits in between
+#define SIM_CHECKPOINT_INTERVAL_TICKS (SIM_TICKS_PER_SEC*30)
+
+struct PlayerState
+{
+    glm::vec3 pos{};
+    float yawDeg{};
+    float pitchDeg{};
+};
+
+/*
+ * State of the simulation after a tick, for the render thread.
+ * It is never changed after it is published.
+ */
+struct SimSnapshot
+{
+    uint64_t tickI{};
+    // When the tick was due
+    std::chrono::steady_clock::time_point time{};
+    // Before and after the tick
+    PlayerState prevPlayer{};
+    PlayerState player{};
+    RayHit targetedBlock{};
+
+    /*
+     * Interpolates the player between the last two ticks, so the result is one tick behind.
+     */
+    PlayerState interpolatePlayer(std::chrono::steady_clock::time_point now) const;
+};
+
+/*
+ * Runs the world, its block ticks, fluids and the player at a fixed tick rate on its own thread,
+ * independently of the frame rate.
+ *
+ * The input comes through an `InputQueue`, and each tick publishes a `SimSnapshot`.
+ * The chunks are shared with the mesher: access the world only while holding `lockWorld()`.
+ */
+class Simulation final
+{
+private:
+    World m_world;
+    std::mutex m_worldMutex;
+    LightEngine m_lightEngine{&m_world};
+    TickScheduler m_tickScheduler;
+    FluidSim m_fluidSim;
+    WorldStore* m_worldStore{};
+    NetClient* m_netClient{};
+    InputQueue* m_inputQueue{};
+    // Set by `recordInput()` or `replayInput()`
+    InputRecording* m_inputRecording{};
+    bool m_isReplaying{};
+    std::atomic<bool> m_isReplayDone{};
+    // Hash of the player state after each tick
+    uint64_t m_pathChecksum{fnv1aHash({})};
+    // Only the position and the rotation are used, it is never rendered from
+    Camera m_player{1.0f, 1.0f};
+    std::array<bool, INPUT_ACTION__COUNT> m_heldActions{};
+    uint64_t m_tickI{};
+
+    std::atomic<std::shared_ptr<const SimSnapshot>> m_snapshot;
+    std::thread m_thread;
+    std::atomic<bool> m_isStopping{};
+    Metrics::Gauge& m_tickTimeGauge;
+
+    PlayerState getPlayerState() const;
+    void threadMain();
+    /*
+     * Applies the queued input events, and the clicks to `isBreakRequested` and `placedBlock`.
+     * `placedBlock` is left as it is if nothing is placed.
+     */
+    void handleInput(bool* isBreakRequested, Block* placedBlock);
+    /*
+     * Returns the next input event for this tick, from the queue or the replayed recording.
+     */
+    bool popInput(InputEvent* out);
+    /*
+     * Tells the block ticks and the fluids that a block changed.
+     */
+    void onBlockChanged(BlockPos pos);
+    /*
+     * A block edit of the player, applied here or sent to the server.
+     */
+    void setBlock(BlockPos pos, Block block);
+    void tick(std::chrono::steady_clock::time_point tickTime);
+
+public:
+    /*
+     * `seed` drives the random block ticks.
+     */
+    Simulation(InputQueue* inputQueue, uint64_t seed);
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+    Simulation(Simulation&&) = delete;
+    Simulation& operator=(Simulation&&) = delete;
+
+    /*
+     * Call before `start()`.
+     */
+    void setPlayerPos(const glm::vec3& pos);
+    /*
+     * Checkpoints `store` every `SIM_CHECKPOINT_INTERVAL_TICKS`, it has to be attached to the world.
+     * Call before `start()`.
+     */
+    inline void setWorldStore(WorldStore* store) { m_worldStore = store; }
+    /*
+     * Plays on a server: the world is the copy it sends, the edits go to it,
+     * and the block ticks and fluids run there. Call before `start()`.
+     */
+    inline void setNetClient(NetClient* client) { m_netClient = client; }
+    /*
+     * Records the input events into `recording` by the tick that applied them.
+     * Call before `start()`, and read the recording after `stop()`.
+     */
+    void recordInput(InputRecording* recording);
+    /*
+     * Takes the input from `recording` instead of the input queue, and stops ticking at its end.
+     * Started from the recorded seed and world, the ticks repeat the recorded player path and edits.
+     * Call before `start()`.
+     */
+    void replayInput(InputRecording* recording);
+    inline bool isReplayDone() const { return m_isReplayDone; }
+    /*
+     * Changes with every tick, the same input from the same start gives the same checksum.
+     * Call after `stop()`.
+     */
+    inline uint64_t getPathChecksum() const { return m_pathChecksum; }
+    inline uint64_t getTickCount() const { return m_tickI; }
+
+    void start();
+    /*
+     * Waits for the running tick to finish. Called by the destructor too.
+     */
+    void stop();
+
+    [[nodiscard]] inline std::unique_lock<std::mutex> lockWorld() { return std::unique_lock{m_worldMutex}; }
+    inline World& getWorld() { return m_world; }
+
+    /*
+     * Returns the snapshot of the last tick. Never null after `start()`.
+     */
+    inline std::shared_ptr<const SimSnapshot> getSnapshot() const { return m_snapshot.load(); }
+
+    ~Simulation();
+};
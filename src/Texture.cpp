@@ -1,9 +1,13 @@
 #include "Texture.h"
 #include "Logger.h"
 #include "glstuff.h"
+#include "GlState.h"
+#include "Profiler.h"
+#include "AssetPack.h"
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_FAILURE_USERMSG // Get better error messages
 #include "../deps/stb/stb_image.h"
+#include <algorithm>
 
 Texture::Texture(const std::string& path)
 {
@@ -39,10 +43,36 @@ Texture& Texture::operator=(Texture&& temp) noexcept
 
 void Texture::open(const std::string& path)
 {
+    PROFILE_ZONE("Texture::open");
     Logger::log << "Loading texture: \"" << path << '"' << Logger::End;
 
     m_path = path;
 
+    glGenTextures(1, &m_texId);
+    GlState::bindTexture(GL_TEXTURE_2D, m_texId);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    AssetPack::TextureView packed;
+    if (AssetPack::findTexture(path, &packed))
+    {
+        // Already decoded and mipmapped by the baker
+        const uint8_t* levelData = packed.data;
+        int levelW = packed.width;
+        int levelH = packed.height;
+        for (int level{}; level < packed.mipLevelCount; ++level)
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, levelW, levelH, 0, GL_RGBA, GL_UNSIGNED_BYTE, levelData);
+            levelData += (size_t)levelW*levelH*4;
+            levelW = std::max(levelW/2, 1);
+            levelH = std::max(levelH/2, 1);
+        }
+
+        Logger::dbg << "Successfully loaded texture from asset pack (id=" << m_texId
+            << ", width=" << packed.width << ", height=" << packed.height << ")" << Logger::End;
+        return;
+    }
+
     stbi_set_flip_vertically_on_load(1);
 
     int width{};
@@ -52,15 +82,9 @@ void Texture::open(const std::string& path)
 
     if (data)
     {
-        glGenTextures(1, &m_texId);
-        glBindTexture(GL_TEXTURE_2D, m_texId);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
         glGenerateMipmap(GL_TEXTURE_2D);
 
-        glBindTexture(GL_TEXTURE_2D, 0);
-
         stbi_image_free(data);
 
         Logger::dbg << "Successfully loaded texture (id=" << m_texId
@@ -74,14 +98,15 @@ void Texture::open(const std::string& path)
 
 void Texture::bind()
 {
-    glBindTexture(GL_TEXTURE_2D, m_texId);
+    GlState::bindTexture(GL_TEXTURE_2D, m_texId);
 }
 
 Texture::~Texture()
 {
     if (m_texId)
     {
-        glDeleteSamplers(1, &m_texId);
+        glDeleteTextures(1, &m_texId);
+        GlState::onTextureDeleted(m_texId);
         Logger::dbg << "Texture " << m_texId << " (" << m_path << ") deleted" << Logger::End;
     }
 }
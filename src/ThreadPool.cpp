@@ -0,0 +1,101 @@
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include "Logger.h"
+#include <atomic>
+#include <algorithm>
+
+// The pool whose worker is the calling thread, null on other threads
+static thread_local const ThreadPool* t_workerPool{};
+
+ThreadPool::ThreadPool(int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = std::max((int)std::thread::hardware_concurrency()-1, 1);
+
+    for (int i{}; i < threadCount; ++i)
+        m_threads.emplace_back(&ThreadPool::workerMain, this);
+    Logger::dbg << "Started thread pool with " << threadCount << " threads" << Logger::End;
+}
+
+static int s_sharedThreadCount{};
+
+void ThreadPool::setSharedThreadCount(int threadCount)
+{
+    s_sharedThreadCount = threadCount;
+}
+
+ThreadPool& ThreadPool::getShared()
+{
+    static ThreadPool instance{s_sharedThreadCount};
+    return instance;
+}
+
+void ThreadPool::workerMain()
+{
+    // The profiler keeps the pointer, so it has to be a literal. Threads are told apart by their IDs.
+    PROFILE_THREAD_NAME("Worker");
+    t_workerPool = this;
+
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock lock{m_mutex};
+            m_taskCv.wait(lock, [this](){ return m_isStopping || !m_tasks.empty(); });
+            if (m_tasks.empty())
+                return; // Stopping and nothing left to do
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::push(std::function<void()> task)
+{
+    {
+        std::lock_guard lock{m_mutex};
+        m_tasks.push_back(std::move(task));
+    }
+    m_taskCv.notify_one();
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& func)
+{
+    if (count <= 0)
+        return;
+    // Nested in a task, the helpers would queue up behind the workers that wait for them
+    if (t_workerPool == this)
+    {
+        for (int i{}; i < count; ++i)
+            func(i);
+        return;
+    }
+
+    // Indices are claimed one by one, so uneven items balance out
+    std::atomic<int> nextI{};
+    auto runItems{[&](){
+        for (int i = nextI.fetch_add(1); i < count; i = nextI.fetch_add(1))
+            func(i);
+    }};
+
+    const int helperCount = std::min(getThreadCount(), count-1);
+    std::vector<std::future<void>> helpers;
+    helpers.reserve(helperCount);
+    for (int i{}; i < helperCount; ++i)
+        helpers.push_back(submit(runItems));
+    runItems();
+    for (auto& helper : helpers)
+        helper.get();
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock{m_mutex};
+        m_isStopping = true;
+    }
+    m_taskCv.notify_all();
+    for (auto& thread : m_threads)
+        thread.join();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Fixed set of worker threads running queued tasks in FIFO order.
+ */
+class ThreadPool final
+{
+private:
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_taskCv;
+    bool m_isStopping{};
+
+    void workerMain();
+    void push(std::function<void()> task);
+
+public:
+    /*
+     * `threadCount` <= 0 means one thread per hardware thread, minus the calling one.
+     */
+    explicit ThreadPool(int threadCount);
+
+    /*
+     * Pool shared by the game's subsystems, created on first use.
+     */
+    static ThreadPool& getShared();
+    /*
+     * Sets the thread count of the shared pool, the default is 0. Call before the first `getShared()`.
+     */
+    static void setSharedThreadCount(int threadCount);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    ThreadPool& operator=(ThreadPool&&) = delete;
+
+    inline int getThreadCount() const { return m_threads.size(); }
+
+    /*
+     * Queues `func` and returns a future of its result.
+     * Don't wait for the future inside a task of the same pool, every worker could end up waiting.
+     */
+    template <typename Func>
+    auto submit(Func&& func) -> std::future<std::invoke_result_t<Func>>
+    {
+        using Result = std::invoke_result_t<Func>;
+        // `std::function` needs a copyable callable
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func));
+        std::future<Result> future = task->get_future();
+        push([task](){ (*task)(); });
+        return future;
+    }
+
+    /*
+     * Calls `func(i)` for every i in [0, count) and waits for all of them.
+     * The calling thread takes part in the work. Called from a task of this pool,
+     * it runs everything on the calling thread, waiting for the other workers could deadlock.
+     */
+    void parallelFor(int count, const std::function<void(int)>& func);
+
+    ~ThreadPool();
+};
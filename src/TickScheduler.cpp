@@ -0,0 +1,258 @@
+#include "TickScheduler.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <bit>
+
+void TimingWheel::insert(const Entry& entry)
+{
+    // The highest bit group where the ticks differ, the levels above it are in the current slot
+    const uint64_t diff = entry.dueTick ^ m_currTick;
+    int level{};
+    while (level < TICK_WHEEL_LEVEL_COUNT-1 && (diff >> (TICK_WHEEL_SLOT_BITS*(level+1))) != 0)
+        ++level;
+    const int slotI = (entry.dueTick >> (TICK_WHEEL_SLOT_BITS*level)) & (TICK_WHEEL_SLOT_COUNT-1);
+    m_levels[level][slotI].push_back(entry);
+}
+
+void TimingWheel::schedule(BlockPos pos, uint64_t dueTick)
+{
+    insert({pos, std::clamp<uint64_t>(dueTick, m_currTick, m_currTick+TICK_MAX_DELAY)});
+    ++m_size;
+}
+
+void TimingWheel::advance(std::vector<BlockPos>* out)
+{
+    // The slots starting at this tick move down, from the top so they can go down more levels
+    for (int level{TICK_WHEEL_LEVEL_COUNT-1}; level > 0; --level)
+    {
+        if (m_currTick & ((1ull << (TICK_WHEEL_SLOT_BITS*level))-1))
+            continue;
+        std::vector<Entry>& slot = m_levels[level][(m_currTick >> (TICK_WHEEL_SLOT_BITS*level)) & (TICK_WHEEL_SLOT_COUNT-1)];
+        m_cascaded.swap(slot);
+        for (const Entry& entry : m_cascaded)
+            insert(entry);
+        m_cascaded.clear();
+    }
+
+    std::vector<Entry>& slot = m_levels[0][m_currTick & (TICK_WHEEL_SLOT_COUNT-1)];
+    for (const Entry& entry : slot)
+        out->push_back(entry.pos);
+    m_size -= slot.size();
+    slot.clear();
+    ++m_currTick;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * xorshift64*, the state must not be 0.
+ */
+static inline uint64_t nextRandom(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x*0x2545f4914f6cdd1dull;
+}
+
+/*
+ * splitmix64, to make the shard seeds from the world seed.
+ */
+static uint64_t mixSeed(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30))*0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27))*0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+TickScheduler::TickScheduler(World* world, ThreadPool* pool, uint64_t seed)
+    : m_world{world}, m_pool{pool}, m_shards(TICK_SHARD_COUNT)
+{
+    for (int i{}; i < TICK_SHARD_COUNT; ++i)
+        m_shards[i].rngState = mixSeed(seed+i) | 1;
+}
+
+int TickScheduler::getShardI(int chunkX, int chunkZ)
+{
+    // Neighbouring chunks go to different shards, so a busy area is spread out
+    return ((uint32_t)chunkX*73856093u ^ (uint32_t)chunkZ*19349663u) % TICK_SHARD_COUNT;
+}
+
+void TickScheduler::scheduleTick(BlockPos pos, uint64_t delay)
+{
+    const int shardI = getShardI(World::blockToChunkCoord(pos.x), World::blockToChunkCoord(pos.z));
+    m_shards[shardI].wheel.schedule(pos, m_tickI+std::max<uint64_t>(delay, 1));
+}
+
+void TickScheduler::onBlockChanged(BlockPos pos)
+{
+    // The block itself and the one resting on it may fall now
+    for (int dy{}; dy <= 1 && pos.y+dy < CHUNK_HEIGHT_BLOCKS; ++dy)
+    {
+        if (BlockRegistry::isFalling(m_world->getBlock(pos.x, pos.y+dy, pos.z).type))
+            scheduleTick({pos.x, pos.y+dy, pos.z}, TICK_FALL_DELAY);
+    }
+}
+
+void TickScheduler::randomTickChunk(Shard* shard, const Chunk& chunk)
+{
+    const ChunkNeighbourhood view = m_world->getNeighbourhood(chunk);
+    const int originX = chunk.getChunkX()*CHUNK_WIDTH_BLOCKS;
+    const int originZ = chunk.getChunkZ()*CHUNK_WIDTH_BLOCKS;
+
+    for (uint32_t sections = chunk.getRandomTickedSections(); sections; sections &= sections-1)
+    {
+        const int sectionI = std::countr_zero(sections);
+        const ChunkSection* section = chunk.getSection(sectionI);
+
+        // 12 bits per block
+        static_assert(TICK_RANDOM_TICKS_PER_SECTION*12 <= 64);
+        uint64_t bits = nextRandom(&shard->rngState);
+        for (int i{}; i < TICK_RANDOM_TICKS_PER_SECTION; ++i, bits >>= 12)
+        {
+            const int x = bits & 0xf;
+            const int y = sectionI*CHUNK_SECTION_HEIGHT+((bits >> 4) & 0xf);
+            const int z = (bits >> 8) & 0xf;
+            ++shard->randomTickCount;
+            if (section->blocks[ChunkSection::getIndex(x, y%CHUNK_SECTION_HEIGHT, z)].type != BLOCK_TYPE_GRASS)
+                continue;
+
+            // Grass dies under opaque blocks, otherwise spreads to the lit dirt around it
+            if (BlockRegistry::isOpaque(view.getBlock(x, y+1, z).type))
+            {
+                shard->actions.push_back({TICK_ACTION_SET, {originX+x, y, originZ+z}, BLOCK_TYPE_GRASS, {BLOCK_TYPE_DIRT}});
+                continue;
+            }
+            for (int tryI{}; tryI < TICK_GRASS_SPREAD_TRIES; ++tryI)
+            {
+                const uint64_t random = nextRandom(&shard->rngState);
+                const int targetX = x+(int)(random%3)-1;
+                const int targetY = y+(int)((random >> 8)%5)-3;
+                const int targetZ = z+(int)((random >> 16)%3)-1;
+                if (view.getBlock(targetX, targetY, targetZ).type != BLOCK_TYPE_DIRT
+                 || BlockRegistry::isOpaque(view.getBlock(targetX, targetY+1, targetZ).type))
+                    continue;
+                const int light = std::max(
+                        view.getLight(LIGHT_SKY, targetX, targetY+1, targetZ),
+                        view.getLight(LIGHT_BLOCK, targetX, targetY+1, targetZ));
+                if (light >= TICK_GRASS_SPREAD_MIN_LIGHT)
+                {
+                    shard->actions.push_back({TICK_ACTION_SET,
+                            {originX+targetX, targetY, originZ+targetZ}, BLOCK_TYPE_DIRT, {BLOCK_TYPE_GRASS}});
+                }
+            }
+        }
+    }
+}
+
+void TickScheduler::tickShard(Shard* shard)
+{
+    shard->actions.clear();
+    shard->randomTickCount = 0;
+    for (const Chunk* chunk : shard->chunks)
+        randomTickChunk(shard, *chunk);
+
+    shard->dueBlocks.clear();
+    shard->wheel.advance(&shard->dueBlocks);
+    const World& world = *m_world;
+    for (const BlockPos& pos : shard->dueBlocks)
+    {
+        // The chunk may have been unloaded since
+        const Chunk* chunk = world.getChunk(World::blockToChunkCoord(pos.x), World::blockToChunkCoord(pos.z));
+        if (!chunk)
+            continue;
+        const int localX = World::blockToLocalCoord(pos.x);
+        const int localZ = World::blockToLocalCoord(pos.z);
+        const BlockType type = chunk->getBlock(localX, pos.y, localZ).type;
+        if (BlockRegistry::isFalling(type) && pos.y > 0
+         && !BlockRegistry::isSolid(chunk->getBlock(localX, pos.y-1, localZ).type))
+        {
+            shard->actions.push_back({TICK_ACTION_FALL, pos, type, {type}});
+        }
+    }
+}
+
+void TickScheduler::applyAction(const TickAction& action, TickStats* stats)
+{
+    const BlockPos& pos = action.pos;
+    if (m_world->getBlock(pos.x, pos.y, pos.z).type != action.expected)
+        return;
+
+    switch (action.type)
+    {
+    case TICK_ACTION_SET:
+        m_world->setBlock(pos.x, pos.y, pos.z, action.block);
+        ++stats->writes;
+        m_changedBlocks.push_back(pos);
+        onBlockChanged(pos);
+        break;
+
+    case TICK_ACTION_FALL:
+        // Something may have been put under it by an earlier action
+        if (BlockRegistry::isSolid(m_world->getBlock(pos.x, pos.y-1, pos.z).type))
+            break;
+        m_world->setBlock(pos.x, pos.y, pos.z, {BLOCK_TYPE_AIR});
+        m_world->setBlock(pos.x, pos.y-1, pos.z, action.block);
+        stats->writes += 2;
+        m_changedBlocks.push_back(pos);
+        m_changedBlocks.push_back({pos.x, pos.y-1, pos.z});
+        onBlockChanged(pos);
+        onBlockChanged({pos.x, pos.y-1, pos.z});
+        break;
+    }
+}
+
+void TickScheduler::updateShardChunks()
+{
+    const auto& chunks = m_world->getChunks();
+    if (chunks.size() == m_shardedChunkCount && m_world->getChunkListVersion() == m_shardedChunkListVersion)
+        return;
+
+    for (Shard& shard : m_shards)
+        shard.chunks.clear();
+    for (const auto& [_, chunk] : chunks)
+        m_shards[getShardI(chunk->getChunkX(), chunk->getChunkZ())].chunks.push_back(chunk.get());
+    m_shardedChunkCount = chunks.size();
+    m_shardedChunkListVersion = m_world->getChunkListVersion();
+}
+
+TickStats TickScheduler::tick()
+{
+    PROFILE_ZONE("TickScheduler::tick");
+
+    updateShardChunks();
+
+    // Only reads the world
+    if (m_pool)
+    {
+        m_pool->parallelFor(m_shards.size(), [&](int i){ tickShard(&m_shards[i]); });
+    }
+    else
+    {
+        for (Shard& shard : m_shards)
+            tickShard(&shard);
+    }
+    ++m_tickI;
+
+    TickStats stats;
+    m_changedBlocks.clear();
+    for (const Shard& shard : m_shards)
+    {
+        stats.randomTicks += shard.randomTickCount;
+        stats.scheduledTicks += shard.dueBlocks.size();
+        for (const TickAction& action : shard.actions)
+            applyAction(action, &stats);
+    }
+    return stats;
+}
+
+size_t TickScheduler::getScheduledCount() const
+{
+    size_t count{};
+    for (const Shard& shard : m_shards)
+        count += shard.wheel.getSize();
+    return count;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "World.h"
+#include "ThreadPool.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Blocks picked at random per tick in each section that has random ticked blocks
+#define TICK_RANDOM_TICKS_PER_SECTION 3
+// The chunks are split into this many shards by their position, ticked in parallel
+#define TICK_SHARD_COUNT 64
+
+#define TICK_WHEEL_SLOT_BITS 6
+#define TICK_WHEEL_SLOT_COUNT (1 << TICK_WHEEL_SLOT_BITS)
+#define TICK_WHEEL_LEVEL_COUNT 4
+// Longer delays are shortened to this, about 3 days at 60 ticks/s
+#define TICK_MAX_DELAY ((1ull << (TICK_WHEEL_SLOT_BITS*TICK_WHEEL_LEVEL_COUNT))-1)
+
+// Ticks a falling block waits before moving down a block
+#define TICK_FALL_DELAY 2
+// Grass spreads to dirt with at least this much light above it
+#define TICK_GRASS_SPREAD_MIN_LIGHT 9
+// Blocks grass tries to spread to per random tick
+#define TICK_GRASS_SPREAD_TRIES 4
+
+/*
+ * Hierarchical timing wheel of block positions, scheduling and taking the due ones are O(1).
+ *
+ * A slot of level N spans 64^N ticks. An entry goes to the lowest level where it isn't due in
+ * the current slot of the level, and when the wheel reaches its slot, it moves down the levels.
+ */
+class TimingWheel final
+{
+private:
+    struct Entry
+    {
+        BlockPos pos;
+        uint64_t dueTick{};
+    };
+
+    std::array<std::array<std::vector<Entry>, TICK_WHEEL_SLOT_COUNT>, TICK_WHEEL_LEVEL_COUNT> m_levels;
+    // The next tick to take
+    uint64_t m_currTick{};
+    size_t m_size{};
+    // Kept to reuse its memory
+    std::vector<Entry> m_cascaded;
+
+    void insert(const Entry& entry);
+
+public:
+    /*
+     * Entries due before the current tick are due at it.
+     */
+    void schedule(BlockPos pos, uint64_t dueTick);
+    /*
+     * Appends the positions due at the current tick to `out`, then steps to the next tick.
+     */
+    void advance(std::vector<BlockPos>* out);
+
+    inline uint64_t getCurrTick() const { return m_currTick; }
+    inline size_t getSize() const { return m_size; }
+};
+
+struct TickStats
+{
+    // Blocks picked by the random ticks, most of them do nothing
+    long randomTicks{};
+    long scheduledTicks{};
+    // Blocks changed by the ticks
+    long writes{};
+};
+
+/*
+ * Runs the random and scheduled block ticks of the loaded chunks.
+ *
+ * The shards decide the block changes in parallel, only reading the world.
+ * The changes are then applied one by one in shard order, each only if the block
+ * is still what the tick saw, so the results don't depend on the thread count.
+ */
+class TickScheduler final
+{
+private:
+    enum TickActionType
+    {
+        // Replace the block
+        TICK_ACTION_SET,
+        // Move the block down one
+        TICK_ACTION_FALL,
+    };
+
+    struct TickAction
+    {
+        TickActionType type{};
+        BlockPos pos;
+        // Skipped if the block changed since
+        BlockType expected{};
+        Block block{};
+    };
+
+    struct Shard
+    {
+        TimingWheel wheel;
+        uint64_t rngState{};
+        // Rebuilt when the chunk set changes, see `tick()`
+        std::vector<const Chunk*> chunks;
+        std::vector<BlockPos> dueBlocks;
+        std::vector<TickAction> actions;
+        long randomTickCount{};
+    };
+
+    World* m_world{};
+    ThreadPool* m_pool{};
+    uint64_t m_tickI{};
+    // The chunk set the shard chunk lists were built from
+    size_t m_shardedChunkCount{};
+    uint64_t m_shardedChunkListVersion{};
+    // Allocated, the wheels are too big for the stack
+    std::vector<Shard> m_shards;
+    std::vector<BlockPos> m_changedBlocks;
+
+    static int getShardI(int chunkX, int chunkZ);
+
+    void updateShardChunks();
+    void tickShard(Shard* shard);
+    void randomTickChunk(Shard* shard, const Chunk& chunk);
+    void applyAction(const TickAction& action, TickStats* stats);
+
+public:
+    /*
+     * With a null pool, the shards are ticked on the calling thread.
+     */
+    TickScheduler(World* world, ThreadPool* pool, uint64_t seed);
+
+    TickScheduler(const TickScheduler&) = delete;
+    TickScheduler& operator=(const TickScheduler&) = delete;
+    TickScheduler(TickScheduler&&) = delete;
+    TickScheduler& operator=(TickScheduler&&) = delete;
+
+    /*
+     * Ticks the block at `pos` after `delay` ticks, at least 1.
+     */
+    void scheduleTick(BlockPos pos, uint64_t delay);
+    /*
+     * Call after a block is changed outside of the ticks, schedules the updates it causes.
+     */
+    void onBlockChanged(BlockPos pos);
+
+    TickStats tick();
+    /*
+     * The blocks changed by the last `tick()`.
+     */
+    inline const std::vector<BlockPos>& getChangedBlocks() const { return m_changedBlocks; }
+
+    inline uint64_t getTickI() const { return m_tickI; }
+    size_t getScheduledCount() const;
+};
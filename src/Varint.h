@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/*
+ * LEB128 variable length integers for the save files: 7 bits per byte, small values are short.
+ */
+namespace Varint
+{
+
+// Longest encoding of a 64-bit value
+#define VARINT_MAX_SIZE 10
+
+inline void write(std::string* out, uint64_t val)
+{
+    while (val >= 0x80)
+    {
+        out->push_back((char)(val | 0x80));
+        val >>= 7;
+    }
+    out->push_back((char)val);
+}
+
+/*
+ * Reads a value and moves `pos` past it.
+ * Returns false if the data ends in the middle of the value or the value is too long.
+ */
+inline bool read(const char** pos, const char* end, uint64_t* out)
+{
+    uint64_t val{};
+    for (int shift{}; shift < VARINT_MAX_SIZE*7 && *pos < end; shift += 7)
+    {
+        const uint8_t byte = *(*pos)++;
+        val |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            *out = val;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Maps signed values to unsigned ones so that small negative values are short too.
+ */
+constexpr uint64_t zigzag(int64_t val) { return ((uint64_t)val << 1) ^ (uint64_t)(val >> 63); }
+constexpr int64_t unzigzag(uint64_t val) { return (int64_t)(val >> 1) ^ -(int64_t)(val & 1); }
+
+} // End of namespace Varint
@@ -0,0 +1,374 @@
+#include "World.h"
+#include "EditJournal.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include "common.h"
+#include <algorithm>
+
+Chunk* World::getChunk(int chunkX, int chunkZ)
+{
+    const auto found = m_chunks.find(getChunkKey(chunkX, chunkZ));
+    return found == m_chunks.end() ? nullptr : found->second.get();
+}
+
+const Chunk* World::getChunk(int chunkX, int chunkZ) const
+{
+    const auto found = m_chunks.find(getChunkKey(chunkX, chunkZ));
+    return found == m_chunks.end() ? nullptr : found->second.get();
+}
+
+void World::linkNeighbours(Chunk* chunk, bool isAdding)
+{
+    for (int dz{-1}; dz <= 1; ++dz)
+    {
+        for (int dx{-1}; dx <= 1; ++dx)
+        {
+            if (dx == 0 && dz == 0)
+                continue;
+
+            Chunk* neighbour = getChunk(chunk->getChunkX()+dx, chunk->getChunkZ()+dz);
+            if (!neighbour)
+                continue;
+            chunk->m_neighbourhood[(dz+1)*3+(dx+1)] = isAdding ? neighbour : nullptr;
+            // We are in the opposite direction from the neighbour
+            neighbour->m_neighbourhood[(-dz+1)*3+(-dx+1)] = isAdding ? chunk : nullptr;
+        }
+    }
+}
+
+Chunk& World::addChunk(std::unique_ptr<Chunk> chunk)
+{
+    const uint64_t key = getChunkKey(chunk->getChunkX(), chunk->getChunkZ());
+    if (m_chunks.contains(key))
+    {
+        Logger::fatal << "Chunk already loaded: " << chunk->getChunkX() << ", " << chunk->getChunkZ() << Logger::End;
+    }
+
+    Chunk* chunkP = chunk.get();
+    m_chunks.emplace(key, std::move(chunk));
+    linkNeighbours(chunkP, true);
+    for (Chunk* neighbour : chunkP->m_neighbourhood)
+    {
+        // The light spreads into the neighbours when the new chunk gets lit
+        if (neighbour != chunkP && neighbour)
+            neighbour->markSectionsDirty(CHUNK_ALL_SECTIONS_MASK, 1u << CHUNK_CACHE_MESH);
+    }
+    return *chunkP;
+}
+
+void World::removeChunk(int chunkX, int chunkZ)
+{
+    const auto found = m_chunks.find(getChunkKey(chunkX, chunkZ));
+    if (found == m_chunks.end())
+        return;
+
+    for (Chunk* neighbour : found->second->m_neighbourhood)
+    {
+        if (neighbour)
+            neighbour->markSectionsDirty(CHUNK_ALL_SECTIONS_MASK, 1u << CHUNK_CACHE_MESH);
+    }
+    linkNeighbours(found->second.get(), false);
+    m_chunks.erase(found);
+    ++m_chunkListVersion;
+}
+
+uint64_t World::computeChecksum() const
+{
+    std::vector<uint64_t> keys;
+    keys.reserve(m_chunks.size());
+    for (const auto& [key, chunk] : m_chunks)
+        keys.push_back(key);
+    std::sort(keys.begin(), keys.end());
+
+    uint64_t hash = fnv1aHash({});
+    for (const uint64_t key : keys)
+    {
+        const Chunk& chunk = *m_chunks.at(key);
+        hash = fnv1aHash({(const char*)&key, sizeof(key)}, hash);
+        for (int i{}; i < CHUNK_SECTION_COUNT; ++i)
+        {
+            // Empty sections hash like all-air ones, whether they are allocated is an implementation detail
+            static const ChunkSection airSection{};
+            const ChunkSection* section = chunk.getSection(i);
+            const auto& blocks = (section ? *section : airSection).blocks;
+            hash = fnv1aHash({(const char*)blocks.data(), blocks.size()*sizeof(Block)}, hash);
+        }
+    }
+    return hash;
+}
+
+ChunkNeighbourhood World::getNeighbourhood(const Chunk& chunk) const
+{
+    ChunkNeighbourhood view;
+    for (size_t i{}; i < view.chunks.size(); ++i)
+        view.chunks[i] = chunk.m_neighbourhood[i];
+    return view;
+}
+
+void World::onBlockSet(Chunk* chunk, BlockPos pos, Block block)
+{
+    // Only the chunk itself changes on disk
+    chunk->markSectionsDirty(1u << (pos.y/CHUNK_SECTION_HEIGHT), 1u << CHUNK_CACHE_SAVE);
+    if (m_journal)
+        m_journal->append(pos, block);
+
+    markBoxDirty(pos, pos, 1u << CHUNK_CACHE_MESH);
+    if (m_changedBlocks.size() < WORLD_MAX_CHANGED_BLOCKS)
+        m_changedBlocks.push_back(pos);
+    else
+        markBoxDirty(pos, pos, 1u << CHUNK_CACHE_LIGHT);
+}
+
+static void sortBounds(BlockPos* min, BlockPos* max)
+{
+    if (min->x > max->x) std::swap(min->x, max->x);
+    if (min->y > max->y) std::swap(min->y, max->y);
+    if (min->z > max->z) std::swap(min->z, max->z);
+}
+
+void World::markBoxDirty(BlockPos min, BlockPos max, uint32_t cacheMask)
+{
+    sortBounds(&min, &max);
+    const int minY = std::max(min.y-1, 0);
+    const int maxY = std::min(max.y+1, CHUNK_HEIGHT_BLOCKS-1);
+    if (minY > maxY)
+        return;
+    const int minSectionI = minY/CHUNK_SECTION_HEIGHT;
+    const int maxSectionI = maxY/CHUNK_SECTION_HEIGHT;
+    const uint32_t sectionMask = ((2u << maxSectionI)-1) & ~((1u << minSectionI)-1);
+
+    for (int chunkZ = blockToChunkCoord(min.z-1); chunkZ <= blockToChunkCoord(max.z+1); ++chunkZ)
+    {
+        for (int chunkX = blockToChunkCoord(min.x-1); chunkX <= blockToChunkCoord(max.x+1); ++chunkX)
+        {
+            if (Chunk* chunk = getChunk(chunkX, chunkZ))
+                chunk->markSectionsDirty(sectionMask, cacheMask);
+        }
+    }
+}
+
+template <typename Func>
+size_t World::editBox(BlockPos min, BlockPos max, Func func)
+{
+    sortBounds(&min, &max);
+    min.y = std::max(min.y, 0);
+    max.y = std::min(max.y, CHUNK_HEIGHT_BLOCKS-1);
+    if (min.y > max.y)
+        return 0;
+
+    size_t writtenCount{};
+    for (int chunkZ = blockToChunkCoord(min.z); chunkZ <= blockToChunkCoord(max.z); ++chunkZ)
+    {
+        for (int chunkX = blockToChunkCoord(min.x); chunkX <= blockToChunkCoord(max.x); ++chunkX)
+        {
+            Chunk* chunk = getChunk(chunkX, chunkZ);
+            if (!chunk)
+                continue;
+
+            SectionSpan span;
+            span.origin.x = chunkX*CHUNK_WIDTH_BLOCKS;
+            span.origin.z = chunkZ*CHUNK_WIDTH_BLOCKS;
+            span.min.x = std::max(min.x-span.origin.x, 0);
+            span.max.x = std::min(max.x-span.origin.x, CHUNK_WIDTH_BLOCKS-1);
+            span.min.z = std::max(min.z-span.origin.z, 0);
+            span.max.z = std::min(max.z-span.origin.z, CHUNK_WIDTH_BLOCKS-1);
+
+            uint32_t writtenSectionMask{};
+            for (int sectionI = min.y/CHUNK_SECTION_HEIGHT; sectionI <= max.y/CHUNK_SECTION_HEIGHT; ++sectionI)
+            {
+                span.origin.y = sectionI*CHUNK_SECTION_HEIGHT;
+                span.min.y = std::max(min.y-span.origin.y, 0);
+                span.max.y = std::min(max.y-span.origin.y, CHUNK_SECTION_HEIGHT-1);
+                const size_t sectionWrittenCount = func(*chunk, sectionI, span);
+                chunk->onSectionWritten(sectionI);
+                if (sectionWrittenCount)
+                    writtenSectionMask |= 1u << sectionI;
+                writtenCount += sectionWrittenCount;
+            }
+            // Only the written sections change on disk
+            chunk->markSectionsDirty(writtenSectionMask, 1u << CHUNK_CACHE_SAVE);
+        }
+    }
+
+    // The light spreads and the faces are culled across the borders, a chunk is relit whole
+    if (writtenCount)
+        markBoxDirty(min, max, (1u << CHUNK_CACHE_MESH) | (1u << CHUNK_CACHE_LIGHT));
+    return writtenCount;
+}
+
+/*
+ * Writes a block and keeps the block counts of the section up to date.
+ */
+static inline void writeBlock(ChunkSection& section, int index, Block block)
+{
+    Block& dst = section.blocks[index];
+    section.nonAirCount += (block.type != BLOCK_TYPE_AIR)-(dst.type != BLOCK_TYPE_AIR);
+    section.randomTickedCount += BlockRegistry::isRandomTicked(block.type)-BlockRegistry::isRandomTicked(dst.type);
+    dst = block;
+}
+
+size_t World::fillBox(BlockPos min, BlockPos max, Block block)
+{
+    PROFILE_ZONE("World::fillBox");
+    const bool isAir = block.type == BLOCK_TYPE_AIR;
+    return editBox(min, max, [&](Chunk& chunk, int sectionI, const SectionSpan& span) -> size_t {
+        // Already air, nothing is written
+        if (isAir && !chunk.getSection(sectionI))
+            return 0;
+        const size_t spanVolume = (size_t)(span.max.x-span.min.x+1)*(span.max.y-span.min.y+1)*(span.max.z-span.min.z+1);
+        // Only the written part, so a replay doesn't fill the chunks that weren't loaded
+        if (m_journal)
+        {
+            m_journal->appendFill({span.origin.x+span.min.x, span.origin.y+span.min.y, span.origin.z+span.min.z},
+                    {span.origin.x+span.max.x, span.origin.y+span.max.y, span.origin.z+span.max.z}, block);
+        }
+
+        ChunkSection& section = chunk.getOrCreateSection(sectionI);
+        if (span.isWholeSection())
+        {
+            section.blocks.fill(block);
+            section.nonAirCount = isAir ? 0 : CHUNK_SECTION_BLOCK_COUNT;
+            section.randomTickedCount = BlockRegistry::isRandomTicked(block.type) ? CHUNK_SECTION_BLOCK_COUNT : 0;
+            return spanVolume;
+        }
+
+        for (int y = span.min.y; y <= span.max.y; ++y)
+        {
+            for (int z = span.min.z; z <= span.max.z; ++z)
+            {
+                for (int x = span.min.x; x <= span.max.x; ++x)
+                    writeBlock(section, ChunkSection::getIndex(x, y, z), block);
+            }
+        }
+        return spanVolume;
+    });
+}
+
+size_t World::replaceInBox(BlockPos min, BlockPos max, BlockType from, Block to)
+{
+    PROFILE_ZONE("World::replaceInBox");
+    return editBox(min, max, [&](Chunk& chunk, int sectionI, const SectionSpan& span) -> size_t {
+        // Nothing to replace in an empty section, unless we replace air
+        if (from != BLOCK_TYPE_AIR && !chunk.getSection(sectionI))
+            return 0;
+
+        ChunkSection& section = chunk.getOrCreateSection(sectionI);
+        size_t writtenCount{};
+        for (int y = span.min.y; y <= span.max.y; ++y)
+        {
+            for (int z = span.min.z; z <= span.max.z; ++z)
+            {
+                for (int x = span.min.x; x <= span.max.x; ++x)
+                {
+                    const int index = ChunkSection::getIndex(x, y, z);
+                    if (section.blocks[index].type == from)
+                    {
+                        writeBlock(section, index, to);
+                        if (m_journal)
+                            m_journal->append({span.origin.x+x, span.origin.y+y, span.origin.z+z}, to);
+                        ++writtenCount;
+                    }
+                }
+            }
+        }
+        return writtenCount;
+    });
+}
+
+size_t World::applySchematic(const Schematic& schematic, BlockPos origin, bool skipAir)
+{
+    PROFILE_ZONE("World::applySchematic");
+    if (schematic.size.x <= 0 || schematic.size.y <= 0 || schematic.size.z <= 0
+     || schematic.blocks.size() != (size_t)schematic.size.x*schematic.size.y*schematic.size.z)
+    {
+        Logger::err << "Invalid schematic, size: " << schematic.size.x << 'x' << schematic.size.y << 'x' << schematic.size.z
+            << ", block count: " << schematic.blocks.size() << Logger::End;
+        return 0;
+    }
+
+    const BlockPos max{origin.x+schematic.size.x-1, origin.y+schematic.size.y-1, origin.z+schematic.size.z-1};
+    return editBox(origin, max, [&](Chunk& chunk, int sectionI, const SectionSpan& span) -> size_t {
+        ChunkSection& section = chunk.getOrCreateSection(sectionI);
+        size_t writtenCount{};
+        for (int y = span.min.y; y <= span.max.y; ++y)
+        {
+            for (int z = span.min.z; z <= span.max.z; ++z)
+            {
+                for (int x = span.min.x; x <= span.max.x; ++x)
+                {
+                    const Block block = schematic.blocks[schematic.getIndex(
+                            span.origin.x+x-origin.x, span.origin.y+y-origin.y, span.origin.z+z-origin.z)];
+                    if (skipAir && block.type == BLOCK_TYPE_AIR)
+                        continue;
+                    writeBlock(section, ChunkSection::getIndex(x, y, z), block);
+                    if (m_journal)
+                        m_journal->append({span.origin.x+x, span.origin.y+y, span.origin.z+z}, block);
+                    ++writtenCount;
+                }
+            }
+        }
+        return writtenCount;
+    });
+}
+
+/*
+ * Whether the light has to be updated around a block changing from `prev` to `next`.
+ */
+static inline bool changesLight(BlockType prev, BlockType next)
+{
+    return BlockRegistry::isOpaque(prev) != BlockRegistry::isOpaque(next)
+        || BlockRegistry::getLightEmission(prev) != BlockRegistry::getLightEmission(next);
+}
+
+size_t World::setBlocks(const std::vector<BlockEdit>& edits)
+{
+    PROFILE_ZONE("World::setBlocks");
+    size_t writtenCount{};
+    Chunk* chunk{};
+    // Bounds of the edits of `chunk` so far
+    BlockPos dirtyMin;
+    BlockPos dirtyMax;
+    auto flushDirty{[&](){
+        if (chunk)
+            markBoxDirty(dirtyMin, dirtyMax, 1u << CHUNK_CACHE_MESH);
+    }};
+
+    for (const BlockEdit& edit : edits)
+    {
+        const BlockPos& pos = edit.pos;
+        if (pos.y < 0 || pos.y >= CHUNK_HEIGHT_BLOCKS)
+            continue;
+        const int chunkX = blockToChunkCoord(pos.x);
+        const int chunkZ = blockToChunkCoord(pos.z);
+        if (!chunk || chunk->getChunkX() != chunkX || chunk->getChunkZ() != chunkZ)
+        {
+            flushDirty();
+            chunk = getChunk(chunkX, chunkZ);
+            if (!chunk)
+                continue;
+            dirtyMin = pos;
+            dirtyMax = pos;
+        }
+
+        const int localX = blockToLocalCoord(pos.x);
+        const int localZ = blockToLocalCoord(pos.z);
+        const BlockType prevType = chunk->getBlock(localX, pos.y, localZ).type;
+        chunk->setBlock(localX, pos.y, localZ, edit.block);
+        chunk->markSectionsDirty(1u << (pos.y/CHUNK_SECTION_HEIGHT), 1u << CHUNK_CACHE_SAVE);
+        if (m_journal)
+            m_journal->append(pos, edit.block);
+        ++writtenCount;
+        dirtyMin = {std::min(dirtyMin.x, pos.x), std::min(dirtyMin.y, pos.y), std::min(dirtyMin.z, pos.z)};
+        dirtyMax = {std::max(dirtyMax.x, pos.x), std::max(dirtyMax.y, pos.y), std::max(dirtyMax.z, pos.z)};
+
+        if (changesLight(prevType, edit.block.type))
+        {
+            if (m_changedBlocks.size() < WORLD_MAX_CHANGED_BLOCKS)
+                m_changedBlocks.push_back(pos);
+            else
+                markBoxDirty(pos, pos, 1u << CHUNK_CACHE_LIGHT);
+        }
+    }
+    flushDirty();
+    return writtenCount;
+}
@@ -0,0 +1,293 @@
+#pragma once
+
+#include "Chunk.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <utility>
+
+// Single-block edits kept for the light engine between updates,
+// after this many the chunks are relit instead, see `World::takeChangedBlocks()`
+#define WORLD_MAX_CHANGED_BLOCKS 4096
+
+class World;
+class EditJournal;
+
+struct BlockPos
+{
+    int x{};
+    int y{};
+    int z{};
+};
+
+struct BlockEdit
+{
+    BlockPos pos;
+    Block block{};
+};
+
+/*
+ * A box of blocks that can be pasted into the world.
+ */
+struct Schematic
+{
+    BlockPos size;
+    // Indexing: [y][z][x], see `getIndex()`
+    std::vector<Block> blocks;
+
+    inline size_t getIndex(int x, int y, int z) const { return ((size_t)y*size.z+z)*size.x+x; }
+};
+
+/*
+ * Block lookup by world coordinates that remembers the last chunk it used,
+ * and reaches the neighbours of that through their pointers, so coherent
+ * access rarely needs a hash lookup.
+ *
+ * Not thread-safe, use one per thread.
+ */
+class BlockAccessor final
+{
+private:
+    World* m_world{};
+    Chunk* m_lastChunk{};
+    // `World::m_chunkListVersion` when `m_lastChunk` was set
+    uint64_t m_chunkListVersion{};
+
+    inline Chunk* findChunk(int chunkX, int chunkZ);
+
+public:
+    explicit BlockAccessor(World* world)
+        : m_world{world}
+    {
+    }
+
+    /*
+     * Returns air outside the loaded chunks and the height limits.
+     */
+    inline Block getBlock(int x, int y, int z);
+    /*
+     * Returns false if the chunk isn't loaded or `y` is out of range.
+     */
+    inline bool setBlock(int x, int y, int z, Block block);
+};
+
+/*
+ * A 3x3 chunk window, for code that looks at neighbouring blocks,
+ * like meshing and lighting. It doesn't do any hash lookups.
+ */
+struct ChunkNeighbourhood
+{
+    // Indexed by `(dz+1)*3+(dx+1)`, null if not loaded
+    std::array<const Chunk*, 9> chunks{};
+
+    /*
+     * `x` and `z` are relative to the middle chunk, in [-16, 32).
+     * Returns air for chunks that aren't loaded and outside the height limits.
+     */
+    inline Block getBlock(int x, int y, int z) const
+    {
+        if (y < 0 || y >= CHUNK_HEIGHT_BLOCKS)
+            return {};
+        const Chunk* chunk = chunks[((z+CHUNK_WIDTH_BLOCKS)/CHUNK_WIDTH_BLOCKS)*3+(x+CHUNK_WIDTH_BLOCKS)/CHUNK_WIDTH_BLOCKS];
+        return chunk ? chunk->getBlock(x&(CHUNK_WIDTH_BLOCKS-1), y, z&(CHUNK_WIDTH_BLOCKS-1)) : Block{};
+    }
+    /*
+     * Takes the same coordinates as `getBlock()`.
+     * Unloaded chunks and the space above the world have the default light.
+     */
+    inline uint8_t getLight(LightType type, int x, int y, int z) const
+    {
+        if (y < 0)
+            return 0;
+        if (y >= CHUNK_HEIGHT_BLOCKS)
+            return Chunk::getDefaultLight(type);
+        const Chunk* chunk = chunks[((z+CHUNK_WIDTH_BLOCKS)/CHUNK_WIDTH_BLOCKS)*3+(x+CHUNK_WIDTH_BLOCKS)/CHUNK_WIDTH_BLOCKS];
+        return chunk ? chunk->getLight(type, x&(CHUNK_WIDTH_BLOCKS-1), y, z&(CHUNK_WIDTH_BLOCKS-1)) : Chunk::getDefaultLight(type);
+    }
+
+    inline const Chunk& getMiddle() const { return *chunks[4]; }
+};
+
+/*
+ * Owns the loaded chunks and gives access to the blocks by world coordinates.
+ */
+class World final
+{
+private:
+    std::unordered_map<uint64_t, std::unique_ptr<Chunk>> m_chunks;
+    // Changed whenever a chunk is removed, so accessors drop their pointers
+    uint64_t m_chunkListVersion{};
+    // Used by `getBlock()` and `setBlock()`
+    BlockAccessor m_accessor{this};
+    std::vector<BlockPos> m_changedBlocks;
+    // Null if the edits aren't saved
+    EditJournal* m_journal{};
+
+    friend class BlockAccessor;
+
+    void linkNeighbours(Chunk* chunk, bool isAdding);
+    // Called by `BlockAccessor::setBlock()`
+    void onBlockSet(Chunk* chunk, BlockPos pos, Block block);
+
+    /*
+     * Local, inclusive bounds of the part of a section inside a box.
+     */
+    struct SectionSpan
+    {
+        BlockPos min;
+        BlockPos max;
+        // World position of the local origin of the section
+        BlockPos origin;
+
+        inline bool isWholeSection() const
+        {
+            return min.x == 0 && min.y == 0 && min.z == 0
+                && max.x == CHUNK_WIDTH_BLOCKS-1 && max.y == CHUNK_SECTION_HEIGHT-1 && max.z == CHUNK_WIDTH_BLOCKS-1;
+        }
+    };
+
+    /*
+     * Calls `func(chunk, sectionI, span)` for each section of the loaded chunks that
+     * intersects the box, `func` returns the number of blocks it wrote. Marks the written
+     * sections for saving, then the box dirty once for the other caches. Returns the sum.
+     */
+    template <typename Func>
+    size_t editBox(BlockPos min, BlockPos max, Func func);
+
+public:
+    World() = default;
+    World(const World&) = delete;
+    World& operator=(const World&) = delete;
+    World(World&&) = delete;
+    World& operator=(World&&) = delete;
+
+    static inline uint64_t getChunkKey(int chunkX, int chunkZ)
+    {
+        return ((uint64_t)(uint32_t)chunkX << 32) | (uint32_t)chunkZ;
+    }
+
+    static inline int blockToChunkCoord(int blockCoord) { return blockCoord >> 4; }
+    static inline int blockToLocalCoord(int blockCoord) { return blockCoord & (CHUNK_WIDTH_BLOCKS-1); }
+
+    /*
+     * Returns null if the chunk isn't loaded.
+     */
+    Chunk* getChunk(int chunkX, int chunkZ);
+    const Chunk* getChunk(int chunkX, int chunkZ) const;
+    inline const std::unordered_map<uint64_t, std::unique_ptr<Chunk>>& getChunks() const { return m_chunks; }
+    /*
+     * Changes when a chunk is removed, with the chunk count it tells if the chunk set changed.
+     */
+    inline uint64_t getChunkListVersion() const { return m_chunkListVersion; }
+
+    /*
+     * Also marks the neighbours dirty, their border faces and light change.
+     */
+    Chunk& addChunk(std::unique_ptr<Chunk> chunk);
+    void removeChunk(int chunkX, int chunkZ);
+
+    /*
+     * Shortcuts for the main thread, other threads need their own `BlockAccessor`.
+     */
+    inline Block getBlock(int x, int y, int z) { return m_accessor.getBlock(x, y, z); }
+    inline bool setBlock(int x, int y, int z, Block block) { return m_accessor.setBlock(x, y, z, block); }
+
+    ChunkNeighbourhood getNeighbourhood(const Chunk& chunk) const;
+
+    /*
+     * Hash of the blocks of the loaded chunks, independent of the order they were loaded in.
+     * Reads every block, for checking that runs are deterministic.
+     */
+    uint64_t computeChecksum() const;
+
+    /*
+     * Every edit is appended to the journal from now on, null stops it.
+     * The edited sections are marked dirty for `CHUNK_CACHE_SAVE` either way.
+     */
+    inline void setJournal(EditJournal* journal) { m_journal = journal; }
+
+    /*
+     * Marks the sections dirty that intersect the box grown by one block,
+     * as the meshes and light of the neighbours depend on the box too.
+     * `cacheMask` has a bit per `ChunkCache`.
+     */
+    void markBoxDirty(BlockPos min, BlockPos max, uint32_t cacheMask);
+
+    /*
+     * Returns the blocks set one by one since the last call, for the incremental light update.
+     * Batched edits mark the light dirty instead.
+     */
+    inline std::vector<BlockPos> takeChangedBlocks() { return std::exchange(m_changedBlocks, {}); }
+
+    /*
+     * Batched edits. They write the chunk storage directly and mark each affected section
+     * dirty once, no matter how many blocks change. The bounds are inclusive, the parts
+     * outside the loaded chunks are skipped. Return the number of blocks written.
+     */
+    size_t fillBox(BlockPos min, BlockPos max, Block block);
+    size_t replaceInBox(BlockPos min, BlockPos max, BlockType from, Block to);
+    /*
+     * `origin` is where the (0, 0, 0) block of the schematic goes.
+     * With `skipAir`, the air blocks of the schematic leave the world unchanged.
+     */
+    size_t applySchematic(const Schematic& schematic, BlockPos origin, bool skipAir);
+    /*
+     * Scattered single-block edits, like the ones of the fluids. Consecutive edits in the
+     * same chunk share the chunk lookup and mark the sections around them dirty once,
+     * so sort them by chunk. Only the blocks that change how the light spreads are
+     * queued for the light update. Edits outside the loaded chunks are skipped.
+     */
+    size_t setBlocks(const std::vector<BlockEdit>& edits);
+};
+
+//------------------------------------------------------------------------------
+
+inline Chunk* BlockAccessor::findChunk(int chunkX, int chunkZ)
+{
+    if (m_lastChunk && m_chunkListVersion == m_world->m_chunkListVersion)
+    {
+        const int dx = chunkX-m_lastChunk->getChunkX();
+        const int dz = chunkZ-m_lastChunk->getChunkZ();
+        if (dx == 0 && dz == 0)
+            return m_lastChunk;
+        if (dx >= -1 && dx <= 1 && dz >= -1 && dz <= 1)
+        {
+            if (Chunk* neighbour = m_lastChunk->getNeighbour(dx, dz))
+                return m_lastChunk = neighbour;
+        }
+    }
+
+    Chunk* chunk = m_world->getChunk(chunkX, chunkZ);
+    if (chunk)
+    {
+        m_lastChunk = chunk;
+        m_chunkListVersion = m_world->m_chunkListVersion;
+    }
+    return chunk;
+}
+
+inline Block BlockAccessor::getBlock(int x, int y, int z)
+{
+    if (y < 0 || y >= CHUNK_HEIGHT_BLOCKS)
+        return {};
+    const Chunk* chunk = findChunk(World::blockToChunkCoord(x), World::blockToChunkCoord(z));
+    return chunk ? chunk->getBlock(World::blockToLocalCoord(x), y, World::blockToLocalCoord(z)) : Block{};
+}
+
+inline bool BlockAccessor::setBlock(int x, int y, int z, Block block)
+{
+    if (y < 0 || y >= CHUNK_HEIGHT_BLOCKS)
+        return false;
+    Chunk* chunk = findChunk(World::blockToChunkCoord(x), World::blockToChunkCoord(z));
+    if (!chunk)
+        return false;
+    const int localX = World::blockToLocalCoord(x);
+    const int localZ = World::blockToLocalCoord(z);
+    const Block prev = chunk->getBlock(localX, y, localZ);
+    if (prev.type == block.type && prev.state == block.state)
+        return true;
+    chunk->setBlock(localX, y, localZ, block);
+    m_world->onBlockSet(chunk, {x, y, z}, block);
+    return true;
+}
@@ -0,0 +1,85 @@
+#include "WorldGen.h"
+#include "Profiler.h"
+#include "../deps/OpenSimplexNoise/OpenSimplexNoise/OpenSimplexNoise.h"
+#include <cmath>
+
+namespace WorldGen
+{
+
+static OpenSimplexNoise::Noise s_noiseGen;
+
+void setSeed(uint64_t seed)
+{
+    s_noiseGen = OpenSimplexNoise::Noise{(int64_t)seed};
+}
+
+std::unique_ptr<Chunk> genChunk(int chunkX, int chunkZ)
+{
+    PROFILE_ZONE("WorldGen::genChunk");
+
+    auto chunk = std::make_unique<Chunk>(chunkX, chunkZ);
+
+    for (int offsX{}; offsX < CHUNK_WIDTH_BLOCKS; ++offsX)
+    {
+        for (int offsZ{}; offsZ < CHUNK_WIDTH_BLOCKS; ++offsZ)
+        {
+            const int x = chunkX*CHUNK_WIDTH_BLOCKS+offsX;
+            const int z = chunkZ*CHUNK_WIDTH_BLOCKS+offsZ;
+
+            const int groundHeight = 50+std::round((s_noiseGen.eval(x/500.0f, z/500.0f)+0.5f)*(GROUND_HEIGHT_MAX-50));
+            for (int y{}; y < GROUND_HEIGHT_MAX; ++y)
+            {
+                BlockType type = BLOCK_TYPE_AIR;
+                if (y <= groundHeight)
+                {
+                    // TODO: More stone types
+                    // TODO: Ores
+                    const int grassLayerHeight = 1;
+                    const int dirtLayerHeight = 5+10*(s_noiseGen.eval(x/54.0f, z/54.0f)+0.5f);
+                    const int stoneLayerHeight = groundHeight*0.75f-20*(s_noiseGen.eval(x/20.0f, z/20.0f)+0.5f);
+                    const int bedrockLayerHeight = 1+2*(s_noiseGen.eval(x/5.0f, z/5.0f)+0.5f);
+                    const int isDirtBlob = y > 20 && s_noiseGen.eval(x/8.0f, z/8.0f, y/8.0f) >= 0.4f;
+                    const int isCoalOreBlob = s_noiseGen.eval(x/7.0f+10, z/7.0f+10, y/7.0f+10) >= 0.6f; // Coal or deepslate coal
+                    if (y <= bedrockLayerHeight)
+                    {
+                        type = BLOCK_TYPE_BEDROCK;
+                    }
+                    else if (y > groundHeight-grassLayerHeight)
+                    {
+                        type = BLOCK_TYPE_GRASS;
+                    }
+                    else if (isDirtBlob || y > groundHeight-grassLayerHeight-dirtLayerHeight)
+                    {
+                        type = BLOCK_TYPE_DIRT;
+                    }
+                    else if (y > groundHeight-grassLayerHeight-dirtLayerHeight-stoneLayerHeight)
+                    {
+                        if (isCoalOreBlob)
+                        {
+                            type = BLOCK_TYPE_COAL_ORE;
+                        }
+                        else
+                        {
+                            type = BLOCK_TYPE_STONE;
+                        }
+                    }
+                    else
+                    {
+                        if (isCoalOreBlob)
+                        {
+                            type = BLOCK_TYPE_DEEPSLATE_COAL_ORE;
+                        }
+                        else
+                        {
+                            type = BLOCK_TYPE_DEEPSLATE;
+                        }
+                    }
+                }
+                chunk->setBlock(offsX, y, offsZ, {type});
+            }
+        }
+    }
+    return chunk;
+}
+
+} // End of namespace WorldGen
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Chunk.h"
+#include <cstdint>
+#include <memory>
+
+#define GROUND_HEIGHT_MAX 384
+static_assert(GROUND_HEIGHT_MAX <= CHUNK_HEIGHT_BLOCKS);
+
+/*
+ * Terrain generation, shared by the game and the server.
+ */
+namespace WorldGen
+{
+
+/*
+ * Call before generating any chunk.
+ */
+void setSeed(uint64_t seed);
+/*
+ * Only reads the noise, so chunks can be generated on several threads at once.
+ */
+std::unique_ptr<Chunk> genChunk(int chunkX, int chunkZ);
+
+} // End of namespace WorldGen
@@ -0,0 +1,276 @@
+#include "WorldStore.h"
+#include "MappedFile.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+
+bool WorldStore::open(const std::string& dirPath, uint64_t* seed)
+{
+    if (!m_regions.open(dirPath+"/" WORLD_STORE_REGION_DIR))
+        return false;
+
+    const std::string infoPath = dirPath+"/" WORLD_STORE_INFO_FILE;
+    WorldInfoFile info;
+    std::error_code ec;
+    if (std::filesystem::exists(infoPath, ec))
+    {
+        MappedFile file;
+        if (file.open(infoPath) && file.size() == sizeof(info))
+            std::memcpy(&info, file.data(), sizeof(info));
+        if (std::memcmp(info.magic, WORLD_INFO_MAGIC, 4) != 0 || info.version != WORLD_INFO_VERSION)
+        {
+            Logger::err << "Invalid or outdated world info file: \"" << infoPath << '"' << Logger::End;
+            return false;
+        }
+        *seed = info.seed;
+    }
+    else
+    {
+        // A new world, or one saved before the info file existed
+        std::memcpy(info.magic, WORLD_INFO_MAGIC, 4);
+        info.version = WORLD_INFO_VERSION;
+        info.seed = *seed;
+        if (!writeFileAtomically(infoPath, {reinterpret_cast<const char*>(&info), sizeof(info)}))
+            return false;
+    }
+
+    m_dirPath = dirPath;
+    return true;
+}
+
+std::string WorldStore::getSegmentPath(uint64_t segmentI) const
+{
+    return m_dirPath+"/" WORLD_STORE_JOURNAL_PREFIX+std::to_string(segmentI)+WORLD_STORE_JOURNAL_SUFFIX;
+}
+
+std::vector<uint64_t> WorldStore::findSegments() const
+{
+    static constexpr std::string_view prefix = WORLD_STORE_JOURNAL_PREFIX;
+    static constexpr std::string_view suffix = WORLD_STORE_JOURNAL_SUFFIX;
+
+    std::vector<uint64_t> segments;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator{m_dirPath, ec})
+    {
+        const std::string name = entry.path().filename().string();
+        if (name.size() <= prefix.size()+suffix.size() || !name.starts_with(prefix) || !name.ends_with(suffix))
+            continue;
+        uint64_t segmentI{};
+        const char* const end = name.data()+name.size()-suffix.size();
+        const auto result = std::from_chars(name.data()+prefix.size(), end, segmentI);
+        if (result.ec == std::errc{} && result.ptr == end)
+            segments.push_back(segmentI);
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+void WorldStore::deleteSegmentsBefore(uint64_t segmentI) const
+{
+    for (const uint64_t oldSegmentI : findSegments())
+    {
+        if (oldSegmentI >= segmentI)
+            break;
+        std::error_code ec;
+        std::filesystem::remove(getSegmentPath(oldSegmentI), ec);
+    }
+}
+
+bool WorldStore::attach(World* world, const ChunkLoader& loader)
+{
+    detach();
+
+    const auto startTime = std::chrono::steady_clock::now();
+    const std::vector<uint64_t> segments = findSegments();
+    JournalReplayStats stats;
+    for (const uint64_t segmentI : segments)
+    {
+        const JournalReplayStats segmentStats = EditJournal::replay(getSegmentPath(segmentI), world, loader);
+        stats.batchCount += segmentStats.batchCount;
+        stats.editCount += segmentStats.editCount;
+    }
+    if (stats.editCount)
+    {
+        Logger::log << "Recovered " << stats.editCount << " edits from " << stats.batchCount
+            << " journal batches in "
+            << std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-startTime).count()
+            << "ms" << Logger::End;
+    }
+
+    // Save the recovered edits (and the newly generated chunks) before the old segments are deleted
+    m_world = world;
+    m_segmentI = segments.empty() ? 0 : segments.back()+1;
+    if (!saveNow() || !m_journal.open(getSegmentPath(m_segmentI)))
+    {
+        m_world = nullptr;
+        return false;
+    }
+    deleteSegmentsBefore(m_segmentI);
+
+    m_isStopping = false;
+    m_writerThread = std::thread{&WorldStore::writerMain, this};
+    world->setJournal(&m_journal);
+    return true;
+}
+
+void WorldStore::markFailedChunksDirty()
+{
+    for (const auto& [chunkX, chunkZ] : m_failedChunks)
+    {
+        // Can't happen if the chunks are only unloaded when `isChunkSaved()`
+        Chunk* chunk = m_world->getChunk(chunkX, chunkZ);
+        if (!chunk)
+        {
+            Logger::err << "Chunk " << chunkX << ", " << chunkZ
+                << " was unloaded before it could be saved, its edits are lost" << Logger::End;
+            continue;
+        }
+        chunk->markSectionsDirty(CHUNK_ALL_SECTIONS_MASK, 1u << CHUNK_CACHE_SAVE);
+    }
+    m_failedChunks.clear();
+}
+
+std::vector<ChunkSnapshot> WorldStore::takeDirtySnapshots()
+{
+    markFailedChunksDirty();
+
+    std::vector<ChunkSnapshot> snapshots;
+    snapshots.reserve(m_world->getChunks().size());
+    for (const auto& [key, chunk] : m_world->getChunks())
+    {
+        if (chunk->takeDirtySections(CHUNK_CACHE_SAVE))
+            snapshots.push_back(chunk->takeSnapshot());
+    }
+    return snapshots;
+}
+
+size_t WorldStore::checkpoint()
+{
+    if (!m_world)
+        return 0;
+    PROFILE_ZONE("WorldStore::checkpoint");
+
+    const std::lock_guard lock{m_writerMutex};
+    if (m_isCheckpointRunning)
+        return 0;
+    m_snapshots = takeDirtySnapshots();
+    if (m_snapshots.empty())
+        return 0;
+
+    // The edits from now on aren't in the snapshots
+    m_journal.rotate(getSegmentPath(++m_segmentI));
+    m_isCheckpointRunning = true;
+    m_writerCv.notify_all();
+    return m_snapshots.size();
+}
+
+void WorldStore::waitForCheckpoint()
+{
+    std::unique_lock lock{m_writerMutex};
+    m_writerCv.wait(lock, [&](){ return !m_isCheckpointRunning; });
+}
+
+bool WorldStore::isCheckpointRunning()
+{
+    const std::lock_guard lock{m_writerMutex};
+    return m_isCheckpointRunning;
+}
+
+bool WorldStore::isChunkSaved(const Chunk& chunk)
+{
+    const std::lock_guard lock{m_writerMutex};
+    if (m_isCheckpointRunning)
+        return false;
+    // Dirty again if it failed
+    markFailedChunksDirty();
+    return !chunk.getDirtySections(CHUNK_CACHE_SAVE);
+}
+
+void WorldStore::writerMain()
+{
+    PROFILE_THREAD_NAME("World writer");
+    std::unique_lock lock{m_writerMutex};
+    while (true)
+    {
+        m_writerCv.wait(lock, [&](){ return m_isStopping || !m_snapshots.empty(); });
+        if (m_snapshots.empty())
+            break;
+
+        std::vector<ChunkSnapshot> snapshots = std::move(m_snapshots);
+        m_snapshots.clear();
+        const uint64_t segmentI = m_segmentI;
+        lock.unlock();
+
+        const bool isSaved = m_regions.saveChunks(snapshots);
+        if (isSaved)
+        {
+            // Closes the segments before `segmentI`, unless the rotation failed and we are still writing them
+            m_journal.commit();
+            if (m_journal.getPath() == getSegmentPath(segmentI))
+                deleteSegmentsBefore(segmentI);
+        }
+
+        lock.lock();
+        if (!isSaved)
+        {
+            for (const ChunkSnapshot& snapshot : snapshots)
+                m_failedChunks.push_back({snapshot.chunkX, snapshot.chunkZ});
+        }
+        // Let the sections go before the next edits, so they aren't copied for nothing
+        snapshots.clear();
+        m_isCheckpointRunning = false;
+        m_writerCv.notify_all();
+    }
+}
+
+bool WorldStore::saveNow()
+{
+    waitForCheckpoint();
+    std::vector<ChunkSnapshot> snapshots;
+    {
+        const std::lock_guard lock{m_writerMutex};
+        snapshots = takeDirtySnapshots();
+    }
+    if (snapshots.empty() || m_regions.saveChunks(snapshots))
+        return true;
+
+    const std::lock_guard lock{m_writerMutex};
+    for (const ChunkSnapshot& snapshot : snapshots)
+        m_failedChunks.push_back({snapshot.chunkX, snapshot.chunkZ});
+    return false;
+}
+
+void WorldStore::detach()
+{
+    if (!m_world)
+        return;
+
+    m_world->setJournal(nullptr);
+    {
+        const std::lock_guard lock{m_writerMutex};
+        m_isStopping = true;
+    }
+    m_writerCv.notify_all();
+    m_writerThread.join();
+
+    m_journal.close();
+    if (saveNow())
+    {
+        deleteSegmentsBefore(m_segmentI+1);
+    }
+    else
+    {
+        Logger::err << "Failed to save the world, keeping the journal for the next run" << Logger::End;
+    }
+    m_world = nullptr;
+}
+
+WorldStore::~WorldStore()
+{
+    detach();
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "RegionStore.h"
+#include "EditJournal.h"
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define WORLD_STORE_REGION_DIR "region"
+// Settings of the world that the saved chunks depend on, see `WorldInfoFile`
+#define WORLD_STORE_INFO_FILE "world.bin"
+#define WORLD_INFO_MAGIC "ACWD"
+#define WORLD_INFO_VERSION 1
+// The journal is split into numbered segments, each checkpoint starts a new one
+#define WORLD_STORE_JOURNAL_PREFIX "journal."
+#define WORLD_STORE_JOURNAL_SUFFIX ".bin"
+
+struct WorldInfoFile
+{
+    char magic[4]{};
+    uint32_t version{};
+    // The chunks that aren't saved yet are generated with it
+    uint64_t seed{};
+};
+
+/*
+ * A saved world: the chunks in region files, and the edits since the last checkpoint in a journal.
+ *
+ * The edits are journaled as they happen. A checkpoint snapshots the edited chunks and
+ * starts a new journal segment, then a writer thread writes the snapshots to the region files
+ * and deletes the older segments. The world is only paused for the snapshot, the sections are
+ * shared with it and copied when written, see `ChunkSnapshot`.
+ * After a crash the segments are replayed on top of the region files.
+ */
+class WorldStore final
+{
+private:
+    std::string m_dirPath;
+    RegionStore m_regions;
+    EditJournal m_journal;
+    World* m_world{};
+    // The journal segment that the new edits go to
+    uint64_t m_segmentI{};
+
+    // Guards the checkpoint handed to the writer thread
+    std::mutex m_writerMutex;
+    std::condition_variable m_writerCv;
+    std::vector<ChunkSnapshot> m_snapshots;
+    bool m_isCheckpointRunning{};
+    bool m_isStopping{};
+    // The writer couldn't save these, they are saved again by the next checkpoint
+    std::vector<std::pair<int, int>> m_failedChunks;
+    std::thread m_writerThread;
+
+    std::string getSegmentPath(uint64_t segmentI) const;
+    /*
+     * Returns the indices of the journal segments in the directory, in order.
+     */
+    std::vector<uint64_t> findSegments() const;
+    void deleteSegmentsBefore(uint64_t segmentI) const;
+    /*
+     * Marks the chunks the writer failed to save dirty again, so the next checkpoint retries them.
+     * Call with `m_writerMutex` held.
+     */
+    void markFailedChunksDirty();
+    /*
+     * Snapshots the chunks edited since their last save, and the ones the writer failed to save.
+     * Call with `m_writerMutex` held.
+     */
+    std::vector<ChunkSnapshot> takeDirtySnapshots();
+    /*
+     * Waits for the running checkpoint, then saves the edited chunks on this thread.
+     * Returns false on error.
+     */
+    bool saveNow();
+    void writerMain();
+
+public:
+    WorldStore() = default;
+
+    WorldStore(const WorldStore&) = delete;
+    WorldStore& operator=(const WorldStore&) = delete;
+    WorldStore(WorldStore&&) = delete;
+    WorldStore& operator=(WorldStore&&) = delete;
+
+    /*
+     * Creates the directories if needed. A new world is created with `*seed`,
+     * for an existing one `*seed` is set to the seed it was created with.
+     * Returns false on error.
+     */
+    bool open(const std::string& dirPath, uint64_t* seed);
+
+    /*
+     * Returns null if the chunk was never saved.
+     */
+    inline std::unique_ptr<Chunk> loadChunk(int chunkX, int chunkZ) const { return m_regions.loadChunk(chunkX, chunkZ); }
+
+    /*
+     * Replays the journal left by the last run into the loaded chunks, saves them,
+     * then journals the edits of `world` until `detach()`. Call after loading the chunks,
+     * or pass a `loader` for the journaled chunks that aren't loaded.
+     * Returns false on error.
+     */
+    bool attach(World* world, const ChunkLoader& loader={});
+    /*
+     * Snapshots the chunks edited since the last checkpoint and hands them to the writer thread.
+     * Call from the thread that edits the world. Returns the number of chunks,
+     * 0 if none were edited or the previous checkpoint is still being written.
+     */
+    size_t checkpoint();
+    /*
+     * Waits for the writer thread to finish the running checkpoint.
+     */
+    void waitForCheckpoint();
+    bool isCheckpointRunning();
+    /*
+     * Whether everything in `chunk` is in the region files, so it can be unloaded without
+     * losing edits. False while a checkpoint is being written, its snapshots aren't on the disk
+     * yet, and for the chunks the writer failed to save. Call from the thread that edits the world.
+     */
+    bool isChunkSaved(const Chunk& chunk);
+    /*
+     * Saves everything and stops journaling. Called by the destructor too.
+     */
+    void detach();
+
+    inline EditJournal& getJournal() { return m_journal; }
+
+    ~WorldStore();
+};
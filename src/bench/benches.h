@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+
+class World;
+
+/*
+ * Each benchmark gets the arguments after its name and returns the exit code.
+ */
+int runObjBench(int argc, char** argv);
+int runWorldBench(int argc, char** argv);
+int runEditBench(int argc, char** argv);
+int runRaycastBench(int argc, char** argv);
+int runLightBench(int argc, char** argv);
+int runMeshBench(int argc, char** argv);
+int runRenderBench(int argc, char** argv);
+int runTickBench(int argc, char** argv);
+int runFloodBench(int argc, char** argv);
+int runJournalBench(int argc, char** argv);
+int runSnapshotBench(int argc, char** argv);
+
+namespace BenchUtils
+{
+
+class Stopwatch final
+{
+private:
+    std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+
+public:
+    inline void restart() { m_start = std::chrono::steady_clock::now(); }
+    inline double getElapsedMs() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-m_start).count();
+    }
+};
+
+/*
+ * Parses the `i`th argument as a number, or returns `defaultVal` if there is none.
+ */
+long getArgOr(int argc, char** argv, int i, long defaultVal);
+
+/*
+ * Fills the chunks in [-radius, radius) with rolling hills of stone under a dirt layer topped with grass,
+ * `groundHeight` high on average.
+ */
+void generateHills(World* world, int radius, int groundHeight);
+
+} // End of namespace BenchUtils
@@ -0,0 +1,133 @@
+#include "benches.h"
+#include "../World.h"
+#include "../ChunkMesher.h"
+#include "../Logger.h"
+#include <bit>
+#include <memory>
+
+#define EDIT_BENCH_DEFAULT_SIZE 256
+
+static void addEmptyChunks(World* world, int widthChunks)
+{
+    for (int chunkZ{}; chunkZ < widthChunks; ++chunkZ)
+    {
+        for (int chunkX{}; chunkX < widthChunks; ++chunkX)
+            world->addChunk(std::make_unique<Chunk>(chunkX, chunkZ));
+    }
+}
+
+/*
+ * Clears the dirty bits left by the previous step and returns their number.
+ */
+static long takeDirtyCount(World* world, ChunkCache cache)
+{
+    long count{};
+    for (const auto& [_, chunk] : world->getChunks())
+        count += std::popcount(chunk->takeDirtySections(cache));
+    return count;
+}
+
+static void printResult(const char* name, double elapsedMs, size_t blockCount)
+{
+    Logger::log << name << ": " << blockCount << " blocks in " << elapsedMs << "ms, "
+        << blockCount/(elapsedMs/1000)/1e6 << " M blocks/s" << Logger::End;
+}
+
+int runEditBench(int argc, char** argv)
+{
+    const int size = BenchUtils::getArgOr(argc, argv, 0, EDIT_BENCH_DEFAULT_SIZE);
+    if (size <= 0 || size > CHUNK_HEIGHT_BLOCKS)
+    {
+        Logger::err << "The size has to be in [1, " << CHUNK_HEIGHT_BLOCKS << ']' << Logger::End;
+        return 1;
+    }
+    const int widthChunks = (size+CHUNK_WIDTH_BLOCKS-1)/CHUNK_WIDTH_BLOCKS;
+    const BlockPos boxMin{0, 0, 0};
+    const BlockPos boxMax{size-1, size-1, size-1};
+
+    {
+        World world;
+        addEmptyChunks(&world, widthChunks);
+        takeDirtyCount(&world, CHUNK_CACHE_MESH);
+
+        BenchUtils::Stopwatch stopwatch;
+        size_t written{};
+        for (int y{}; y < size; ++y)
+        {
+            for (int z{}; z < size; ++z)
+            {
+                for (int x{}; x < size; ++x)
+                    written += world.setBlock(x, y, z, {BLOCK_TYPE_STONE});
+            }
+        }
+        printResult("World::setBlock() per block", stopwatch.getElapsedMs(), written);
+        Logger::log << "  Sections marked dirty: " << takeDirtyCount(&world, CHUNK_CACHE_MESH) << Logger::End;
+    }
+
+    World world;
+    addEmptyChunks(&world, widthChunks);
+    takeDirtyCount(&world, CHUNK_CACHE_MESH);
+    {
+        BenchUtils::Stopwatch stopwatch;
+        const size_t written = world.fillBox(boxMin, boxMax, {BLOCK_TYPE_STONE});
+        printResult("World::fillBox()", stopwatch.getElapsedMs(), written);
+    }
+    {
+        BenchUtils::Stopwatch stopwatch;
+        const size_t written = world.replaceInBox(boxMin, boxMax, BLOCK_TYPE_STONE, {BLOCK_TYPE_DIRT});
+        printResult("World::replaceInBox()", stopwatch.getElapsedMs(), written);
+    }
+    {
+        // A checkered cube, the air of it is skipped
+        Schematic schematic;
+        schematic.size = {32, 32, 32};
+        schematic.blocks.resize(32*32*32);
+        for (int y{}; y < 32; ++y)
+        {
+            for (int z{}; z < 32; ++z)
+            {
+                for (int x{}; x < 32; ++x)
+                {
+                    if ((x+y+z)%2)
+                        schematic.blocks[schematic.getIndex(x, y, z)] = {BLOCK_TYPE_GRASS};
+                }
+            }
+        }
+
+        BenchUtils::Stopwatch stopwatch;
+        size_t written{};
+        for (int y{}; y+32 <= size; y += 32)
+        {
+            for (int z{}; z+32 <= size; z += 32)
+            {
+                for (int x{}; x+32 <= size; x += 32)
+                    written += world.applySchematic(schematic, {x, y, z}, true);
+            }
+        }
+        if (written)
+            printResult("World::applySchematic()", stopwatch.getElapsedMs(), written);
+    }
+
+    // All the edits above share the same dirty sections
+    long remeshedCount{};
+    size_t triangleCount{};
+    BenchUtils::Stopwatch stopwatch;
+    SectionMesh mesh;
+    for (const auto& [_, chunk] : world.getChunks())
+    {
+        const uint32_t dirtySections = chunk->takeDirtySections(CHUNK_CACHE_MESH);
+        const ChunkNeighbourhood view = world.getNeighbourhood(*chunk);
+        for (int i{}; i < CHUNK_SECTION_COUNT; ++i)
+        {
+            if (!(dirtySections & (1u << i)))
+                continue;
+            ChunkMesher::meshSection(view, i, true, &mesh);
+            triangleCount += mesh.indices.size()/3;
+            ++remeshedCount;
+        }
+    }
+    Logger::log << "Remeshed " << remeshedCount << " dirty sections once in " << stopwatch.getElapsedMs()
+        << "ms (" << triangleCount << " triangles)" << Logger::End;
+
+    return 0;
+}
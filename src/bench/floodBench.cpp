@@ -0,0 +1,130 @@
+#include "benches.h"
+#include "../FluidSim.h"
+#include "../ThreadPool.h"
+#include "../Logger.h"
+#include <algorithm>
+#include <bit>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#define FLOOD_BENCH_DEFAULT_LAKE_SIZE 64
+#define FLOOD_BENCH_GROUND_HEIGHT 64
+#define FLOOD_BENCH_LAKE_DEPTH 4
+// Room around the lake for the flood, in chunks
+#define FLOOD_BENCH_MARGIN_CHUNKS 6
+// Gives up after this, if the fluids never settle
+#define FLOOD_BENCH_MAX_STEPS 10'000
+
+/*
+ * Returns the y of the highest block of the column.
+ */
+static int findSurfaceY(World* world, int x, int z)
+{
+    int y = CHUNK_HEIGHT_BLOCKS-1;
+    while (y > 0 && world->getBlock(x, y, z).type == BLOCK_TYPE_AIR)
+        --y;
+    return y;
+}
+
+/*
+ * Clears the dirty mesh bits and returns their number.
+ */
+static long takeDirtyMeshCount(World* world)
+{
+    long count{};
+    for (const auto& [_, chunk] : world->getChunks())
+        count += std::popcount(chunk->takeDirtySections(CHUNK_CACHE_MESH));
+    return count;
+}
+
+/*
+ * Fills a walled lake of sources above the hills, then removes its +X wall.
+ */
+static void setUpFlood(World* world, FluidSim* fluids, int lakeSize)
+{
+    const int min = -lakeSize/2;
+    const int max = min+lakeSize-1;
+    int floorY{};
+    for (int z = min-1; z <= max+1; ++z)
+    {
+        for (int x = min-1; x <= max+1; ++x)
+            floorY = std::max(floorY, findSurfaceY(world, x, z)+1);
+    }
+    const int topY = floorY+FLOOD_BENCH_LAKE_DEPTH;
+
+    world->fillBox({min-1, floorY, min-1}, {max+1, topY, max+1}, {BLOCK_TYPE_STONE});
+    world->fillBox({min, floorY+1, min}, {max, topY, max}, {BLOCK_TYPE_WATER});
+    world->fillBox({max+1, floorY+1, min}, {max+1, topY, max}, {BLOCK_TYPE_AIR});
+    for (int y = floorY+1; y <= topY; ++y)
+    {
+        for (int z = min; z <= max; ++z)
+            fluids->onBlockChanged({max+1, y, z});
+    }
+    takeDirtyMeshCount(world);
+}
+
+/*
+ * Returns the hash of the world after the flood settled.
+ */
+static uint64_t runFlood(int lakeSize, ThreadPool* pool, const char* name)
+{
+    World world;
+    const int radius = (lakeSize+CHUNK_WIDTH_BLOCKS-1)/CHUNK_WIDTH_BLOCKS/2+FLOOD_BENCH_MARGIN_CHUNKS;
+    BenchUtils::generateHills(&world, radius, FLOOD_BENCH_GROUND_HEIGHT);
+    FluidSim fluids{&world, pool};
+    setUpFlood(&world, &fluids, lakeSize);
+
+    std::vector<double> stepMs;
+    FluidStats total;
+    long dirtySections{};
+    while (fluids.getActiveCount() && (int)stepMs.size() < FLOOD_BENCH_MAX_STEPS)
+    {
+        BenchUtils::Stopwatch stopwatch;
+        const FluidStats stats = fluids.step();
+        stepMs.push_back(stopwatch.getElapsedMs());
+        total.activeCells += stats.activeCells;
+        total.changes += stats.changes;
+        dirtySections += takeDirtyMeshCount(&world);
+        // Nobody takes them in the benchmark
+        world.takeChangedBlocks();
+    }
+    if (fluids.getActiveCount())
+    {
+        Logger::warn << name << ": The flood didn't settle in " << FLOOD_BENCH_MAX_STEPS << " steps" << Logger::End;
+    }
+    if (stepMs.empty())
+        return world.computeChecksum();
+
+    const size_t stepCount = stepMs.size();
+    const double sumMs = std::accumulate(stepMs.begin(), stepMs.end(), 0.0);
+    std::sort(stepMs.begin(), stepMs.end());
+    Logger::log << name << ": settled in " << stepCount << " steps, " << sumMs << "ms, step latency: avg "
+        << sumMs/stepCount << "ms, p50 " << stepMs[stepCount/2] << "ms, p99 " << stepMs[stepCount*99/100]
+        << "ms, max " << stepMs.back() << "ms; per step: " << total.activeCells/stepCount << " active cells, "
+        << total.changes/stepCount << " changes, " << dirtySections/(double)stepCount << " sections to remesh"
+        << Logger::End;
+    return world.computeChecksum();
+}
+
+int runFloodBench(int argc, char** argv)
+{
+    const int lakeSize = BenchUtils::getArgOr(argc, argv, 0, FLOOD_BENCH_DEFAULT_LAKE_SIZE);
+    if (lakeSize <= 0)
+    {
+        Logger::err << "The lake size has to be positive" << Logger::End;
+        return 1;
+    }
+    Logger::log << "Opening a " << lakeSize << 'x' << lakeSize << " lake" << Logger::End;
+
+    const uint64_t serialHash = runFlood(lakeSize, nullptr, "1 thread");
+    ThreadPool& pool = ThreadPool::getShared();
+    const uint64_t parallelHash = runFlood(lakeSize, &pool,
+            (std::to_string(pool.getThreadCount()+1)+" threads").c_str());
+    if (serialHash != parallelHash)
+    {
+        Logger::err << "The results depend on the thread count" << Logger::End;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "benches.h"
+#include "../WorldStore.h"
+#include "../Logger.h"
+#include <unistd.h>
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#define JOURNAL_BENCH_DEFAULT_EDIT_COUNT 5'000'000
+#define JOURNAL_BENCH_RADIUS_CHUNKS 4
+#define JOURNAL_BENCH_GROUND_HEIGHT 64
+
+/*
+ * A player building: a random walk near the ground, placing and breaking blocks.
+ * Returns the milliseconds it took.
+ */
+static double makeEdits(World* world, long editCount)
+{
+    static constexpr int extent = JOURNAL_BENCH_RADIUS_CHUNKS*CHUNK_WIDTH_BLOCKS;
+    static constexpr Block blocks[] = {{BLOCK_TYPE_AIR}, {BLOCK_TYPE_STONE}, {BLOCK_TYPE_DIRT}, {BLOCK_TYPE_WATER, 3}};
+    std::mt19937 rng{1234};
+    std::uniform_int_distribution<int> stepDist{-2, 2};
+    BlockPos pos{0, JOURNAL_BENCH_GROUND_HEIGHT, 0};
+
+    BenchUtils::Stopwatch stopwatch;
+    for (long i{}; i < editCount; ++i)
+    {
+        pos.x = std::clamp(pos.x+stepDist(rng), -extent, extent-1);
+        pos.y = std::clamp(pos.y+stepDist(rng), JOURNAL_BENCH_GROUND_HEIGHT-24, JOURNAL_BENCH_GROUND_HEIGHT+24);
+        pos.z = std::clamp(pos.z+stepDist(rng), -extent, extent-1);
+        world->setBlock(pos.x, pos.y, pos.z, blocks[rng()%std::size(blocks)]);
+        if (i%4096 == 0)
+            world->takeChangedBlocks();
+    }
+    return stopwatch.getElapsedMs();
+}
+
+/*
+ * Replays the journal into freshly generated hills. Returns the hash of the result.
+ */
+static uint64_t replayInto(const std::string& path, JournalReplayStats* stats, double* ms)
+{
+    World world;
+    BenchUtils::generateHills(&world, JOURNAL_BENCH_RADIUS_CHUNKS, JOURNAL_BENCH_GROUND_HEIGHT);
+    BenchUtils::Stopwatch stopwatch;
+    *stats = EditJournal::replay(path, &world);
+    *ms = stopwatch.getElapsedMs();
+    return world.computeChecksum();
+}
+
+int runJournalBench(int argc, char** argv)
+{
+    const long editCount = BenchUtils::getArgOr(argc, argv, 0, JOURNAL_BENCH_DEFAULT_EDIT_COUNT);
+    if (editCount <= 0)
+    {
+        Logger::err << "The edit count has to be positive" << Logger::End;
+        return 1;
+    }
+    const std::filesystem::path dirPath = std::filesystem::temp_directory_path()
+        /("acraft-journal-bench-"+std::to_string(getpid()));
+    std::filesystem::remove_all(dirPath);
+    const std::string crashPath = (dirPath/"crashed-journal.bin").string();
+    Logger::log << "Making " << editCount << " edits in " << dirPath.string() << Logger::End;
+
+    int result{};
+    uint64_t editedHash{};
+    {
+        World unjournaled;
+        BenchUtils::generateHills(&unjournaled, JOURNAL_BENCH_RADIUS_CHUNKS, JOURNAL_BENCH_GROUND_HEIGHT);
+        const double unjournaledMs = makeEdits(&unjournaled, editCount);
+
+        World world;
+        BenchUtils::generateHills(&world, JOURNAL_BENCH_RADIUS_CHUNKS, JOURNAL_BENCH_GROUND_HEIGHT);
+        WorldStore store;
+        // The hills don't depend on the seed
+        uint64_t seed{};
+        BenchUtils::Stopwatch stopwatch;
+        if (!store.open(dirPath.string(), &seed) || !store.attach(&world))
+            return 1;
+        Logger::log << "First checkpoint of " << world.getChunks().size() << " chunks: "
+            << stopwatch.getElapsedMs() << "ms" << Logger::End;
+
+        const double journaledMs = makeEdits(&world, editCount);
+        stopwatch.restart();
+        store.getJournal().commit();
+        const double commitMs = stopwatch.getElapsedMs();
+        const EditJournal& journal = store.getJournal();
+        Logger::log << "Edits: " << editCount/unjournaledMs/1000 << " M/s unjournaled, "
+            << editCount/journaledMs/1000 << " M/s journaled (" << (journaledMs-unjournaledMs)*1e6/editCount
+            << "ns overhead per edit); journal: " << journal.getCommittedBytes()/(double)editCount
+            << " bytes per edit, " << journal.getCommittedBytes()/journaledMs/1000 << " MB/s, "
+            << journal.getCommitCount() << " commits, last commit " << commitMs << "ms" << Logger::End;
+
+        // What a crash would leave behind
+        std::filesystem::copy_file(store.getJournal().getPath(), crashPath);
+        editedHash = world.computeChecksum();
+
+        stopwatch.restart();
+        const size_t savedCount = store.checkpoint();
+        const double pauseMs = stopwatch.getElapsedMs();
+        store.waitForCheckpoint();
+        Logger::log << "Checkpoint of " << savedCount << " chunks: " << pauseMs << "ms pause, "
+            << stopwatch.getElapsedMs() << "ms in the background, journal: "
+            << std::filesystem::file_size(store.getJournal().getPath()) << " bytes after it" << Logger::End;
+        store.detach();
+
+        World loaded;
+        stopwatch.restart();
+        for (int chunkZ{-JOURNAL_BENCH_RADIUS_CHUNKS}; chunkZ < JOURNAL_BENCH_RADIUS_CHUNKS; ++chunkZ)
+        {
+            for (int chunkX{-JOURNAL_BENCH_RADIUS_CHUNKS}; chunkX < JOURNAL_BENCH_RADIUS_CHUNKS; ++chunkX)
+            {
+                std::unique_ptr<Chunk> chunk = store.loadChunk(chunkX, chunkZ);
+                if (chunk)
+                    loaded.addChunk(std::move(chunk));
+            }
+        }
+        Logger::log << "Loaded " << loaded.getChunks().size() << " chunks from the region files: "
+            << stopwatch.getElapsedMs() << "ms" << Logger::End;
+        if (loaded.computeChecksum() != editedHash)
+        {
+            Logger::err << "The loaded world doesn't match the saved one" << Logger::End;
+            result = 1;
+        }
+    }
+
+    JournalReplayStats stats;
+    double replayMs{};
+    if (replayInto(crashPath, &stats, &replayMs) != editedHash)
+    {
+        Logger::err << "The recovered world doesn't match the edited one" << Logger::End;
+        result = 1;
+    }
+    Logger::log << "Recovery: replayed " << stats.editCount << " edits from " << stats.batchCount << " batches in "
+        << replayMs << "ms, " << stats.editCount/replayMs/1000 << " M edits/s" << Logger::End;
+
+    // A crash in the middle of writing the last batch
+    const long fullBatchCount = stats.batchCount;
+    std::filesystem::resize_file(crashPath, std::filesystem::file_size(crashPath)-3);
+    replayInto(crashPath, &stats, &replayMs);
+    if (stats.batchCount != fullBatchCount-1 || !stats.discardedBytes)
+    {
+        Logger::err << "The torn batch wasn't discarded" << Logger::End;
+        result = 1;
+    }
+    Logger::log << "Torn journal: replayed " << stats.batchCount << " of " << fullBatchCount << " batches, discarded "
+        << stats.discardedBytes << " bytes" << Logger::End;
+
+    std::filesystem::remove_all(dirPath);
+    return result;
+}
@@ -0,0 +1,183 @@
+#include "benches.h"
+#include "../LightEngine.h"
+#include "../Logger.h"
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#define LIGHT_BENCH_DEFAULT_RADIUS 8
+#define LIGHT_BENCH_DEFAULT_EDITS 1000
+#define LIGHT_BENCH_GROUND_HEIGHT 64
+#define LIGHT_BENCH_FULL_RELIGHT_RUNS 10
+// No block emits light yet, so we make one for the measurement
+#define LIGHT_BENCH_LAMP_TYPE BLOCK_TYPE_COAL_ORE
+#define LIGHT_BENCH_LAMP_LEVEL 14
+
+static void printLatencies(const char* name, std::vector<double> latenciesUs)
+{
+    if (latenciesUs.empty())
+        return;
+    std::sort(latenciesUs.begin(), latenciesUs.end());
+    const double avg = std::accumulate(latenciesUs.begin(), latenciesUs.end(), 0.0)/latenciesUs.size();
+    Logger::log << name << " (" << latenciesUs.size() << "x): avg " << avg
+        << "us, p50 " << latenciesUs[latenciesUs.size()/2]
+        << "us, p99 " << latenciesUs[latenciesUs.size()*99/100]
+        << "us, max " << latenciesUs.back() << "us" << Logger::End;
+}
+
+/*
+ * Lights a copy of the blocks of `world` from scratch, and returns the number
+ * of light levels that differ from `world`.
+ */
+static long countLightDifferences(const World& world)
+{
+    World fresh;
+    for (const auto& [_, chunk] : world.getChunks())
+    {
+        // Not lit yet, so the engine lights it whole
+        auto copy = std::make_unique<Chunk>(chunk->getChunkX(), chunk->getChunkZ());
+        for (int y{}; y < CHUNK_HEIGHT_BLOCKS; ++y)
+        {
+            if (!chunk->getSection(y/CHUNK_SECTION_HEIGHT))
+                continue;
+            for (int z{}; z < CHUNK_WIDTH_BLOCKS; ++z)
+            {
+                for (int x{}; x < CHUNK_WIDTH_BLOCKS; ++x)
+                    copy->setBlock(x, y, z, chunk->getBlock(x, y, z));
+            }
+        }
+        fresh.addChunk(std::move(copy));
+    }
+    LightEngine engine{&fresh};
+    engine.update();
+
+    long differenceCount{};
+    for (const auto& [_, chunk] : world.getChunks())
+    {
+        const Chunk* freshChunk = fresh.getChunk(chunk->getChunkX(), chunk->getChunkZ());
+        for (int typeI{}; typeI < LIGHT__COUNT; ++typeI)
+        {
+            for (int y{}; y < CHUNK_HEIGHT_BLOCKS; ++y)
+            {
+                for (int z{}; z < CHUNK_WIDTH_BLOCKS; ++z)
+                {
+                    for (int x{}; x < CHUNK_WIDTH_BLOCKS; ++x)
+                    {
+                        if (chunk->getLight((LightType)typeI, x, y, z) != freshChunk->getLight((LightType)typeI, x, y, z))
+                            ++differenceCount;
+                    }
+                }
+            }
+        }
+    }
+    return differenceCount;
+}
+
+/*
+ * Returns the y of the highest block of the column.
+ */
+static int findSurfaceY(World* world, int x, int z)
+{
+    int y = CHUNK_HEIGHT_BLOCKS-1;
+    while (y > 0 && world->getBlock(x, y, z).type == BLOCK_TYPE_AIR)
+        --y;
+    return y;
+}
+
+int runLightBench(int argc, char** argv)
+{
+    const int radius = BenchUtils::getArgOr(argc, argv, 0, LIGHT_BENCH_DEFAULT_RADIUS);
+    const long editCount = BenchUtils::getArgOr(argc, argv, 1, LIGHT_BENCH_DEFAULT_EDITS);
+    // Away from the edges of the world, so the light can spread freely
+    const int minCoord = (-radius+1)*CHUNK_WIDTH_BLOCKS;
+    const int coordRange = (radius*2-2)*CHUNK_WIDTH_BLOCKS;
+    if (coordRange <= 0)
+    {
+        Logger::err << "The radius has to be at least 2 for the edits" << Logger::End;
+        return 1;
+    }
+    // Restored at the end
+    const uint8_t origLampLevel = BlockRegistry::g_tables.lightEmission[LIGHT_BENCH_LAMP_TYPE];
+    BlockRegistry::g_tables.lightEmission[LIGHT_BENCH_LAMP_TYPE] = LIGHT_BENCH_LAMP_LEVEL;
+
+    World world;
+    BenchUtils::generateHills(&world, radius, LIGHT_BENCH_GROUND_HEIGHT);
+    LightEngine engine{&world};
+    {
+        BenchUtils::Stopwatch stopwatch;
+        const int chunkCount = engine.update();
+        const double elapsedMs = stopwatch.getElapsedMs();
+        Logger::log << "Initial lighting: " << chunkCount << " chunks in " << elapsedMs << "ms, "
+            << elapsedMs/chunkCount << "ms/chunk" << Logger::End;
+    }
+
+    {
+        // Like after a batched edit, the darkening spreads into the neighbours too
+        Chunk* chunk = world.getChunk(0, 0);
+        BenchUtils::Stopwatch stopwatch;
+        for (int i{}; i < LIGHT_BENCH_FULL_RELIGHT_RUNS; ++i)
+        {
+            chunk->markSectionsDirty(CHUNK_ALL_SECTIONS_MASK, 1u << CHUNK_CACHE_LIGHT);
+            engine.update();
+        }
+        Logger::log << "Relighting a lit chunk: " << stopwatch.getElapsedMs()/LIGHT_BENCH_FULL_RELIGHT_RUNS
+            << "ms" << Logger::End;
+    }
+
+    std::mt19937 rng{42};
+    std::vector<double> digUs;
+    std::vector<double> placeUs;
+    std::vector<double> placeLampUs;
+    std::vector<double> removeLampUs;
+    std::vector<BlockPos> lamps;
+    auto timeEdit{[&](std::vector<double>* latencies, const BlockPos& pos, BlockType type){
+        BenchUtils::Stopwatch stopwatch;
+        world.setBlock(pos.x, pos.y, pos.z, {type});
+        engine.update();
+        latencies->push_back(stopwatch.getElapsedMs()*1000);
+    }};
+    for (long i{}; i < editCount; ++i)
+    {
+        const int x = minCoord+rng()%coordRange;
+        const int z = minCoord+rng()%coordRange;
+        const int surfaceY = findSurfaceY(&world, x, z);
+        switch (i%4)
+        {
+        case 0: timeEdit(&digUs, {x, surfaceY, z}, BLOCK_TYPE_AIR); break;
+        // Shades the column under it
+        case 1: timeEdit(&placeUs, {x, surfaceY+1, z}, BLOCK_TYPE_STONE); break;
+        case 2:
+            // In a pit, where the lamp is brighter than the sky
+            timeEdit(&digUs, {x, surfaceY, z}, BLOCK_TYPE_AIR);
+            timeEdit(&placeLampUs, {x, surfaceY-1, z}, LIGHT_BENCH_LAMP_TYPE);
+            lamps.push_back({x, surfaceY-1, z});
+            break;
+        case 3:
+            // Every other lamp is kept, so the light check at the end covers both
+            if (i%8 == 3 && !lamps.empty())
+            {
+                timeEdit(&removeLampUs, lamps.back(), BLOCK_TYPE_AIR);
+                lamps.pop_back();
+            }
+            break;
+        }
+    }
+
+    printLatencies("Dig", digUs);
+    printLatencies("Place", placeUs);
+    printLatencies("Place lamp", placeLampUs);
+    printLatencies("Remove lamp", removeLampUs);
+
+    // The incremental updates have to give the same light as lighting everything again
+    const long differenceCount = countLightDifferences(world);
+    BlockRegistry::g_tables.lightEmission[LIGHT_BENCH_LAMP_TYPE] = origLampLevel;
+    if (differenceCount)
+    {
+        Logger::err << differenceCount << " light levels differ from lighting from scratch" << Logger::End;
+        return 1;
+    }
+    Logger::log << "The light matches lighting from scratch" << Logger::End;
+    return 0;
+}
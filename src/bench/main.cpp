@@ -0,0 +1,111 @@
+#include "benches.h"
+#include "../World.h"
+#include "../Logger.h"
+#include <cmath>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+struct BenchEntry
+{
+    const char* name;
+    const char* args;
+    int (*func)(int argc, char** argv);
+};
+
+static constexpr BenchEntry benches[] = {
+    {"obj", "[face count]", runObjBench},
+    {"world", "[radius in chunks] [access count]", runWorldBench},
+    {"edit", "[box size in blocks]", runEditBench},
+    {"raycast", "[radius in chunks] [ray count]", runRaycastBench},
+    {"light", "[radius in chunks] [edit count]", runLightBench},
+    {"mesh", "[radius in chunks]", runMeshBench},
+    {"render", "[radius in chunks] [frames]", runRenderBench},
+    {"tick", "[chunk count] [tick count]", runTickBench},
+    {"flood", "[lake size in blocks]", runFloodBench},
+    {"journal", "[edit count]", runJournalBench},
+    {"snapshot", "[chunk count] [edits per tick]", runSnapshotBench},
+};
+
+namespace BenchUtils
+{
+
+long getArgOr(int argc, char** argv, int i, long defaultVal)
+{
+    if (i >= argc)
+        return defaultVal;
+
+    long value{};
+    const auto result = std::from_chars(argv[i], argv[i]+std::strlen(argv[i]), value);
+    if (result.ec != std::errc{})
+    {
+        Logger::fatal << "Invalid numeric argument: " << argv[i] << Logger::End;
+    }
+    return value;
+}
+
+void generateHills(World* world, int radius, int groundHeight)
+{
+    for (int chunkZ{-radius}; chunkZ < radius; ++chunkZ)
+    {
+        for (int chunkX{-radius}; chunkX < radius; ++chunkX)
+        {
+            auto chunk = std::make_unique<Chunk>(chunkX, chunkZ);
+            for (int z{}; z < CHUNK_WIDTH_BLOCKS; ++z)
+            {
+                for (int x{}; x < CHUNK_WIDTH_BLOCKS; ++x)
+                {
+                    const int worldX = chunkX*CHUNK_WIDTH_BLOCKS+x;
+                    const int worldZ = chunkZ*CHUNK_WIDTH_BLOCKS+z;
+                    const int height = groundHeight+(int)(std::sin(worldX*0.05f)*12+std::cos(worldZ*0.07f)*10);
+                    for (int y{}; y < height; ++y)
+                    {
+                        BlockType type = BLOCK_TYPE_DIRT;
+                        if (y == height-1)
+                            type = BLOCK_TYPE_GRASS;
+                        else if (y < height-3)
+                            type = BLOCK_TYPE_STONE;
+                        chunk->setBlock(x, y, z, {type});
+                    }
+                }
+            }
+            world->addChunk(std::move(chunk));
+        }
+    }
+}
+
+} // End of namespace BenchUtils
+
+static void printUsage(const char* progName)
+{
+    std::cout << "Usage: " << progName << " <benchmark> [args...]\n"
+        << "Benchmarks:\n";
+    for (const auto& bench : benches)
+        std::cout << "  " << bench.name << ' ' << bench.args << '\n';
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Verbose);
+
+    const std::string_view name = argv[1];
+    for (const auto& bench : benches)
+    {
+        if (name == bench.name)
+        {
+            const int ret = bench.func(argc-2, argv+2);
+            Logger::flush();
+            return ret;
+        }
+    }
+
+    printUsage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,57 @@
+#include "benches.h"
+#include "../ChunkMesher.h"
+#include "../Logger.h"
+#include <algorithm>
+
+#define MESH_BENCH_DEFAULT_RADIUS 4
+#define MESH_BENCH_GROUND_HEIGHT 64
+#define MESH_BENCH_RUNS 20
+
+/*
+ * Meshes every section of the world, returns the best time of the runs in ms.
+ */
+static double meshWorld(const World& world, bool withAo, size_t* triangleCount)
+{
+    double bestMs = 1e100;
+    SectionMesh mesh;
+    for (int runI{}; runI < MESH_BENCH_RUNS; ++runI)
+    {
+        *triangleCount = 0;
+        BenchUtils::Stopwatch stopwatch;
+        for (const auto& [_, chunk] : world.getChunks())
+        {
+            const ChunkNeighbourhood view = world.getNeighbourhood(*chunk);
+            for (int sectionI{}; sectionI < CHUNK_SECTION_COUNT; ++sectionI)
+            {
+                ChunkMesher::meshSection(view, sectionI, withAo, &mesh);
+                *triangleCount += mesh.indices.size()/3;
+            }
+        }
+        bestMs = std::min(bestMs, stopwatch.getElapsedMs());
+    }
+    return bestMs;
+}
+
+int runMeshBench(int argc, char** argv)
+{
+    const int radius = BenchUtils::getArgOr(argc, argv, 0, MESH_BENCH_DEFAULT_RADIUS);
+
+    World world;
+    BenchUtils::generateHills(&world, radius, MESH_BENCH_GROUND_HEIGHT);
+    long sectionCount{};
+    for (const auto& [_, chunk] : world.getChunks())
+    {
+        for (int sectionI{}; sectionI < CHUNK_SECTION_COUNT; ++sectionI)
+            sectionCount += chunk->getSection(sectionI) != nullptr;
+    }
+
+    size_t triangleCount{};
+    const double noAoMs = meshWorld(world, false, &triangleCount);
+    Logger::log << "Without AO: " << sectionCount << " sections in " << noAoMs << "ms, "
+        << noAoMs*1000/sectionCount << "us/section, " << triangleCount << " triangles" << Logger::End;
+    const double aoMs = meshWorld(world, true, &triangleCount);
+    Logger::log << "With AO: " << sectionCount << " sections in " << aoMs << "ms, "
+        << aoMs*1000/sectionCount << "us/section, " << triangleCount << " triangles" << Logger::End;
+    Logger::log << "AO overhead: " << (aoMs/noAoMs-1)*100 << '%' << Logger::End;
+    return 0;
+}
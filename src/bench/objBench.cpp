@@ -0,0 +1,92 @@
+#include "benches.h"
+#include "../obj.h"
+#include "../Logger.h"
+#include <cstdio>
+#include <filesystem>
+#include <algorithm>
+#include <cmath>
+
+#define OBJ_BENCH_DEFAULT_FACES 2'000'000
+#define OBJ_BENCH_RUNS 3
+
+/*
+ * Writes a square grid of quads, split into triangles, with shared vertices.
+ */
+static void generateGridObj(const std::string& path, long faceCount)
+{
+    // Two triangles per cell
+    const long cellsPerSide = std::max(1L, (long)std::sqrt(faceCount/2.0));
+    const long vertsPerSide = cellsPerSide+1;
+
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (!file)
+    {
+        Logger::fatal << "Failed to create " << path << Logger::End;
+    }
+
+    std::fprintf(file, "# Generated by acraft-bench\no grid\n");
+    for (long z{}; z < vertsPerSide; ++z)
+    {
+        for (long x{}; x < vertsPerSide; ++x)
+        {
+            std::fprintf(file, "v %f %f %f\n", x*0.5, std::sin(x*0.1)*std::cos(z*0.1), z*0.5);
+            std::fprintf(file, "vt %f %f\n", (double)x/cellsPerSide, (double)z/cellsPerSide);
+        }
+    }
+    std::fprintf(file, "vn 0.0 1.0 0.0\n");
+    for (long z{}; z < cellsPerSide; ++z)
+    {
+        for (long x{}; x < cellsPerSide; ++x)
+        {
+            // Positions and UVs have the same indices
+            const long i00 = z*vertsPerSide+x+1;
+            const long i10 = i00+1;
+            const long i01 = i00+vertsPerSide;
+            const long i11 = i01+1;
+            std::fprintf(file, "f %ld/%ld/1 %ld/%ld/1 %ld/%ld/1\n", i00, i00, i01, i01, i11, i11);
+            std::fprintf(file, "f %ld/%ld/1 %ld/%ld/1 %ld/%ld/1\n", i00, i00, i11, i11, i10, i10);
+        }
+    }
+    std::fclose(file);
+}
+
+int runObjBench(int argc, char** argv)
+{
+    const long faceCount = BenchUtils::getArgOr(argc, argv, 0, OBJ_BENCH_DEFAULT_FACES);
+    const std::string path = (std::filesystem::temp_directory_path()/"acraft_bench_grid.obj").string();
+
+    Logger::log << "Generating OBJ with ~" << faceCount << " faces: " << path << Logger::End;
+    generateGridObj(path, faceCount);
+    const double fileSizeMb = std::filesystem::file_size(path)/(1024.0*1024.0);
+
+    // Only report our own lines
+    Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Quiet);
+    double bestMs = 1e100;
+    ObjMesh mesh;
+    for (int i{}; i < OBJ_BENCH_RUNS; ++i)
+    {
+        const BenchUtils::Stopwatch stopwatch;
+        mesh = loadObjFile(path);
+        bestMs = std::min(bestMs, stopwatch.getElapsedMs());
+    }
+    Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Verbose);
+
+    if (mesh.isEmpty())
+    {
+        Logger::err << "Failed to load the generated model" << Logger::End;
+        return 1;
+    }
+
+    const size_t triCount = mesh.indices.size()/3;
+    const double indexedMb = (mesh.vertices.size()*sizeof(float)+mesh.indices.size()*sizeof(uint))/(1024.0*1024.0);
+    const double deindexedMb = mesh.indices.size()*OBJ_VALS_PER_VERT*sizeof(float)/(1024.0*1024.0);
+    Logger::log << "Loaded " << fileSizeMb << " MiB, " << triCount << " triangles in " << bestMs
+        << "ms (best of " << OBJ_BENCH_RUNS << "): "
+        << fileSizeMb/(bestMs/1000) << " MiB/s, "
+        << triCount/(bestMs/1000)/1e6 << " M triangles/s" << Logger::End;
+    Logger::log << "Unique vertices: " << mesh.vertices.size()/OBJ_VALS_PER_VERT
+        << ", indexed output: " << indexedMb << " MiB (de-indexed would be " << deindexedMb << " MiB)" << Logger::End;
+
+    std::filesystem::remove(path);
+    return 0;
+}
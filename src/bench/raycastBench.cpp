@@ -0,0 +1,73 @@
+#include "benches.h"
+#include "../Raycast.h"
+#include "../ThreadPool.h"
+#include "../Logger.h"
+#include <random>
+#include <string>
+
+#define RAYCAST_BENCH_DEFAULT_RADIUS 8
+#define RAYCAST_BENCH_DEFAULT_RAYS 1'000'000
+#define RAYCAST_BENCH_RAY_LENGTH 64.0f
+// The rays start above the terrain
+#define RAYCAST_BENCH_GROUND_HEIGHT 64
+
+static void printResult(const char* name, double elapsedMs, const std::vector<RayHit>& hits)
+{
+    size_t hitCount{};
+    double distanceSum{};
+    for (const RayHit& hit : hits)
+    {
+        hitCount += hit.isHit;
+        distanceSum += hit.distance;
+    }
+    Logger::log << name << ": " << hits.size()/(elapsedMs/1000)/1e6 << " M rays/s ("
+        << elapsedMs << "ms, " << hitCount*100.0/hits.size() << "% hit, avg. hit distance: "
+        << (hitCount ? distanceSum/hitCount : 0) << ')' << Logger::End;
+}
+
+int runRaycastBench(int argc, char** argv)
+{
+    const int radius = BenchUtils::getArgOr(argc, argv, 0, RAYCAST_BENCH_DEFAULT_RADIUS);
+    const long rayCount = BenchUtils::getArgOr(argc, argv, 1, RAYCAST_BENCH_DEFAULT_RAYS);
+    const int widthBlocks = radius*2*CHUNK_WIDTH_BLOCKS;
+
+    World world;
+    {
+        BenchUtils::Stopwatch stopwatch;
+        BenchUtils::generateHills(&world, radius, RAYCAST_BENCH_GROUND_HEIGHT);
+        Logger::log << "Generated " << world.getChunks().size() << " chunks in " << stopwatch.getElapsedMs() << "ms" << Logger::End;
+    }
+
+    // From above the terrain, in any direction, like players looking around
+    std::mt19937 rng{42};
+    std::uniform_real_distribution<float> posDist{-widthBlocks/2.0f, widthBlocks/2.0f};
+    std::uniform_real_distribution<float> heightDist{RAYCAST_BENCH_GROUND_HEIGHT+25.0f, RAYCAST_BENCH_GROUND_HEIGHT+60.0f};
+    std::normal_distribution<float> dirDist;
+    std::vector<Ray> rays(rayCount);
+    for (Ray& ray : rays)
+    {
+        ray.origin = {posDist(rng), heightDist(rng), posDist(rng)};
+        ray.dir = {dirDist(rng), dirDist(rng), dirDist(rng)};
+        ray.maxDist = RAYCAST_BENCH_RAY_LENGTH;
+    }
+
+    std::vector<RayHit> hits(rayCount);
+    {
+        BenchUtils::Stopwatch stopwatch;
+        for (long i{}; i < rayCount; ++i)
+            hits[i] = Raycast::castRay(world, rays[i]);
+        printResult("1 thread", stopwatch.getElapsedMs(), hits);
+    }
+
+    for (int threadCount : {2, 4, 8})
+    {
+        // The calling thread works too
+        ThreadPool pool{threadCount-1};
+        BenchUtils::Stopwatch stopwatch;
+        Raycast::castRays(world, rays, &hits, &pool);
+        const std::string name = std::to_string(threadCount)+" threads";
+        printResult(name.c_str(), stopwatch.getElapsedMs(), hits);
+    }
+
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include "benches.h"
+#include "../ChunkRenderList.h"
+#include "../World.h"
+#include "../ThreadPool.h"
+#include "../Logger.h"
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#define RENDER_BENCH_DEFAULT_RADIUS 16
+#define RENDER_BENCH_DEFAULT_FRAMES 500
+#define RENDER_BENCH_GROUND_HEIGHT 64
+
+/*
+ * Orbits the middle of the world, looking down at the terrain like the benchmark path of the game.
+ */
+static Frustum getFrameFrustum(int frameI, int frameCount, int radius)
+{
+    const float angle = glm::radians(frameI*360.0f/frameCount);
+    // Render units, see `Raycast::renderToBlockCoords()`
+    const float orbitRadius = radius*CHUNK_WIDTH_BLOCKS;
+    const glm::vec3 pos{std::cos(angle)*orbitRadius, RENDER_BENCH_GROUND_HEIGHT*2+200.0f, std::sin(angle)*orbitRadius};
+    const glm::mat4 viewMat = glm::lookAt(pos, glm::vec3{0.0f, RENDER_BENCH_GROUND_HEIGHT*2.0f, 0.0f}, {0.0f, 1.0f, 0.0f});
+    const glm::mat4 projMat = glm::perspective(glm::radians(45.0f), 1.5f, 0.01f, 1000.0f);
+    return Frustum{projMat*viewMat};
+}
+
+int runRenderBench(int argc, char** argv)
+{
+    const int radius = BenchUtils::getArgOr(argc, argv, 0, RENDER_BENCH_DEFAULT_RADIUS);
+    const int frameCount = BenchUtils::getArgOr(argc, argv, 1, RENDER_BENCH_DEFAULT_FRAMES);
+
+    // Only the layout of the meshes is needed, the GPU buffers are never made
+    std::vector<std::unique_ptr<ChunkGpuMesh>> meshes;
+    std::vector<const ChunkGpuMesh*> meshList;
+    {
+        BenchUtils::Stopwatch stopwatch;
+        World world;
+        BenchUtils::generateHills(&world, radius, RENDER_BENCH_GROUND_HEIGHT);
+        SectionMesh sectionMesh;
+        for (const auto& [_, chunk] : world.getChunks())
+        {
+            auto mesh = std::make_unique<ChunkGpuMesh>();
+            mesh->chunkX = chunk->getChunkX();
+            mesh->chunkZ = chunk->getChunkZ();
+            mesh->vao = meshes.size()+1;
+            const ChunkNeighbourhood view = world.getNeighbourhood(*chunk);
+            uint firstIndex{};
+            for (int i{}; i < CHUNK_SECTION_COUNT; ++i)
+            {
+                ChunkMesher::meshSection(view, i, true, &sectionMesh);
+                mesh->firstIndices[i] = firstIndex;
+                mesh->indexCounts[i] = sectionMesh.indices.size();
+                firstIndex += sectionMesh.indices.size();
+            }
+            meshList.push_back(mesh.get());
+            meshes.push_back(std::move(mesh));
+        }
+        Logger::log << "Meshed " << meshes.size() << " chunks in " << stopwatch.getElapsedMs() << "ms" << Logger::End;
+    }
+
+    double singleThreadMs{};
+    long singleThreadDraws{};
+    for (int threadCount : {1, 2, 4, 8})
+    {
+        // The calling thread records too
+        std::unique_ptr<ThreadPool> pool;
+        if (threadCount > 1)
+            pool = std::make_unique<ThreadPool>(threadCount-1);
+
+        std::vector<RenderCommandBuffer> buffers;
+        long drawCount{};
+        long commandCount{};
+        long visibleSectionCount{};
+        double recordMs{};
+        double mergeMs{};
+        for (int frameI{}; frameI < frameCount; ++frameI)
+        {
+            const Frustum frustum = getFrameFrustum(frameI, frameCount, radius);
+            BenchUtils::Stopwatch stopwatch;
+            visibleSectionCount += ChunkRenderList::recordDrawsParallel(
+                    meshList, frustum, 1, 1, pool.get(), &buffers);
+            recordMs += stopwatch.getElapsedMs();
+
+            // What the render thread does besides the GL calls
+            stopwatch.restart();
+            for (const RenderCommandBuffer& buffer : buffers)
+            {
+                for (const RenderCommand& command : buffer.getCommands())
+                    drawCount += command.type == RENDER_CMD_DRAW_TRIANGLES;
+                commandCount += buffer.getCommands().size();
+            }
+            mergeMs += stopwatch.getElapsedMs();
+        }
+
+        if (threadCount == 1)
+        {
+            singleThreadMs = recordMs;
+            singleThreadDraws = drawCount;
+        }
+        else if (drawCount != singleThreadDraws)
+        {
+            Logger::err << "The " << threadCount << " thread recording has " << drawCount
+                << " draws instead of " << singleThreadDraws << Logger::End;
+            return 1;
+        }
+        Logger::log << threadCount << " thread(s): record " << recordMs/frameCount << "ms/frame, merge "
+            << mergeMs/frameCount << "ms/frame, " << buffers.size() << " buffers, "
+            << commandCount/frameCount << " commands, " << drawCount/frameCount << " draws, "
+            << visibleSectionCount/frameCount << " sections/frame, speedup: " << singleThreadMs/recordMs << 'x' << Logger::End;
+    }
+    return 0;
+}
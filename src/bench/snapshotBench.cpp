@@ -0,0 +1,124 @@
+#include "benches.h"
+#include "../WorldStore.h"
+#include "../Logger.h"
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#define SNAPSHOT_BENCH_DEFAULT_CHUNK_COUNT 10'000
+#define SNAPSHOT_BENCH_DEFAULT_EDITS_PER_TICK 100
+#define SNAPSHOT_BENCH_GROUND_HEIGHT 64
+
+/*
+ * Player edits scattered over the whole world, like many players would make.
+ */
+static void makeEdits(World* world, int radius, int editCount, std::mt19937* rng)
+{
+    std::uniform_int_distribution<int> xzDist{-radius*CHUNK_WIDTH_BLOCKS, radius*CHUNK_WIDTH_BLOCKS-1};
+    std::uniform_int_distribution<int> yDist{SNAPSHOT_BENCH_GROUND_HEIGHT-16, SNAPSHOT_BENCH_GROUND_HEIGHT+16};
+    for (int i{}; i < editCount; ++i)
+    {
+        const BlockType type = (*rng)()%2 ? BLOCK_TYPE_STONE : BLOCK_TYPE_AIR;
+        world->setBlock(xzDist(*rng), yDist(*rng), xzDist(*rng), {type});
+    }
+    world->takeChangedBlocks();
+}
+
+int runSnapshotBench(int argc, char** argv)
+{
+    const long chunkCount = BenchUtils::getArgOr(argc, argv, 0, SNAPSHOT_BENCH_DEFAULT_CHUNK_COUNT);
+    const int editsPerTick = BenchUtils::getArgOr(argc, argv, 1, SNAPSHOT_BENCH_DEFAULT_EDITS_PER_TICK);
+    if (chunkCount <= 0 || editsPerTick < 0)
+    {
+        Logger::err << "The chunk count has to be positive" << Logger::End;
+        return 1;
+    }
+    const int radius = std::max(1, (int)std::ceil(std::sqrt((double)chunkCount)/2));
+    const std::filesystem::path dirPath = std::filesystem::temp_directory_path()
+        /("acraft-snapshot-bench-"+std::to_string(getpid()));
+    std::filesystem::remove_all(dirPath);
+
+    int result{};
+    {
+        World world;
+        BenchUtils::generateHills(&world, radius, SNAPSHOT_BENCH_GROUND_HEIGHT);
+        WorldStore store;
+        // The hills don't depend on the seed
+        uint64_t seed{};
+        if (!store.open(dirPath.string(), &seed))
+            return 1;
+        BenchUtils::Stopwatch stopwatch;
+        if (!store.attach(&world))
+            return 1;
+        Logger::log << "Saved " << world.getChunks().size() << " chunks on the calling thread in "
+            << stopwatch.getElapsedMs() << "ms, that is what a blocking save would pause for" << Logger::End;
+
+        // Every chunk edited since the last checkpoint
+        std::mt19937 rng{1234};
+        for (const auto& [key, chunk] : world.getChunks())
+            chunk->markSectionsDirty(CHUNK_ALL_SECTIONS_MASK, 1u << CHUNK_CACHE_SAVE);
+        std::vector<const ChunkSection*> sectionsBefore;
+        for (const auto& [key, chunk] : world.getChunks())
+        {
+            for (int sectionI{}; sectionI < CHUNK_SECTION_COUNT; ++sectionI)
+                sectionsBefore.push_back(chunk->getSection(sectionI));
+        }
+        const uint64_t snapshotHash = world.computeChecksum();
+
+        stopwatch.restart();
+        const size_t snapshotCount = store.checkpoint();
+        const double pauseMs = stopwatch.getElapsedMs();
+
+        // Keep editing while the writer thread saves
+        std::vector<double> tickMs;
+        while (store.isCheckpointRunning())
+        {
+            BenchUtils::Stopwatch tickStopwatch;
+            makeEdits(&world, radius, editsPerTick, &rng);
+            tickMs.push_back(tickStopwatch.getElapsedMs());
+        }
+        const double saveMs = stopwatch.getElapsedMs();
+
+        long copiedCount{};
+        size_t sectionI{};
+        for (const auto& [key, chunk] : world.getChunks())
+        {
+            for (int i{}; i < CHUNK_SECTION_COUNT; ++i, ++sectionI)
+                copiedCount += sectionsBefore[sectionI] && chunk->getSection(i) != sectionsBefore[sectionI];
+        }
+
+        const size_t tickCount = std::max<size_t>(tickMs.size(), 1);
+        const double sumMs = std::accumulate(tickMs.begin(), tickMs.end(), 0.0);
+        std::sort(tickMs.begin(), tickMs.end());
+        tickMs.resize(tickCount);
+        Logger::log << "Checkpoint of " << snapshotCount << " chunks: " << pauseMs << "ms pause, saved in "
+            << saveMs << "ms in the background, meanwhile " << tickMs.size() << " ticks of " << editsPerTick
+            << " edits: avg " << sumMs/tickCount << "ms, p99 " << tickMs[tickCount*99/100] << "ms, max "
+            << tickMs.back() << "ms, " << copiedCount << " sections copied on write" << Logger::End;
+
+        World loaded;
+        for (int chunkZ{-radius}; chunkZ < radius; ++chunkZ)
+        {
+            for (int chunkX{-radius}; chunkX < radius; ++chunkX)
+            {
+                std::unique_ptr<Chunk> chunk = store.loadChunk(chunkX, chunkZ);
+                if (chunk)
+                    loaded.addChunk(std::move(chunk));
+            }
+        }
+        if (loaded.computeChecksum() != snapshotHash)
+        {
+            Logger::err << "The saved world doesn't match the snapshot" << Logger::End;
+            result = 1;
+        }
+        store.detach();
+    }
+
+    std::filesystem::remove_all(dirPath);
+    return result;
+}
@@ -0,0 +1,122 @@
+#include "benches.h"
+#include "../TickScheduler.h"
+#include "../ThreadPool.h"
+#include "../Logger.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#define TICK_BENCH_DEFAULT_CHUNKS 10'000
+#define TICK_BENCH_DEFAULT_TICKS 200
+#define TICK_BENCH_GROUND_HEIGHT 24
+#define TICK_BENCH_SEED 42
+// Nothing falls yet, so we make a block fall for the measurement
+#define TICK_BENCH_FALLING_TYPE BLOCK_TYPE_COBBLESTONE
+#define TICK_BENCH_FALLING_COLUMNS 2000
+#define TICK_BENCH_FALLING_COLUMN_HEIGHT 8
+// 16x16 patches where the grass is dug up, so it spreads back
+#define TICK_BENCH_BARE_PATCHES 2000
+
+/*
+ * Returns the y of the highest block of the column.
+ */
+static int findSurfaceY(World* world, int x, int z)
+{
+    int y = CHUNK_HEIGHT_BLOCKS-1;
+    while (y > 0 && world->getBlock(x, y, z).type == BLOCK_TYPE_AIR)
+        --y;
+    return y;
+}
+
+/*
+ * Makes the same world for every run: hills, with bare dirt patches and floating columns
+ * of falling blocks. The chunks aren't lit, so they have full sky light.
+ */
+static void setUpWorld(World* world, TickScheduler* scheduler, int radius)
+{
+    BenchUtils::generateHills(world, radius, TICK_BENCH_GROUND_HEIGHT);
+
+    std::mt19937 rng{TICK_BENCH_SEED};
+    const int widthBlocks = radius*2*CHUNK_WIDTH_BLOCKS;
+    auto randomCoord{[&](){ return (int)(rng()%widthBlocks)-widthBlocks/2; }};
+    for (int i{}; i < TICK_BENCH_BARE_PATCHES; ++i)
+    {
+        const int x = randomCoord();
+        const int z = randomCoord();
+        world->replaceInBox({x, 0, z}, {x+15, CHUNK_HEIGHT_BLOCKS-1, z+15}, BLOCK_TYPE_GRASS, {BLOCK_TYPE_DIRT});
+    }
+    for (int i{}; i < TICK_BENCH_FALLING_COLUMNS; ++i)
+    {
+        const int x = randomCoord();
+        const int z = randomCoord();
+        const int bottomY = findSurfaceY(world, x, z)+10;
+        for (int y = bottomY; y < bottomY+TICK_BENCH_FALLING_COLUMN_HEIGHT; ++y)
+        {
+            world->setBlock(x, y, z, {TICK_BENCH_FALLING_TYPE});
+            scheduler->onBlockChanged({x, y, z});
+        }
+    }
+    // Nobody takes them in the benchmark
+    world->takeChangedBlocks();
+}
+
+/*
+ * Returns the hash of the world after the ticks.
+ */
+static uint64_t runTicks(int radius, int tickCount, ThreadPool* pool, const char* name)
+{
+    World world;
+    TickScheduler scheduler{&world, pool, TICK_BENCH_SEED};
+    setUpWorld(&world, &scheduler, radius);
+
+    std::vector<double> tickMs;
+    TickStats total;
+    for (int i{}; i < tickCount; ++i)
+    {
+        BenchUtils::Stopwatch stopwatch;
+        const TickStats stats = scheduler.tick();
+        tickMs.push_back(stopwatch.getElapsedMs());
+        total.randomTicks += stats.randomTicks;
+        total.scheduledTicks += stats.scheduledTicks;
+        total.writes += stats.writes;
+        world.takeChangedBlocks();
+    }
+
+    const double sumMs = std::accumulate(tickMs.begin(), tickMs.end(), 0.0);
+    std::sort(tickMs.begin(), tickMs.end());
+    Logger::log << name << ": " << (total.randomTicks+total.scheduledTicks)/(sumMs/1000)/1e6 << " M block ticks/s ("
+        << total.randomTicks/tickCount << " random, " << total.scheduledTicks/(double)tickCount << " scheduled, "
+        << total.writes/(double)tickCount << " writes per tick), tick latency: avg " << sumMs/tickCount
+        << "ms, p50 " << tickMs[tickMs.size()/2] << "ms, p99 " << tickMs[tickMs.size()*99/100]
+        << "ms, max " << tickMs.back() << "ms, " << scheduler.getScheduledCount() << " still scheduled" << Logger::End;
+    return world.computeChecksum();
+}
+
+int runTickBench(int argc, char** argv)
+{
+    const long chunkCount = BenchUtils::getArgOr(argc, argv, 0, TICK_BENCH_DEFAULT_CHUNKS);
+    const int tickCount = BenchUtils::getArgOr(argc, argv, 1, TICK_BENCH_DEFAULT_TICKS);
+    if (chunkCount <= 0 || tickCount <= 0)
+    {
+        Logger::err << "The chunk and tick counts have to be positive" << Logger::End;
+        return 1;
+    }
+    BlockRegistry::g_tables.flags[TICK_BENCH_FALLING_TYPE] |= BLOCK_FLAG_FALLING;
+
+    // A square of at least `chunkCount` chunks
+    const int radius = std::ceil(std::sqrt((double)chunkCount)/2);
+    Logger::log << "Ticking " << radius*2*radius*2 << " chunks " << tickCount << " times" << Logger::End;
+
+    const uint64_t serialHash = runTicks(radius, tickCount, nullptr, "1 thread");
+    ThreadPool& pool = ThreadPool::getShared();
+    const uint64_t parallelHash = runTicks(radius, tickCount, &pool,
+            (std::to_string(pool.getThreadCount()+1)+" threads").c_str());
+    if (serialHash != parallelHash)
+    {
+        Logger::err << "The results depend on the thread count" << Logger::End;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "benches.h"
+#include "../World.h"
+#include "../Logger.h"
+#include <algorithm>
+#include <vector>
+#include <random>
+#include <tuple>
+
+#define WORLD_BENCH_DEFAULT_RADIUS 8
+#define WORLD_BENCH_DEFAULT_ACCESSES 4'000'000
+// Height of the generated terrain
+#define WORLD_BENCH_GROUND_HEIGHT 96
+
+static void fillWorld(World* world, int radius)
+{
+    std::mt19937 rng{1234};
+    for (int chunkZ{-radius}; chunkZ < radius; ++chunkZ)
+    {
+        for (int chunkX{-radius}; chunkX < radius; ++chunkX)
+        {
+            auto chunk = std::make_unique<Chunk>(chunkX, chunkZ);
+            for (int y{}; y < WORLD_BENCH_GROUND_HEIGHT; ++y)
+            {
+                for (int z{}; z < CHUNK_WIDTH_BLOCKS; ++z)
+                {
+                    for (int x{}; x < CHUNK_WIDTH_BLOCKS; ++x)
+                    {
+                        // Some caves, so that not everything is the same
+                        if (rng()%8 != 0)
+                            chunk->setBlock(x, y, z, {BLOCK_TYPE_STONE});
+                    }
+                }
+            }
+            world->addChunk(std::move(chunk));
+        }
+    }
+}
+
+static void printResult(const char* name, double elapsedMs, long accessCount, uint64_t checksum)
+{
+    Logger::log << name << ": " << elapsedMs*1e6/accessCount << " ns/access, "
+        << accessCount/(elapsedMs/1000)/1e6 << " M accesses/s (checksum: " << checksum << ')' << Logger::End;
+}
+
+/*
+ * Runs `func` on every position and prints the time per access.
+ * The results are summed so the accesses can't be optimized out.
+ */
+template <typename Func>
+static void measure(const char* name, const std::vector<BlockPos>& positions, Func func)
+{
+    BenchUtils::Stopwatch stopwatch;
+    uint64_t checksum{};
+    for (const BlockPos& pos : positions)
+        checksum += func(pos);
+    printResult(name, stopwatch.getElapsedMs(), positions.size(), checksum);
+}
+
+int runWorldBench(int argc, char** argv)
+{
+    const int radius = BenchUtils::getArgOr(argc, argv, 0, WORLD_BENCH_DEFAULT_RADIUS);
+    const long accessCount = BenchUtils::getArgOr(argc, argv, 1, WORLD_BENCH_DEFAULT_ACCESSES);
+    const int widthBlocks = radius*2*CHUNK_WIDTH_BLOCKS;
+
+    World world;
+    {
+        BenchUtils::Stopwatch stopwatch;
+        fillWorld(&world, radius);
+        Logger::log << "Filled " << world.getChunks().size() << " chunks in " << stopwatch.getElapsedMs() << "ms" << Logger::End;
+    }
+
+    std::mt19937 rng{42};
+    std::vector<BlockPos> randomPositions(accessCount);
+    for (BlockPos& pos : randomPositions)
+    {
+        pos.x = (int)(rng()%widthBlocks)-widthBlocks/2;
+        pos.y = rng()%WORLD_BENCH_GROUND_HEIGHT;
+        pos.z = (int)(rng()%widthBlocks)-widthBlocks/2;
+    }
+
+    // A walk that steps to a neighbouring block each time, like a flood fill does
+    std::vector<BlockPos> coherentPositions(accessCount);
+    {
+        BlockPos pos{0, WORLD_BENCH_GROUND_HEIGHT/2, 0};
+        for (BlockPos& outPos : coherentPositions)
+        {
+            const uint axisI = rng()%3;
+            int* axis = axisI == 0 ? &pos.x : (axisI == 1 ? &pos.y : &pos.z);
+            *axis += (rng()%2) ? 1 : -1;
+            pos.x = std::clamp(pos.x, -widthBlocks/2, widthBlocks/2-1);
+            pos.y = std::clamp(pos.y, 0, WORLD_BENCH_GROUND_HEIGHT-1);
+            pos.z = std::clamp(pos.z, -widthBlocks/2, widthBlocks/2-1);
+            outPos = pos;
+        }
+    }
+
+    auto hashLookup{[&](const BlockPos& pos){
+        const Chunk* chunk = world.getChunk(World::blockToChunkCoord(pos.x), World::blockToChunkCoord(pos.z));
+        return chunk ? chunk->getBlock(World::blockToLocalCoord(pos.x), pos.y, World::blockToLocalCoord(pos.z)).type : 0;
+    }};
+    auto cachedLookup{[&](const BlockPos& pos){
+        return world.getBlock(pos.x, pos.y, pos.z).type;
+    }};
+
+    measure("Random, hash lookup", randomPositions, hashLookup);
+    measure("Random, World::getBlock()", randomPositions, cachedLookup);
+    measure("Coherent, hash lookup", coherentPositions, hashLookup);
+    measure("Coherent, World::getBlock()", coherentPositions, cachedLookup);
+
+    // The 6 neighbours of every block, the access pattern of meshing
+    auto visitNeighbours{[&](auto getBlock){
+        BenchUtils::Stopwatch stopwatch;
+        uint64_t checksum{};
+        long accesses{};
+        for (const auto& [_, chunk] : world.getChunks())
+        {
+            const ChunkNeighbourhood view = world.getNeighbourhood(*chunk);
+            for (int y{}; y < WORLD_BENCH_GROUND_HEIGHT; ++y)
+            {
+                for (int z{}; z < CHUNK_WIDTH_BLOCKS; ++z)
+                {
+                    for (int x{}; x < CHUNK_WIDTH_BLOCKS; ++x)
+                    {
+                        checksum += getBlock(*chunk, view, x-1, y, z) + getBlock(*chunk, view, x+1, y, z)
+                                  + getBlock(*chunk, view, x, y-1, z) + getBlock(*chunk, view, x, y+1, z)
+                                  + getBlock(*chunk, view, x, y, z-1) + getBlock(*chunk, view, x, y, z+1);
+                        accesses += 6;
+                    }
+                }
+            }
+        }
+        return std::make_tuple(stopwatch.getElapsedMs(), accesses, checksum);
+    }};
+
+    {
+        const auto [elapsedMs, accesses, checksum] = visitNeighbours(
+                [&](const Chunk& chunk, const ChunkNeighbourhood&, int x, int y, int z){
+            return world.getBlock(chunk.getChunkX()*CHUNK_WIDTH_BLOCKS+x, y, chunk.getChunkZ()*CHUNK_WIDTH_BLOCKS+z).type;
+        });
+        printResult("Block neighbours, World::getBlock()", elapsedMs, accesses, checksum);
+    }
+    {
+        const auto [elapsedMs, accesses, checksum] = visitNeighbours(
+                [](const Chunk&, const ChunkNeighbourhood& view, int x, int y, int z){
+            return view.getBlock(x, y, z).type;
+        });
+        printResult("Block neighbours, ChunkNeighbourhood", elapsedMs, accesses, checksum);
+    }
+
+    return 0;
+}
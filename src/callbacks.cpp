@@ -1,55 +1,58 @@
 #include "callbacks.h"
 #include "Logger.h"
 #include "Camera.h"
+#include "GlState.h"
+#include "Profiler.h"
+#include "Block.h"
+#include "InputQueue.h"
 
 extern bool g_isWireframeMode;
-extern int g_cursRelativeX;
-extern int g_cursRelativeY;
 extern bool g_isDebugCam;
+extern InputQueue g_inputQueue;
 extern Camera g_camera;
 
 void GLAPIENTRY _glMsgCb(
         GLenum source, GLenum type, GLuint, GLenum severity,
         GLsizei, const GLchar* message, const void*)
 {
-    std::cout << "\033[93m[OpenGL]\033[0m: " << "Message: type=\"";
+    Logger::log("OpenGL") << "Message: type=\"";
     switch (type)
     {
-    case GL_DEBUG_TYPE_ERROR: std::cout << "other"; break;
-    case GL_DEBUG_TYPE_PERFORMANCE: std::cout << "performance"; break;
-    case GL_DEBUG_TYPE_PORTABILITY: std::cout << "portability"; break;
-    case GL_DEBUG_TYPE_POP_GROUP: std::cout << "pop group"; break;
-    case GL_DEBUG_TYPE_PUSH_GROUP: std::cout << "push group"; break;
-    case GL_DEBUG_TYPE_MARKER: std::cout << "marker"; break;
-    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: std::cout << "undefined behavior"; break;
-    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: std::cout << "deprecated behavior"; break;
-    default: std::cout << "unknown"; break;
+    case GL_DEBUG_TYPE_ERROR: Logger::log << "other"; break;
+    case GL_DEBUG_TYPE_PERFORMANCE: Logger::log << "performance"; break;
+    case GL_DEBUG_TYPE_PORTABILITY: Logger::log << "portability"; break;
+    case GL_DEBUG_TYPE_POP_GROUP: Logger::log << "pop group"; break;
+    case GL_DEBUG_TYPE_PUSH_GROUP: Logger::log << "push group"; break;
+    case GL_DEBUG_TYPE_MARKER: Logger::log << "marker"; break;
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: Logger::log << "undefined behavior"; break;
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: Logger::log << "deprecated behavior"; break;
+    default: Logger::log << "unknown"; break;
     }
 
-    std::cout << "\", source=\"";
+    Logger::log << "\", source=\"";
     switch (source)
     {
-    case GL_DEBUG_SOURCE_API: std::cout << "API"; break;
-    case GL_DEBUG_SOURCE_WINDOW_SYSTEM: std::cout << "window system"; break;
-    case GL_DEBUG_SOURCE_SHADER_COMPILER: std::cout << "shader compiler"; break;
-    case GL_DEBUG_SOURCE_THIRD_PARTY: std::cout << "third party"; break;
-    case GL_DEBUG_SOURCE_APPLICATION: std::cout << "application"; break;
-    case GL_DEBUG_SOURCE_OTHER: std::cout << "other"; break;
-    default: std::cout << "unknown"; break;
+    case GL_DEBUG_SOURCE_API: Logger::log << "API"; break;
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM: Logger::log << "window system"; break;
+    case GL_DEBUG_SOURCE_SHADER_COMPILER: Logger::log << "shader compiler"; break;
+    case GL_DEBUG_SOURCE_THIRD_PARTY: Logger::log << "third party"; break;
+    case GL_DEBUG_SOURCE_APPLICATION: Logger::log << "application"; break;
+    case GL_DEBUG_SOURCE_OTHER: Logger::log << "other"; break;
+    default: Logger::log << "unknown"; break;
     }
 
-    std::cout << "\", severity=\"";
+    Logger::log << "\", severity=\"";
     switch (severity)
     {
-    case GL_DEBUG_SEVERITY_HIGH: std::cout << "high"; break;
-    case GL_DEBUG_SEVERITY_MEDIUM: std::cout << "medium"; break;
-    case GL_DEBUG_SEVERITY_LOW: std::cout << "low"; break;
-    case GL_DEBUG_SEVERITY_NOTIFICATION: std::cout << "notification"; break;
-    default: std::cout << "unknown"; break;
+    case GL_DEBUG_SEVERITY_HIGH: Logger::log << "high"; break;
+    case GL_DEBUG_SEVERITY_MEDIUM: Logger::log << "medium"; break;
+    case GL_DEBUG_SEVERITY_LOW: Logger::log << "low"; break;
+    case GL_DEBUG_SEVERITY_NOTIFICATION: Logger::log << "notification"; break;
+    default: Logger::log << "unknown"; break;
     }
 
-    std::cout << "\" : " << message << '\n';
-    std::cout.flush();
+    Logger::log << "\" : " << message << Logger::End;
+    Logger::log(Logger::End);
 
     int arrayBufferBinding{};
     glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &arrayBufferBinding);
@@ -92,6 +95,23 @@ void _keyCb(GLFWwindow* win, int key, int scancode, int action, int mods)
     (void)win;
     (void)scancode;
 
+    // Held down with any modifier, the simulation tracks them until the release
+    InputAction movement = INPUT_ACTION__COUNT;
+    switch (key)
+    {
+    case GLFW_KEY_W: movement = INPUT_ACTION_FORWARD; break;
+    case GLFW_KEY_S: movement = INPUT_ACTION_BACKWARDS; break;
+    case GLFW_KEY_A: movement = INPUT_ACTION_LEFT; break;
+    case GLFW_KEY_D: movement = INPUT_ACTION_RIGHT; break;
+    case GLFW_KEY_SPACE: movement = INPUT_ACTION_UP; break;
+    case GLFW_KEY_LEFT_SHIFT: movement = INPUT_ACTION_DOWN; break;
+    }
+    if (movement != INPUT_ACTION__COUNT && action != GLFW_REPEAT)
+    {
+        g_inputQueue.push({INPUT_EVENT_ACTION, movement, action == GLFW_PRESS});
+        return;
+    }
+
     if (action == GLFW_PRESS && mods == 0)
     {
         if (key == GLFW_KEY_F3)
@@ -102,13 +122,30 @@ void _keyCb(GLFWwindow* win, int key, int scancode, int action, int mods)
         {
             toggleDebugCam();
         }
+        else if (key == GLFW_KEY_F4)
+        {
+            BlockStuffHandler::get().toggleAo();
+        }
+        else if (key == GLFW_KEY_F5)
+        {
+            toggleProfilerCapture();
+        }
     }
 }
 
 void toggleWireframeMode()
 {
     g_isWireframeMode = !g_isWireframeMode;
-    glPolygonMode(GL_FRONT_AND_BACK, g_isWireframeMode ? GL_LINE : GL_FILL);
+    GlState::setPolygonMode(g_isWireframeMode ? GL_LINE : GL_FILL);
+}
+
+void toggleProfilerCapture()
+{
+#ifdef ACRAFT_PROFILER
+    Profiler::toggleCapture();
+#else
+    Logger::warn << "The profiler is not compiled in, reconfigure with -DENABLE_PROFILER=ON" << Logger::End;
+#endif
 }
 
 void toggleDebugCam()
@@ -122,8 +159,24 @@ void _mouseMoveCb(GLFWwindow*, double x, double y)
     static double cursLastX = x;
     static double cursLastY = y;
 
-    g_cursRelativeX = x - cursLastX;
-    g_cursRelativeY = cursLastY - y;
+    InputEvent event{INPUT_EVENT_LOOK};
+    event.lookX = x - cursLastX;
+    event.lookY = cursLastY - y;
+    g_inputQueue.push(event);
     cursLastX = x;
     cursLastY = y;
 }
+
+void _mouseButtonCb(GLFWwindow*, int button, int action, int mods)
+{
+    if (action != GLFW_PRESS || mods != 0)
+        return;
+
+    // Handled on the next tick, against the targeted block
+    if (button == GLFW_MOUSE_BUTTON_LEFT)
+        g_inputQueue.push({INPUT_EVENT_ACTION, INPUT_ACTION_BREAK_BLOCK, true});
+    else if (button == GLFW_MOUSE_BUTTON_RIGHT)
+        g_inputQueue.push({INPUT_EVENT_ACTION, INPUT_ACTION_PLACE_BLOCK, true});
+    else if (button == GLFW_MOUSE_BUTTON_MIDDLE)
+        g_inputQueue.push({INPUT_EVENT_ACTION, INPUT_ACTION_PLACE_FLUID, true});
+}
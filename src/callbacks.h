@@ -13,4 +13,6 @@ void _windowResizeCb(GLFWwindow*, int width, int height);
 void _keyCb(GLFWwindow* win, int key, int scancode, int action, int mods);
 void toggleWireframeMode();
 void toggleDebugCam();
+void toggleProfilerCapture();
 void _mouseMoveCb(GLFWwindow*, double x, double y);
+void _mouseButtonCb(GLFWwindow*, int button, int action, int mods);
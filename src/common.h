@@ -4,6 +4,8 @@
 #include <fstream>
 #include <sstream>
 #include <cstring>
+#include <cstdint>
+#include <string_view>
 
 inline std::string loadTextFile(const std::string& path)
 {
@@ -23,3 +25,17 @@ inline std::string loadTextFile(const std::string& path)
         return ""; // Not reached
     }
 }
+
+/*
+ * 64-bit FNV-1a hash. Pass the previous result as `hash` to hash
+ * several pieces of data as one.
+ */
+constexpr uint64_t fnv1aHash(std::string_view data, uint64_t hash=0xcbf29ce484222325)
+{
+    for (char c : data)
+    {
+        hash ^= (unsigned char)c;
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
@@ -2,135 +2,368 @@
 #include "Logger.h"
 #include "ShaderProg.h"
 #include "Texture.h"
+#include "GlState.h"
 #include "Camera.h"
 #include "Block.h"
+#include "World.h"
+#include "WorldGen.h"
+#include "WorldStore.h"
+#include "NetClient.h"
+#include "Simulation.h"
+#include "InputQueue.h"
+#include "InputRecording.h"
+#include "ThreadPool.h"
 #include "obj.h"
+#include "AssetPack.h"
 #include "callbacks.h"
-#include "../deps/OpenSimplexNoise/OpenSimplexNoise/OpenSimplexNoise.h"
+#include "Benchmark.h"
+#include "Profiler.h"
+#include "GpuTimer.h"
+#include "Metrics.h"
 #include <cmath>
+#include <cstdio>
 #include <iomanip>
+#include <iostream>
 #include <vector>
 #include <ctime>
+#include <memory>
+#include <chrono>
+#include <charconv>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #define WIN_W 1500
 #define WIN_H 1000
-#define CAM_SPEED 0.1f
 #define CAM_FOV_DEG 45.0f
 
-#define GROUND_HEIGHT_MAX 384
-
-#define CHUNK_WIDTH_BLOCKS 16
+#define TITLE_UPDATE_INTERVAL_SEC 0.25
 
 bool g_isWireframeMode = false;
-int g_cursRelativeX = 0;
-int g_cursRelativeY = 0;
 bool g_isDebugCam = false;
+// Filled by the window callbacks, emptied by the simulation
+InputQueue g_inputQueue;
 
 auto g_camera = Camera{(float)WIN_W/WIN_H, CAM_FOV_DEG};
-auto g_noiseGen = OpenSimplexNoise::Noise{std::time(nullptr)};
 
-struct Chunk
+// Frame count of the benchmark when only `--headless` is given
+#define BENCH_DEFAULT_FRAMES 1000
+// In chunks, asked from the server with `--connect`
+#define CONNECT_VIEW_DISTANCE 8
+// Limit of `--threads`, more is most likely a typo
+#define MAX_THREAD_COUNT 1024
+
+struct Options
 {
-    /*
-     * Position of the chunk in a chunk-sized grid.
-     */
-    int chunkX{};
-    int chunkZ{};
-
-    using BlockRow_t = std::array<Block, CHUNK_WIDTH_BLOCKS>;
-    using ChunkSlice_t = std::array<BlockRow_t, CHUNK_WIDTH_BLOCKS>;
-    using ChunkContent_t = std::array<ChunkSlice_t, GROUND_HEIGHT_MAX>;
-    ChunkContent_t blocks; // Indexing: [y][z][x]
+    // Render to an invisible window or an offscreen context
+    bool isHeadless{};
+    // Fly along the benchmark path and exit after this many frames, 0 means run normally
+    int benchFrames{};
+    uint64_t seed = std::time(nullptr);
+    bool isSeedSet{};
+    // Append the metrics to this file every second, if not null
+    const char* statsCsvPath{};
+    // Load and save the world in this directory, if not null
+    const char* worldDir{};
+    // Play on the server at this address instead of a local world, if not null
+    const char* connectAddress{};
+    // Save the input to this file at exit, if not null
+    const char* recordPath{};
+    // Replay the input from this file and exit at its end, if not null
+    const char* replayPath{};
+    // Threads of the shared pool, 0 means one per hardware thread
+    int threadCount{};
 };
 
-Chunk genChunk(int chunkX, int chunkZ)
+static void printUsage(const char* progName)
 {
-    Chunk chunk;
-    chunk.chunkX = chunkX;
-    chunk.chunkZ = chunkZ;
+    std::cout << "Usage: " << progName << " [options]\n"
+        << "Options:\n"
+        << "  --headless      Render without a visible window, implies --frames " << BENCH_DEFAULT_FRAMES << '\n'
+        << "  --frames N      Run the benchmark for N frames with V-Sync disabled and print the results as JSON\n"
+        << "  --seed N        World seed, default is the current time, or the seed of the loaded world\n"
+        << "  --stats-csv F   Write frame statistics to the CSV file F every second\n"
+        << "  --world DIR     Save the world in the directory DIR, and load it from there if it exists\n"
+        << "  --connect ADDR  Play on the server at ADDR (HOST:PORT or unix:PATH), see acraft-server\n"
+        << "  --record F      Record the seed, window size and input to the file F\n"
+        << "  --replay F      Replay the recording F, then print the world and player path checksums\n"
+        << "  --threads N     Use N worker threads, default is one per hardware thread\n"
+        << "  --help          Show this help\n";
+}
 
-    for (int offsX{}; offsX < CHUNK_WIDTH_BLOCKS; ++offsX)
+static Options parseArgs(int argc, char** argv)
+{
+    Options opts;
+    for (int i{1}; i < argc; ++i)
     {
-        for (int offsZ{}; offsZ < CHUNK_WIDTH_BLOCKS; ++offsZ)
-        {
-            const int x = chunkX*CHUNK_WIDTH_BLOCKS+offsX;
-            const int z = chunkZ*CHUNK_WIDTH_BLOCKS+offsZ;
+        const std::string_view arg = argv[i];
 
-            const int groundHeight = 50+std::round((g_noiseGen.eval(x/500.0f, z/500.0f)+0.5f)*(GROUND_HEIGHT_MAX-50));
-            for (int y{}; y < GROUND_HEIGHT_MAX; ++y)
+        auto getNumValue{[&](){
+            uint64_t value{};
+            const char* str = i+1 < argc ? argv[++i] : "";
+            const auto result = std::from_chars(str, str+std::strlen(str), value);
+            if (result.ec != std::errc{} || *result.ptr != '\0')
             {
-                BlockType type = BLOCK_TYPE_AIR;
-                if (y <= groundHeight)
-                {
-                    // TODO: More stone types
-                    // TODO: Ores
-                    const int grassLayerHeight = 1;
-                    const int dirtLayerHeight = 5+10*(g_noiseGen.eval(x/54.0f, z/54.0f)+0.5f);
-                    const int stoneLayerHeight = groundHeight*0.75f-20*(g_noiseGen.eval(x/20.0f, z/20.0f)+0.5f);
-                    const int bedrockLayerHeight = 1+2*(g_noiseGen.eval(x/5.0f, z/5.0f)+0.5f);
-                    const int isDirtBlob = y > 20 && g_noiseGen.eval(x/8.0f, z/8.0f, y/8.0f) >= 0.4f;
-                    const int isCoalOreBlob = g_noiseGen.eval(x/7.0f+10, z/7.0f+10, y/7.0f+10) >= 0.6f; // Coal or deepslate coal
-                    if (y <= bedrockLayerHeight)
-                    {
-                        type = BLOCK_TYPE_BEDROCK;
-                    }
-                    else if (y > groundHeight-grassLayerHeight)
-                    {
-                        type = BLOCK_TYPE_GRASS;
-                    }
-                    else if (isDirtBlob || y > groundHeight-grassLayerHeight-dirtLayerHeight)
-                    {
-                        type = BLOCK_TYPE_DIRT;
-                    }
-                    else if (y > groundHeight-grassLayerHeight-dirtLayerHeight-stoneLayerHeight)
-                    {
-                        if (isCoalOreBlob)
-                        {
-                            type = BLOCK_TYPE_COAL_ORE;
-                        }
-                        else
-                        {
-                            type = BLOCK_TYPE_STONE;
-                        }
-                    }
-                    else
-                    {
-                        if (isCoalOreBlob)
-                        {
-                            type = BLOCK_TYPE_DEEPSLATE_COAL_ORE;
-                        }
-                        else
-                        {
-                            type = BLOCK_TYPE_DEEPSLATE;
-                        }
-                    }
-                }
-                chunk.blocks[y][offsZ][offsX].type = type;
+                Logger::fatal << "Invalid or missing value for argument: " << arg << Logger::End;
             }
+            return value;
+        }};
+        auto getIntValue{[&](int maxValue){
+            const uint64_t value = getNumValue();
+            if (value > (uint64_t)maxValue)
+            {
+                Logger::fatal << "Value out of range for argument: " << arg << ", the maximum is " << maxValue << Logger::End;
+            }
+            return (int)value;
+        }};
+
+        if (arg == "--headless")
+        {
+            opts.isHeadless = true;
+        }
+        else if (arg == "--frames")
+        {
+            opts.benchFrames = getIntValue(std::numeric_limits<int>::max());
+        }
+        else if (arg == "--seed")
+        {
+            opts.seed = getNumValue();
+            opts.isSeedSet = true;
+        }
+        else if (arg == "--stats-csv")
+        {
+            if (i+1 >= argc)
+            {
+                Logger::fatal << "Missing value for argument: " << arg << Logger::End;
+            }
+            opts.statsCsvPath = argv[++i];
+        }
+        else if (arg == "--world")
+        {
+            if (i+1 >= argc)
+            {
+                Logger::fatal << "Missing value for argument: " << arg << Logger::End;
+            }
+            opts.worldDir = argv[++i];
+        }
+        else if (arg == "--connect")
+        {
+            if (i+1 >= argc)
+            {
+                Logger::fatal << "Missing value for argument: " << arg << Logger::End;
+            }
+            opts.connectAddress = argv[++i];
+        }
+        else if (arg == "--record")
+        {
+            if (i+1 >= argc)
+            {
+                Logger::fatal << "Missing value for argument: " << arg << Logger::End;
+            }
+            opts.recordPath = argv[++i];
+        }
+        else if (arg == "--replay")
+        {
+            if (i+1 >= argc)
+            {
+                Logger::fatal << "Missing value for argument: " << arg << Logger::End;
+            }
+            opts.replayPath = argv[++i];
+        }
+        else if (arg == "--threads")
+        {
+            opts.threadCount = getIntValue(MAX_THREAD_COUNT);
+        }
+        else if (arg == "--help")
+        {
+            printUsage(argv[0]);
+            std::exit(0);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            Logger::fatal << "Unknown argument: " << arg << Logger::End;
+        }
+    }
+
+    // The replay runs until the end of the recording instead
+    if (opts.isHeadless && !opts.benchFrames && !opts.replayPath)
+        opts.benchFrames = BENCH_DEFAULT_FRAMES;
+    if (opts.worldDir && opts.connectAddress)
+    {
+        Logger::fatal << "--world and --connect can't be used together, the server saves the world" << Logger::End;
+    }
+    // Recordings start from a newly generated world, and the benchmark flies its own path
+    if ((opts.recordPath || opts.replayPath) && (opts.worldDir || opts.connectAddress || opts.benchFrames))
+    {
+        Logger::fatal << "--record and --replay can't be used with --world, --connect or --frames" << Logger::End;
+    }
+    if (opts.recordPath && opts.replayPath)
+    {
+        Logger::fatal << "--record and --replay can't be used together" << Logger::End;
+    }
+    return opts;
+}
+
+struct FrameMetrics
+{
+    Metrics::Counter& frames = Metrics::addCounter("frames");
+    Metrics::Histogram& frameTime = Metrics::addHistogram("frame_ms");
+    Metrics::Gauge& sectionsRendered = Metrics::addGauge("sections_rendered");
+    Metrics::Gauge& sectionsRemeshed = Metrics::addGauge("sections_remeshed");
+    Metrics::Gauge& drawCalls = Metrics::addGauge("draw_calls");
+    Metrics::Gauge& triangles = Metrics::addGauge("triangles");
+    Metrics::Gauge& glStateChanges = Metrics::addGauge("gl_state_changes");
+    Metrics::Gauge& glStateChangesAvoided = Metrics::addGauge("gl_state_changes_avoided");
+
+    // Registered up front like the rest, the CSV columns are fixed after the first window
+    struct GpuPass
+    {
+        const char* name{};
+        Metrics::Histogram& time;
+    };
+    GpuPass gpuPasses[2]{
+        {"Blocks", Metrics::addHistogram("gpu_blocks_ms")},
+        {"Debug camera model", Metrics::addHistogram("gpu_debug_camera_model_ms")},
+    };
+    uint64_t lastGpuFrameId{};
+};
+
+/*
+ * Records the pass times of the newest frame the GPU finished, see `GPU_PASS()`.
+ */
+static void recordGpuPassTimes(FrameMetrics* metrics)
+{
+    const GpuTimer::FrameResults& results = GpuTimer::getLatestResults();
+    if (results.frameId == metrics->lastGpuFrameId)
+        return;
+    metrics->lastGpuFrameId = results.frameId;
+
+    for (int i{}; i < results.passCount; ++i)
+    {
+        const GpuTimer::PassResult& result = results.passes[i];
+        for (FrameMetrics::GpuPass& pass : metrics->gpuPasses)
+        {
+            if (std::strcmp(pass.name, result.name) == 0)
+                pass.time.record(result.gpuMs);
         }
     }
-    return chunk;
 }
 
-int main()
+static void updateWindowTitle(GLFWwindow* window, const FrameMetrics& metrics, const RayHit& target)
 {
+    const Metrics::HistogramStats& frameStats = metrics.frameTime.getLastWindowStats();
+    const glm::vec3& camPos = g_camera.getPos();
+
+    static char title[256]{};
+    std::snprintf(title, sizeof(title),
+            "ACraft | FPS: %lu | Frame ms p50: %.1f p95: %.1f p99: %.1f max: %.1f "
+            "| Camera: {%.1f, %.1f, %.1f} | Sections rendered: %.0f | Draw calls: %.0f "
+            "| GL state changes: %.0f (avoided: %.0f) | Target: %s",
+            (unsigned long)(frameStats.count/METRICS_WINDOW_SEC),
+            frameStats.p50, frameStats.p95, frameStats.p99, frameStats.max,
+            camPos.x, camPos.y, camPos.z,
+            metrics.sectionsRendered.get(), metrics.drawCalls.get(),
+            metrics.glStateChanges.get(), metrics.glStateChangesAvoided.get(),
+            target.isHit ? BlockRegistry::getName(target.block.type) : "none");
+    glfwSetWindowTitle(window, title);
+}
+
+int main(int argc, char** argv)
+{
+    PROFILE_THREAD_NAME("Main");
+    const auto startupBeginTime = std::chrono::steady_clock::now();
+    Options opts = parseArgs(argc, argv);
+    const bool isBenchmark = opts.benchFrames > 0;
+    ThreadPool::setSharedThreadCount(opts.threadCount);
+
+    if (isBenchmark || opts.replayPath)
+    {
+        // Keep stdout clean for the JSON output
+        Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Quiet);
+    }
+
+    InputRecording replay;
+    int winW = WIN_W;
+    int winH = WIN_H;
+    if (opts.replayPath)
+    {
+        if (!replay.load(opts.replayPath))
+        {
+            Logger::fatal << "Failed to load recording: \"" << opts.replayPath << '"' << Logger::End;
+        }
+        // Same world and view as when recording
+        opts.seed = replay.getSeed();
+        winW = replay.getWindowWidth();
+        winH = replay.getWindowHeight();
+        g_camera.setWinAspectRatio((float)winW/winH);
+        Logger::log << "Replaying " << replay.getTickCount() << " ticks and " << replay.getEventCount()
+            << " input events" << Logger::End;
+    }
+
+    // The saved world decides the seed, the chunks that aren't saved yet must match the saved ones
+    std::unique_ptr<WorldStore> worldStore;
+    if (opts.worldDir)
+    {
+        worldStore = std::make_unique<WorldStore>();
+        uint64_t worldSeed = opts.seed;
+        if (!worldStore->open(opts.worldDir, &worldSeed))
+        {
+            Logger::fatal << "Failed to open world: \"" << opts.worldDir << '"' << Logger::End;
+        }
+        if (opts.isSeedSet && worldSeed != opts.seed)
+        {
+            Logger::fatal << "The world \"" << opts.worldDir << "\" was created with seed " << worldSeed
+                << ", not " << opts.seed << Logger::End;
+        }
+        opts.seed = worldSeed;
+    }
+    WorldGen::setSeed(opts.seed);
+    Logger::log << "World seed: " << opts.seed << Logger::End;
+
     glfwSetErrorCallback(_glfwErrCb);
+    bool isOffscreenContext = false;
+#ifdef GLFW_PLATFORM_NULL
+    // Without a display server, use the null platform with an OSMesa context (e.g. llvmpipe)
+    if (opts.isHeadless && !std::getenv("DISPLAY") && !std::getenv("WAYLAND_DISPLAY"))
+    {
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+        isOffscreenContext = true;
+    }
+#endif
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    GLFWwindow* window = glfwCreateWindow(WIN_W, WIN_H, "ACraft", NULL, NULL);
+    if (opts.isHeadless)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        if (isOffscreenContext)
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    }
+    GLFWwindow* window = glfwCreateWindow(winW, winH, "ACraft", NULL, NULL);
     glfwSetWindowCloseCallback(window, _windowCloseCb);
     glfwSetWindowSizeCallback(window, _windowResizeCb);
     glfwSetKeyCallback(window, _keyCb);
-    glfwSetCursorPosCallback(window, _mouseMoveCb);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    // The benchmark path overrides the camera, and it mustn't edit the world
+    if (!isBenchmark)
+    {
+        glfwSetCursorPosCallback(window, _mouseMoveCb);
+        glfwSetMouseButtonCallback(window, _mouseButtonCb);
+    }
+    if (!opts.isHeadless)
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwMakeContextCurrent(window);
 
     glewExperimental = true;
     GLenum glewErr = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLEW still loads the core functions without GLX
+    if (isOffscreenContext && glewErr == GLEW_ERROR_NO_GLX_DISPLAY)
+        glewErr = GLEW_OK;
+#endif
     if (glewErr != GLEW_OK)
     {
         Logger::fatal << "Failed to initialize GLEW: " << glewGetErrorString(glewErr) << Logger::End;
@@ -163,199 +396,239 @@ int main()
     //----------------------------------------------------------------------
 
     ShaderProg camModelShaderProg = ShaderProg{"../src/shaders/cam_model.vert.glsl", "../src/shaders/cam_model.frag.glsl"};
+    const int camModelMatLoc = camModelShaderProg.getUniformLocation("inModelMat");
 
     //----------------------------------------------------------------------
 
-    std::vector<Chunk> chunks;
-    chunks.push_back(genChunk(0, 0));
+    // Before any chunk is made, the sections count the blocks by their flags
+    BlockRegistry::loadOverlay(BLOCK_OVERLAY_PATH);
+    Simulation sim{&g_inputQueue, opts.seed};
+    NetClient netClient;
+    if (opts.connectAddress)
+    {
+        // The chunks come from the server
+        if (!netClient.connect(opts.connectAddress, CONNECT_VIEW_DISTANCE))
+        {
+            Logger::fatal << "Failed to connect to server: \"" << opts.connectAddress << '"' << Logger::End;
+        }
+        sim.setNetClient(&netClient);
+    }
+    else
+    {
+        std::unique_ptr<Chunk> chunk = worldStore ? worldStore->loadChunk(0, 0) : nullptr;
+        sim.getWorld().addChunk(chunk ? std::move(chunk) : WorldGen::genChunk(0, 0));
+    }
+    // Recovers the edits lost by a crash, and journals the new ones
+    if (worldStore)
+    {
+        if (!worldStore->attach(&sim.getWorld()))
+        {
+            Logger::fatal << "Failed to open the journal of world: \"" << opts.worldDir << '"' << Logger::End;
+        }
+        sim.setWorldStore(worldStore.get());
+    }
 
     //----------------------------------------------------------------------
 
     Logger::dbg << "Setting up camera model buffers" << Logger::End;
 
-    auto camModelVertices = loadObjFile("../models/camera.obj");
+    static_assert(OBJ_VALS_PER_VERT == VALS_PER_VERT);
+    ObjMesh camModelFromFile;
+    AssetPack::MeshView camModel;
+    if (!AssetPack::findMesh("../models/camera.obj", &camModel))
+    {
+        camModelFromFile = loadObjFile("../models/camera.obj");
+        if (camModelFromFile.isEmpty())
+        {
+            Logger::fatal << "Failed to load camera model" << Logger::End;
+        }
+        camModel = {camModelFromFile.vertices.data(), camModelFromFile.vertices.size(),
+                    camModelFromFile.indices.data(), camModelFromFile.indices.size()};
+    }
 
     uint camModelVao{};
     glGenVertexArrays(1, &camModelVao);
-    glBindVertexArray(camModelVao);
+    GlState::bindVao(camModelVao);
 
     uint camModelVbo{};
+    uint camModelEbo{};
     {
         glGenBuffers(1, &camModelVbo);
 
-        glBindBuffer(GL_ARRAY_BUFFER, camModelVbo);
-        glBufferData(GL_ARRAY_BUFFER, camModelVertices.size()*sizeof(float), camModelVertices.data(), GL_STATIC_DRAW);
+        GlState::bindBuffer(GL_ARRAY_BUFFER, camModelVbo);
+        glBufferData(GL_ARRAY_BUFFER, camModel.vertexValCount*sizeof(float), camModel.vertices, GL_STATIC_DRAW);
 
         glVertexAttribPointer(VERT_ATTRIB_INDEX_MESH_COORDS, 3, GL_FLOAT, GL_FALSE, VALS_PER_VERT*sizeof(float), (void*)(0));
         glEnableVertexAttribArray(VERT_ATTRIB_INDEX_MESH_COORDS);
 
         glVertexAttribPointer(VERT_ATTRIB_INDEX_TEX_COORDS, 2, GL_FLOAT, GL_FALSE, VALS_PER_VERT*sizeof(float), (void*)(3*sizeof(float)));
         glEnableVertexAttribArray(VERT_ATTRIB_INDEX_TEX_COORDS);
+
+        glGenBuffers(1, &camModelEbo);
+        // Part of the VAO state
+        GlState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, camModelEbo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, camModel.indexCount*sizeof(uint), camModel.indices, GL_STATIC_DRAW);
     }
-    glBindVertexArray(0);
+    GlState::bindVao(0);
 
     Logger::dbg << "Set up camera model buffers" << Logger::End;
 
     //----------------------------------------------------------------------
 
     Texture placeholderTex = Texture{"../textures/placeholder.png"};
+    // Load the block resources now instead of on the first frame, so it counts as startup
+    BlockStuffHandler::get();
 
     //----------------------------------------------------------------------
 
-    g_camera.setPos({0.0f, 5.0f, 0.0f});
+    sim.setPlayerPos({0.0f, 5.0f, 0.0f});
+    std::unique_ptr<InputRecording> recording;
+    if (opts.recordPath)
+    {
+        recording = std::make_unique<InputRecording>(opts.seed, winW, winH);
+        sim.recordInput(recording.get());
+    }
+    else if (opts.replayPath)
+    {
+        sim.replayInput(&replay);
+    }
+
+    std::unique_ptr<Benchmark::FrameRecorder> benchRecorder;
+    if (isBenchmark)
+        benchRecorder = std::make_unique<Benchmark::FrameRecorder>(opts.benchFrames);
+
+    FrameMetrics frameMetrics;
+    if (opts.statsCsvPath)
+        Metrics::openCsv(opts.statsCsvPath);
+
+    const float startupMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-startupBeginTime).count();
+    Logger::log << "Startup took " << startupMs << "ms" << Logger::End;
 
     double lastTime{};
-    double fps{};
-    glfwSwapInterval(1); // Force V-Sync
-    while (!glfwWindowShouldClose(window))
+    double lastTitleUpdateSec{};
+    sim.start();
+    glfwSwapInterval(isBenchmark || opts.replayPath ? 0 : 1); // Force V-Sync, except when measuring
+    for (int frameI{}; !glfwWindowShouldClose(window); ++frameI)
     {
+        if (isBenchmark && frameI >= opts.benchFrames)
+            break;
+        if (opts.replayPath && sim.isReplayDone())
+            break;
+        PROFILE_ZONE("Frame");
+        if (benchRecorder)
+            benchRecorder->beginFrame();
+
         const double currTime = glfwGetTime()*1000;
         const double deltaTime = currTime - lastTime;
         lastTime = currTime;
+        if (frameI > 0)
+            frameMetrics.frameTime.record(deltaTime);
 
-        // Calculate FPS and average with previous value for less jitter
-        fps = (fps + 1000/deltaTime) / 2;
-
+        Metrics::update(currTime/1000);
         glfwPollEvents();
 
-        bool isTitleUpdateNeeded = false;
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        const std::shared_ptr<const SimSnapshot> snapshot = sim.getSnapshot();
+        if (currTime/1000-lastTitleUpdateSec >= TITLE_UPDATE_INTERVAL_SEC)
         {
-            g_camera.moveForward(CAM_SPEED, deltaTime);
-            isTitleUpdateNeeded = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        {
-            g_camera.moveBackwards(CAM_SPEED, deltaTime);
-            isTitleUpdateNeeded = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        {
-            g_camera.moveLeft(CAM_SPEED, deltaTime);
-            isTitleUpdateNeeded = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        {
-            g_camera.moveRight(CAM_SPEED, deltaTime);
-            isTitleUpdateNeeded = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
-        {
-            g_camera.moveUp(CAM_SPEED, deltaTime);
-            isTitleUpdateNeeded = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
-        {
-            g_camera.moveDown(CAM_SPEED, deltaTime);
-            isTitleUpdateNeeded = true;
-        }
-        if (isTitleUpdateNeeded)
-        {
-            glfwSetWindowTitle(window, ("ACraft - Camera: {"
-                    +std::to_string(g_camera.getPos().x)+", "
-                    +std::to_string(g_camera.getPos().y)+", "
-                    +std::to_string(g_camera.getPos().z)+"}").c_str());
+            updateWindowTitle(window, frameMetrics, snapshot->targetedBlock);
+            lastTitleUpdateSec = currTime/1000;
         }
 
         glClearColor(0.0f, 0.5f, 0.5f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        if (g_cursRelativeX)
+        if (isBenchmark)
         {
-            g_camera.rotateHorizontallyDeg(g_cursRelativeX/10.0f);
-            g_cursRelativeX = 0;
+            // Override any input, the path has to be the same in every run
+            Benchmark::applyFlightPath(g_camera, frameI, opts.benchFrames);
         }
-        if (g_cursRelativeY)
+        else
         {
-            g_camera.rotateVerticallyDeg(g_cursRelativeY/10.0f);
-            g_cursRelativeY = 0;
+            // Smooth at any frame rate, the simulation runs at a fixed tick rate
+            const PlayerState player = snapshot->interpolatePlayer(std::chrono::steady_clock::now());
+            g_camera.setPos(player.pos);
+            g_camera.setRotationDeg(player.yawDeg, player.pitchDeg);
         }
 
+        // Upload the camera matrices once for all programs
+        // and make the frustum up to date before culling
+        g_camera.updateUniformBufferIfNeeded();
+
         // TODO: More culling
         //  * https://community.khronos.org/t/improve-performance-render-100000-objects/67088/3
 
         //------------------------ Block rendering -----------------------------
 
-        std::vector<glm::vec3> blockPositions{};
-        blockPositions.reserve(50000);
-        std::vector<int> blockTexIds{};
-        blockTexIds.reserve(50000);
-        // Prepare block data
-        for (const auto& chunk : chunks)
-        {
-            // TODO: Check for chunk visibility
-            {
-                for (int sliceI{}; sliceI < (int)chunk.blocks.size(); ++sliceI) // Y
-                {
-                    const auto& slice = chunk.blocks[sliceI];
-
-                    for (int rowI{}; rowI < (int)slice.size(); ++rowI) // Z
-                    {
-                        const auto& row = slice[rowI];
-
-                        for (int blockI{}; blockI < (int)row.size(); ++blockI) // X
-                        {
-                            const auto& block = row[blockI];
-
-                            // Don't render air
-                            if (block.type == BLOCK_TYPE_AIR)
-                                continue;
-
-                            const float x = chunk.chunkX*CHUNK_WIDTH_BLOCKS+blockI;
-                            const float y = sliceI;
-                            const float z = chunk.chunkZ*CHUNK_WIDTH_BLOCKS+rowI;
-
-                            const bool isVisible = g_camera.isPointVisible({x*2, y*2, z*2});
-
-                            // Don't render not visible blocks
-                            if (!isVisible)
-                                continue;
-
-                            blockTexIds.push_back(block.type);
-                            blockPositions.emplace_back(x, y, z);
-                        }
-                    }
-                }
-            }
-        }
-
-        //Logger::log << "Rendering " << blockPositions.size() << " objects" << Logger::End;
-
-        glfwSetWindowTitle(window, ("ACraft "
-                    "| FPS: "
-                    +std::to_string((int)std::round(fps))
-                    +"| Camera: {"
-                    +std::to_string(g_camera.getPos().x)+", "
-                    +std::to_string(g_camera.getPos().y)+", "
-                    +std::to_string(g_camera.getPos().z)+"} "
-                    "| Objs. rendered: "
-                    +std::to_string(blockPositions.size())).c_str());
-        BlockStuffHandler::get().renderBlocks(blockPositions, blockTexIds);
+        // Only the sections edited since the last frame are remeshed
+        frameMetrics.sectionsRemeshed.set(BlockStuffHandler::get().updateChunkMeshes(sim.getWorld(), sim.lockWorld()));
+        frameMetrics.sectionsRendered.set(BlockStuffHandler::get().renderChunks(g_camera));
 
         //------------------- Debug camera model rendering ---------------------
 
         if (g_isDebugCam)
         {
+            GPU_PASS("Debug camera model");
+
             auto camModelMat = glm::mat4(1.0f);
             camModelMat = glm::translate(camModelMat, {g_camera.getPos().x, g_camera.getPos().y-10, g_camera.getPos().z});
             camModelMat = glm::rotate(camModelMat, glm::radians(g_camera.getHorizRotDeg()+90.0f), {0.0f, -1.0f, 0.0f});
             camModelMat = glm::rotate(camModelMat, glm::radians(g_camera.getVertRotDeg()), {1.0f, 0.0f, 0.0f});
             camModelMat = glm::scale(camModelMat, {10.0f, 10.0f, 10.0f});
 
-            glBindVertexArray(camModelVao);
+            GlState::bindVao(camModelVao);
             camModelShaderProg.bind();
-            camModelShaderProg.setUniform("inModelMat", camModelMat);
-            g_camera.updateShaderUniformsIfNeeded(camModelShaderProg);
+            camModelShaderProg.setUniform(camModelMatLoc, camModelMat);
             placeholderTex.bind();
-            glDrawArrays(GL_TRIANGLES, 0, camModelVertices.size()/VALS_PER_VERT);
+            glDrawElements(GL_TRIANGLES, camModel.indexCount, GL_UNSIGNED_INT, nullptr);
+            GlState::countDraw(camModel.indexCount/3);
         }
 
         //----------------------------------------------------------------------
 
-        glfwSwapBuffers(window);
+        {
+            PROFILE_ZONE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
+        GlState::onFrameEnd();
+        GpuTimer::onFrameEnd();
+        recordGpuPassTimes(&frameMetrics);
+
+        const GlState::FrameStats& glStats = GlState::getLastFrameStats();
+        frameMetrics.frames.add();
+        frameMetrics.drawCalls.set(glStats.drawCalls);
+        frameMetrics.triangles.set(glStats.triangles);
+        frameMetrics.glStateChanges.set(glStats.changesIssued);
+        frameMetrics.glStateChangesAvoided.set(glStats.changesAvoided);
+
+        if (benchRecorder)
+        {
+            benchRecorder->endFrame(
+                    GlState::getLastFrameStats().drawCalls,
+                    GlState::getLastFrameStats().triangles);
+        }
+    }
+
+    if (benchRecorder)
+    {
+        benchRecorder->printJson(opts.seed, startupMs);
+        benchRecorder.reset();
     }
 
     Logger::log << "Cleaning up" << Logger::End;
+    sim.stop();
+    if (worldStore)
+        worldStore->detach();
+    if (recording)
+        recording->save(opts.recordPath);
+    if (opts.replayPath)
+    {
+        // Compare these between runs, e.g. with different --threads
+        std::printf("{\"seed\": %lu, \"ticks\": %lu, \"path_checksum\": \"%016lx\", \"world_checksum\": \"%016lx\"}\n",
+                (unsigned long)opts.seed, (unsigned long)sim.getTickCount(),
+                (unsigned long)sim.getPathChecksum(), (unsigned long)sim.getWorld().computeChecksum());
+        std::fflush(stdout);
+    }
+    Metrics::shutdown();
     glfwDestroyWindow(window);
     glfwTerminate();
     return 0;
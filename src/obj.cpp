@@ -1,228 +1,357 @@
 #include "obj.h"
 #include "Logger.h"
-#include "common.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <string_view>
 
 #define MODEL_FILE_PARSER_VERBOSE 0
 
-std::vector<float> loadObjFile(const std::string& path)
+// Polygons with more corners are rejected
+#define OBJ_MAX_POLYGON_CORNERS 64
+
+namespace
 {
-    Logger::log << "Loading model: " << path << Logger::End;
 
-    const std::string fileContents = loadTextFile(path);
+/*
+ * Reads the file contents in a single pass. Never reads past `end`.
+ */
+struct Cursor
+{
+    const char* pos{};
+    const char* end{};
 
-    std::vector<float> verticesTmp;
-    std::vector<float> uvCoordsTmp;
-    //std::vector<float> normalsTmp;
-    std::vector<float> vertices;
-    std::vector<float> uvCoords;
-    //std::vector<float> normals;
+    inline void skipSpaces()
+    {
+        while (pos < end && (*pos == ' ' || *pos == '\t'))
+            ++pos;
+    }
+
+    inline void skipLine()
+    {
+        const void* newline = std::memchr(pos, '\n', end-pos);
+        pos = newline ? (const char*)newline+1 : end;
+    }
+
+    inline bool isAtLineEnd() const
+    {
+        return pos >= end || *pos == '\n' || *pos == '\r' || *pos == '#';
+    }
+
+    inline std::string_view getWord()
+    {
+        skipSpaces();
+        const char* start = pos;
+        while (pos < end && *pos != ' ' && *pos != '\t' && *pos != '\n' && *pos != '\r')
+            ++pos;
+        return {start, (size_t)(pos-start)};
+    }
 
-    for (size_t i{}; i < fileContents.size();)
+    template <typename T>
+    inline bool parseNumber(T& out)
     {
-        std::string token;
+        const auto result = std::from_chars(pos, end, out);
+        if (result.ec != std::errc{})
+            return false;
+        pos = result.ptr;
+        return true;
+    }
+};
 
-        // Skip comments
-        if (fileContents[i] == '#')
+struct ElementCounts
+{
+    size_t positions{};
+    size_t uvs{};
+    size_t faces{};
+};
+
+/*
+ * Counts the elements so the output can be allocated up front.
+ */
+ElementCounts countElements(std::string_view contents)
+{
+    ElementCounts counts;
+    const char* pos = contents.data();
+    const char* const end = contents.data()+contents.size();
+    while (pos < end)
+    {
+        if (end-pos >= 2)
         {
-            while (i < fileContents.size() && fileContents[i] != '\n')
-                ++i;
+            if (pos[0] == 'v' && pos[1] == ' ')
+                ++counts.positions;
+            else if (pos[0] == 'f' && pos[1] == ' ')
+                ++counts.faces;
+            else if (end-pos >= 3 && pos[0] == 'v' && pos[1] == 't' && pos[2] == ' ')
+                ++counts.uvs;
         }
 
-        auto getToken{
-            [&](){
-                token.clear();
-
-                // Get token
-                while (i < fileContents.size() && !std::isspace((unsigned char)fileContents[i]))
-                    token += fileContents[i++];
-    
-                // Skip whitespace
-                while (i < fileContents.size() && (fileContents[i] == ' ' || fileContents[i] == '\t'))
-                    ++i;
-            }
-        };
+        const void* newline = std::memchr(pos, '\n', end-pos);
+        pos = newline ? (const char*)newline+1 : end;
+    }
+    return counts;
+}
 
-        auto tokenToFloat{
-            [&](){
-                try
-                {
-                    return std::stof(token.c_str(), nullptr);
-                }
-                catch (...)
-                {
-                    return 0.0f;
-                }
-            }
-        };
+/*
+ * Maps (position index, UV index) pairs to output vertex indices.
+ * Open addressing with linear probing, much faster than `std::unordered_map` here.
+ */
+class VertexDedupTable final
+{
+private:
+    // Key + 1, 0 marks an empty slot
+    std::vector<uint64_t> m_keys;
+    std::vector<uint> m_values;
+    size_t m_count{};
 
-        getToken();
+    static inline size_t hash(uint64_t key)
+    {
+        key *= 0x9e3779b97f4a7c15;
+        return key ^ (key >> 32);
+    }
 
-        if (token.compare("v") == 0)
+    void grow()
+    {
+        std::vector<uint64_t> oldKeys = std::move(m_keys);
+        std::vector<uint> oldValues = std::move(m_values);
+        m_keys.assign(oldKeys.size()*2, 0);
+        m_values.assign(oldKeys.size()*2, 0);
+        const size_t mask = m_keys.size()-1;
+        for (size_t i{}; i < oldKeys.size(); ++i)
         {
-            getToken();
-            float vertexX = tokenToFloat();
-            getToken();
-            float vertexY = tokenToFloat();
-            getToken();
-            float vertexZ = tokenToFloat();
+            if (!oldKeys[i])
+                continue;
+            size_t slot = hash(oldKeys[i]-1) & mask;
+            while (m_keys[slot])
+                slot = (slot+1) & mask;
+            m_keys[slot] = oldKeys[i];
+            m_values[slot] = oldValues[i];
+        }
+    }
 
-#if MODEL_FILE_PARSER_VERBOSE
-            Logger::dbg << "Vertex(" << vertexX << ", " << vertexY << ", " << vertexZ << ")" << Logger::End;
-#endif
+public:
+    explicit VertexDedupTable(size_t expectedCount)
+    {
+        size_t capacity = 16;
+        while (capacity < expectedCount*2)
+            capacity *= 2;
+        m_keys.assign(capacity, 0);
+        m_values.assign(capacity, 0);
+    }
 
-            verticesTmp.push_back(vertexX);
-            verticesTmp.push_back(vertexY);
-            verticesTmp.push_back(vertexZ);
+    /*
+     * Returns the index stored for `key`, or stores and returns `newValue`.
+     */
+    inline uint findOrInsert(uint64_t key, uint newValue)
+    {
+        if ((m_count+1)*2 > m_keys.size())
+            grow();
+
+        const size_t mask = m_keys.size()-1;
+        size_t slot = hash(key) & mask;
+        while (m_keys[slot])
+        {
+            if (m_keys[slot] == key+1)
+                return m_values[slot];
+            slot = (slot+1) & mask;
         }
-        else if (token.compare("vt") == 0)
+        m_keys[slot] = key+1;
+        m_values[slot] = newValue;
+        ++m_count;
+        return newValue;
+    }
+};
+
+/*
+ * Converts a 1-based or negative (relative) OBJ index to a 0-based one.
+ * Returns -1 if it is out of range.
+ */
+inline long resolveIndex(long index, size_t count)
+{
+    const long resolved = index < 0 ? (long)count+index : index-1;
+    return (resolved >= 0 && resolved < (long)count) ? resolved : -1;
+}
+
+} // End of anonymous namespace
+
+ObjMesh loadObjFile(const std::string& path)
+{
+    PROFILE_ZONE("loadObjFile");
+    Logger::log << "Loading model: " << path << Logger::End;
+
+    const MappedFile file{path};
+    if (!file.isOpen())
+    {
+        Logger::err << "Failed to open model file: " << path << Logger::End;
+        return {};
+    }
+
+    const ElementCounts counts = countElements(file.view());
+
+    std::vector<float> positions;
+    positions.reserve(counts.positions*3);
+    std::vector<float> uvCoords;
+    uvCoords.reserve(counts.uvs*2);
+
+    ObjMesh mesh;
+    // Assume triangles, polygons with more corners just grow the buffers
+    mesh.indices.reserve(counts.faces*3);
+    // Assume that vertices are shared by about half of the face corners
+    mesh.vertices.reserve(std::min(counts.positions*2, counts.faces*3)*OBJ_VALS_PER_VERT);
+    VertexDedupTable dedupTable{std::min(counts.positions*2, counts.faces*3)};
+
+    Cursor cursor{file.data(), file.data()+file.size()};
+    std::array<uint, OBJ_MAX_POLYGON_CORNERS> corners{};
+    while (cursor.pos < cursor.end)
+    {
+        const std::string_view keyword = cursor.getWord();
+
+        if (keyword == "v")
         {
-            getToken();
-            float textureX = tokenToFloat();
-            getToken();
-            float textureY = tokenToFloat();
+            float vertexX{};
+            float vertexY{};
+            float vertexZ{};
+            cursor.skipSpaces();
+            bool isValid = cursor.parseNumber(vertexX);
+            cursor.skipSpaces();
+            isValid = isValid && cursor.parseNumber(vertexY);
+            cursor.skipSpaces();
+            isValid = isValid && cursor.parseNumber(vertexZ);
+            if (!isValid)
+            {
+                Logger::err << "Invalid vertex in model: " << path << Logger::End;
+                return {};
+            }
 
 #if MODEL_FILE_PARSER_VERBOSE
-            Logger::dbg << "TexCoord(" << textureX << ", " << textureY << ")" << Logger::End;
+            Logger::dbg << "Vertex(" << vertexX << ", " << vertexY << ", " << vertexZ << ")" << Logger::End;
 #endif
 
-            uvCoordsTmp.push_back(textureX);
-            uvCoordsTmp.push_back(textureY);
+            positions.push_back(vertexX);
+            positions.push_back(vertexY);
+            positions.push_back(vertexZ);
         }
-#if 0
-        else if (token.compare("vn") == 0)
+        else if (keyword == "vt")
         {
-            getToken();
-            float normalX = tokenToFloat();
-            getToken();
-            float normalY = tokenToFloat();
-            getToken();
-            float normalZ = tokenToFloat();
+            float textureX{};
+            float textureY{};
+            cursor.skipSpaces();
+            bool isValid = cursor.parseNumber(textureX);
+            cursor.skipSpaces();
+            isValid = isValid && cursor.parseNumber(textureY);
+            if (!isValid)
+            {
+                Logger::err << "Invalid texture coordinate in model: " << path << Logger::End;
+                return {};
+            }
 
 #if MODEL_FILE_PARSER_VERBOSE
-            Logger::dbg << "Normal(" << normalX << ", " << normalY << ", " << normalZ << ")" << Logger::End;
+            Logger::dbg << "TexCoord(" << textureX << ", " << textureY << ")" << Logger::End;
 #endif
 
-            normalsTmp.push_back(normalX);
-            normalsTmp.push_back(normalY);
-            normalsTmp.push_back(normalZ);
+            uvCoords.push_back(textureX);
+            uvCoords.push_back(textureY);
         }
-#endif
-        else if (token.compare("f") == 0)
+        else if (keyword == "f")
         {
-            for (int i{}; i < 3; ++i)
+            int cornerCount{};
+            while (true)
             {
-                getToken();
-                std::string originalToken = token;
-                size_t vertexI, uvCoordI, normalI;
-                size_t numOfProcessed;
-
-                vertexI = std::stoul(token.c_str(), &numOfProcessed);
+                cursor.skipSpaces();
+                if (cursor.isAtLineEnd())
+                    break;
 
-                try
+                long vertexI{};
+                long uvCoordI{};
+                if (!cursor.parseNumber(vertexI))
                 {
-                    token = token.substr(numOfProcessed+1);
-                    uvCoordI = std::stoul(token.c_str(), &numOfProcessed);
+                    Logger::err << "Invalid face specifier in model: " << path << Logger::End;
+                    return {};
                 }
-                catch (...)
+                bool hasUvCoord = cursor.pos < cursor.end && *cursor.pos == '/';
+                if (hasUvCoord)
+                {
+                    ++cursor.pos;
+                    hasUvCoord = cursor.parseNumber(uvCoordI);
+                }
+                if (!hasUvCoord)
                 {
                     Logger::err << "Invalid face specifier (UV coordinates missing? Make sure to export model with UV coordinates included)" << Logger::End;
                     return {};
                 }
-
-                try
+                // Skip the normal index, we don't use it
+                if (cursor.pos < cursor.end && *cursor.pos == '/')
                 {
-                    token = token.substr(numOfProcessed+1);
-                    normalI = std::stoul(token.c_str(), &numOfProcessed);
+                    long normalI{};
+                    ++cursor.pos;
+                    cursor.parseNumber(normalI);
                 }
-                catch (...)
+
+                const long resolvedVertexI = resolveIndex(vertexI, positions.size()/3);
+                const long resolvedUvCoordI = resolveIndex(uvCoordI, uvCoords.size()/2);
+                if (resolvedVertexI == -1 || resolvedUvCoordI == -1)
                 {
-                    Logger::err << "Invalid face specifier (Normals missing? Make sure to export model with normals included)" << Logger::End;
+                    Logger::err << "Invalid face vertex: FaceVertex(" << vertexI << ", " << uvCoordI << ")"  << Logger::End;
+                    Logger::log << positions.size()/3 << ", " << uvCoords.size()/2 << Logger::End;
                     return {};
                 }
 
-                if (vertexI  < 1 || vertexI  > verticesTmp.size()
-                 || uvCoordI < 1 || uvCoordI > uvCoordsTmp.size()
-                /* || normalI  < 1 || normalI  > normalsTmp.size()*/)
+                if (cornerCount >= OBJ_MAX_POLYGON_CORNERS)
                 {
-                    Logger::err << "Invalid face vertex: " << originalToken
-                        << ": FaceVertex(" << vertexI << ", " << uvCoordI << ", " << normalI << ")"  << Logger::End;
-                    Logger::log << verticesTmp.size() << ", " << uvCoordsTmp.size()/* << ", " << normalsTmp.size()*/ << Logger::End;
+                    Logger::err << "Face element with more than " << OBJ_MAX_POLYGON_CORNERS << " vertices" << Logger::End;
                     return {};
                 }
 
 #if MODEL_FILE_PARSER_VERBOSE
-                Logger::dbg << "FaceVertex(" << vertexI << ", " << uvCoordI << ", " << normalI << ")" << Logger::End;
+                Logger::dbg << "FaceVertex(" << vertexI << ", " << uvCoordI << ")" << Logger::End;
 #endif
 
-                vertices.push_back(verticesTmp[(vertexI-1)*3+0]);
-                vertices.push_back(verticesTmp[(vertexI-1)*3+1]);
-                vertices.push_back(verticesTmp[(vertexI-1)*3+2]);
-                uvCoords.push_back(uvCoordsTmp[(uvCoordI-1)*2+0]);
-                uvCoords.push_back(uvCoordsTmp[(uvCoordI-1)*2+1]);
-                //normals.push_back(normalsTmp[(normalI-1)*3+0]);
-                //normals.push_back(normalsTmp[(normalI-1)*3+1]);
-                //normals.push_back(normalsTmp[(normalI-1)*3+2]);
+                const uint newIndex = mesh.vertices.size()/OBJ_VALS_PER_VERT;
+                const uint index = dedupTable.findOrInsert(((uint64_t)resolvedVertexI << 32) | (uint64_t)resolvedUvCoordI, newIndex);
+                if (index == newIndex)
+                {
+                    mesh.vertices.push_back(positions[resolvedVertexI*3+0]);
+                    mesh.vertices.push_back(positions[resolvedVertexI*3+1]);
+                    mesh.vertices.push_back(positions[resolvedVertexI*3+2]);
+                    mesh.vertices.push_back(uvCoords[resolvedUvCoordI*2+0]);
+                    mesh.vertices.push_back(uvCoords[resolvedUvCoordI*2+1]);
+                }
+                corners[cornerCount++] = index;
             }
-            getToken();
-            if (token.size())
+
+            if (cornerCount < 3)
             {
-                Logger::err << "Face element with 3+ values. Re-export model with \"Triangulate faces\" option" << Logger::End;
+                Logger::err << "Face element with less than 3 vertices" << Logger::End;
                 return {};
             }
+
+            // Triangulate as a fan
+            for (int i{2}; i < cornerCount; ++i)
+            {
+                mesh.indices.push_back(corners[0]);
+                mesh.indices.push_back(corners[i-1]);
+                mesh.indices.push_back(corners[i]);
+            }
         }
         else
         {
 #if MODEL_FILE_PARSER_VERBOSE
-            Logger::dbg << "Skipping unsupported keyword: " << token << Logger::End;
+            Logger::dbg << "Skipping unsupported keyword: " << keyword << Logger::End;
 #endif
         }
 
-        // Skip the remaining characters in the line
-        while (i < fileContents.size() && fileContents[i] != '\n')
-            ++i;
-        ++i;
+        // Skip the remaining characters in the line, including comments
+        cursor.skipLine();
     }
 
     Logger::dbg << "Parsed a model with "
-        << vertices.size()/3 << " vertices and "
-        << uvCoords.size()/2 << " UV coordinates"
-        //<< normals.size()/3 << " normals"
+        << positions.size()/3 << " positions, "
+        << uvCoords.size()/2 << " UV coordinates, "
+        << mesh.vertices.size()/OBJ_VALS_PER_VERT << " unique vertices and "
+        << mesh.indices.size()/3 << " triangles"
         << Logger::End;
 
-#if MODEL_FILE_PARSER_VERBOSE
-    Logger::dbg << "Vertices: ";
-    for (float v : vertices)
-        Logger::dbg << v << ", ";
-    Logger::dbg << Logger::End;
-
-    Logger::dbg << "UVs: ";
-    for (float v : uvCoords)
-        Logger::dbg << v << ", ";
-    Logger::dbg << Logger::End;
-
-    //Logger::dbg << "Normals: ";
-    //for (float v : normals)
-    //    Logger::dbg << v << ", ";
-    //Logger::dbg << Logger::End;
-#endif
-
-    std::vector<float> output;
-    for (size_t i{}; i < vertices.size()/3; ++i)
-    {
-        /*
-         * Vertex data layout:
-         *  * vertex (3 values)
-         *  * UV coordinates (2 values)
-         */
-
-        output.push_back(vertices[i*3+0]);
-        output.push_back(vertices[i*3+1]);
-        output.push_back(vertices[i*3+2]);
-        output.push_back(uvCoords[i*2+0]);
-        output.push_back(uvCoords[i*2+1]);
-        //m_vboData[arrayI+5] = normals[i+0];
-        //m_vboData[arrayI+6] = normals[i+1];
-        //m_vboData[arrayI+7] = normals[i+2];
-    }
-    return output;
+    return mesh;
 }
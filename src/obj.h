@@ -1,6 +1,28 @@
 #pragma once
 
+#include "types.h"
 #include <string>
 #include <vector>
 
-std::vector<float> loadObjFile(const std::string& path);
+/*
+ * Vertex data layout:
+ *  * vertex (3 values)
+ *  * UV coordinates (2 values)
+ */
+#define OBJ_VALS_PER_VERT 5
+
+struct ObjMesh
+{
+    // Unique vertices, see `OBJ_VALS_PER_VERT`
+    std::vector<float> vertices;
+    // Triangle list indexing `vertices`
+    std::vector<uint> indices;
+
+    inline bool isEmpty() const { return indices.empty(); }
+};
+
+/*
+ * Loads the positions and UV coordinates of a Wavefront OBJ model.
+ * Polygons are triangulated as fans. Returns an empty mesh on error.
+ */
+ObjMesh loadObjFile(const std::string& path);
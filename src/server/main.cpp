@@ -0,0 +1,152 @@
+/*
+ * Dedicated server: runs the world without a window and streams it to the players.
+ *
+ * Usage: acraft-server [options], see `printUsage()`
+ */
+
+#include "../Server.h"
+#include "../WorldGen.h"
+#include "../WorldStore.h"
+#include "../BlockRegistry.h"
+#include "../Logger.h"
+#include <atomic>
+#include <charconv>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+struct Options
+{
+    std::string listenAddress = NET_DEFAULT_ADDRESS;
+    uint64_t seed = std::time(nullptr);
+    bool isSeedSet{};
+    // Load and save the world in this directory, if not null
+    const char* worldDir{};
+};
+
+static std::atomic<bool> s_isStopping;
+static_assert(std::atomic<bool>::is_always_lock_free);
+
+static void onStopSignal(int)
+{
+    s_isStopping = true;
+}
+
+static void printUsage(const char* progName)
+{
+    std::cout << "Usage: " << progName << " [options]\n"
+        << "Options:\n"
+        << "  --listen ADDR   Listen on ADDR (HOST:PORT or unix:PATH), default is " NET_DEFAULT_ADDRESS "\n"
+        << "  --seed N        World seed, default is the current time, or the seed of the loaded world\n"
+        << "  --world DIR     Save the world in the directory DIR, and load it from there if it exists\n"
+        << "  --help          Show this help\n";
+}
+
+static Options parseArgs(int argc, char** argv)
+{
+    Options opts;
+    for (int i{1}; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+
+        auto getValue{[&](){
+            if (i+1 >= argc)
+            {
+                Logger::fatal << "Missing value for argument: " << arg << Logger::End;
+            }
+            return argv[++i];
+        }};
+
+        if (arg == "--listen")
+        {
+            opts.listenAddress = getValue();
+        }
+        else if (arg == "--seed")
+        {
+            const char* str = getValue();
+            const auto result = std::from_chars(str, str+std::strlen(str), opts.seed);
+            if (result.ec != std::errc{} || *result.ptr != '\0')
+            {
+                Logger::fatal << "Invalid value for argument: " << arg << Logger::End;
+            }
+            opts.isSeedSet = true;
+        }
+        else if (arg == "--world")
+        {
+            opts.worldDir = getValue();
+        }
+        else if (arg == "--help")
+        {
+            printUsage(argv[0]);
+            std::exit(0);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            Logger::fatal << "Unknown argument: " << arg << Logger::End;
+        }
+    }
+    return opts;
+}
+
+int main(int argc, char** argv)
+{
+    Options opts = parseArgs(argc, argv);
+
+    // Before any chunk is made, the sections count the blocks by their flags
+    BlockRegistry::loadOverlay(BLOCK_OVERLAY_PATH);
+
+    // The saved world decides the seed, the chunks that aren't saved yet must match the saved ones
+    std::unique_ptr<WorldStore> worldStore;
+    if (opts.worldDir)
+    {
+        worldStore = std::make_unique<WorldStore>();
+        uint64_t worldSeed = opts.seed;
+        if (!worldStore->open(opts.worldDir, &worldSeed))
+        {
+            Logger::fatal << "Failed to open world: \"" << opts.worldDir << '"' << Logger::End;
+        }
+        if (opts.isSeedSet && worldSeed != opts.seed)
+        {
+            Logger::fatal << "The world \"" << opts.worldDir << "\" was created with seed " << worldSeed
+                << ", not " << opts.seed << Logger::End;
+        }
+        opts.seed = worldSeed;
+    }
+    WorldGen::setSeed(opts.seed);
+    Logger::log << "World seed: " << opts.seed << Logger::End;
+
+    Server server{opts.seed};
+    if (worldStore)
+    {
+        // Nothing is loaded yet, the journaled chunks are loaded as the edits are replayed
+        const bool isAttached = worldStore->attach(&server.getWorld(), [&](int chunkX, int chunkZ){
+            std::unique_ptr<Chunk> chunk = worldStore->loadChunk(chunkX, chunkZ);
+            return chunk ? std::move(chunk) : WorldGen::genChunk(chunkX, chunkZ);
+        });
+        if (!isAttached)
+        {
+            Logger::fatal << "Failed to open the journal of world: \"" << opts.worldDir << '"' << Logger::End;
+        }
+        server.setWorldStore(worldStore.get());
+    }
+
+    if (!server.listen(opts.listenAddress))
+    {
+        Logger::fatal << "Failed to start the server" << Logger::End;
+    }
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+
+    server.run(s_isStopping);
+
+    Logger::log << "Stopping" << Logger::End;
+    if (worldStore)
+        worldStore->detach();
+    Logger::flush();
+    return 0;
+}
@@ -0,0 +1,15 @@
+#version 330
+
+out vec4 outColor;
+
+in vec2 texCoord;
+in float texLayerI;
+in float brightness;
+
+uniform sampler2DArray textures;
+
+void main()
+{
+    vec4 color = texture(textures, vec3(texCoord, texLayerI));
+    outColor = vec4(color.rgb*brightness, color.a);
+}
@@ -0,0 +1,38 @@
+#version 330
+
+// In block units, see `ChunkVertex`
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec2 inTexCoord;
+layout (location = 2) in float inTexLayer;
+// Sky and block light, in [0, 1]
+layout (location = 3) in vec2 inLight;
+// 0 is fully occluded, 1 is open
+layout (location = 4) in float inAo;
+
+out vec2 texCoord;
+out float texLayerI;
+out float brightness;
+
+layout (std140) uniform CameraBlock
+{
+    mat4 inViewMat;
+    mat4 inProjMat;
+};
+
+// Blocks are 2 units wide and centered on twice their position
+#define MODEL_POS_MULTIPLIER 2.0f
+#define LIGHT_MAX 15.0f
+// Each light level is this much darker than the one above it
+#define LIGHT_FALLOFF 0.8f
+#define MIN_BRIGHTNESS 0.05f
+// Brightness of a fully occluded corner
+#define AO_MIN_BRIGHTNESS 0.4f
+
+void main()
+{
+    texCoord = inTexCoord;
+    texLayerI = inTexLayer;
+    float level = max(inLight.x, inLight.y)*LIGHT_MAX;
+    brightness = max(pow(LIGHT_FALLOFF, LIGHT_MAX-level), MIN_BRIGHTNESS)*mix(AO_MIN_BRIGHTNESS, 1.0f, inAo);
+    gl_Position = inProjMat * inViewMat * vec4(inPos*MODEL_POS_MULTIPLIER - 1.0f, 1.0f);
+}
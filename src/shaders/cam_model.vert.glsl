@@ -5,8 +5,11 @@ layout (location = 1) in vec2 inTexCoord;
 
 out vec2 texCoord;
 
-uniform mat4 inViewMat;
-uniform mat4 inProjMat;
+layout (std140) uniform CameraBlock
+{
+    mat4 inViewMat;
+    mat4 inProjMat;
+};
 uniform mat4 inModelMat;
 
 #define MODEL_POS_MULTIPLIER 2.0f
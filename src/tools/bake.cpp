@@ -0,0 +1,185 @@
+/*
+ * Bakes the loose assets into a single pack, see `AssetPack.h` for the format.
+ *
+ * Usage: acraft-bake <repository root> <output path>
+ */
+
+#include "../AssetPack.h"
+#include "../Image.h"
+#include "../Logger.h"
+#include "../obj.h"
+#include "../common.h"
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_FAILURE_USERMSG // Get better error messages
+#include "../../deps/stb/stb_image.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct BakedAsset
+{
+    AssetPack::PackEntry entry;
+    std::vector<char> data;
+};
+
+static BakedAsset bakeTexture(const fs::path& path)
+{
+    BakedAsset asset;
+    asset.entry.type = AssetPack::AssetType::Texture;
+
+    // Same orientation as the runtime loader uses
+    stbi_set_flip_vertically_on_load(1);
+    int width{};
+    int height{};
+    int _{};
+    unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &_, 4);
+    if (!pixels)
+    {
+        Logger::fatal << "Failed to load texture: " << path.string() << ": " << stbi_failure_reason() << Logger::End;
+    }
+
+    const std::vector<uint8_t> mipChain = Image::generateMipChain(pixels, width, height);
+    stbi_image_free(pixels);
+
+    asset.entry.params[0] = width;
+    asset.entry.params[1] = height;
+    asset.entry.params[2] = Image::getMipLevelCount(width, height);
+    asset.data.assign(mipChain.begin(), mipChain.end());
+    return asset;
+}
+
+static BakedAsset bakeMesh(const fs::path& path)
+{
+    BakedAsset asset;
+    asset.entry.type = AssetPack::AssetType::Mesh;
+
+    const ObjMesh mesh = loadObjFile(path.string());
+    if (mesh.isEmpty())
+    {
+        Logger::fatal << "Failed to load mesh: " << path.string() << Logger::End;
+    }
+
+    const size_t vertSize = mesh.vertices.size()*sizeof(float);
+    const size_t indexSize = mesh.indices.size()*sizeof(uint);
+    asset.entry.params[0] = mesh.vertices.size();
+    asset.entry.params[1] = mesh.indices.size();
+    asset.data.resize(vertSize+indexSize);
+    std::memcpy(asset.data.data(), mesh.vertices.data(), vertSize);
+    std::memcpy(asset.data.data()+vertSize, mesh.indices.data(), indexSize);
+    return asset;
+}
+
+static BakedAsset bakeShader(const fs::path& path)
+{
+    BakedAsset asset;
+    asset.entry.type = AssetPack::AssetType::Shader;
+
+    const std::string source = loadTextFile(path.string());
+    asset.data.assign(source.begin(), source.end());
+    return asset;
+}
+
+/*
+ * Bakes the files of `dir` that have the extension `ext`, sorted by name so the output is reproducible.
+ */
+static void bakeDir(const fs::path& rootDir, const std::string& dir, const std::string& ext,
+        BakedAsset (*bakeFunc)(const fs::path&), std::vector<BakedAsset>* output)
+{
+    std::vector<fs::path> paths;
+    for (const auto& dirEntry : fs::directory_iterator{rootDir/dir})
+    {
+        if (dirEntry.is_regular_file() && dirEntry.path().extension() == ext)
+            paths.push_back(dirEntry.path());
+    }
+    std::sort(paths.begin(), paths.end());
+
+    for (const auto& path : paths)
+    {
+        const std::string name = fs::relative(path, rootDir).generic_string();
+        if (name.size() >= ASSET_PACK_NAME_LEN)
+        {
+            Logger::fatal << "Asset path is too long: " << name << Logger::End;
+        }
+
+        BakedAsset asset = bakeFunc(path);
+        std::strcpy(asset.entry.name, name.c_str());
+        asset.entry.size = asset.data.size();
+        Logger::log << "Baked " << name << " (" << asset.data.size() << " bytes)" << Logger::End;
+        output->push_back(std::move(asset));
+    }
+}
+
+static size_t alignUp(size_t value)
+{
+    return (value+ASSET_PACK_ALIGNMENT-1)/ASSET_PACK_ALIGNMENT*ASSET_PACK_ALIGNMENT;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        Logger::err << "Usage: " << argv[0] << " <repository root> <output path>" << Logger::End;
+        Logger::flush();
+        return 1;
+    }
+    Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Verbose);
+
+    const auto startTime = std::chrono::steady_clock::now();
+    const fs::path rootDir = argv[1];
+    const std::string outputPath = argv[2];
+
+    std::vector<BakedAsset> assets;
+    bakeDir(rootDir, "textures", ".png", bakeTexture, &assets);
+    bakeDir(rootDir, "models", ".obj", bakeMesh, &assets);
+    bakeDir(rootDir, "src/shaders", ".glsl", bakeShader, &assets);
+
+    AssetPack::PackHeader header;
+    std::memcpy(header.magic, ASSET_PACK_MAGIC, 4);
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = assets.size();
+
+    size_t offset = alignUp(sizeof(header)+assets.size()*sizeof(AssetPack::PackEntry));
+    for (auto& asset : assets)
+    {
+        asset.entry.offset = offset;
+        offset = alignUp(offset+asset.data.size());
+    }
+
+    // Write to a temporary file first, so a failed bake never leaves a broken pack behind
+    const std::string tempPath = outputPath+".tmp";
+    {
+        std::ofstream file{tempPath, std::ios::binary|std::ios::trunc};
+        if (!file)
+        {
+            Logger::fatal << "Failed to open output file: " << tempPath << ": " << std::strerror(errno) << Logger::End;
+        }
+
+        file.write((const char*)&header, sizeof(header));
+        for (const auto& asset : assets)
+            file.write((const char*)&asset.entry, sizeof(asset.entry));
+
+        static constexpr char padding[ASSET_PACK_ALIGNMENT]{};
+        for (const auto& asset : assets)
+        {
+            file.write(padding, asset.entry.offset-file.tellp());
+            file.write(asset.data.data(), asset.data.size());
+        }
+
+        if (!file.flush())
+        {
+            Logger::fatal << "Failed to write output file: " << tempPath << Logger::End;
+        }
+    }
+    fs::rename(tempPath, outputPath);
+
+    const float elapsedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-startTime).count();
+    Logger::log << "Wrote " << assets.size() << " assets (" << offset/1024 << " KiB) to "
+        << outputPath << " in " << elapsedMs << "ms" << Logger::End;
+    Logger::flush();
+    return 0;
+}
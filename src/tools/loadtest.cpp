@@ -0,0 +1,131 @@
+/*
+ * Connects players that fly away from the spawn in all directions to a server,
+ * then reports the bandwidth per player and the tick times of the server.
+ *
+ * Usage: acraft-loadtest [address] [player count] [seconds] [view distance]
+ */
+
+#include "../NetClient.h"
+#include "../Logger.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The server's tick rate, the players move and send their positions this often
+#define LOADTEST_TICKS_PER_SEC 20
+// In blocks per second, faster than the chunks can be generated on a small machine
+#define LOADTEST_PLAYER_SPEED 20.0f
+#define LOADTEST_PLAYER_HEIGHT 300.0f
+// Ticks between the block edits of each player
+#define LOADTEST_EDIT_INTERVAL_TICKS 10
+
+static long getArgOr(int argc, char** argv, int i, long defaultVal)
+{
+    if (i >= argc)
+        return defaultVal;
+
+    long value{};
+    const auto result = std::from_chars(argv[i], argv[i]+std::strlen(argv[i]), value);
+    if (result.ec != std::errc{} || value <= 0)
+    {
+        Logger::fatal << "Invalid numeric argument: " << argv[i] << Logger::End;
+    }
+    return value;
+}
+
+int main(int argc, char** argv)
+{
+    const std::string address = argc > 1 ? argv[1] : NET_DEFAULT_ADDRESS;
+    const int playerCount = getArgOr(argc, argv, 2, 8);
+    const int seconds = getArgOr(argc, argv, 3, 30);
+    const int viewDistance = getArgOr(argc, argv, 4, 8);
+    Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Verbose);
+
+    std::vector<std::unique_ptr<NetClient>> clients;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> directions;
+    for (int i{}; i < playerCount; ++i)
+    {
+        auto client = std::make_unique<NetClient>();
+        if (!client->connect(address, viewDistance))
+        {
+            Logger::fatal << "Failed to connect player " << i << " to: \"" << address << '"' << Logger::End;
+        }
+        // The server tick times are the same for everyone
+        client->setRecordingServerTickMs(i == 0);
+        clients.push_back(std::move(client));
+        const float angle = 2*M_PI*i/playerCount;
+        positions.push_back({0.0f, LOADTEST_PLAYER_HEIGHT, 0.0f});
+        directions.push_back({std::cos(angle), 0.0f, std::sin(angle)});
+    }
+    Logger::log << "Connected " << playerCount << " players to " << address << ", view distance: "
+        << viewDistance << ", running for " << seconds << 's' << Logger::End;
+
+    using Clock = std::chrono::steady_clock;
+    const auto tickDuration = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>{1.0/LOADTEST_TICKS_PER_SEC});
+    // Seen by the first player, they are the same for everyone
+    std::vector<float> serverTickMs;
+    const auto startTime = Clock::now();
+    Clock::time_point nextTickTime = startTime;
+    for (int tickI{}; tickI < seconds*LOADTEST_TICKS_PER_SEC; ++tickI)
+    {
+        for (int i{}; i < playerCount; ++i)
+        {
+            NetClient& client = *clients[i];
+            positions[i] += directions[i]*(LOADTEST_PLAYER_SPEED/LOADTEST_TICKS_PER_SEC);
+            client.sendPlayerPos(positions[i]);
+            // Below the player, in a chunk it already has unless it's moving too fast for the server
+            if (tickI%LOADTEST_EDIT_INTERVAL_TICKS == i%LOADTEST_EDIT_INTERVAL_TICKS)
+            {
+                client.sendSetBlock({(int)std::floor(positions[i].x), (int)LOADTEST_PLAYER_HEIGHT-10,
+                        (int)std::floor(positions[i].z)}, {BLOCK_TYPE_COBBLESTONE});
+            }
+            if (!client.update(nullptr))
+            {
+                Logger::fatal << "Player " << i << " lost the connection" << Logger::End;
+            }
+        }
+        const std::vector<float> tickMs = clients[0]->takeServerTickMs();
+        serverTickMs.insert(serverTickMs.end(), tickMs.begin(), tickMs.end());
+
+        nextTickTime += tickDuration;
+        std::this_thread::sleep_until(nextTickTime);
+    }
+    const float elapsedSec = std::chrono::duration<float>(Clock::now()-startTime).count();
+
+    uint64_t receivedBytes{};
+    uint64_t sentBytes{};
+    long chunkCount{};
+    for (const auto& client : clients)
+    {
+        receivedBytes += client->getReceivedBytes();
+        sentBytes += client->getSentBytes();
+        chunkCount += client->getReceivedChunkCount();
+    }
+    Logger::log << "Per player: down: " << receivedBytes/1024.0f/elapsedSec/playerCount << "KiB/s, up: "
+        << sentBytes/1024.0f/elapsedSec/playerCount << "KiB/s, chunks received: " << chunkCount/playerCount
+        << " (" << (float)receivedBytes/std::max(chunkCount, 1l)/1024 << "KiB/chunk with the deltas)" << Logger::End;
+
+    if (serverTickMs.empty())
+    {
+        Logger::warn << "No tick messages were received" << Logger::End;
+    }
+    else
+    {
+        std::sort(serverTickMs.begin(), serverTickMs.end());
+        Logger::log << "Server tick time over " << serverTickMs.size() << " ticks: avg: "
+            << std::accumulate(serverTickMs.begin(), serverTickMs.end(), 0.0)/serverTickMs.size()
+            << "ms, p99: " << serverTickMs[serverTickMs.size()*99/100] << "ms, max: " << serverTickMs.back()
+            << "ms" << Logger::End;
+    }
+    Logger::flush();
+    return 0;
+}